@@ -12,5 +12,29 @@
 #include "dispatch/error.hpp"
 #include "dispatch/commands.hpp"
 #include "dispatch/tables.hpp"
+#include "dispatch/statistics.hpp"
+#include "dispatch/counters.hpp"
+#include "dispatch/histograms.hpp"
+#include "dispatch/tracer.hpp"
+#include "dispatch/profiler.hpp"
+#include "dispatch/instrumented_tables.hpp"
+#include "dispatch/hooked_tables.hpp"
+#include "dispatch/policies.hpp"
+#include "dispatch/intercepted_tables.hpp"
+#include "dispatch/trampoline_tables.hpp"
+#include "dispatch/cached_tables.hpp"
+#include "dispatch/batching.hpp"
+#include "dispatch/funneling.hpp"
+#include "dispatch/coalescing.hpp"
+#include "dispatch/barriers.hpp"
+#include "dispatch/filtering.hpp"
+#include "dispatch/recording.hpp"
+#include "dispatch/pipeline_caches.hpp"
+#include "dispatch/compilation.hpp"
+#include "dispatch/deduplication.hpp"
+#include "dispatch/allocation.hpp"
+#include "dispatch/destruction.hpp"
+#include "dispatch/awaiting.hpp"
+#include "dispatch/capture.hpp"
 
 #endif
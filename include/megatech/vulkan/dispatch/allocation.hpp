@@ -0,0 +1,377 @@
+/**
+ * @file allocation.hpp
+ * @brief Vulkan Pooled Host Allocation
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_ALLOCATION_HPP
+#define MEGATECH_VULKAN_DISPATCH_ALLOCATION_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <memory>
+#include <type_traits>
+
+#include "defs.hpp"
+
+#include "internal/base/allocation.hpp"
+
+/**
+ * @def MEGATECH_VULKAN_DISPATCH_INSTANCE_ALLOCATION_COMMAND_LIST
+ * @brief Expand a macro for every Vulkan 1.0 instance-level command that accepts allocation callbacks.
+ * @details `vkDestroyInstance` is excluded. Instances are created by a global command, which can't be intercepted, so
+ *          the policy can't ensure that an instance was created with compatible callbacks. Instances created with
+ *          `host_allocator::callbacks()` **MUST** be destroyed with them explicitly.
+ * @param entry A function-like macro that accepts a command name.
+ */
+#define MEGATECH_VULKAN_DISPATCH_INSTANCE_ALLOCATION_COMMAND_LIST(entry) \
+  entry(vkCreateDevice)
+
+/**
+ * @def MEGATECH_VULKAN_DISPATCH_DEVICE_ALLOCATION_COMMAND_LIST
+ * @brief Expand a macro for every Vulkan 1.0 device-level command that accepts allocation callbacks.
+ * @param entry A function-like macro that accepts a command name.
+ */
+#define MEGATECH_VULKAN_DISPATCH_DEVICE_ALLOCATION_COMMAND_LIST(entry) \
+  entry(vkDestroyDevice) entry(vkAllocateMemory) entry(vkFreeMemory) entry(vkCreateFence) entry(vkDestroyFence) \
+  entry(vkCreateSemaphore) entry(vkDestroySemaphore) entry(vkCreateEvent) entry(vkDestroyEvent) \
+  entry(vkCreateQueryPool) entry(vkDestroyQueryPool) entry(vkCreateBuffer) entry(vkDestroyBuffer) \
+  entry(vkCreateBufferView) entry(vkDestroyBufferView) entry(vkCreateImage) entry(vkDestroyImage) \
+  entry(vkCreateImageView) entry(vkDestroyImageView) entry(vkCreateShaderModule) entry(vkDestroyShaderModule) \
+  entry(vkCreatePipelineCache) entry(vkDestroyPipelineCache) entry(vkCreateGraphicsPipelines) \
+  entry(vkCreateComputePipelines) entry(vkDestroyPipeline) entry(vkCreatePipelineLayout) \
+  entry(vkDestroyPipelineLayout) entry(vkCreateSampler) entry(vkDestroySampler) entry(vkCreateDescriptorSetLayout) \
+  entry(vkDestroyDescriptorSetLayout) entry(vkCreateDescriptorPool) entry(vkDestroyDescriptorPool) \
+  entry(vkCreateFramebuffer) entry(vkDestroyFramebuffer) entry(vkCreateRenderPass) entry(vkDestroyRenderPass) \
+  entry(vkCreateCommandPool) entry(vkDestroyCommandPool)
+
+/// @cond INTERNAL
+#define MEGATECH_VULKAN_DISPATCH_INTERCEPT_ALLOCATION(level, name) \
+  static_assert(::megatech::vulkan::dispatch::internal::base::allocates< \
+                ::megatech::vulkan::dispatch::level::command::name>()); \
+  megatech_vulkan_dispatch_table.template intercept<::megatech::vulkan::dispatch::level::command::name, \
+                                                    PFN_##name>();
+#define MEGATECH_VULKAN_DISPATCH_INTERCEPT_INSTANCE_ALLOCATION(name) \
+  MEGATECH_VULKAN_DISPATCH_INTERCEPT_ALLOCATION(instance, name)
+#define MEGATECH_VULKAN_DISPATCH_INTERCEPT_DEVICE_ALLOCATION(name) \
+  MEGATECH_VULKAN_DISPATCH_INTERCEPT_ALLOCATION(device, name)
+/// @endcond
+
+/**
+ * @def MEGATECH_VULKAN_DISPATCH_INTERCEPT_INSTANCE_ALLOCATIONS
+ * @brief Intercept every command of ::MEGATECH_VULKAN_DISPATCH_INSTANCE_ALLOCATION_COMMAND_LIST.
+ * @details The library never names Vulkan types, so this expands in client code. The `PFN_` type of every listed
+ *          command **MUST** be declared.
+ * @param table An instance::intercepted_table.
+ */
+#define MEGATECH_VULKAN_DISPATCH_INTERCEPT_INSTANCE_ALLOCATIONS(table) \
+  do \
+  { \
+    auto& megatech_vulkan_dispatch_table = (table); \
+    MEGATECH_VULKAN_DISPATCH_INSTANCE_ALLOCATION_COMMAND_LIST(MEGATECH_VULKAN_DISPATCH_INTERCEPT_INSTANCE_ALLOCATION) \
+  } \
+  while (0)
+
+/**
+ * @def MEGATECH_VULKAN_DISPATCH_INTERCEPT_DEVICE_ALLOCATIONS
+ * @brief Intercept every command of ::MEGATECH_VULKAN_DISPATCH_DEVICE_ALLOCATION_COMMAND_LIST.
+ * @details The library never names Vulkan types, so this expands in client code. The `PFN_` type of every listed
+ *          command **MUST** be declared.
+ * @param table A device::intercepted_table.
+ */
+#define MEGATECH_VULKAN_DISPATCH_INTERCEPT_DEVICE_ALLOCATIONS(table) \
+  do \
+  { \
+    auto& megatech_vulkan_dispatch_table = (table); \
+    MEGATECH_VULKAN_DISPATCH_DEVICE_ALLOCATION_COMMAND_LIST(MEGATECH_VULKAN_DISPATCH_INTERCEPT_DEVICE_ALLOCATION) \
+  } \
+  while (0)
+
+namespace megatech::vulkan::dispatch {
+
+  /**
+   * @brief Statistics describing the host allocations made in a single `VkSystemAllocationScope`.
+   */
+  struct host_allocation_statistics final {
+    /**
+     * @brief The number of successful allocations.
+     */
+    std::uint64_t allocations{ };
+
+    /**
+     * @brief The number of successful reallocations.
+     */
+    std::uint64_t reallocations{ };
+
+    /**
+     * @brief The number of frees.
+     */
+    std::uint64_t frees{ };
+
+    /**
+     * @brief The number of requested bytes that haven't been freed.
+     */
+    std::uint64_t live_bytes{ };
+
+    /**
+     * @brief The number of bytes that the driver reports allocating internally without the callbacks.
+     */
+    std::uint64_t internal_bytes{ };
+  };
+
+  /**
+   * @brief A pooled host memory allocator for driver allocations.
+   * @details Allocations are served according to their `VkSystemAllocationScope`:
+   *
+   *          - Command scope allocations only live for the duration of a single command. They are bump allocated from
+   *            a per-thread arena. A chunk of the arena is rewound once every allocation in it has been freed.
+   *          - Every other scope is served from size-class pools of up to 4 KiB. Each thread caches free blocks of
+   *            every size, so steady-state allocation and freeing takes no locks.
+   *
+   *          Allocations that are too large for an arena or a pool fall back to the global `operator new`. Memory
+   *          **MAY** be freed or reallocated by any thread. All memory is released when the pool is destroyed, so the
+   *          pool **MUST** outlive every object that was created with it. The pool is safe to use concurrently.
+   */
+  class host_memory_pool final {
+  private:
+    struct implementation;
+
+    std::unique_ptr<implementation> m_implementation;
+  public:
+    /**
+     * @brief Construct an empty host memory pool.
+     */
+    host_memory_pool();
+
+    /// @cond
+    host_memory_pool(const host_memory_pool& other) = delete;
+    host_memory_pool(host_memory_pool&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a host memory pool and release all of its memory.
+     */
+    ~host_memory_pool() noexcept;
+
+    /// @cond
+    host_memory_pool& operator=(const host_memory_pool& rhs) = delete;
+    host_memory_pool& operator=(host_memory_pool&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Allocate memory.
+     * @param size The size of the allocation in bytes.
+     * @param alignment The alignment of the allocation in bytes. This **MUST** be a power of 2.
+     * @param scope The value of the allocation's `VkSystemAllocationScope`.
+     * @return A pointer to the allocated memory, or null if `size` is zero or if the allocation failed.
+     */
+    void* allocate(const std::size_t size, const std::size_t alignment, const std::size_t scope) noexcept;
+
+    /**
+     * @brief Reallocate memory.
+     * @details The contents of the original allocation are preserved up to the lesser of the old and new sizes. If
+     *          reallocation fails, the original allocation is unchanged.
+     * @param original The allocation to reallocate or null. This **MUST** have been allocated by this pool.
+     * @param size The new size of the allocation in bytes. If this is zero, the original allocation is freed.
+     * @param alignment The alignment of the allocation in bytes. This **MUST** match the original alignment.
+     * @param scope The value of the allocation's `VkSystemAllocationScope`.
+     * @return A pointer to the reallocated memory, or null if `size` is zero or if the reallocation failed.
+     */
+    void* reallocate(void *const original, const std::size_t size, const std::size_t alignment,
+                     const std::size_t scope) noexcept;
+
+    /**
+     * @brief Free memory.
+     * @param memory The allocation to free or null. This **MUST** have been allocated by this pool.
+     */
+    void free(void *const memory) noexcept;
+
+    /**
+     * @brief Record a notification of an internal driver allocation.
+     * @param size The size of the allocation in bytes.
+     * @param scope The value of the allocation's `VkSystemAllocationScope`.
+     */
+    void record_internal_allocation(const std::size_t size, const std::size_t scope) noexcept;
+
+    /**
+     * @brief Record a notification of an internal driver free.
+     * @param size The size of the freed allocation in bytes.
+     * @param scope The value of the allocation's `VkSystemAllocationScope`.
+     */
+    void record_internal_free(const std::size_t size, const std::size_t scope) noexcept;
+
+    /**
+     * @brief Retrieve the statistics of an allocation scope.
+     * @details Statistics are accumulated by each thread, so they **MAY** lag behind concurrent allocations.
+     * @param scope The value of the `VkSystemAllocationScope` to retrieve.
+     * @return The statistics of all allocations made in `scope`.
+     */
+    host_allocation_statistics statistics(const std::size_t scope) const;
+  };
+
+  /**
+   * @brief A set of Vulkan allocation callbacks backed by a host_memory_pool.
+   * @details The allocator's callbacks can be passed to creation commands directly, or the allocator's policy can pass
+   *          them to every command that is called without callbacks. For example:
+   *          @code{.cpp}
+   *          auto allocator = host_allocator<VkAllocationCallbacks>{ };
+   *          auto dit = intercepted_table<host_allocator<VkAllocationCallbacks>::policy>{ ddt };
+   *          dit.policy<host_allocator<VkAllocationCallbacks>::policy>().set_allocator(&allocator);
+   *          MEGATECH_VULKAN_DISPATCH_INTERCEPT_DEVICE_ALLOCATIONS(dit);
+   *          dit.intercept<command::vkCreateSwapchainKHR, PFN_vkCreateSwapchainKHR>();
+   *          dit.intercept<command::vkDestroySwapchainKHR, PFN_vkDestroySwapchainKHR>();
+   *          @endcode
+   *
+   *          The bulk interception macros only cover Vulkan 1.0 commands. Later core and extension commands that
+   *          accept callbacks are intercepted individually.
+   *
+   *          Vulkan requires objects to be destroyed with callbacks that are compatible with the callbacks they were
+   *          created with. Destruction commands **MUST** therefore be routed through the policy whenever creation
+   *          commands are, and objects created without the policy **MUST** be destroyed without it.
+   * @tparam Callbacks The allocation callbacks structure type (i.e., `VkAllocationCallbacks`).
+   */
+  template <typename Callbacks>
+  class host_allocator final {
+  public:
+    /**
+     * @brief An interception policy that supplies a host_allocator's callbacks to calls without callbacks.
+     * @details Any argument of type `const Callbacks*` that is null is replaced. Calls that supply their own callbacks
+     *          are unchanged. When no allocator is attached, the policy costs a single load and branch per call.
+     *          Commands whose names don't begin with `vkCreate`, `vkDestroy`, `vkAllocate`, or `vkFree` pass through
+     *          the policy at no cost.
+     */
+    class policy final {
+    private:
+      const host_allocator* m_allocator{ };
+
+      template <typename Argument>
+      Argument substitute(const Argument argument) const noexcept {
+        if constexpr (std::is_same_v<Argument, const Callbacks*>)
+        {
+          return argument ? argument : m_allocator->callbacks();
+        }
+        else
+        {
+          return argument;
+        }
+      }
+    public:
+      /**
+       * @brief Supply allocation callbacks to the call and continue the chain.
+       * @tparam Cmd The called command.
+       * @param next The remainder of the policy chain.
+       * @param arguments The arguments of the call.
+       * @return The result of `next`.
+       */
+      template <auto Cmd, typename Next, typename... Arguments>
+      decltype(auto) invoke(const Next& next, Arguments... arguments) {
+        if constexpr (internal::base::allocates<Cmd>())
+        {
+          if (m_allocator)
+          {
+            return next(substitute(arguments)...);
+          }
+        }
+        return next(arguments...);
+      }
+
+      /**
+       * @brief Attach a host_allocator to the policy.
+       * @details This **MUST NOT** be called concurrently with calls through the owning table.
+       * @param allocator A pointer to the allocator to attach or null.
+       */
+      void set_allocator(const host_allocator *const allocator) noexcept {
+        m_allocator = allocator;
+      }
+
+      /**
+       * @brief Retrieve the host_allocator attached to the policy.
+       * @return A pointer to the attached allocator, or null if no allocator is attached.
+       */
+      const host_allocator* allocator() const noexcept {
+        return m_allocator;
+      }
+    };
+  private:
+    using scope = typename internal::base::allocation_signature<decltype(Callbacks::pfnAllocation)>::scope;
+    using internal_type = typename internal::base::notification_signature<
+      decltype(Callbacks::pfnInternalAllocation)>::type;
+
+    host_memory_pool m_pool{ };
+    Callbacks m_callbacks{ };
+
+    static host_memory_pool& pool_of(void *const user) noexcept {
+      return static_cast<host_allocator*>(user)->m_pool;
+    }
+
+    static MEGATECH_VULKAN_DISPATCH_API_ATTR void* MEGATECH_VULKAN_DISPATCH_API_CALL
+    allocate(void *const user, const std::size_t size, const std::size_t alignment, const scope current) {
+      return pool_of(user).allocate(size, alignment, static_cast<std::size_t>(current));
+    }
+
+    static MEGATECH_VULKAN_DISPATCH_API_ATTR void* MEGATECH_VULKAN_DISPATCH_API_CALL
+    reallocate(void *const user, void *const original, const std::size_t size, const std::size_t alignment,
+               const scope current) {
+      return pool_of(user).reallocate(original, size, alignment, static_cast<std::size_t>(current));
+    }
+
+    static MEGATECH_VULKAN_DISPATCH_API_ATTR void MEGATECH_VULKAN_DISPATCH_API_CALL
+    free(void *const user, void *const memory) {
+      pool_of(user).free(memory);
+    }
+
+    static MEGATECH_VULKAN_DISPATCH_API_ATTR void MEGATECH_VULKAN_DISPATCH_API_CALL
+    notify_allocation(void *const user, const std::size_t size, const internal_type, const scope current) {
+      pool_of(user).record_internal_allocation(size, static_cast<std::size_t>(current));
+    }
+
+    static MEGATECH_VULKAN_DISPATCH_API_ATTR void MEGATECH_VULKAN_DISPATCH_API_CALL
+    notify_free(void *const user, const std::size_t size, const internal_type, const scope current) {
+      pool_of(user).record_internal_free(size, static_cast<std::size_t>(current));
+    }
+  public:
+    /**
+     * @brief Construct a host allocator with an empty pool.
+     */
+    host_allocator() {
+      m_callbacks.pUserData = this;
+      m_callbacks.pfnAllocation = &allocate;
+      m_callbacks.pfnReallocation = &reallocate;
+      m_callbacks.pfnFree = &free;
+      m_callbacks.pfnInternalAllocation = &notify_allocation;
+      m_callbacks.pfnInternalFree = &notify_free;
+    }
+
+    /// @cond
+    host_allocator(const host_allocator& other) = delete;
+    host_allocator(host_allocator&& other) = delete;
+
+    ~host_allocator() noexcept = default;
+
+    host_allocator& operator=(const host_allocator& rhs) = delete;
+    host_allocator& operator=(host_allocator&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Retrieve the allocator's callbacks.
+     * @return A pointer to callbacks that remain valid for the allocator's entire lifetime.
+     */
+    const Callbacks* callbacks() const noexcept {
+      return &m_callbacks;
+    }
+
+    /**
+     * @brief Retrieve the statistics of an allocation scope.
+     * @param current The `VkSystemAllocationScope` to retrieve.
+     * @return The statistics of all allocations made in `current`.
+     */
+    host_allocation_statistics statistics(const scope current) const {
+      return m_pool.statistics(static_cast<std::size_t>(current));
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,436 @@
+/**
+ * @file awaiting.hpp
+ * @brief Vulkan Asynchronous Waiting
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_AWAITING_HPP
+#define MEGATECH_VULKAN_DISPATCH_AWAITING_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "tables.hpp"
+
+#include "internal/base/awaiting.hpp"
+#include "internal/base/destruction.hpp"
+#include "internal/base/fnv_1a.hpp"
+#include "internal/base/slots.hpp"
+#include "internal/base/work_stealing.hpp"
+
+namespace megatech::vulkan::dispatch::device {
+
+  /**
+   * @brief A reactor that lets coroutines wait for fences and timeline semaphores without blocking threads.
+   * @details A single reactor thread waits for every outstanding object at once. While timeline semaphores are awaited,
+   *          it blocks in one `vkWaitSemaphores` call on all of them with `VK_SEMAPHORE_WAIT_ANY_BIT`. Fences are
+   *          polled with `vkGetFenceStatus`. Once an object is ready, the coroutine that awaited it is resumed on a
+   *          work-stealing pool of executor threads. For example:
+   *          @code{.cpp}
+   *          using reactor = wait_reactor<PFN_vkGetFenceStatus, PFN_vkGetSemaphoreCounterValue,
+   *                                       PFN_vkWaitSemaphores>;
+   *          auto waits = reactor{ ddt };
+   *          // Inside of a coroutine:
+   *          if (co_await waits.wait(fence) == VK_SUCCESS)
+   *          {
+   *            // ...use the results of the submission.
+   *          }
+   *          if (co_await waits.wait(timeline, value) == VK_SUCCESS)
+   *          {
+   *            // ...
+   *          }
+   *          @endcode
+   *
+   *          Objects that are ready when they're awaited don't suspend the coroutine at all. Newly awaited objects are
+   *          noticed by the reactor within one polling interval. If a command fails (e.g., because the device was
+   *          lost), every coroutine waiting on the failing object is resumed with the failing result.
+   *
+   *          Coroutines that are still waiting when the reactor is destroyed are resumed with `VK_NOT_READY`. So are
+   *          coroutines that begin waiting after destruction has begun. Awaited objects **MUST** remain valid until the
+   *          coroutine waiting on them is resumed. The reactor is safe to use concurrently.
+   * @tparam GetFenceStatus The function pointer type of `vkGetFenceStatus` (i.e., `PFN_vkGetFenceStatus`).
+   * @tparam GetCounterValue The function pointer type of `vkGetSemaphoreCounterValue` (i.e.,
+   *                         `PFN_vkGetSemaphoreCounterValue`).
+   * @tparam WaitSemaphores The function pointer type of `vkWaitSemaphores` (i.e., `PFN_vkWaitSemaphores`).
+   */
+  template <internal::base::command_pointer GetFenceStatus, internal::base::command_pointer GetCounterValue,
+            internal::base::command_pointer WaitSemaphores>
+  class wait_reactor final {
+  private:
+    using fence_signature = internal::base::fence_status_signature<GetFenceStatus>;
+    using counter_signature = internal::base::counter_value_signature<GetCounterValue>;
+    using wait_signature = internal::base::wait_semaphores_signature<WaitSemaphores>;
+  public:
+    /**
+     * @brief The result type of waiting (i.e., `VkResult`).
+     */
+    using result = typename fence_signature::result;
+
+    /**
+     * @brief The fence handle type (i.e., `VkFence`).
+     */
+    using fence = typename fence_signature::fence;
+
+    /**
+     * @brief The semaphore handle type (i.e., `VkSemaphore`).
+     */
+    using semaphore = typename counter_signature::semaphore;
+  private:
+    struct waiter final {
+      fence awaited_fence{ };
+      semaphore awaited_semaphore{ };
+      std::uint64_t value{ };
+      std::coroutine_handle<> continuation{ };
+      result status{ };
+    };
+  public:
+    /**
+     * @brief An awaitable wait for a fence or a timeline semaphore value.
+     * @details Awaiting produces `VK_SUCCESS` once the object is ready, or the result of the failing command.
+     */
+    class awaitable final {
+    private:
+      friend class wait_reactor;
+
+      wait_reactor* m_reactor{ };
+      waiter m_waiter{ };
+
+      awaitable(wait_reactor& reactor, const waiter& pending) noexcept :
+      m_reactor{ &reactor },
+      m_waiter{ pending } { }
+    public:
+      /// @cond
+      awaitable(const awaitable& other) = delete;
+      awaitable(awaitable&& other) = delete;
+
+      ~awaitable() noexcept = default;
+
+      awaitable& operator=(const awaitable& rhs) = delete;
+      awaitable& operator=(awaitable&& rhs) = delete;
+
+      bool await_ready() {
+        return m_reactor->ready(m_waiter);
+      }
+
+      bool await_suspend(const std::coroutine_handle<> continuation) {
+        m_waiter.continuation = continuation;
+        return m_reactor->enqueue(m_waiter);
+      }
+
+      result await_resume() const noexcept {
+        return m_waiter.status;
+      }
+      /// @endcond
+    };
+  private:
+    typename fence_signature::device m_device{ };
+    GetFenceStatus m_fence_status{ };
+    GetCounterValue m_counter_value{ };
+    WaitSemaphores m_wait_semaphores{ };
+    std::chrono::nanoseconds m_interval{ };
+    std::mutex m_mutex{ };
+    std::condition_variable_any m_arrived{ };
+    std::vector<waiter*> m_incoming{ };
+    bool m_stopping{ };
+    std::atomic<std::uint64_t> m_waiting{ };
+    std::atomic<std::uint64_t> m_resumed{ };
+    std::jthread m_reactor{ };
+    // The executor is destroyed first, so resumed coroutines can still reach the rest of the reactor.
+    internal::base::work_stealing_pool<std::coroutine_handle<>> m_executor;
+
+    template <typename Pointer>
+    static Pointer resolve(const table& base, const std::uint_least64_t hash) noexcept {
+      const auto pfn = static_cast<const Pointer*>(base.get(hash));
+      return pfn ? *pfn : nullptr;
+    }
+
+    static std::size_t checked(const std::size_t threads) {
+      if (!threads)
+      {
+        throw dispatch::error{ "A wait reactor requires at least 1 executor thread." };
+      }
+      return threads;
+    }
+
+    static std::size_t default_threads() noexcept {
+      return std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    bool ready(waiter& pending) const {
+      if (pending.awaited_fence)
+      {
+        pending.status = m_fence_status(m_device, pending.awaited_fence);
+        return pending.status != static_cast<result>(internal::base::not_ready);
+      }
+      auto current = std::uint64_t{ 0 };
+      pending.status = m_counter_value(m_device, pending.awaited_semaphore, &current);
+      return pending.status != result{ } || current >= pending.value;
+    }
+
+    bool enqueue(waiter& pending) {
+      {
+        auto lock = std::unique_lock<std::mutex>{ m_mutex };
+        if (m_stopping)
+        {
+          pending.status = static_cast<result>(internal::base::not_ready);
+          return false;
+        }
+        m_incoming.emplace_back(&pending);
+        m_waiting.fetch_add(1, std::memory_order_relaxed);
+      }
+      m_arrived.notify_one();
+      return true;
+    }
+
+    void resume(waiter& pending) {
+      m_waiting.fetch_sub(1, std::memory_order_relaxed);
+      m_resumed.fetch_add(1, std::memory_order_relaxed);
+      m_executor.submit(pending.continuation);
+    }
+
+    // Block until any awaited timeline value might have been reached, a waiter arrives, or the interval elapses.
+    void block(const std::stop_token& stop, const std::vector<waiter*>& active,
+               std::vector<std::pair<semaphore, std::uint64_t>>& targets) {
+      targets.clear();
+      for (const auto pending : active)
+      {
+        if (!pending->awaited_fence)
+        {
+          targets.emplace_back(pending->awaited_semaphore, pending->value);
+        }
+      }
+      if (!targets.empty())
+      {
+        // Only the lowest value of each semaphore matters, and each semaphore may only be waited on once.
+        std::sort(targets.begin(), targets.end());
+        targets.erase(std::unique(targets.begin(), targets.end(), [](const auto& a, const auto& b) {
+          return a.first == b.first;
+        }), targets.end());
+        auto semaphores = std::vector<semaphore>{ };
+        auto values = std::vector<std::uint64_t>{ };
+        semaphores.reserve(targets.size());
+        values.reserve(targets.size());
+        for (const auto& [handle, value] : targets)
+        {
+          semaphores.emplace_back(handle);
+          values.emplace_back(value);
+        }
+        auto info = typename wait_signature::info{ };
+        info.sType = static_cast<decltype(info.sType)>(internal::base::semaphore_wait_info_type);
+        info.flags = internal::base::semaphore_wait_any;
+        info.semaphoreCount = static_cast<std::uint32_t>(semaphores.size());
+        info.pSemaphores = semaphores.data();
+        info.pValues = values.data();
+        const auto status = m_wait_semaphores(m_device, &info, m_interval.count());
+        if (status == result{ } || status == static_cast<result>(internal::base::timeout))
+        {
+          return;
+        }
+      }
+      auto lock = std::unique_lock<std::mutex>{ m_mutex };
+      m_arrived.wait_for(lock, stop, m_interval, [this]() { return !m_incoming.empty(); });
+    }
+
+    void poll(std::vector<waiter*>& active, std::unordered_map<semaphore, std::pair<result, std::uint64_t>>& counters) {
+      counters.clear();
+      auto i = std::size_t{ 0 };
+      while (i < active.size())
+      {
+        auto& pending = *active[i];
+        auto complete = false;
+        if (pending.awaited_fence)
+        {
+          pending.status = m_fence_status(m_device, pending.awaited_fence);
+          complete = pending.status != static_cast<result>(internal::base::not_ready);
+        }
+        else
+        {
+          // Each semaphore is only queried once per pass, no matter how many coroutines are waiting on it.
+          auto [itr, inserted] = counters.try_emplace(pending.awaited_semaphore);
+          if (inserted)
+          {
+            itr->second.first = m_counter_value(m_device, pending.awaited_semaphore, &itr->second.second);
+          }
+          pending.status = itr->second.first;
+          complete = pending.status != result{ } || itr->second.second >= pending.value;
+        }
+        if (complete)
+        {
+          resume(pending);
+          active[i] = active.back();
+          active.pop_back();
+        }
+        else
+        {
+          ++i;
+        }
+      }
+    }
+
+    void react(const std::stop_token stop) {
+      auto active = std::vector<waiter*>{ };
+      auto targets = std::vector<std::pair<semaphore, std::uint64_t>>{ };
+      auto counters = std::unordered_map<semaphore, std::pair<result, std::uint64_t>>{ };
+      while (true)
+      {
+        {
+          auto lock = std::unique_lock<std::mutex>{ m_mutex };
+          if (active.empty())
+          {
+            m_arrived.wait(lock, stop, [this]() { return !m_incoming.empty(); });
+          }
+          active.insert(active.end(), m_incoming.begin(), m_incoming.end());
+          m_incoming.clear();
+          if (stop.stop_requested())
+          {
+            break;
+          }
+        }
+        block(stop, active, targets);
+        poll(active, counters);
+      }
+      // New waiters are refused once stopping, so every remaining waiter is in active.
+      for (const auto pending : active)
+      {
+        pending->status = static_cast<result>(internal::base::not_ready);
+        resume(*pending);
+      }
+    }
+  public:
+    /**
+     * @brief Construct a wait reactor.
+     * @details If `vkGetSemaphoreCounterValue` or `vkWaitSemaphores` (or their `KHR` aliases) were resolved to null,
+     *          only fences can be awaited.
+     * @param base The table whose `vkGetFenceStatus`, `vkGetSemaphoreCounterValue`, and `vkWaitSemaphores` are used.
+     *             The table's ::VkDevice **MUST** remain valid for the reactor's entire lifetime.
+     * @param threads The number of executor threads that resume coroutines. This **MUST** be greater than zero.
+     * @param interval The longest time that the reactor waits before noticing newly awaited objects or polling fences.
+     * @throw dispatch::error If the table has no ::VkDevice, if `threads` is zero, or if `vkGetFenceStatus` was
+     *                        resolved to null.
+     */
+    explicit wait_reactor(const table& base, const std::size_t threads = default_threads(),
+                          const std::chrono::microseconds interval = std::chrono::microseconds{ 1000 }) :
+    m_device{ base.device() },
+    m_fence_status{ resolve<GetFenceStatus>(base, internal::base::fnv_1a_cstr("vkGetFenceStatus")) },
+    m_counter_value{ resolve<GetCounterValue>(base, internal::base::fnv_1a_cstr("vkGetSemaphoreCounterValue")) },
+    m_wait_semaphores{ resolve<WaitSemaphores>(base, internal::base::fnv_1a_cstr("vkWaitSemaphores")) },
+    m_interval{ interval },
+    m_executor{ checked(threads) } {
+      if (!m_device)
+      {
+        throw dispatch::error{ "A wait reactor requires a table with a VkDevice." };
+      }
+      if (!m_fence_status)
+      {
+        throw dispatch::error{ "A wait reactor requires \"vkGetFenceStatus\"." };
+      }
+      if (!m_counter_value)
+      {
+        m_counter_value = resolve<GetCounterValue>(base, internal::base::fnv_1a_cstr("vkGetSemaphoreCounterValueKHR"));
+      }
+      if (!m_wait_semaphores)
+      {
+        m_wait_semaphores = resolve<WaitSemaphores>(base, internal::base::fnv_1a_cstr("vkWaitSemaphoresKHR"));
+      }
+      // The reactor is started last, so that it never observes a partially constructed executor.
+      m_reactor = std::jthread{ [this](const std::stop_token stop) { react(stop); } };
+    }
+
+    /// @cond
+    wait_reactor(const wait_reactor& other) = delete;
+    wait_reactor(wait_reactor&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a wait reactor.
+     * @details Every coroutine that is still waiting is resumed with `VK_NOT_READY`, and every resumed coroutine runs
+     *          until it completes or suspends before the reactor is destroyed.
+     */
+    ~wait_reactor() noexcept {
+      {
+        auto lock = std::unique_lock<std::mutex>{ m_mutex };
+        m_stopping = true;
+      }
+      m_reactor.request_stop();
+      m_reactor.join();
+    }
+
+    /// @cond
+    wait_reactor& operator=(const wait_reactor& rhs) = delete;
+    wait_reactor& operator=(wait_reactor&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Wait for a fence to be signaled.
+     * @param target The fence to wait for. This **MUST** remain valid until the awaiting coroutine is resumed.
+     * @return An awaitable that produces `VK_SUCCESS` once `target` is signaled.
+     */
+    awaitable wait(const fence target) {
+      auto pending = waiter{ };
+      pending.awaited_fence = target;
+      return awaitable{ *this, pending };
+    }
+
+    /**
+     * @brief Wait for a timeline semaphore to reach a value.
+     * @param target The timeline semaphore to wait for. This **MUST** remain valid until the awaiting coroutine is
+     *               resumed.
+     * @param value The value to wait for.
+     * @return An awaitable that produces `VK_SUCCESS` once the value of `target` is greater than or equal to `value`.
+     * @throw dispatch::error If `vkGetSemaphoreCounterValue` or `vkWaitSemaphores` was resolved to null.
+     */
+    awaitable wait(const semaphore target, const std::uint64_t value) {
+      if (!m_counter_value || !m_wait_semaphores)
+      {
+        throw dispatch::error{ "Waiting for a timeline semaphore requires \"vkGetSemaphoreCounterValue\" and "
+                               "\"vkWaitSemaphores\"." };
+      }
+      auto pending = waiter{ };
+      pending.awaited_semaphore = target;
+      pending.value = value;
+      return awaitable{ *this, pending };
+    }
+
+    /**
+     * @brief Retrieve the number of executor threads.
+     * @return The number of threads that resume coroutines.
+     */
+    std::size_t threads() const noexcept {
+      return m_executor.size();
+    }
+
+    /**
+     * @brief Count the coroutines that are suspended in the reactor.
+     * @return The number of coroutines that are waiting.
+     */
+    std::uint64_t waiting() const noexcept {
+      return m_waiting.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count the coroutines that the reactor has resumed.
+     * @return The total number of coroutines that were resumed on the executor.
+     */
+    std::uint64_t resumed() const noexcept {
+      return m_resumed.load(std::memory_order_relaxed);
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,668 @@
+/**
+ * @file barriers.hpp
+ * @brief Vulkan Pipeline Barrier Coalescing
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_BARRIERS_HPP
+#define MEGATECH_VULKAN_DISPATCH_BARRIERS_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "commands.hpp"
+#include "tables.hpp"
+
+#include "internal/base/arguments.hpp"
+#include "internal/base/barriers.hpp"
+#include "internal/base/fnv_1a.hpp"
+#include "internal/base/per_thread.hpp"
+#include "internal/base/submissions.hpp"
+
+namespace megatech::vulkan::dispatch::device {
+
+  /**
+   * @brief An aggregator that merges adjacent pipeline barriers within a command buffer.
+   * @details Barriers recorded through a coalescer are deferred until the next command recorded into the same command
+   *          buffer. Adjacent barriers are then recorded by a single call that unions their stage masks and
+   *          concatenates their memory, buffer, and image barriers. For example:
+   *          @code{.cpp}
+   *          using coalescer = barrier_coalescer<PFN_vkCmdPipelineBarrier, PFN_vkCmdPipelineBarrier2>;
+   *          auto barriers = coalescer{ ddt };
+   *          auto dit = intercepted_table<coalescer::policy>{ ddt };
+   *          dit.policy<coalescer::policy>().set_coalescer(&barriers);
+   *          dit.intercept<command::vkCmdPipelineBarrier, PFN_vkCmdPipelineBarrier>();
+   *          dit.intercept<command::vkCmdPipelineBarrier2, PFN_vkCmdPipelineBarrier2>();
+   *          dit.intercept<command::vkCmdDraw, PFN_vkCmdDraw>();
+   *          dit.intercept<command::vkEndCommandBuffer, PFN_vkEndCommandBuffer>();
+   *          // ...and every other command recorded through dit.
+   *          @endcode
+   *
+   *          Barriers in a single command aren't ordered relative to each other, so merged barriers don't form
+   *          dependency chains the way consecutive commands do. To preserve every chain, the access masks of each
+   *          barrier in a merged call are widened to the union of the access masks of the call. For
+   *          `vkCmdPipelineBarrier2`, the stage masks of each barrier are also widened to their union. This never
+   *          weakens synchronization. Barriers aren't merged, and the pending barriers are recorded first, when:
+   *          - The dependency flags differ.
+   *          - The barrier type changes between `vkCmdPipelineBarrier` and `vkCmdPipelineBarrier2`.
+   *          - Both calls refer to the same buffer or image. Two layout transitions or ownership transfers of the same
+   *            resource in one command would be unordered.
+   *          - The new barrier extends a `pNext` chain. It's then recorded directly.
+   *
+   *          When routed through policy, a command buffer's pending barriers are recorded before any other `vkCmd*`
+   *          command and before `vkEndCommandBuffer`. Pending barriers are discarded by `vkBeginCommandBuffer` and
+   *          `vkResetCommandBuffer`. Every command recorded into a command buffer that has pending barriers **MUST** be
+   *          routed through the policy, or flush() **MUST** be called first.
+   *
+   *          Pending barriers belong to their command buffer, so a command buffer **MAY** be recorded by different
+   *          threads as long as the application synchronizes it externally, as Vulkan requires. Each thread keeps its
+   *          own index of command buffers, so steady-state recording only takes a lock the first time a thread
+   *          records into a command buffer. Each command buffer's state is released by `vkFreeCommandBuffers` or by
+   *          `vkDestroyCommandPool`, and its storage is released by `vkResetCommandPool`. Pools are only known for
+   *          command buffers allocated through the policy. Recording calls the base table's function pointers
+   *          directly, so the coalescer's policy **SHOULD** be the last policy of the chain.
+   * @tparam Barrier The function pointer type of `vkCmdPipelineBarrier` (i.e., `PFN_vkCmdPipelineBarrier`).
+   * @tparam Barrier2 The function pointer type of `vkCmdPipelineBarrier2` (i.e., `PFN_vkCmdPipelineBarrier2`).
+   */
+  template <internal::base::command_pointer Barrier, internal::base::command_pointer Barrier2>
+  class barrier_coalescer final {
+  private:
+    using legacy = internal::base::barrier_signature<Barrier>;
+    using modern = internal::base::barrier2_signature<Barrier2>;
+  public:
+    /**
+     * @brief The command buffer handle type (i.e., `VkCommandBuffer`).
+     */
+    using command_buffer = typename legacy::command_buffer;
+
+    /**
+     * @brief The stage mask type of `vkCmdPipelineBarrier` (i.e., `VkPipelineStageFlags`).
+     */
+    using stages = typename legacy::stages;
+
+    /**
+     * @brief The dependency flags type (i.e., `VkDependencyFlags`).
+     */
+    using dependencies = typename legacy::dependencies;
+
+    /**
+     * @brief The global memory barrier type of `vkCmdPipelineBarrier` (i.e., `VkMemoryBarrier`).
+     */
+    using memory_barrier = typename legacy::memory_barrier;
+
+    /**
+     * @brief The buffer barrier type of `vkCmdPipelineBarrier` (i.e., `VkBufferMemoryBarrier`).
+     */
+    using buffer_barrier = typename legacy::buffer_barrier;
+
+    /**
+     * @brief The image barrier type of `vkCmdPipelineBarrier` (i.e., `VkImageMemoryBarrier`).
+     */
+    using image_barrier = typename legacy::image_barrier;
+
+    /**
+     * @brief The dependency structure type of `vkCmdPipelineBarrier2` (i.e., `VkDependencyInfo`).
+     */
+    using dependency_info = typename modern::dependency_info;
+
+    /**
+     * @brief An interception policy that routes pipeline barriers through a barrier_coalescer.
+     * @details When no coalescer is attached, the policy costs a single load and branch per call. Otherwise, recorded
+     *          commands cost a single load while no barriers are pending.
+     */
+    class policy final {
+    private:
+      barrier_coalescer* m_coalescer{ };
+    public:
+      /**
+       * @brief Defer a barrier, or record pending barriers before another command, and continue the chain.
+       * @tparam Cmd The called command.
+       * @param next The remainder of the policy chain.
+       * @param arguments The arguments of the call.
+       * @return The result of `next`.
+       */
+      template <command Cmd, typename Next, typename... Arguments>
+      decltype(auto) invoke(const Next& next, Arguments... arguments) {
+        using internal::base::named;
+        using internal::base::recorded;
+        if (!m_coalescer)
+        {
+          return next(arguments...);
+        }
+        if constexpr (named<Cmd>("vkCmdPipelineBarrier") || named<Cmd>("vkCmdPipelineBarrier2") ||
+                      named<Cmd>("vkCmdPipelineBarrier2KHR"))
+        {
+          m_coalescer->barrier(arguments...);
+        }
+        else if constexpr (recorded<Cmd>() || named<Cmd>("vkEndCommandBuffer"))
+        {
+          m_coalescer->flush(std::get<0>(std::tuple<Arguments...>{ arguments... }));
+          return next(arguments...);
+        }
+        else if constexpr (named<Cmd>("vkBeginCommandBuffer") || named<Cmd>("vkResetCommandBuffer"))
+        {
+          m_coalescer->discard(std::get<0>(std::tuple<Arguments...>{ arguments... }));
+          return next(arguments...);
+        }
+        else if constexpr (named<Cmd>("vkAllocateCommandBuffers"))
+        {
+          // On failure, every command buffer is set to null, so nothing is tracked.
+          decltype(auto) result = next(arguments...);
+          m_coalescer->allocate(arguments...);
+          return result;
+        }
+        else if constexpr (named<Cmd>("vkFreeCommandBuffers"))
+        {
+          m_coalescer->free(arguments...);
+          return next(arguments...);
+        }
+        else if constexpr (named<Cmd>("vkResetCommandPool"))
+        {
+          m_coalescer->reset(std::get<1>(std::tuple<Arguments...>{ arguments... }));
+          return next(arguments...);
+        }
+        else if constexpr (named<Cmd>("vkDestroyCommandPool"))
+        {
+          m_coalescer->destroy(std::get<1>(std::tuple<Arguments...>{ arguments... }));
+          return next(arguments...);
+        }
+        else
+        {
+          return next(arguments...);
+        }
+      }
+
+      /**
+       * @brief Attach a barrier_coalescer to the policy.
+       * @details This **MUST NOT** be called concurrently with calls through the owning table.
+       * @param coalescer A pointer to the coalescer to attach or null.
+       */
+      void set_coalescer(barrier_coalescer *const coalescer) noexcept {
+        m_coalescer = coalescer;
+      }
+
+      /**
+       * @brief Retrieve the barrier_coalescer attached to the policy.
+       * @return A pointer to the attached coalescer, or null if no coalescer is attached.
+       */
+      barrier_coalescer* coalescer() const noexcept {
+        return m_coalescer;
+      }
+    };
+  private:
+    struct pending final {
+      command_buffer target{ };
+      std::uint64_t pool{ };
+      std::size_t calls{ };
+      bool modern_kind{ };
+      stages source{ };
+      stages destination{ };
+      dependencies flags{ };
+      dependency_info info{ };
+      std::vector<memory_barrier> memory{ };
+      std::vector<buffer_barrier> buffers{ };
+      std::vector<image_barrier> images{ };
+      std::vector<typename modern::memory_barrier> memory2{ };
+      std::vector<typename modern::buffer_barrier> buffers2{ };
+      std::vector<typename modern::image_barrier> images2{ };
+    };
+
+    // Indices are value-initialized by internal::base::per_thread. An index is cleared whenever its generation
+    // doesn't match the coalescer's, so it never refers to released state.
+    struct index final {
+      std::unordered_map<std::uint64_t, pending*> buffers;
+      std::uint64_t generation;
+    };
+
+    Barrier m_barrier{ };
+    Barrier2 m_barrier2{ };
+    mutable std::mutex m_lock{ };
+    std::unordered_map<std::uint64_t, std::unique_ptr<pending>> m_pending{ };
+    std::atomic<std::uint64_t> m_generation{ };
+    std::atomic<std::size_t> m_active{ };
+    internal::base::per_thread<index> m_indices{ };
+    std::atomic<std::uint64_t> m_deferred{ };
+    std::atomic<std::uint64_t> m_merged{ };
+    std::atomic<std::uint64_t> m_barriers{ };
+
+    template <typename Pointer>
+    static Pointer resolve(const table& base, const std::uint_least64_t hash) noexcept {
+      const auto pfn = static_cast<const Pointer*>(base.get(hash));
+      return pfn ? *pfn : nullptr;
+    }
+
+    template <typename Existing, typename Incoming>
+    static bool overlaps(const std::vector<Existing>& existing, const Incoming *const incoming,
+                         const std::uint32_t count) noexcept {
+      return std::any_of(incoming, incoming + count, [&](const Incoming& barrier) {
+        return std::any_of(existing.begin(), existing.end(), [&](const Existing& other) {
+          if constexpr (requires { barrier.image; })
+          {
+            return other.image == barrier.image;
+          }
+          else
+          {
+            return other.buffer == barrier.buffer;
+          }
+        });
+      });
+    }
+
+    template <typename... Arrays>
+    static void widen_access(Arrays&... arrays) noexcept {
+      auto source = decltype(std::get<0>(std::tie(arrays...)).front().srcAccessMask){ };
+      auto destination = decltype(source){ };
+      const auto gather = [&](const auto& array) {
+        for (const auto& barrier : array)
+        {
+          source |= barrier.srcAccessMask;
+          destination |= barrier.dstAccessMask;
+        }
+      };
+      const auto apply = [&](auto& array) {
+        for (auto& barrier : array)
+        {
+          barrier.srcAccessMask = source;
+          barrier.dstAccessMask = destination;
+        }
+      };
+      (gather(arrays), ...);
+      (apply(arrays), ...);
+    }
+
+    template <typename... Arrays>
+    static void widen_stages(Arrays&... arrays) noexcept {
+      auto source = decltype(std::get<0>(std::tie(arrays...)).front().srcStageMask){ };
+      auto destination = decltype(source){ };
+      const auto gather = [&](const auto& array) {
+        for (const auto& barrier : array)
+        {
+          source |= barrier.srcStageMask;
+          destination |= barrier.dstStageMask;
+        }
+      };
+      const auto apply = [&](auto& array) {
+        for (auto& barrier : array)
+        {
+          barrier.srcStageMask = source;
+          barrier.dstStageMask = destination;
+        }
+      };
+      (gather(arrays), ...);
+      (apply(arrays), ...);
+    }
+
+    pending& find(const command_buffer target) {
+      auto& local = m_indices.local();
+      if (const auto generation = m_generation.load(std::memory_order_acquire); local.generation != generation)
+      {
+        local.buffers.clear();
+        local.generation = generation;
+      }
+      const auto key = internal::base::encode(target).value;
+      if (const auto found = local.buffers.find(key); found != local.buffers.end())
+      {
+        return *found->second;
+      }
+      auto lock = std::unique_lock<std::mutex>{ m_lock };
+      auto& owned = m_pending[key];
+      if (!owned)
+      {
+        owned = std::make_unique<pending>();
+        owned->target = target;
+      }
+      local.buffers.emplace(key, owned.get());
+      return *owned;
+    }
+
+    void acquire(pending& current) noexcept {
+      if (!current.calls)
+      {
+        m_active.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    void release(pending& current) noexcept {
+      if (current.calls)
+      {
+        m_active.fetch_sub(1, std::memory_order_relaxed);
+      }
+      current.calls = 0;
+      current.source = stages{ };
+      current.destination = stages{ };
+      current.memory.clear();
+      current.buffers.clear();
+      current.images.clear();
+      current.memory2.clear();
+      current.buffers2.clear();
+      current.images2.clear();
+    }
+
+    // Released entries may still be indexed by other threads, so the generation is advanced before the lock is
+    // released.
+    template <typename Predicate>
+    void erase_if(Predicate&& predicate) {
+      auto lock = std::unique_lock<std::mutex>{ m_lock };
+      const auto erased = std::erase_if(m_pending, [&](auto& entry) {
+        if (predicate(*entry.second))
+        {
+          release(*entry.second);
+          return true;
+        }
+        return false;
+      });
+      if (erased)
+      {
+        m_generation.fetch_add(1, std::memory_order_release);
+      }
+    }
+
+    void record(pending& current) {
+      if (current.calls > 1)
+      {
+        m_merged.fetch_add(current.calls - 1, std::memory_order_relaxed);
+        if (current.modern_kind)
+        {
+          widen_stages(current.memory2, current.buffers2, current.images2);
+          widen_access(current.memory2, current.buffers2, current.images2);
+        }
+        else
+        {
+          widen_access(current.memory, current.buffers, current.images);
+        }
+      }
+      if (current.modern_kind)
+      {
+        auto info = current.info;
+        info.memoryBarrierCount = static_cast<std::uint32_t>(current.memory2.size());
+        info.pMemoryBarriers = current.memory2.data();
+        info.bufferMemoryBarrierCount = static_cast<std::uint32_t>(current.buffers2.size());
+        info.pBufferMemoryBarriers = current.buffers2.data();
+        info.imageMemoryBarrierCount = static_cast<std::uint32_t>(current.images2.size());
+        info.pImageMemoryBarriers = current.images2.data();
+        m_barrier2(current.target, &info);
+      }
+      else
+      {
+        m_barrier(current.target, current.source, current.destination, current.flags,
+                  static_cast<std::uint32_t>(current.memory.size()), current.memory.data(),
+                  static_cast<std::uint32_t>(current.buffers.size()), current.buffers.data(),
+                  static_cast<std::uint32_t>(current.images.size()), current.images.data());
+      }
+      m_barriers.fetch_add(1, std::memory_order_relaxed);
+      release(current);
+    }
+  public:
+    /**
+     * @brief Construct a barrier coalescer.
+     * @param base The table whose `vkCmdPipelineBarrier` and `vkCmdPipelineBarrier2` (or `vkCmdPipelineBarrier2KHR`)
+     *             are used to record barriers. The table's ::VkDevice **MUST** remain valid for the coalescer's entire
+     *             lifetime.
+     * @throw dispatch::error If `vkCmdPipelineBarrier` was resolved to null.
+     */
+    explicit barrier_coalescer(const table& base) :
+    m_barrier{ resolve<Barrier>(base, internal::base::fnv_1a_cstr("vkCmdPipelineBarrier")) },
+    m_barrier2{ resolve<Barrier2>(base, internal::base::fnv_1a_cstr("vkCmdPipelineBarrier2")) } {
+      if (!m_barrier)
+      {
+        throw dispatch::error{ "Barrier coalescing requires \"vkCmdPipelineBarrier\"." };
+      }
+      if (!m_barrier2)
+      {
+        m_barrier2 = resolve<Barrier2>(base, internal::base::fnv_1a_cstr("vkCmdPipelineBarrier2KHR"));
+      }
+    }
+
+    /// @cond
+    barrier_coalescer(const barrier_coalescer& other) = delete;
+    barrier_coalescer(barrier_coalescer&& other) = delete;
+
+    ~barrier_coalescer() noexcept = default;
+
+    barrier_coalescer& operator=(const barrier_coalescer& rhs) = delete;
+    barrier_coalescer& operator=(barrier_coalescer&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Defer a `vkCmdPipelineBarrier`.
+     * @param target The command buffer to record into.
+     * @param source The source stage mask.
+     * @param destination The destination stage mask.
+     * @param flags The dependency flags.
+     * @param memory_count The number of elements in `memory`.
+     * @param memory The global memory barriers.
+     * @param buffer_count The number of elements in `buffers`.
+     * @param buffers The buffer memory barriers.
+     * @param image_count The number of elements in `images`.
+     * @param images The image memory barriers.
+     */
+    void barrier(const command_buffer target, const stages source, const stages destination,
+                 const dependencies flags, const std::uint32_t memory_count, const memory_barrier *const memory,
+                 const std::uint32_t buffer_count, const buffer_barrier *const buffers,
+                 const std::uint32_t image_count, const image_barrier *const images) {
+      using internal::base::any_chained;
+      auto& current = find(target);
+      const auto chained = any_chained(memory, memory_count) || any_chained(buffers, buffer_count) ||
+                           any_chained(images, image_count);
+      if (current.calls && (chained || current.modern_kind || current.flags != flags ||
+                            overlaps(current.buffers, buffers, buffer_count) ||
+                            overlaps(current.images, images, image_count)))
+      {
+        record(current);
+      }
+      if (chained)
+      {
+        m_barrier(target, source, destination, flags, memory_count, memory, buffer_count, buffers, image_count,
+                  images);
+        m_barriers.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      if (!current.calls)
+      {
+        acquire(current);
+        current.modern_kind = false;
+        current.flags = flags;
+      }
+      current.source |= source;
+      current.destination |= destination;
+      current.memory.insert(current.memory.end(), memory, memory + memory_count);
+      current.buffers.insert(current.buffers.end(), buffers, buffers + buffer_count);
+      current.images.insert(current.images.end(), images, images + image_count);
+      ++current.calls;
+      m_deferred.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Defer a `vkCmdPipelineBarrier2`.
+     * @param target The command buffer to record into.
+     * @param info The dependency to record.
+     * @throw dispatch::error If `vkCmdPipelineBarrier2` is unavailable.
+     */
+    void barrier(const command_buffer target, const dependency_info *const info) {
+      using internal::base::any_chained;
+      if (!m_barrier2)
+      {
+        throw dispatch::error{ "The barrier coalescer has no \"vkCmdPipelineBarrier2\"." };
+      }
+      auto& current = find(target);
+      const auto chained = info->pNext || any_chained(info->pMemoryBarriers, info->memoryBarrierCount) ||
+                           any_chained(info->pBufferMemoryBarriers, info->bufferMemoryBarrierCount) ||
+                           any_chained(info->pImageMemoryBarriers, info->imageMemoryBarrierCount);
+      if (current.calls && (chained || !current.modern_kind || current.info.dependencyFlags != info->dependencyFlags ||
+                            overlaps(current.buffers2, info->pBufferMemoryBarriers, info->bufferMemoryBarrierCount) ||
+                            overlaps(current.images2, info->pImageMemoryBarriers, info->imageMemoryBarrierCount)))
+      {
+        record(current);
+      }
+      if (chained)
+      {
+        m_barrier2(target, info);
+        m_barriers.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      if (!current.calls)
+      {
+        acquire(current);
+        current.modern_kind = true;
+        current.info = dependency_info{ };
+        current.info.sType = info->sType;
+        current.info.dependencyFlags = info->dependencyFlags;
+      }
+      current.memory2.insert(current.memory2.end(), info->pMemoryBarriers,
+                             info->pMemoryBarriers + info->memoryBarrierCount);
+      current.buffers2.insert(current.buffers2.end(), info->pBufferMemoryBarriers,
+                              info->pBufferMemoryBarriers + info->bufferMemoryBarrierCount);
+      current.images2.insert(current.images2.end(), info->pImageMemoryBarriers,
+                             info->pImageMemoryBarriers + info->imageMemoryBarrierCount);
+      ++current.calls;
+      m_deferred.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record a command buffer's pending barriers.
+     * @param target The command buffer to flush.
+     */
+    void flush(const command_buffer target) {
+      if (!m_active.load(std::memory_order_relaxed))
+      {
+        return;
+      }
+      if (auto& current = find(target); current.calls)
+      {
+        record(current);
+      }
+    }
+
+    /**
+     * @brief Discard a command buffer's pending barriers without recording them.
+     * @param target The command buffer whose barriers are discarded.
+     */
+    void discard(const command_buffer target) {
+      if (!m_active.load(std::memory_order_relaxed))
+      {
+        return;
+      }
+      release(find(target));
+    }
+
+    /**
+     * @brief Associate newly allocated command buffers with their pool.
+     * @param device The device that allocated the command buffers.
+     * @param info The `VkCommandBufferAllocateInfo` used to allocate the command buffers.
+     * @param targets The allocated command buffers. Null elements are ignored.
+     */
+    template <typename Device, typename Info>
+    void allocate(const Device, const Info *const info, const command_buffer *const targets) {
+      const auto pool = internal::base::encode(info->commandPool).value;
+      for (auto i = std::uint32_t{ 0 }; i < info->commandBufferCount; ++i)
+      {
+        if (targets[i])
+        {
+          find(targets[i]).pool = pool;
+        }
+      }
+    }
+
+    /**
+     * @brief Release the state of command buffers that are being freed.
+     * @details Pending barriers are discarded.
+     * @param device The device that owns the command buffers.
+     * @param pool The pool that the command buffers were allocated from.
+     * @param count The number of elements in `targets`.
+     * @param targets The command buffers being freed. Null elements are ignored.
+     */
+    template <typename Device, typename Pool>
+    void free(const Device, const Pool, const std::uint32_t count, const command_buffer *const targets) {
+      const auto freed = [&](const pending& current) {
+        return std::find(targets, targets + count, current.target) != targets + count;
+      };
+      erase_if(freed);
+    }
+
+    /**
+     * @brief Release the storage of every command buffer allocated from a pool that is being reset.
+     * @details Pending barriers are discarded. The command buffers remain tracked.
+     * @param pool The pool being reset.
+     */
+    template <typename Pool>
+    void reset(const Pool pool) {
+      const auto key = internal::base::encode(pool).value;
+      auto lock = std::unique_lock<std::mutex>{ m_lock };
+      for (auto& [target, current] : m_pending)
+      {
+        if (current->pool == key)
+        {
+          release(*current);
+          current->memory.shrink_to_fit();
+          current->buffers.shrink_to_fit();
+          current->images.shrink_to_fit();
+          current->memory2.shrink_to_fit();
+          current->buffers2.shrink_to_fit();
+          current->images2.shrink_to_fit();
+        }
+      }
+    }
+
+    /**
+     * @brief Release the state of every command buffer allocated from a pool that is being destroyed.
+     * @details Pending barriers are discarded.
+     * @param pool The pool being destroyed. This **MAY** be null.
+     */
+    template <typename Pool>
+    void destroy(const Pool pool) {
+      if (const auto key = internal::base::encode(pool).value; key)
+      {
+        erase_if([&](const pending& current) { return current.pool == key; });
+      }
+    }
+
+    /**
+     * @brief Count the command buffers whose state is tracked.
+     * @return The number of command buffers that have been recorded into or allocated through the policy and that
+     *         haven't been released.
+     */
+    std::size_t tracked() const {
+      auto lock = std::unique_lock<std::mutex>{ m_lock };
+      return m_pending.size();
+    }
+
+    /**
+     * @brief Count the barrier calls that have been deferred.
+     * @return The total number of barrier calls accepted for deferral.
+     */
+    std::uint64_t deferred() const noexcept {
+      return m_deferred.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count the barrier calls that have been merged into a previous call.
+     * @return The total number of merged barrier calls.
+     */
+    std::uint64_t merged() const noexcept {
+      return m_merged.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count the barrier calls that have been recorded.
+     * @return The total number of `vkCmdPipelineBarrier` and `vkCmdPipelineBarrier2` calls made by the coalescer.
+     */
+    std::uint64_t barriers() const noexcept {
+      return m_barriers.load(std::memory_order_relaxed);
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,450 @@
+/**
+ * @file batching.hpp
+ * @brief Vulkan Queue Submission Batching
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_BATCHING_HPP
+#define MEGATECH_VULKAN_DISPATCH_BATCHING_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <algorithm>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "commands.hpp"
+#include "tables.hpp"
+
+#include "internal/base/fnv_1a.hpp"
+#include "internal/base/submissions.hpp"
+
+namespace megatech::vulkan::dispatch::device {
+
+  /**
+   * @brief An aggregator that merges small queue submissions into larger ones.
+   * @details Submissions made through a batcher are copied and deferred instead of being sent to the driver. Deferred
+   *          batches are sent to the driver in a single call per queue when the batcher is flushed. A single
+   *          `vkQueueSubmit` with N batches behaves exactly like N consecutive calls with one batch each, so
+   *          semaphore ordering is unchanged. For example:
+   *          @code{.cpp}
+   *          using batcher = submission_batcher<PFN_vkQueueSubmit, PFN_vkQueueSubmit2>;
+   *          auto submissions = batcher{ ddt };
+   *          auto dit = intercepted_table<batcher::policy>{ ddt };
+   *          dit.policy<batcher::policy>().set_batcher(&submissions);
+   *          dit.intercept<command::vkQueueSubmit, PFN_vkQueueSubmit>();
+   *          dit.intercept<command::vkQueueSubmit2, PFN_vkQueueSubmit2>();
+   *          dit.intercept<command::vkQueueWaitIdle, PFN_vkQueueWaitIdle>();
+   *          dit.intercept<command::vkQueuePresentKHR, PFN_vkQueuePresentKHR>();
+   *          // Submit per task through dit. Then, at the frame boundary:
+   *          submissions.flush();
+   *          @endcode
+   *
+   *          A queue's deferred batches are also flushed:
+   *          - When a submission has a fence. The fence is attached to the merged submission, so it still signals after
+   *            every batch of the original call completes.
+   *          - When a queue accumulates the maximum number of deferred batches.
+   *          - When a submission can't be copied, because it or one of its elements extends a `pNext` chain (e.g.,
+   *            `VkTimelineSemaphoreSubmitInfo`). The uncopyable submission is then sent directly. `vkQueueSubmit2`
+   *            carries timeline semaphore values without a chain, so it batches timeline submissions too.
+   *          - When a submission to another queue waits on a semaphore that a deferred batch signals. Binary
+   *            semaphores require the signal to be submitted before the wait.
+   *          - When the submission type changes between `vkQueueSubmit` and `vkQueueSubmit2`.
+   *
+   *          When routed through policy, `vkQueueWaitIdle` flushes its queue first, and `vkDeviceWaitIdle`,
+   *          `vkQueueBindSparse`, `vkQueuePresentKHR`, `vkAcquireNextImageKHR`, `vkAcquireNextImage2KHR`,
+   *          `vkWaitSemaphores(KHR)`, `vkGetSemaphoreCounterValue(KHR)`, `vkSignalSemaphore(KHR)`, `vkGetFenceStatus`,
+   *          `vkWaitForFences`, `vkGetEventStatus`, and `vkGetQueryPoolResults` flush every queue first. Otherwise,
+   *          polling or waiting on a fence, timeline, event, or query written by a deferred batch would never observe
+   *          the result, and an acquire could block on a swapchain image whose release is still deferred. Any other
+   *          host-side wait on work submitted through the batcher **MUST** be preceded by a call to flush().
+   *
+   *          Deferred submissions return success immediately. Errors are reported by whichever call flushes the
+   *          batch. All submissions to a queue **MUST** go through the batcher once any have, or submissions will be
+   *          reordered. Flushes call the base table's function pointers directly, so the batcher's policy **SHOULD** be
+   *          the last policy of the chain. The batcher is safe to use concurrently.
+   * @tparam Submit The function pointer type of `vkQueueSubmit` (i.e., `PFN_vkQueueSubmit`).
+   * @tparam Submit2 The function pointer type of `vkQueueSubmit2` (i.e., `PFN_vkQueueSubmit2`).
+   */
+  template <internal::base::command_pointer Submit, internal::base::command_pointer Submit2>
+  class submission_batcher final {
+  public:
+    /**
+     * @brief The result type of a submission (i.e., `VkResult`).
+     */
+    using result = typename internal::base::submit_signature<Submit>::result;
+
+    /**
+     * @brief The queue handle type (i.e., `VkQueue`).
+     */
+    using queue = typename internal::base::submit_signature<Submit>::queue;
+
+    /**
+     * @brief The fence handle type (i.e., `VkFence`).
+     */
+    using fence = typename internal::base::submit_signature<Submit>::fence;
+
+    /**
+     * @brief The submission structure type of `vkQueueSubmit` (i.e., `VkSubmitInfo`).
+     */
+    using submit_info = typename internal::base::submit_signature<Submit>::info;
+
+    /**
+     * @brief The submission structure type of `vkQueueSubmit2` (i.e., `VkSubmitInfo2`).
+     */
+    using submit_info_2 = typename internal::base::submit_signature<Submit2>::info;
+
+    /**
+     * @brief An interception policy that routes submissions through a submission_batcher.
+     * @details When no batcher is attached, the policy costs a single load and branch per call.
+     */
+    class policy final {
+    private:
+      submission_batcher* m_batcher{ };
+    public:
+      /**
+       * @brief Defer a submission, or flush before a synchronizing command, and continue the chain.
+       * @tparam Cmd The called command.
+       * @param next The remainder of the policy chain.
+       * @param arguments The arguments of the call.
+       * @return The result of `next` or of the batcher.
+       */
+      template <command Cmd, typename Next, typename... Arguments>
+      decltype(auto) invoke(const Next& next, Arguments... arguments) {
+        using internal::base::named;
+        if (!m_batcher)
+        {
+          return next(arguments...);
+        }
+        if constexpr (named<Cmd>("vkQueueSubmit") || named<Cmd>("vkQueueSubmit2") || named<Cmd>("vkQueueSubmit2KHR"))
+        {
+          return m_batcher->submit(arguments...);
+        }
+        else if constexpr (named<Cmd>("vkQueueWaitIdle"))
+        {
+          if (auto flushed = m_batcher->flush(std::get<0>(std::tuple<Arguments...>{ arguments... }));
+              flushed != result{ })
+          {
+            return flushed;
+          }
+          return next(arguments...);
+        }
+        else if constexpr (named<Cmd>("vkDeviceWaitIdle") || named<Cmd>("vkQueueBindSparse") ||
+                           named<Cmd>("vkQueuePresentKHR") || named<Cmd>("vkWaitSemaphores") ||
+                           named<Cmd>("vkWaitSemaphoresKHR") || named<Cmd>("vkGetSemaphoreCounterValue") ||
+                           named<Cmd>("vkGetSemaphoreCounterValueKHR") || named<Cmd>("vkSignalSemaphore") ||
+                           named<Cmd>("vkSignalSemaphoreKHR") || named<Cmd>("vkGetFenceStatus") ||
+                           named<Cmd>("vkWaitForFences") || named<Cmd>("vkGetEventStatus") ||
+                           named<Cmd>("vkGetQueryPoolResults") || named<Cmd>("vkAcquireNextImageKHR") ||
+                           named<Cmd>("vkAcquireNextImage2KHR"))
+        {
+          if (auto flushed = m_batcher->flush(); flushed != result{ })
+          {
+            return flushed;
+          }
+          return next(arguments...);
+        }
+        else
+        {
+          return next(arguments...);
+        }
+      }
+
+      /**
+       * @brief Attach a submission_batcher to the policy.
+       * @details This **MUST NOT** be called concurrently with calls through the owning table.
+       * @param batcher A pointer to the batcher to attach or null.
+       */
+      void set_batcher(submission_batcher *const batcher) noexcept {
+        m_batcher = batcher;
+      }
+
+      /**
+       * @brief Retrieve the submission_batcher attached to the policy.
+       * @return A pointer to the attached batcher, or null if no batcher is attached.
+       */
+      submission_batcher* batcher() const noexcept {
+        return m_batcher;
+      }
+    };
+  private:
+    using legacy_submission = internal::base::owned_submission<submit_info>;
+    using modern_submission = internal::base::owned_submission<submit_info_2>;
+
+    struct pending final {
+      std::vector<legacy_submission> legacy{ };
+      std::vector<modern_submission> modern{ };
+      std::vector<submit_info> legacy_infos{ };
+      std::vector<submit_info_2> modern_infos{ };
+      std::size_t size{ };
+      bool modern_kind{ };
+
+      template <typename Semaphore>
+      bool signals(const Semaphore semaphore) const noexcept {
+        const auto signalled = [&](const auto& submission) { return submission.signals(semaphore); };
+        if (modern_kind)
+        {
+          return std::any_of(modern.begin(), modern.begin() + size, signalled);
+        }
+        return std::any_of(legacy.begin(), legacy.begin() + size, signalled);
+      }
+    };
+
+    Submit m_submit{ };
+    Submit2 m_submit2{ };
+    std::size_t m_max_batches{ };
+    mutable std::mutex m_mutex{ };
+    std::unordered_map<queue, pending> m_pending{ };
+    std::uint64_t m_deferred{ };
+    std::uint64_t m_submissions{ };
+
+    template <typename Pointer>
+    static Pointer resolve(const table& base, const std::uint_least64_t hash) noexcept {
+      const auto pfn = static_cast<const Pointer*>(base.get(hash));
+      return pfn ? *pfn : nullptr;
+    }
+
+    template <typename Info>
+    result send(const queue target, const std::uint32_t count, const Info *const infos, const fence signal) {
+      ++m_submissions;
+      if constexpr (std::is_same_v<Info, submit_info>)
+      {
+        return m_submit(target, count, infos, signal);
+      }
+      else
+      {
+        return m_submit2(target, count, infos, signal);
+      }
+    }
+
+    result flush(const queue target, pending& current, const fence signal) {
+      if (!current.size && !signal)
+      {
+        return result{ };
+      }
+      const auto count = static_cast<std::uint32_t>(current.size);
+      current.size = 0;
+      if (current.modern_kind)
+      {
+        current.modern_infos.clear();
+        for (auto i = std::uint32_t{ 0 }; i < count; ++i)
+        {
+          current.modern_infos.emplace_back(current.modern[i].info());
+        }
+        return send(target, count, current.modern_infos.data(), signal);
+      }
+      current.legacy_infos.clear();
+      for (auto i = std::uint32_t{ 0 }; i < count; ++i)
+      {
+        current.legacy_infos.emplace_back(current.legacy[i].info());
+      }
+      return send(target, count, current.legacy_infos.data(), signal);
+    }
+
+    template <typename Info>
+    result defer(const queue target, const std::uint32_t count, const Info *const infos, const fence signal) {
+      using submission = internal::base::owned_submission<Info>;
+      constexpr auto modern_kind = std::is_same_v<Info, submit_info_2>;
+      auto lock = std::unique_lock{ m_mutex };
+      // Binary semaphore signals must be submitted before their waits.
+      for (auto i = std::uint32_t{ 0 }; i < count; ++i)
+      {
+        auto failure = result{ };
+        submission::for_each_wait(infos[i], [&](const auto semaphore) {
+          for (auto& [other_queue, other] : m_pending)
+          {
+            if (other_queue != target && other.size && other.signals(semaphore))
+            {
+              if (const auto flushed = flush(other_queue, other, fence{ }); flushed != result{ })
+              {
+                failure = flushed;
+              }
+            }
+          }
+        });
+        if (failure != result{ })
+        {
+          return failure;
+        }
+      }
+      auto& current = m_pending[target];
+      const auto copyable = std::all_of(infos, infos + count, [](const Info& info) {
+        return submission::copyable(info);
+      });
+      if (current.size && (!copyable || current.modern_kind != modern_kind))
+      {
+        if (const auto flushed = flush(target, current, fence{ }); flushed != result{ })
+        {
+          return flushed;
+        }
+      }
+      if (!copyable)
+      {
+        return send(target, count, infos, signal);
+      }
+      current.modern_kind = modern_kind;
+      auto& submissions = [&]() -> std::vector<submission>& {
+        if constexpr (modern_kind)
+        {
+          return current.modern;
+        }
+        else
+        {
+          return current.legacy;
+        }
+      }();
+      for (auto i = std::uint32_t{ 0 }; i < count; ++i)
+      {
+        if (submissions.size() <= current.size)
+        {
+          submissions.emplace_back();
+        }
+        submissions[current.size++].assign(infos[i]);
+      }
+      m_deferred += count;
+      if (signal || current.size >= m_max_batches)
+      {
+        return flush(target, current, signal);
+      }
+      return result{ };
+    }
+  public:
+    /**
+     * @brief Construct a submission batcher.
+     * @param base The table whose `vkQueueSubmit` and `vkQueueSubmit2` (or `vkQueueSubmit2KHR`) are used to flush.
+     *             The table's ::VkDevice **MUST** remain valid for the batcher's entire lifetime.
+     * @param max_batches The maximum number of deferred batches per queue. Reaching it flushes the queue.
+     * @throw dispatch::error If `max_batches` is zero or if `vkQueueSubmit` was resolved to null.
+     */
+    explicit submission_batcher(const table& base, const std::size_t max_batches = 64) :
+    m_submit{ resolve<Submit>(base, internal::base::fnv_1a_cstr("vkQueueSubmit")) },
+    m_submit2{ resolve<Submit2>(base, internal::base::fnv_1a_cstr("vkQueueSubmit2")) },
+    m_max_batches{ max_batches } {
+      if (!m_max_batches)
+      {
+        throw dispatch::error{ "The maximum number of deferred batches must be at least 1." };
+      }
+      if (!m_submit)
+      {
+        throw dispatch::error{ "Submission batching requires \"vkQueueSubmit\"." };
+      }
+      if (!m_submit2)
+      {
+        m_submit2 = resolve<Submit2>(base, internal::base::fnv_1a_cstr("vkQueueSubmit2KHR"));
+      }
+    }
+
+    /// @cond
+    submission_batcher(const submission_batcher& other) = delete;
+    submission_batcher(submission_batcher&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a submission batcher.
+     * @details Every deferred batch is flushed. Errors are discarded.
+     */
+    ~submission_batcher() noexcept {
+      flush();
+    }
+
+    /// @cond
+    submission_batcher& operator=(const submission_batcher& rhs) = delete;
+    submission_batcher& operator=(submission_batcher&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Defer a `vkQueueSubmit`.
+     * @param target The queue to submit to.
+     * @param count The number of elements in `infos`.
+     * @param infos The batches to submit.
+     * @param signal A fence to signal or null. If this isn't null, the queue is flushed.
+     * @return Success if the batches were deferred. Otherwise, the result of the first failed flush.
+     */
+    result submit(const queue target, const std::uint32_t count, const submit_info *const infos, const fence signal) {
+      return defer(target, count, infos, signal);
+    }
+
+    /**
+     * @brief Defer a `vkQueueSubmit2`.
+     * @param target The queue to submit to.
+     * @param count The number of elements in `infos`.
+     * @param infos The batches to submit.
+     * @param signal A fence to signal or null. If this isn't null, the queue is flushed.
+     * @return Success if the batches were deferred. Otherwise, the result of the first failed flush.
+     */
+    result submit(const queue target, const std::uint32_t count, const submit_info_2 *const infos,
+                  const fence signal) {
+      return defer(target, count, infos, signal);
+    }
+
+    /**
+     * @brief Send every deferred batch of a queue to the driver.
+     * @param target The queue to flush.
+     * @return The result of the driver call, or success if nothing was deferred.
+     */
+    result flush(const queue target) {
+      auto lock = std::unique_lock{ m_mutex };
+      if (const auto found = m_pending.find(target); found != m_pending.end())
+      {
+        return flush(target, found->second, fence{ });
+      }
+      return result{ };
+    }
+
+    /**
+     * @brief Send every deferred batch of every queue to the driver.
+     * @return The first failed result, or success.
+     */
+    result flush() {
+      auto lock = std::unique_lock{ m_mutex };
+      auto failure = result{ };
+      for (auto& [target, current] : m_pending)
+      {
+        if (const auto flushed = flush(target, current, fence{ }); flushed != result{ } && failure == result{ })
+        {
+          failure = flushed;
+        }
+      }
+      return failure;
+    }
+
+    /**
+     * @brief Count the deferred batches of a queue.
+     * @param target The queue to check.
+     * @return The number of batches waiting to be flushed.
+     */
+    std::size_t pending(const queue target) const {
+      auto lock = std::unique_lock{ m_mutex };
+      const auto found = m_pending.find(target);
+      return found != m_pending.end() ? found->second.size : 0;
+    }
+
+    /**
+     * @brief Count the batches that have been deferred.
+     * @return The total number of batches accepted for deferral.
+     */
+    std::uint64_t deferred() const {
+      auto lock = std::unique_lock{ m_mutex };
+      return m_deferred;
+    }
+
+    /**
+     * @brief Count the calls that have been made to the driver.
+     * @return The total number of `vkQueueSubmit` and `vkQueueSubmit2` calls made by the batcher.
+     */
+    std::uint64_t submissions() const {
+      auto lock = std::unique_lock{ m_mutex };
+      return m_submissions;
+    }
+  };
+
+}
+
+#endif
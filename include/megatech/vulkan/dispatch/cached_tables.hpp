@@ -0,0 +1,437 @@
+/**
+ * @file cached_tables.hpp
+ * @brief Memoizing Vulkan Dispatch Tables
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_CACHED_TABLES_HPP
+#define MEGATECH_VULKAN_DISPATCH_CACHED_TABLES_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <utility>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "commands.hpp"
+#include "tables.hpp"
+
+#include "internal/base/memoization.hpp"
+#include "internal/base/query_cache.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+  /**
+   * @brief A byte string that identifies the inputs of a cached query.
+   * @see device::cached_table
+   */
+  using query_key = internal::base::query_key;
+
+  /**
+   * @brief The type of a function that computes the key of a cached query.
+   * @details Key functions receive a query_key to append to, followed by a copy of every argument of the call (e.g.,
+   *          `bool(query_key&, VkDevice, const VkDeviceBufferMemoryRequirements*, VkMemoryRequirements2*)` for
+   *          `PFN_vkGetDeviceBufferMemoryRequirements`). They return false if the call can't be cached.
+   * @tparam Pointer The function pointer type of the cached command.
+   */
+  template <internal::base::command_pointer Pointer>
+  using key_function = typename internal::base::key_signature<Pointer>::type;
+
+namespace instance {
+
+  /**
+   * @brief An instance-level dispatch table that memoizes immutable physical device queries.
+   * @details Cached tables expose the same interface as table. Initially, every entry is identical to the
+   *          corresponding entry of the table used to construct it. Memoizing a command replaces its entry with a
+   *          pointer to a thunk. The first call with a given set of arguments calls through to the loader and stores
+   *          the result. Every later call with the same arguments copies the stored result without calling into the
+   *          loader or the driver. For example:
+   *          @code{.cpp}
+   *          auto ict = cached_table{ idt };
+   *          ict.memoize<command::vkGetPhysicalDeviceProperties, PFN_vkGetPhysicalDeviceProperties>();
+   *          ict.memoize<command::vkGetPhysicalDeviceFormatProperties, PFN_vkGetPhysicalDeviceFormatProperties>();
+   *          ict.memoize<command::vkGetPhysicalDeviceQueueFamilyProperties,
+   *                      PFN_vkGetPhysicalDeviceQueueFamilyProperties>();
+   *          // Retrieve and call "vkGetPhysicalDeviceFormatProperties" through ict as usual.
+   *          @endcode
+   *
+   *          This is intended for `vkGetPhysicalDeviceProperties(2)`, `vkGetPhysicalDeviceFeatures(2)`,
+   *          `vkGetPhysicalDeviceMemoryProperties(2)`, `vkGetPhysicalDeviceQueueFamilyProperties(2)`,
+   *          `vkGetPhysicalDeviceFormatProperties(2)`, and `vkGetPhysicalDeviceImageFormatProperties`, whose results
+   *          never change for the lifetime of a ::VkInstance. Any command whose only outputs are its final
+   *          structure (or its final count and array), and whose other arguments are all scalars or handles, may be
+   *          memoized. Memoizing a command with any other pointer argument (e.g.,
+   *          `vkGetPhysicalDeviceImageFormatProperties2`) fails to compile, because keys only hold argument values and
+   *          the pointed-to structure would not be part of the key.
+   *
+   *          Memoized thunks are safe to call concurrently. Lookups never lock. Two threads that miss at the same time
+   *          will both call through, and one of their results is kept. Calls with an output structure that extends a
+   *          `pNext` chain always bypass the cache. Results of `VK_ERROR_OUT_OF_HOST_MEMORY` and
+   *          `VK_ERROR_OUT_OF_DEVICE_MEMORY` are never stored. Count-only calls to an enumeration pass through until
+   *          the first call that retrieves elements.
+   *
+   *          Thunks are bound to their table. At most `MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS` cached tables
+   *          of each level may exist at once. Function pointers retrieved from a cached table **MUST NOT** be called
+   *          after the table is destroyed.
+   */
+  class cached_table final {
+  private:
+    VkInstance m_instance{ };
+    internal::base::memoization<command, MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT> m_memoization;
+  public:
+    /**
+     * @brief Construct a cached table.
+     * @details Cached tables do not have an ownership relationship with the table they are constructed from. The
+     *          lifetime of `base` **MAY** end immediately after construction.
+     * @param base The table to cache. The table shares ownership of the base table's ::VkInstance, and so it **MUST**
+     *             remain valid for the table's entire lifetime.
+     * @throw dispatch::error If there are no free slots.
+     */
+    explicit cached_table(const table& base);
+
+    /// @cond
+    cached_table(const cached_table& other) = delete;
+    cached_table(cached_table&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a cached table.
+     * @details Every memoized result is freed.
+     */
+    ~cached_table() noexcept = default;
+
+    /// @cond
+    cached_table& operator=(const cached_table& rhs) = delete;
+    cached_table& operator=(cached_table&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Memoize every future call to a command.
+     * @details If the command was resolved to null, the entry remains null. This **MUST NOT** be called concurrently
+     *          with ::get() or with calls through the table.
+     * @tparam Cmd The ::command to memoize.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkGetPhysicalDeviceProperties`).
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void memoize() {
+      m_memoization.memoize<Cmd, Pointer>();
+    }
+
+    /**
+     * @brief Restore the original function pointer of a command.
+     * @details Stored results are retained until the table is destroyed. This **MUST NOT** be called concurrently
+     *          with ::get() or with calls through the table.
+     * @tparam Cmd The ::command to restore.
+     */
+    template <command Cmd>
+    void restore() noexcept {
+      m_memoization.restore<Cmd>();
+    }
+
+    /**
+     * @brief Determine whether or not a command is memoized.
+     * @param cmd The ::command to check.
+     * @return True if calls to `cmd` are routed through a thunk. Otherwise false.
+     */
+    bool memoized(const command cmd) const noexcept;
+
+    /**
+     * @brief Retrieve the ::VkInstance used to construct the table.
+     * @return The ::VkInstance handle that was used to construct the table.
+     */
+    VkInstance instance() const;
+
+    /**
+     * @brief Retrieve the size of the table.
+     * @return The number of commands held in the table.
+     */
+    constexpr std::size_t size() const noexcept {
+      return MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT;
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* get(const command cmd) const {
+      if (static_cast<std::size_t>(cmd) >= size())
+      {
+        throw dispatch::error{ "The input command is outside the valid range of possible instance commnds." };
+      }
+      return m_memoization.slot(static_cast<std::size_t>(cmd));
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* operator()(const command cmd) const {
+      return get(cmd);
+    }
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case dispatch::internal::base::fnv_1a_cstr(#name): return get(command::name);
+/// @endcond
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash A 64-bit FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* get(const std::uint_least64_t hash) const noexcept {
+      switch (hash)
+      {
+      MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_LIST
+      default:
+        return nullptr;
+      }
+    }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash A 64-bit FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* operator()(const std::uint_least64_t hash) const noexcept {
+      return get(hash);
+    }
+  };
+
+}
+
+namespace device {
+
+  /**
+   * @brief A device-level dispatch table that caches queries whose results depend only on their inputs.
+   * @details Cached tables expose the same interface as table. Caching a command replaces its entry with a pointer to
+   *          a thunk. The thunk computes a key from the call's inputs and looks it up in a sharded concurrent hash map.
+   *          On a hit, the stored result is copied out without calling into the driver. On a miss, the thunk calls
+   *          through and stores the result.
+   *
+   *          If every input of a query is a scalar or a handle (e.g., `vkGetDeviceQueue`), no key function is needed.
+   *          Queries with structure inputs need a key_function that writes the contents of those structures. For
+   *          example:
+   *          @code{.cpp}
+   *          auto dct = cached_table{ ddt };
+   *          dct.cache<command::vkGetDeviceQueue, PFN_vkGetDeviceQueue>();
+   *          dct.cache<command::vkGetDeviceBufferMemoryRequirements, PFN_vkGetDeviceBufferMemoryRequirements>(
+   *            [](query_key& key, VkDevice device, const VkDeviceBufferMemoryRequirements* info,
+   *               VkMemoryRequirements2*) {
+   *              const auto& buffer = *info->pCreateInfo;
+   *              if (info->pNext || buffer.pNext)
+   *              {
+   *                return false;
+   *              }
+   *              key.write(device);
+   *              key.write(buffer.flags);
+   *              key.write(buffer.size);
+   *              key.write(buffer.usage);
+   *              key.write(buffer.sharingMode);
+   *              key.write(buffer.pQueueFamilyIndices, buffer.queueFamilyIndexCount);
+   *              return true;
+   *            }
+   *          );
+   *          @endcode
+   *
+   *          Other good candidates are `vkGetDeviceImageMemoryRequirements`, `vkGetDescriptorSetLayoutSupport`, and
+   *          `vkGetImageSubresourceLayout` for linear images. Results keyed by a non-dispatchable handle (e.g., a
+   *          `VkImage`) **MUST** be cleared with ::clear() before that handle is destroyed, since the implementation
+   *          may reuse handle values.
+   *
+   *          Cached thunks are safe to call concurrently. Readers take a shared lock on one shard of the map, so they
+   *          never block each other. Calls with an output structure that extends a `pNext` chain always bypass the
+   *          cache. Thunks are bound to their table. At most `MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS` cached
+   *          tables of each level may exist at once. Function pointers retrieved from a cached table **MUST NOT** be
+   *          called after the table is destroyed.
+   * @see instance::cached_table
+   */
+  class cached_table final {
+  private:
+    VkInstance m_instance{ };
+    VkDevice m_device{ };
+    internal::base::query_cache<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT> m_cache;
+  public:
+    /**
+     * @brief Construct a cached table.
+     * @details Cached tables do not have an ownership relationship with the table they are constructed from. The
+     *          lifetime of `base` **MAY** end immediately after construction.
+     * @param base The table to cache. The table shares ownership of the base table's ::VkInstance and ::VkDevice, and
+     *             so they **MUST** remain valid for the table's entire lifetime.
+     * @throw dispatch::error If there are no free slots.
+     */
+    explicit cached_table(const table& base);
+
+    /// @cond
+    cached_table(const cached_table& other) = delete;
+    cached_table(cached_table&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a cached table.
+     * @details Every stored result is freed.
+     */
+    ~cached_table() noexcept = default;
+
+    /// @cond
+    cached_table& operator=(const cached_table& rhs) = delete;
+    cached_table& operator=(cached_table&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Cache every future call to a command whose inputs are all scalars or handles.
+     * @details If the command was resolved to null, the entry remains null. This **MUST NOT** be called concurrently
+     *          with ::get() or with calls through the table.
+     * @tparam Cmd The ::command to cache.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkGetDeviceQueue`).
+     * @throw dispatch::error If `Cmd` was previously cached with a different `Pointer` type.
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void cache() {
+      m_cache.cache<Cmd, Pointer>();
+    }
+
+    /**
+     * @brief Cache every future call to a command.
+     * @details If the command was resolved to null, the entry remains null. Any previously stored results of `Cmd`
+     *          are discarded. This **MUST NOT** be called concurrently with ::get() or with calls through the table.
+     * @tparam Cmd The ::command to cache.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkGetDeviceImageMemoryRequirements`).
+     * @param key The function that computes the key of each call. Two calls with equal keys **MUST** produce equal
+     *            results.
+     * @throw dispatch::error If `Cmd` was previously cached with a different `Pointer` type.
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void cache(key_function<Pointer> key) {
+      m_cache.cache<Cmd, Pointer>(std::move(key));
+    }
+
+    /**
+     * @brief Discard every stored result of a command.
+     * @details This is safe to call concurrently with calls through the table.
+     * @tparam Cmd The ::command to clear.
+     */
+    template <command Cmd>
+    void clear() noexcept {
+      m_cache.clear<Cmd>();
+    }
+
+    /**
+     * @brief Restore the original function pointer of a command and discard its stored results.
+     * @details This **MUST NOT** be called concurrently with ::get() or with calls through the table.
+     * @tparam Cmd The ::command to restore.
+     */
+    template <command Cmd>
+    void restore() noexcept {
+      m_cache.restore<Cmd>();
+    }
+
+    /**
+     * @brief Determine whether or not a command is cached.
+     * @param cmd The ::command to check.
+     * @return True if calls to `cmd` are routed through a thunk. Otherwise false.
+     */
+    bool cached(const command cmd) const noexcept;
+
+    /**
+     * @brief Count the stored results of a command.
+     * @param cmd The ::command to check.
+     * @return The number of distinct keys stored for `cmd`.
+     */
+    std::size_t entries(const command cmd) const noexcept;
+
+    /**
+     * @brief Retrieve the ::VkInstance used to construct the table.
+     * @return The ::VkInstance handle that was used to construct the table.
+     */
+    VkInstance instance() const;
+
+    /**
+     * @brief Retrieve the ::VkDevice used to construct the table.
+     * @return The ::VkDevice handle that was used to construct the table if any. Null is returned in all other
+     *         cases.
+     */
+    VkDevice device() const;
+
+    /**
+     * @brief Retrieve the size of the table.
+     * @return The number of commands held in the table.
+     */
+    constexpr std::size_t size() const noexcept {
+      return MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT;
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* get(const command cmd) const {
+      if (static_cast<std::size_t>(cmd) >= size())
+      {
+        throw dispatch::error{ "The input command is outside the valid range of possible device commnds." };
+      }
+      return m_cache.slot(static_cast<std::size_t>(cmd));
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* operator()(const command cmd) const {
+      return get(cmd);
+    }
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case dispatch::internal::base::fnv_1a_cstr(#name): return get(command::name);
+/// @endcond
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* get(const std::uint_least64_t hash) const noexcept {
+      switch (hash)
+      {
+      MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+      default:
+        return nullptr;
+      }
+    }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* operator()(const std::uint_least64_t hash) const noexcept {
+      return get(hash);
+    }
+  };
+
+}
+
+}
+
+#endif
@@ -0,0 +1,528 @@
+/**
+ * @file capture.hpp
+ * @brief Vulkan Command Call Stream Capture and Replay
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_CAPTURE_HPP
+#define MEGATECH_VULKAN_DISPATCH_CAPTURE_HPP
+
+#include <cstddef>
+#include <cinttypes>
+#include <cstring>
+
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "commands.hpp"
+
+#include "internal/base/arguments.hpp"
+#include "internal/base/payloads.hpp"
+#include "internal/base/probes.hpp"
+#include "internal/base/slots.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+  /**
+   * @brief A writer that records Vulkan command calls to a compact binary stream.
+   * @details Each record holds the command's level and value, a timestamp, the calling thread, one fixed-size
+   *          entry per argument, and the payloads of the call's pointer arguments. Scalars are stored by value and
+   *          handles are stored by identity. Pointer arguments are deep copied into the record using the same
+   *          hand-written structure metadata as command_recording. Pointers that can't be copied (e.g., outputs,
+   *          structures with extension chains, or structures that aren't described) are stored only as null or
+   *          non-null.
+   *
+   *          The stream is a native-endian file that can be memory-mapped. It consists of a header, a sequence of
+   *          8-byte aligned records, and an index containing the offset of every Nth record. The index and the final
+   *          record count are written when the capture is closed. A capture that is never closed (e.g., because the
+   *          process crashed) has no index, but its records remain readable.
+   *
+   *          Writes are buffered and serialized by a mutex. Timestamps are taken while the mutex is held, so records
+   *          are in timestamp order. Calls are normally recorded by a capture_policy.
+   */
+  class call_capture final {
+  private:
+    std::ofstream m_output{ };
+    mutable std::mutex m_mutex{ };
+    std::vector<std::uint64_t> m_index{ };
+    std::uint64_t m_stride{ };
+    std::uint64_t m_offset{ };
+    std::uint64_t m_records{ };
+    bool m_closed{ };
+
+    void write(const std::uint16_t level, const std::uint16_t command,
+               const std::span<const internal::base::encoded_argument> arguments,
+               const std::span<const std::byte> payloads);
+  public:
+    /**
+     * @brief Construct a capture.
+     * @param path The path of the stream file. Any existing file is truncated.
+     * @param stride The number of records between index entries.
+     * @throw dispatch::error If `stride` is zero or if the file cannot be opened.
+     */
+    explicit call_capture(const std::filesystem::path& path, const std::size_t stride = 1024);
+
+    /// @cond
+    call_capture(const call_capture& other) = delete;
+    call_capture(call_capture&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a capture.
+     * @details If the capture is still open, it is closed. Errors are discarded.
+     */
+    ~call_capture() noexcept;
+
+    /// @cond
+    call_capture& operator=(const call_capture& rhs) = delete;
+    call_capture& operator=(call_capture&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Record a call.
+     * @details Calls recorded after the capture is closed are discarded. This is safe to call concurrently.
+     * @tparam Cmd The called command.
+     * @param arguments The arguments of the call.
+     * @throw dispatch::error If the stream cannot be written.
+     */
+    template <auto Cmd, typename... Arguments>
+    void record(const Arguments... arguments) {
+      using internal::base::argument_kind;
+      auto encoded = std::array<internal::base::encoded_argument, sizeof...(Arguments)>{
+        internal::base::encode(arguments)...
+      };
+      auto extents = std::array<internal::base::payload_extent, sizeof...(Arguments)>{ };
+      try
+      {
+        extents = internal::base::payload_extents<Cmd>(arguments...);
+      }
+      catch (const dispatch::error&)
+      {
+        // Calls whose structures can't be copied are still recorded, but only opaquely.
+        write(internal::base::probe_level<decltype(Cmd)>(), static_cast<std::uint16_t>(Cmd), encoded, { });
+        return;
+      }
+      constexpr auto copyable = internal::base::copyable<Cmd, Arguments...>();
+      auto words = std::size_t{ 0 };
+      for (auto i = std::size_t{ 0 }; i < sizeof...(Arguments); ++i)
+      {
+        if (copyable[i] && encoded[i].kind == argument_kind::pointer && encoded[i].value)
+        {
+          words += 2 + internal::base::words_of(extents[i].bytes);
+        }
+      }
+      // Each payload is preceded by its element count and its size. Nested pointers are stored relative to the payload
+      // area.
+      auto payloads = std::vector<std::uint64_t>(words);
+      const auto origin = reinterpret_cast<std::byte*>(payloads.data());
+      auto offset = std::size_t{ 0 };
+      const auto serialize = [&]<std::size_t Index, typename Type>(std::integral_constant<std::size_t, Index>,
+                                                                   const Type value) {
+        if constexpr (std::is_pointer_v<Type> && !internal::base::handle<Type> &&
+                      internal::base::copyable<Cmd, Arguments...>()[Index])
+        {
+          if (value)
+          {
+            payloads[offset] = extents[Index].count;
+            payloads[offset + 1] = extents[Index].span;
+            offset += 2;
+            internal::base::copy_payload(origin + offset * sizeof(std::uint64_t), value, extents[Index],
+                                         reinterpret_cast<std::uintptr_t>(origin));
+            encoded[Index].kind = argument_kind::payload;
+            encoded[Index].value = offset * sizeof(std::uint64_t);
+            offset += internal::base::words_of(extents[Index].bytes);
+          }
+        }
+      };
+      [&]<std::size_t... Indices>(std::index_sequence<Indices...>) {
+        (serialize(std::integral_constant<std::size_t, Indices>{ }, arguments), ...);
+      }(std::index_sequence_for<Arguments...>{ });
+      write(internal::base::probe_level<decltype(Cmd)>(), static_cast<std::uint16_t>(Cmd), encoded,
+            std::as_bytes(std::span{ payloads }));
+    }
+
+    /**
+     * @brief Write the index and the record count, and then close the stream.
+     * @details Subsequent calls have no effect.
+     * @throw dispatch::error If the stream cannot be written.
+     */
+    void close();
+
+    /**
+     * @brief Retrieve the number of recorded calls.
+     * @return The number of calls recorded so far.
+     */
+    std::uint64_t records() const noexcept;
+  };
+
+  /**
+   * @brief An interception policy that records calls into a call_capture.
+   * @details When no capture is attached, the policy costs a single load and branch per call.
+   */
+  class capture_policy final {
+  private:
+    call_capture* m_capture{ };
+  public:
+    /**
+     * @brief Record a call, if a capture is attached, and continue the chain.
+     * @tparam Cmd The called command.
+     * @param next The remainder of the policy chain.
+     * @param arguments The arguments of the call.
+     * @return The result of `next`.
+     */
+    template <auto Cmd, typename Next, typename... Arguments>
+    decltype(auto) invoke(const Next& next, Arguments... arguments) {
+      if (m_capture) [[unlikely]]
+      {
+        m_capture->record<Cmd>(arguments...);
+      }
+      return next(arguments...);
+    }
+
+    /**
+     * @brief Attach a call_capture to the policy.
+     * @details This **MUST NOT** be called concurrently with calls through the owning table.
+     * @param capture A pointer to the capture to attach or null.
+     */
+    void set_capture(call_capture *const capture) noexcept {
+      m_capture = capture;
+    }
+
+    /**
+     * @brief Retrieve the call_capture attached to the policy.
+     * @return A pointer to the attached capture, or null if no capture is attached.
+     */
+    call_capture* capture() const noexcept {
+      return m_capture;
+    }
+  };
+
+  /**
+   * @brief A read-only view of a stream written by a call_capture.
+   * @details On POSIX systems the file is memory-mapped. Elsewhere, it is read into memory.
+   */
+  class call_stream final {
+  public:
+    /**
+     * @brief A single recorded call.
+     */
+    class record final {
+    private:
+      const std::byte* m_data{ };
+    public:
+      /// @cond
+      explicit record(const std::byte *const data) noexcept;
+      /// @endcond
+
+      /**
+       * @brief Retrieve the level of the recorded command.
+       * @return The command's level (1 for instance commands, and 2 for device commands).
+       */
+      std::uint16_t level() const noexcept;
+
+      /**
+       * @brief Retrieve the value of the recorded command.
+       * @return The value of the command in the enumeration of its level.
+       */
+      std::uint16_t command() const noexcept;
+
+      /**
+       * @brief Retrieve the identity of the thread that made the call.
+       * @return A small integer identifying the thread within the capturing process.
+       */
+      std::uint32_t thread() const noexcept;
+
+      /**
+       * @brief Retrieve the time at which the call was made.
+       * @return The call's internal::base::timestamp() in the capturing process.
+       */
+      std::uint64_t timestamp() const noexcept;
+
+      /**
+       * @brief Retrieve the call's encoded arguments.
+       * @return A view of the encoded arguments.
+       */
+      std::span<const internal::base::encoded_argument> arguments() const noexcept;
+
+      /**
+       * @brief Retrieve the call's payload area.
+       * @details Arguments of kind internal::base::argument_kind::payload refer to offsets within this area.
+       * @return A view of the 8-byte aligned payload area.
+       */
+      std::span<const std::byte> payloads() const noexcept;
+
+      /// @cond
+      std::size_t size() const noexcept;
+      /// @endcond
+    };
+
+    /**
+     * @brief A forward iterator over the records of a stream.
+     */
+    class iterator final {
+    private:
+      const std::byte* m_current{ };
+    public:
+      /// @cond
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = record;
+      using difference_type = std::ptrdiff_t;
+      using pointer = void;
+      using reference = record;
+
+      iterator() = default;
+      explicit iterator(const std::byte *const current) noexcept;
+
+      record operator*() const noexcept;
+      iterator& operator++() noexcept;
+      iterator operator++(int) noexcept;
+      bool operator==(const iterator& rhs) const noexcept = default;
+      /// @endcond
+    };
+  private:
+    struct mapping;
+
+    std::unique_ptr<mapping> m_mapping{ };
+    std::span<const std::byte> m_records{ };
+    std::span<const std::byte> m_index{ };
+    std::uint64_t m_count{ };
+    std::uint64_t m_stride{ };
+  public:
+    /**
+     * @brief Open a stream.
+     * @param path The path of a file written by a call_capture.
+     * @throw dispatch::error If the file cannot be read or is not a valid stream.
+     */
+    explicit call_stream(const std::filesystem::path& path);
+
+    /// @cond
+    call_stream(const call_stream& other) = delete;
+    call_stream(call_stream&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Close a stream.
+     */
+    ~call_stream() noexcept;
+
+    /// @cond
+    call_stream& operator=(const call_stream& rhs) = delete;
+    call_stream& operator=(call_stream&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Retrieve the number of records in the stream.
+     * @return The number of records.
+     */
+    std::uint64_t size() const noexcept;
+
+    /**
+     * @brief Retrieve an iterator to the first record.
+     * @return An iterator to the first record.
+     */
+    iterator begin() const noexcept;
+
+    /**
+     * @brief Retrieve an iterator past the last record.
+     * @return An iterator past the last record.
+     */
+    iterator end() const noexcept;
+
+    /**
+     * @brief Retrieve an iterator to a record.
+     * @details This uses the stream's index, so it visits at most one index stride of records.
+     * @param index The index of the desired record.
+     * @return An iterator to the record at `index`, or ::end() if `index` is out of range.
+     */
+    iterator seek(const std::uint64_t index) const noexcept;
+  };
+
+  /**
+   * @brief A player that drives the calls recorded in a call_stream through dispatch tables.
+   * @details Commands are replayed through handlers that decode a record and call a table's function pointer. Handles
+   *          are translated from their captured identity to a live handle using a client-supplied mapping. For
+   *          example:
+   *          @code{.cpp}
+   *          auto player = call_replayer{ };
+   *          player.map_handle(captured_device, device);
+   *          player.bind<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>(ddt);
+   *          player.replay(stream);
+   *          @endcode
+   *
+   *          Captured payloads are copied before each call, and their handles (including those in nested structures)
+   *          are translated as well. Pointer arguments whose payloads weren't captured can only be replayed if they
+   *          were null. Records for unbound commands are skipped.
+   */
+  class call_replayer final {
+  private:
+    using handler = std::function<void(const call_stream::record&)>;
+
+    std::unordered_map<std::uint64_t, std::uint64_t> m_handles{ };
+    std::unordered_map<std::uint32_t, handler> m_handlers{ };
+
+    template <typename Handle>
+    Handle translate(const std::uint64_t captured) const {
+      if (!captured)
+      {
+        return nullptr;
+      }
+      const auto found = m_handles.find(captured);
+      if (found == m_handles.end())
+      {
+        throw dispatch::error{ "The recorded handle has not been mapped to a live handle." };
+      }
+      return reinterpret_cast<Handle>(static_cast<std::uintptr_t>(found->second));
+    }
+
+    template <typename Type, bool Copyable>
+    Type decode(const internal::base::encoded_argument& argument, const std::span<std::byte> payloads) const {
+      using internal::base::argument_kind;
+      if constexpr (internal::base::handle<Type>)
+      {
+        if (argument.kind != argument_kind::handle)
+        {
+          throw dispatch::error{ "The recorded argument is not a handle." };
+        }
+        return translate<Type>(argument.value);
+      }
+      else if constexpr (std::is_pointer_v<Type>)
+      {
+        if constexpr (Copyable)
+        {
+          if (argument.kind == argument_kind::payload)
+          {
+            auto prefix = std::array<std::uint64_t, 2>{ };
+            if (argument.value < sizeof(prefix) || argument.value > payloads.size())
+            {
+              throw dispatch::error{ "The recorded payload is out of bounds." };
+            }
+            std::memcpy(prefix.data(), payloads.data() + argument.value - sizeof(prefix), sizeof(prefix));
+            const auto [count, span] = prefix;
+            const auto bytes = internal::base::locate_payload<std::byte>(payloads, argument.value, span).first;
+            using element = std::remove_cv_t<std::remove_pointer_t<Type>>;
+            const auto values = reinterpret_cast<element*>(bytes);
+            if constexpr (!std::is_void_v<element>)
+            {
+              if (count > span / sizeof(element))
+              {
+                throw dispatch::error{ "The recorded payload is out of bounds." };
+              }
+              internal::base::relocate_nested(values, count, payloads, [this]<typename Handle>(Handle& value) {
+                value = translate<Handle>(reinterpret_cast<std::uintptr_t>(value));
+              });
+            }
+            return values;
+          }
+        }
+        if (argument.kind != argument_kind::pointer || argument.value)
+        {
+          throw dispatch::error{ "Only null pointer arguments and captured payloads can be replayed." };
+        }
+        return nullptr;
+      }
+      else if constexpr (std::is_floating_point_v<Type>)
+      {
+        if (argument.kind != argument_kind::floating)
+        {
+          throw dispatch::error{ "The recorded argument is not a floating point value." };
+        }
+        return static_cast<Type>(std::bit_cast<double>(argument.value));
+      }
+      else
+      {
+        if (argument.kind != argument_kind::integer)
+        {
+          throw dispatch::error{ "The recorded argument is not an integer." };
+        }
+        return static_cast<Type>(argument.value);
+      }
+    }
+
+    template <auto Cmd, typename Result, typename... Arguments>
+    void invoke(Result (MEGATECH_VULKAN_DISPATCH_API_PTR* pfn)(Arguments...),
+                const call_stream::record& current) const {
+      const auto arguments = current.arguments();
+      if (arguments.size() != sizeof...(Arguments))
+      {
+        throw dispatch::error{ "The number of recorded arguments does not match the command's signature." };
+      }
+      // Payloads are relocated and their handles are translated in place, so the record itself is left untouched.
+      const auto recorded = current.payloads();
+      auto scratch = std::vector<std::uint64_t>(recorded.size() / sizeof(std::uint64_t));
+      std::memcpy(scratch.data(), recorded.data(), scratch.size() * sizeof(std::uint64_t));
+      const auto payloads = std::as_writable_bytes(std::span{ scratch });
+      [&]<std::size_t... Indices>(std::index_sequence<Indices...>) {
+        constexpr auto copyable = internal::base::copyable<Cmd, Arguments...>();
+        // Braced initialization guarantees that arguments are decoded from left to right.
+        std::apply(pfn, std::tuple<Arguments...>{ decode<Arguments, copyable[Indices]>(arguments[Indices],
+                                                                                       payloads)... });
+      }(std::index_sequence_for<Arguments...>{ });
+    }
+  public:
+    /**
+     * @brief Map a captured handle to a live handle.
+     * @tparam Handle The type of the live handle.
+     * @param captured The handle's identity in the capture (i.e., its value in the capturing process).
+     * @param live The handle to pass in its place.
+     */
+    template <typename Handle>
+    void map_handle(const std::uint64_t captured, const Handle live) {
+      m_handles[captured] = internal::base::encode(live).value;
+    }
+
+    /**
+     * @brief Replay a command through a table.
+     * @tparam Cmd The command to bind.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkCmdDraw`).
+     * @tparam Table The type of `table`.
+     * @param table The table whose function pointer is called. It **MUST** outlive the replayer's use of the binding.
+     * @throw dispatch::error If `table` resolved the command to null.
+     */
+    template <auto Cmd, internal::base::command_pointer Pointer, typename Table>
+    void bind(const Table& table) {
+      const auto pfn = *reinterpret_cast<const Pointer*>(table.get(Cmd));
+      if (!pfn)
+      {
+        throw dispatch::error{ "A command that was resolved to null cannot be replayed." };
+      }
+      constexpr auto key = (static_cast<std::uint32_t>(internal::base::probe_level<decltype(Cmd)>()) << 16) |
+                           static_cast<std::uint32_t>(Cmd);
+      m_handlers[key] = [this, pfn](const call_stream::record& current) { invoke<Cmd>(pfn, current); };
+    }
+
+    /**
+     * @brief Replay a range of records.
+     * @param first The first record to replay.
+     * @param last The record after the last record to replay.
+     * @return The number of records that were replayed. Records for unbound commands are not counted.
+     * @throw dispatch::error If a bound record cannot be decoded, or if one of its payloads is out of bounds.
+     */
+    std::uint64_t replay(call_stream::iterator first, const call_stream::iterator last) const;
+
+    /**
+     * @brief Replay every record in a stream.
+     * @param stream The stream to replay.
+     * @return The number of records that were replayed. Records for unbound commands are not counted.
+     * @throw dispatch::error If a bound record cannot be decoded, or if one of its payloads is out of bounds.
+     */
+    std::uint64_t replay(const call_stream& stream) const;
+  };
+
+}
+
+#endif
@@ -0,0 +1,484 @@
+/**
+ * @file coalescing.hpp
+ * @brief Vulkan Descriptor Update Coalescing
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_COALESCING_HPP
+#define MEGATECH_VULKAN_DISPATCH_COALESCING_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "commands.hpp"
+#include "tables.hpp"
+
+#include "internal/base/descriptors.hpp"
+#include "internal/base/fnv_1a.hpp"
+#include "internal/base/per_thread.hpp"
+#include "internal/base/submissions.hpp"
+
+namespace megatech::vulkan::dispatch::device {
+
+  /**
+   * @brief An aggregator that merges many small descriptor updates into a few large ones.
+   * @details Writes made through a coalescer are copied into an arena owned by the calling thread instead of being
+   *          sent to the driver. Each thread's writes are sent to the driver in a single `vkUpdateDescriptorSets` call
+   *          when the coalescer is flushed. Before that:
+   *          - A write that extends the previous write to the same binding (i.e., its first array element follows the
+   *            previous write's last one) is merged into it.
+   *          - A write that's entirely overwritten by a later write to the same binding is dropped.
+   *
+   *          Each set with deferred writes is owned by the arena that holds them. Before a thread writes a set owned by
+   *          another thread's arena, that arena is flushed. As a result, the writes to each set are applied in order,
+   *          even across threads, so neither optimization changes the final contents of any set. For example:
+   *          @code{.cpp}
+   *          using coalescer = descriptor_coalescer<PFN_vkUpdateDescriptorSets>;
+   *          auto updates = coalescer{ ddt };
+   *          auto dit = intercepted_table<coalescer::policy>{ ddt };
+   *          dit.policy<coalescer::policy>().set_coalescer(&updates);
+   *          dit.intercept<command::vkUpdateDescriptorSets, PFN_vkUpdateDescriptorSets>();
+   *          dit.intercept<command::vkCmdBindDescriptorSets, PFN_vkCmdBindDescriptorSets>();
+   *          dit.intercept<command::vkQueueSubmit, PFN_vkQueueSubmit>();
+   *          @endcode
+   *
+   *          A thread's writes are also flushed when it accumulates the maximum number of writes, and every thread's
+   *          writes are flushed before an update that copies descriptors. Writes that extend a `pNext` chain, or that
+   *          use descriptor types that aren't stored in `pImageInfo`, `pBufferInfo`, or `pTexelBufferView`, can't be
+   *          coalesced. The calling thread's writes are flushed and the write is sent directly.
+   *
+   *          When routed through policy, every thread's writes are flushed before descriptor sets are bound, before
+   *          queue submissions (for sets that are updated after they're bound), before template updates, and before
+   *          descriptor sets are freed or their pools are reset or destroyed. Updates are **NOT** visible to the
+   *          driver until a flush, so commands that aren't routed through the policy **MUST NOT** read
+   *          descriptor sets before calling flush().
+   *
+   *          Flushes call the base table's `vkUpdateDescriptorSets` directly, so the coalescer's policy **SHOULD** be
+   *          the last policy of the chain. The coalescer is safe to use concurrently.
+   * @tparam Update The function pointer type of `vkUpdateDescriptorSets` (i.e., `PFN_vkUpdateDescriptorSets`).
+   */
+  template <internal::base::command_pointer Update>
+  class descriptor_coalescer final {
+  private:
+    using signature = internal::base::update_signature<Update>;
+  public:
+    /**
+     * @brief The device handle type (i.e., `VkDevice`).
+     */
+    using device_handle = typename signature::device;
+
+    /**
+     * @brief The descriptor write structure type (i.e., `VkWriteDescriptorSet`).
+     */
+    using write = typename signature::write;
+
+    /**
+     * @brief The descriptor copy structure type (i.e., `VkCopyDescriptorSet`).
+     */
+    using copy = typename signature::copy;
+
+    /**
+     * @brief An interception policy that routes descriptor updates through a descriptor_coalescer.
+     * @details When no coalescer is attached, the policy costs a single load and branch per call.
+     */
+    class policy final {
+    private:
+      descriptor_coalescer* m_coalescer{ };
+    public:
+      /**
+       * @brief Defer a descriptor update, or flush before a command that reads descriptor sets, and continue the
+       *        chain.
+       * @tparam Cmd The called command.
+       * @param next The remainder of the policy chain.
+       * @param arguments The arguments of the call.
+       * @return The result of `next`.
+       */
+      template <command Cmd, typename Next, typename... Arguments>
+      decltype(auto) invoke(const Next& next, Arguments... arguments) {
+        using internal::base::named;
+        if (!m_coalescer)
+        {
+          return next(arguments...);
+        }
+        if constexpr (named<Cmd>("vkUpdateDescriptorSets"))
+        {
+          m_coalescer->update(arguments...);
+        }
+        else if constexpr (named<Cmd>("vkCmdBindDescriptorSets") || named<Cmd>("vkCmdBindDescriptorSets2") ||
+                           named<Cmd>("vkCmdBindDescriptorSets2KHR") || named<Cmd>("vkQueueSubmit") ||
+                           named<Cmd>("vkQueueSubmit2") || named<Cmd>("vkQueueSubmit2KHR") ||
+                           named<Cmd>("vkUpdateDescriptorSetWithTemplate") ||
+                           named<Cmd>("vkUpdateDescriptorSetWithTemplateKHR") ||
+                           named<Cmd>("vkFreeDescriptorSets") || named<Cmd>("vkResetDescriptorPool") ||
+                           named<Cmd>("vkDestroyDescriptorPool"))
+        {
+          m_coalescer->flush();
+          return next(arguments...);
+        }
+        else
+        {
+          return next(arguments...);
+        }
+      }
+
+      /**
+       * @brief Attach a descriptor_coalescer to the policy.
+       * @details This **MUST NOT** be called concurrently with calls through the owning table.
+       * @param coalescer A pointer to the coalescer to attach or null.
+       */
+      void set_coalescer(descriptor_coalescer *const coalescer) noexcept {
+        m_coalescer = coalescer;
+      }
+
+      /**
+       * @brief Retrieve the descriptor_coalescer attached to the policy.
+       * @return A pointer to the attached coalescer, or null if no coalescer is attached.
+       */
+      descriptor_coalescer* coalescer() const noexcept {
+        return m_coalescer;
+      }
+    };
+  private:
+    using payload = internal::base::descriptor_payload;
+    using set_handle = std::remove_cv_t<decltype(write{ }.dstSet)>;
+
+    struct pending_write final {
+      write header{ };
+      std::size_t offset{ };
+      payload kind{ };
+      bool live{ };
+    };
+
+    // Arenas are value-initialized by internal::base::per_thread.
+    struct arena final {
+      // Only the owning thread locks this, except during a flush of every thread.
+      std::mutex mutex;
+      std::atomic<std::size_t> size;
+      std::vector<pending_write> writes;
+      std::vector<typename signature::image_info> images;
+      std::vector<typename signature::buffer_info> buffers;
+      std::vector<typename signature::texel_view> views;
+      std::vector<write> flat;
+    };
+
+    Update m_update{ };
+    device_handle m_device{ };
+    std::size_t m_max_writes{ };
+    internal::base::per_thread<arena> m_arenas{ };
+    // Maps sets with deferred writes to the arena that holds them. This is locked after an arena, and never before.
+    std::mutex m_owners_mutex{ };
+    std::unordered_map<set_handle, arena*> m_owners{ };
+    std::atomic<std::uint64_t> m_deferred{ };
+    std::atomic<std::uint64_t> m_merged{ };
+    std::atomic<std::uint64_t> m_dropped{ };
+    std::atomic<std::uint64_t> m_updates{ };
+
+    static std::uint32_t end_of(const write& current) noexcept {
+      return current.dstArrayElement + current.descriptorCount;
+    }
+
+    template <typename Element>
+    static const Element* source(const write& current) noexcept {
+      if constexpr (std::is_same_v<Element, typename signature::image_info>)
+      {
+        return current.pImageInfo;
+      }
+      else if constexpr (std::is_same_v<Element, typename signature::buffer_info>)
+      {
+        return current.pBufferInfo;
+      }
+      else
+      {
+        return current.pTexelBufferView;
+      }
+    }
+
+    template <typename Element>
+    static std::size_t append(std::vector<Element>& destination, const write& current) {
+      const auto offset = destination.size();
+      const auto first = source<Element>(current);
+      destination.insert(destination.end(), first, first + current.descriptorCount);
+      return offset;
+    }
+
+    static std::size_t append(arena& local, const write& current, const payload kind) {
+      switch (kind)
+      {
+      case payload::image:
+        return append(local.images, current);
+      case payload::buffer:
+        return append(local.buffers, current);
+      default:
+        return append(local.views, current);
+      }
+    }
+
+    void flush(arena& local) {
+      if (!local.size.load(std::memory_order_relaxed))
+      {
+        return;
+      }
+      // Arrays are fixed up only after every write is appended, because appending may reallocate them.
+      local.flat.clear();
+      for (const auto& pending : local.writes)
+      {
+        if (!pending.live)
+        {
+          continue;
+        }
+        auto& current = local.flat.emplace_back(pending.header);
+        current.pImageInfo = nullptr;
+        current.pBufferInfo = nullptr;
+        current.pTexelBufferView = nullptr;
+        switch (pending.kind)
+        {
+        case payload::image:
+          current.pImageInfo = local.images.data() + pending.offset;
+          break;
+        case payload::buffer:
+          current.pBufferInfo = local.buffers.data() + pending.offset;
+          break;
+        default:
+          current.pTexelBufferView = local.views.data() + pending.offset;
+          break;
+        }
+      }
+      m_update(m_device, static_cast<std::uint32_t>(local.flat.size()), local.flat.data(), 0, nullptr);
+      m_updates.fetch_add(1, std::memory_order_relaxed);
+      {
+        auto lock = std::unique_lock{ m_owners_mutex };
+        for (const auto& pending : local.writes)
+        {
+          disown(local, pending.header.dstSet);
+        }
+      }
+      local.writes.clear();
+      local.images.clear();
+      local.buffers.clear();
+      local.views.clear();
+      local.size.store(0, std::memory_order_relaxed);
+    }
+
+    // This requires m_owners_mutex.
+    void disown(arena& local, const set_handle set) {
+      if (const auto found = m_owners.find(set); found != m_owners.end() && found->second == &local)
+      {
+        m_owners.erase(found);
+      }
+    }
+
+    // Transfer a set to the calling thread's arena. Writes to the set that are deferred by another thread's arena are
+    // flushed first, so they can't be applied after the calling thread's writes.
+    void claim(arena& local, std::unique_lock<std::mutex>& lock, const set_handle set) {
+      for (;;)
+      {
+        auto owner = static_cast<arena*>(nullptr);
+        {
+          auto guard = std::unique_lock{ m_owners_mutex };
+          auto& current = m_owners[set];
+          if (!current || current == &local)
+          {
+            current = &local;
+            return;
+          }
+          owner = current;
+        }
+        // Two arenas are never locked at once. The owner may change while the calling thread's arena is unlocked, so
+        // ownership is checked again.
+        lock.unlock();
+        {
+          auto other = std::unique_lock{ owner->mutex };
+          flush(*owner);
+        }
+        lock.lock();
+      }
+    }
+
+    void defer(arena& local, const write& current, const payload kind) {
+      m_deferred.fetch_add(1, std::memory_order_relaxed);
+      for (auto& pending : local.writes)
+      {
+        if (pending.live && pending.header.dstSet == current.dstSet &&
+            pending.header.dstBinding == current.dstBinding &&
+            pending.header.dstArrayElement >= current.dstArrayElement && end_of(pending.header) <= end_of(current))
+        {
+          pending.live = false;
+          m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      // Only the most recent write is extended, so merging never reorders writes.
+      if (!local.writes.empty())
+      {
+        auto& last = local.writes.back();
+        if (last.live && last.kind == kind && last.header.dstSet == current.dstSet &&
+            last.header.dstBinding == current.dstBinding && last.header.descriptorType == current.descriptorType &&
+            end_of(last.header) == current.dstArrayElement)
+        {
+          append(local, current, kind);
+          last.header.descriptorCount += current.descriptorCount;
+          m_merged.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+      }
+      const auto offset = append(local, current, kind);
+      local.writes.emplace_back(current, offset, kind, true);
+      local.size.store(local.writes.size(), std::memory_order_relaxed);
+    }
+  public:
+    /**
+     * @brief Construct a descriptor coalescer.
+     * @param base The table whose `vkUpdateDescriptorSets` is used to flush. The table's ::VkDevice **MUST** remain
+     *             valid for the coalescer's entire lifetime.
+     * @param max_writes The maximum number of deferred writes per thread. Reaching it flushes the thread's writes.
+     * @throw dispatch::error If `max_writes` is zero or if `vkUpdateDescriptorSets` was resolved to null.
+     */
+    explicit descriptor_coalescer(const table& base, const std::size_t max_writes = 256) :
+    m_device{ base.device() }, m_max_writes{ max_writes } {
+      if (!m_max_writes)
+      {
+        throw dispatch::error{ "The maximum number of deferred writes must be at least 1." };
+      }
+      const auto pfn = static_cast<const Update*>(base.get(internal::base::fnv_1a_cstr("vkUpdateDescriptorSets")));
+      if (!pfn || !*pfn)
+      {
+        throw dispatch::error{ "Descriptor coalescing requires \"vkUpdateDescriptorSets\"." };
+      }
+      m_update = *pfn;
+    }
+
+    /// @cond
+    descriptor_coalescer(const descriptor_coalescer& other) = delete;
+    descriptor_coalescer(descriptor_coalescer&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a descriptor coalescer.
+     * @details Every thread's deferred writes are flushed.
+     */
+    ~descriptor_coalescer() noexcept {
+      flush();
+    }
+
+    /// @cond
+    descriptor_coalescer& operator=(const descriptor_coalescer& rhs) = delete;
+    descriptor_coalescer& operator=(descriptor_coalescer&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Defer a `vkUpdateDescriptorSets`.
+     * @details Writes are deferred on the calling thread. Another thread's deferred writes are flushed first if they
+     *          target the same set. If `copy_count` isn't zero, every thread's writes are flushed, and then the update
+     *          is sent directly.
+     * @param target The device that owns the descriptor sets. This **MUST** be the base table's device.
+     * @param write_count The number of elements in `writes`.
+     * @param writes The descriptor writes to perform.
+     * @param copy_count The number of elements in `copies`.
+     * @param copies The descriptor copies to perform.
+     */
+    void update(const device_handle target, const std::uint32_t write_count, const write *const writes,
+                const std::uint32_t copy_count, const copy *const copies) {
+      if (copy_count)
+      {
+        // Copies read the current contents of their source sets, so every earlier write has to land first.
+        flush();
+        m_update(target, write_count, writes, copy_count, copies);
+        m_updates.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      auto& local = m_arenas.local();
+      auto lock = std::unique_lock{ local.mutex };
+      for (auto i = std::uint32_t{ 0 }; i < write_count; ++i)
+      {
+        const auto kind = internal::base::payload_of(writes[i].descriptorType);
+        const auto direct = writes[i].pNext || kind == payload::none;
+        if (!direct && !writes[i].descriptorCount)
+        {
+          continue;
+        }
+        claim(local, lock, writes[i].dstSet);
+        if (direct)
+        {
+          flush(local);
+          m_update(target, 1, &writes[i], 0, nullptr);
+          m_updates.fetch_add(1, std::memory_order_relaxed);
+          auto guard = std::unique_lock{ m_owners_mutex };
+          disown(local, writes[i].dstSet);
+          continue;
+        }
+        defer(local, writes[i], kind);
+        if (local.writes.size() >= m_max_writes)
+        {
+          flush(local);
+        }
+      }
+    }
+
+    /**
+     * @brief Send the calling thread's deferred writes to the driver.
+     */
+    void flush_local() {
+      auto& local = m_arenas.local();
+      auto lock = std::unique_lock{ local.mutex };
+      flush(local);
+    }
+
+    /**
+     * @brief Send every thread's deferred writes to the driver.
+     * @details Threads without deferred writes are skipped without locking.
+     */
+    void flush() {
+      m_arenas.for_each([this](arena& local) {
+        if (local.size.load(std::memory_order_relaxed))
+        {
+          auto lock = std::unique_lock{ local.mutex };
+          flush(local);
+        }
+      });
+    }
+
+    /**
+     * @brief Count the writes that have been deferred.
+     * @return The total number of writes accepted for deferral.
+     */
+    std::uint64_t deferred() const noexcept {
+      return m_deferred.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count the writes that have been merged into a previous write.
+     * @return The total number of merged writes.
+     */
+    std::uint64_t merged() const noexcept {
+      return m_merged.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count the writes that have been dropped because a later write overwrote them.
+     * @return The total number of dropped writes.
+     */
+    std::uint64_t dropped() const noexcept {
+      return m_dropped.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count the calls that have been made to the driver.
+     * @return The total number of `vkUpdateDescriptorSets` calls made by the coalescer.
+     */
+    std::uint64_t updates() const noexcept {
+      return m_updates.load(std::memory_order_relaxed);
+    }
+  };
+
+}
+
+#endif
@@ -94,6 +94,32 @@ namespace global {
 
 #undef MEGATECH_VULKAN_DISPATCH_COMMAND
 
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case command::name: return #name;
+/// @endcond
+
+  /**
+   * @brief Convert a ::command to its name.
+   * @details This is primarily useful for reporting (e.g., in traces and statistics). Like ::to_hash(const command),
+   *          this is a simple mapping from ::command values to string literals.
+   * @param cmd A ::command. For example:
+   *            @code{.cpp}
+   *              to_string(command::vkGetInstanceProcAddr); // == "vkGetInstanceProcAddr"
+   *            @endcode
+   * @return A NUL-terminated string containing the name of the ::command. The string has static storage duration.
+   * @throw dispatch::error If the input command is ill-formed.
+   */
+  constexpr const char* to_string(const command cmd) {
+    switch (cmd)
+    {
+    MEGATECH_VULKAN_DISPATCH_GLOBAL_COMMAND_LIST
+    default:
+      throw dispatch::error{ "The input command is outside the valid range of possible global commands." };
+    }
+  }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
 }
 
 namespace instance {
@@ -155,6 +181,28 @@ namespace instance {
 
 #undef MEGATECH_VULKAN_DISPATCH_COMMAND
 
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case command::name: return #name;
+/// @endcond
+
+  /**
+   * @brief Convert a ::command to its name.
+   * @param cmd A ::command.
+   * @return A NUL-terminated string containing the name of the ::command. The string has static storage duration.
+   * @throw dispatch::error If the input command is ill-formed.
+   * @see ::global::to_string
+   */
+  constexpr const char* to_string(const command cmd) {
+    switch (cmd)
+    {
+    MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_LIST
+    default:
+      throw dispatch::error{ "The input command is outside the valid range of possible instance commands." };
+    }
+  }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
 }
 
 namespace device {
@@ -216,6 +264,28 @@ namespace device {
 
 #undef MEGATECH_VULKAN_DISPATCH_COMMAND
 
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case command::name: return #name;
+/// @endcond
+
+  /**
+   * @brief Convert a ::command to its name.
+   * @param cmd A ::command.
+   * @return A NUL-terminated string containing the name of the ::command. The string has static storage duration.
+   * @throw dispatch::error If the input command is ill-formed.
+   * @see ::global::to_string
+   */
+  constexpr const char* to_string(const command cmd) {
+    switch (cmd)
+    {
+    MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+    default:
+      throw dispatch::error{ "The input command is outside the valid range of possible device commands." };
+    }
+  }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
 }
 
 }
@@ -0,0 +1,284 @@
+/**
+ * @file compilation.hpp
+ * @brief Vulkan Asynchronous Pipeline Compilation
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_COMPILATION_HPP
+#define MEGATECH_VULKAN_DISPATCH_COMPILATION_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <type_traits>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "tables.hpp"
+#include "pipeline_caches.hpp"
+
+#include "internal/base/fnv_1a.hpp"
+#include "internal/base/pipeline_caches.hpp"
+#include "internal/base/slots.hpp"
+#include "internal/base/work_stealing.hpp"
+
+namespace megatech::vulkan::dispatch::device {
+
+  /**
+   * @brief A thread pool that creates pipelines concurrently.
+   * @details Each pipeline is created by its own call to `vkCreateGraphicsPipelines`, `vkCreateComputePipelines`, or
+   *          `vkCreateRayTracingPipelinesKHR` on a worker thread. Workers balance load by stealing work from each
+   *          other, so a few expensive pipelines don't delay the rest. The result of each pipeline is returned through
+   *          its own future. For example:
+   *          @code{.cpp}
+   *          using compiler = pipeline_compiler<PFN_vkCreateGraphicsPipelines, PFN_vkCreateComputePipelines,
+   *                                             PFN_vkCreateRayTracingPipelinesKHR>;
+   *          auto caches = pipeline_cache_manager<PFN_vkCreatePipelineCache>{ ddt, properties, "pipeline-caches" };
+   *          auto pipelines = compiler{ ddt, caches };
+   *          auto compiled = pipelines.compile(compute_info);
+   *          // ...do other work. Then:
+   *          const auto [status, pipeline] = compiled.get();
+   *          @endcode
+   *
+   *          When a pipeline_cache_manager is attached, each worker creates pipelines with its own per-thread cache, so
+   *          workers never contend for a single cache. The manager merges the workers' caches afterwards. Otherwise,
+   *          pipelines are created without a cache.
+   *
+   *          Creation structures are copied by value, but the data they point to (e.g., shader stages and `pNext`
+   *          chains) is not. That data **MUST** remain valid until the corresponding future is ready. Ray tracing
+   *          pipelines are only available if `vkCreateRayTracingPipelinesKHR` was resolved to a non-null value. Every
+   *          requested pipeline is created before the compiler is destroyed. The compiler is safe to use concurrently.
+   * @tparam Graphics The function pointer type of `vkCreateGraphicsPipelines` (i.e., `PFN_vkCreateGraphicsPipelines`).
+   * @tparam Compute The function pointer type of `vkCreateComputePipelines` (i.e., `PFN_vkCreateComputePipelines`).
+   * @tparam RayTracing The function pointer type of `vkCreateRayTracingPipelinesKHR` (i.e.,
+   *                    `PFN_vkCreateRayTracingPipelinesKHR`).
+   */
+  template <internal::base::command_pointer Graphics, internal::base::command_pointer Compute,
+            internal::base::command_pointer RayTracing>
+  class pipeline_compiler final {
+  private:
+    using graphics_signature = internal::base::pipeline_signature<Graphics>;
+    using compute_signature = internal::base::pipeline_signature<Compute>;
+    using ray_tracing_signature = internal::base::pipeline_signature<RayTracing>;
+  public:
+    /**
+     * @brief The result type of pipeline creation (i.e., `VkResult`).
+     */
+    using result = typename graphics_signature::result;
+
+    /**
+     * @brief The pipeline handle type (i.e., `VkPipeline`).
+     */
+    using pipeline = typename graphics_signature::pipeline;
+
+    /**
+     * @brief The pipeline cache handle type (i.e., `VkPipelineCache`).
+     */
+    using cache = typename graphics_signature::cache;
+
+    /**
+     * @brief The graphics pipeline creation structure type (i.e., `VkGraphicsPipelineCreateInfo`).
+     */
+    using graphics_info = typename graphics_signature::info;
+
+    /**
+     * @brief The compute pipeline creation structure type (i.e., `VkComputePipelineCreateInfo`).
+     */
+    using compute_info = typename compute_signature::info;
+
+    /**
+     * @brief The ray tracing pipeline creation structure type (i.e., `VkRayTracingPipelineCreateInfoKHR`).
+     */
+    using ray_tracing_info = typename ray_tracing_signature::info;
+
+    /**
+     * @brief The outcome of a single pipeline creation.
+     */
+    struct compilation final {
+      /**
+       * @brief The result of the creation command.
+       */
+      result status{ };
+
+      /**
+       * @brief The created pipeline, or null if creation failed.
+       */
+      pipeline handle{ };
+    };
+  private:
+    using task = std::packaged_task<compilation()>;
+
+    typename graphics_signature::device m_device{ };
+    Graphics m_graphics{ };
+    Compute m_compute{ };
+    RayTracing m_ray_tracing{ };
+    void* m_caches{ };
+    cache (*m_local)(void*){ };
+    std::atomic<std::uint64_t> m_completed{ };
+    std::atomic<std::uint64_t> m_failed{ };
+    // The pool is destroyed first, so every task completes while the rest of the compiler is still alive.
+    internal::base::work_stealing_pool<task> m_pool;
+
+    template <typename Pointer>
+    static Pointer resolve(const table& base, const std::uint_least64_t hash) noexcept {
+      const auto pfn = static_cast<const Pointer*>(base.get(hash));
+      return pfn ? *pfn : nullptr;
+    }
+
+    static std::size_t checked(const std::size_t threads) {
+      if (!threads)
+      {
+        throw dispatch::error{ "A pipeline compiler requires at least 1 thread." };
+      }
+      return threads;
+    }
+
+    static std::size_t default_threads() noexcept {
+      return std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    template <typename Pointer, typename Info>
+    std::future<compilation> enqueue(const Pointer pfn, const Info& info) {
+      auto work = task{ [this, pfn, info]() {
+        auto compiled = compilation{ };
+        const auto target = m_caches ? m_local(m_caches) : cache{ };
+        if constexpr (std::is_void_v<typename internal::base::pipeline_signature<Pointer>::deferred>)
+        {
+          compiled.status = pfn(m_device, target, 1, &info, nullptr, &compiled.handle);
+        }
+        else
+        {
+          using deferred = typename internal::base::pipeline_signature<Pointer>::deferred;
+          compiled.status = pfn(m_device, deferred{ }, target, 1, &info, nullptr, &compiled.handle);
+        }
+        auto& counter = compiled.status == result{ } ? m_completed : m_failed;
+        counter.fetch_add(1, std::memory_order_relaxed);
+        return compiled;
+      } };
+      auto future = work.get_future();
+      m_pool.submit(std::move(work));
+      return future;
+    }
+  public:
+    /**
+     * @brief Construct a pipeline compiler that creates pipelines without a cache.
+     * @param base The table whose pipeline creation commands are used. The table's ::VkDevice **MUST** remain valid for
+     *             the compiler's entire lifetime.
+     * @param threads The number of worker threads.
+     * @throw dispatch::error If `threads` is zero, if the table has no ::VkDevice, or if either
+     *                        `vkCreateGraphicsPipelines` or `vkCreateComputePipelines` was resolved to null.
+     */
+    explicit pipeline_compiler(const table& base, const std::size_t threads = default_threads()) :
+    m_device{ base.device() },
+    m_graphics{ resolve<Graphics>(base, internal::base::fnv_1a_cstr("vkCreateGraphicsPipelines")) },
+    m_compute{ resolve<Compute>(base, internal::base::fnv_1a_cstr("vkCreateComputePipelines")) },
+    m_ray_tracing{ resolve<RayTracing>(base, internal::base::fnv_1a_cstr("vkCreateRayTracingPipelinesKHR")) },
+    m_pool{ checked(threads) } {
+      if (!m_device)
+      {
+        throw dispatch::error{ "Pipeline compilation requires a table with a VkDevice." };
+      }
+      if (!m_graphics || !m_compute)
+      {
+        throw dispatch::error{ "Pipeline compilation requires \"vkCreateGraphicsPipelines\" and "
+                               "\"vkCreateComputePipelines\"." };
+      }
+    }
+
+    /**
+     * @brief Construct a pipeline compiler that creates pipelines with per-thread caches.
+     * @tparam Create The function pointer type of `vkCreatePipelineCache` (i.e., `PFN_vkCreatePipelineCache`).
+     * @param base The table whose pipeline creation commands are used. The table's ::VkDevice **MUST** remain valid for
+     *             the compiler's entire lifetime.
+     * @param caches The manager that provides each worker's cache. This **MUST** outlive the compiler.
+     * @param threads The number of worker threads.
+     * @throw dispatch::error If `threads` is zero, if the table has no ::VkDevice, or if either
+     *                        `vkCreateGraphicsPipelines` or `vkCreateComputePipelines` was resolved to null.
+     */
+    template <internal::base::command_pointer Create>
+    pipeline_compiler(const table& base, pipeline_cache_manager<Create>& caches,
+                      const std::size_t threads = default_threads()) :
+    pipeline_compiler{ base, threads } {
+      m_caches = &caches;
+      m_local = [](void *const owner) -> cache { return static_cast<pipeline_cache_manager<Create>*>(owner)->local(); };
+    }
+
+    /// @cond
+    pipeline_compiler(const pipeline_compiler& other) = delete;
+    pipeline_compiler(pipeline_compiler&& other) = delete;
+
+    ~pipeline_compiler() noexcept = default;
+
+    pipeline_compiler& operator=(const pipeline_compiler& rhs) = delete;
+    pipeline_compiler& operator=(pipeline_compiler&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Create a graphics pipeline asynchronously.
+     * @param info The creation structure of the pipeline.
+     * @return A future that becomes ready when the pipeline is created or when creation fails. If the worker's cache
+     *         can't be created, the future holds a dispatch::error instead.
+     */
+    std::future<compilation> compile(const graphics_info& info) {
+      return enqueue(m_graphics, info);
+    }
+
+    /**
+     * @brief Create a compute pipeline asynchronously.
+     * @param info The creation structure of the pipeline.
+     * @return A future that becomes ready when the pipeline is created or when creation fails. If the worker's cache
+     *         can't be created, the future holds a dispatch::error instead.
+     */
+    std::future<compilation> compile(const compute_info& info) {
+      return enqueue(m_compute, info);
+    }
+
+    /**
+     * @brief Create a ray tracing pipeline asynchronously.
+     * @details Pipelines are created without a deferred operation.
+     * @param info The creation structure of the pipeline.
+     * @return A future that becomes ready when the pipeline is created or when creation fails. If the worker's cache
+     *         can't be created, the future holds a dispatch::error instead.
+     * @throw dispatch::error If `vkCreateRayTracingPipelinesKHR` was resolved to null.
+     */
+    std::future<compilation> compile(const ray_tracing_info& info) {
+      if (!m_ray_tracing)
+      {
+        throw dispatch::error{ "Ray tracing pipeline compilation requires \"vkCreateRayTracingPipelinesKHR\"." };
+      }
+      return enqueue(m_ray_tracing, info);
+    }
+
+    /**
+     * @brief Retrieve the number of worker threads.
+     * @return The number of threads that create pipelines.
+     */
+    std::size_t threads() const noexcept {
+      return m_pool.size();
+    }
+
+    /**
+     * @brief Count the pipelines that have been created.
+     * @return The total number of pipelines whose creation succeeded.
+     */
+    std::uint64_t completed() const noexcept {
+      return m_completed.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count the pipelines that couldn't be created.
+     * @return The total number of pipelines whose creation returned an error or another non-success result.
+     */
+    std::uint64_t failed() const noexcept {
+      return m_failed.load(std::memory_order_relaxed);
+    }
+  };
+
+}
+
+#endif
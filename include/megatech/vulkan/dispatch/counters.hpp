@@ -0,0 +1,146 @@
+/**
+ * @file counters.hpp
+ * @brief Vulkan Command Call Counters
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_COUNTERS_HPP
+#define MEGATECH_VULKAN_DISPATCH_COUNTERS_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <array>
+#include <atomic>
+
+#include "defs.hpp"
+#include "commands.hpp"
+
+#include "internal/base/per_thread.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+  /**
+   * @brief A set of lock-free call counters with one counter per Vulkan command.
+   * @details Every thread that increments a counter receives its own cache-line aligned block of counters. Increments
+   *          are plain (non-RMW) relaxed stores to memory that is exclusively owned by the incrementing thread, so
+   *          they never contend with one another. Readers aggregate the per-thread blocks on demand.
+   *
+   *          Counts accumulated by threads that have exited are retained.
+   * @tparam Command The command enumeration type of the level being counted (e.g., device::command).
+   * @tparam Count The number of commands at the level being counted.
+   */
+  template <typename Command, std::size_t Count>
+  class basic_call_counters final {
+  public:
+    /**
+     * @brief The result type of a snapshot.
+     */
+    using snapshot_type = std::array<std::uint64_t, Count>;
+  private:
+    using block = std::array<std::atomic<std::uint64_t>, Count>;
+
+    internal::base::per_thread<block> m_blocks{ };
+    snapshot_type m_baseline{ };
+
+    snapshot_type totals() const {
+      auto result = snapshot_type{ };
+      m_blocks.for_each([&](const block& current) {
+        for (auto i = std::size_t{ 0 }; i < Count; ++i)
+        {
+          result[i] += current[i].load(std::memory_order_relaxed);
+        }
+      });
+      return result;
+    }
+  public:
+    /**
+     * @brief Construct a set of counters with all counts set to zero.
+     */
+    basic_call_counters() = default;
+
+    /// @cond
+    basic_call_counters(const basic_call_counters& other) = delete;
+    basic_call_counters(basic_call_counters&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a set of counters.
+     */
+    ~basic_call_counters() noexcept = default;
+
+    /// @cond
+    basic_call_counters& operator=(const basic_call_counters& rhs) = delete;
+    basic_call_counters& operator=(basic_call_counters&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Increment the calling thread's counter for a command.
+     * @param cmd The command to count. This **MUST** be a valid `Command`.
+     */
+    void increment(const Command cmd) {
+      auto& counter = m_blocks.local()[static_cast<std::size_t>(cmd)];
+      counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Aggregate the counts of all threads.
+     * @details This is safe to call concurrently with ::increment(). The result is a consistent view of each
+     *          individual counter but not necessarily of the set as a whole.
+     * @return An array containing the number of calls counted for each command since construction or the last call
+     *         to ::reset(). The array is indexed by the value of `Command`.
+     */
+    snapshot_type snapshot() const {
+      auto result = totals();
+      for (auto i = std::size_t{ 0 }; i < Count; ++i)
+      {
+        result[i] -= m_baseline[i];
+      }
+      return result;
+    }
+
+    /**
+     * @brief Aggregate the count of all threads for a single command.
+     * @param cmd The command to retrieve a count for. This **MUST** be a valid `Command`.
+     * @return The number of calls counted for `cmd` since construction or the last call to ::reset().
+     */
+    std::uint64_t count(const Command cmd) const {
+      const auto index = static_cast<std::size_t>(cmd);
+      auto result = std::uint64_t{ 0 };
+      m_blocks.for_each([&](const block& current) { result += current[index].load(std::memory_order_relaxed); });
+      return result - m_baseline[index];
+    }
+
+    /**
+     * @brief Reset all counts to zero.
+     * @details Per-thread counters are never written by readers. Instead, the current totals are recorded and
+     *          subtracted from subsequent snapshots. This **MUST NOT** be called concurrently with ::snapshot(),
+     *          ::count(), or another call to ::reset().
+     */
+    void reset() {
+      m_baseline = totals();
+    }
+  };
+
+namespace instance {
+
+  /**
+   * @brief Call counters for instance-level Vulkan commands.
+   */
+  using call_counters = basic_call_counters<command, MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT>;
+
+}
+
+namespace device {
+
+  /**
+   * @brief Call counters for device-level Vulkan commands.
+   */
+  using call_counters = basic_call_counters<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT>;
+
+}
+
+}
+
+#endif
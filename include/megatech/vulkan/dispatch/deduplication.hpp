@@ -0,0 +1,307 @@
+/**
+ * @file deduplication.hpp
+ * @brief Vulkan Immutable Object Deduplication
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_DEDUPLICATION_HPP
+#define MEGATECH_VULKAN_DISPATCH_DEDUPLICATION_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+
+#include "defs.hpp"
+#include "commands.hpp"
+
+#include "internal/base/arguments.hpp"
+#include "internal/base/deduplication.hpp"
+#include "internal/base/per_thread.hpp"
+#include "internal/base/query_cache.hpp"
+#include "internal/base/sharded_map.hpp"
+
+namespace megatech::vulkan::dispatch::device {
+
+  /**
+   * @brief A content-addressed, reference counted store of immutable objects.
+   * @details A deduplicator returns an existing object instead of creating a new one when a creation command is called
+   *          with the same contents as an earlier call. For example:
+   *          @code{.cpp}
+   *          auto deduplicator = object_deduplicator{ };
+   *          auto dit = intercepted_table<object_deduplicator::policy>{ ddt };
+   *          dit.policy<object_deduplicator::policy>().set_deduplicator(&deduplicator);
+   *          dit.intercept<command::vkCreateSampler, PFN_vkCreateSampler>();
+   *          dit.intercept<command::vkDestroySampler, PFN_vkDestroySampler>();
+   *          // ...and the other creation and destruction commands.
+   *          @endcode
+   *
+   *          Deduplicated commands are `vkCreateShaderModule`, `vkCreateSampler`, `vkCreateDescriptorSetLayout`, and
+   *          `vkCreatePipelineLayout`. Objects are identified by the device, the allocation callbacks, and the full
+   *          contents of their creation structures, including SPIR-V code. Each reuse of an object adds a reference,
+   *          and the matching destruction command only destroys the object when its last reference is released. Every
+   *          successful creation **MUST** therefore be paired with exactly one destruction, as it would be without
+   *          deduplication. Destruction commands **MUST** be routed through the policy whenever creation commands are.
+   *
+   *          Immutable samplers and set layouts are compared by the contents they were created with, not by handle. A
+   *          destroyed object's handle that the driver reuses for different contents never matches a stale entry.
+   *          Layouts that refer to objects the deduplicator isn't tracking (e.g., objects created without the
+   *          deduplicator) are forwarded to the driver and never shared.
+   *
+   *          `pNext` chains are compared by content, but only `VkSamplerReductionModeCreateInfo`,
+   *          `VkSamplerYcbcrConversionInfo`, `VkSamplerCustomBorderColorCreateInfoEXT`, and
+   *          `VkDescriptorSetLayoutBindingFlagsCreateInfo` are understood. Calls whose chains contain any other
+   *          structure are forwarded to the driver and never shared, because their contents can't be compared safely.
+   *          The deduplicator is safe to use concurrently.
+   */
+  class object_deduplicator final {
+  public:
+    /**
+     * @brief An interception policy that deduplicates immutable objects using an object_deduplicator.
+     * @details When no deduplicator is attached, the policy costs a single load and branch per call.
+     */
+    class policy final {
+    private:
+      object_deduplicator* m_deduplicator{ };
+    public:
+      /**
+       * @brief Reuse or release an immutable object, and continue the chain when the driver is needed.
+       * @tparam Cmd The called command.
+       * @param next The remainder of the policy chain.
+       * @param arguments The arguments of the call.
+       * @return The result of `next`, or success if an existing object was reused.
+       */
+      template <command Cmd, typename Next, typename... Arguments>
+      decltype(auto) invoke(const Next& next, Arguments... arguments) {
+        if (!m_deduplicator)
+        {
+          return next(arguments...);
+        }
+        if constexpr (internal::base::created_kind<Cmd>() < internal::base::object_kinds)
+        {
+          return m_deduplicator->create<Cmd>(next, arguments...);
+        }
+        else if constexpr (internal::base::destroyed_kind<Cmd>() < internal::base::object_kinds)
+        {
+          if (m_deduplicator->release<Cmd>(std::get<1>(std::tuple<Arguments...>{ arguments... })))
+          {
+            next(arguments...);
+          }
+        }
+        else
+        {
+          return next(arguments...);
+        }
+      }
+
+      /**
+       * @brief Attach an object_deduplicator to the policy.
+       * @details This **MUST NOT** be called concurrently with calls through the owning table.
+       * @param deduplicator A pointer to the deduplicator to attach or null.
+       */
+      void set_deduplicator(object_deduplicator *const deduplicator) noexcept {
+        m_deduplicator = deduplicator;
+      }
+
+      /**
+       * @brief Retrieve the object_deduplicator attached to the policy.
+       * @return A pointer to the attached deduplicator, or null if no deduplicator is attached.
+       */
+      object_deduplicator* deduplicator() const noexcept {
+        return m_deduplicator;
+      }
+    };
+  private:
+    struct transparent_hash final {
+      using is_transparent = void;
+
+      std::size_t operator()(const std::string_view key) const noexcept {
+        return static_cast<std::size_t>(internal::base::fnv_1a_bytes(key));
+      }
+    };
+
+    struct entry final {
+      std::uint64_t object{ };
+      std::uint64_t references{ };
+    };
+
+    // Indices are value-initialized by internal::base::per_thread.
+    struct index final {
+      internal::base::query_key key;
+      std::atomic<std::uint64_t> created;
+      std::atomic<std::uint64_t> reused;
+      std::atomic<std::uint64_t> bypassed;
+    };
+
+    mutable std::mutex m_lock{ };
+    std::unordered_map<std::string, entry, transparent_hash, std::equal_to<>> m_entries{ };
+    // Handles are only unique within a kind of object, so each kind has its own reverse index.
+    std::array<std::unordered_map<std::uint64_t, const std::string*>, internal::base::object_kinds> m_keys{ };
+    internal::base::per_thread<index> m_indices{ };
+
+    static void bump(std::atomic<std::uint64_t>& counter) noexcept {
+      counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+  public:
+    /**
+     * @brief Construct a deduplicator that isn't tracking any objects.
+     */
+    object_deduplicator() = default;
+
+    /// @cond
+    object_deduplicator(const object_deduplicator& other) = delete;
+    object_deduplicator(object_deduplicator&& other) = delete;
+
+    ~object_deduplicator() noexcept = default;
+
+    object_deduplicator& operator=(const object_deduplicator& rhs) = delete;
+    object_deduplicator& operator=(object_deduplicator&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Create an immutable object or reuse an identical one.
+     * @details The driver is only called when no identical object exists. If two threads create identical objects
+     *          concurrently, both call the driver and only one object is shared. The other is returned untracked, and
+     *          its destruction is forwarded to the driver immediately.
+     * @tparam Cmd The called command. This **MUST** be a deduplicated creation command.
+     * @param next The creation command.
+     * @param device The device that creates the object.
+     * @param info The creation structure of the object.
+     * @param allocator The allocation callbacks of the call or null.
+     * @param output A pointer to the created object's handle.
+     * @return The result of `next`, or success if an existing object was reused.
+     */
+    template <command Cmd, typename Next, internal::base::handle Device, typename Info, typename Allocator,
+              typename Handle>
+    auto create(const Next& next, const Device device, const Info *const info, const Allocator *const allocator,
+                Handle *const output) {
+      using result = std::invoke_result_t<const Next&, Device, const Info*, const Allocator*, Handle*>;
+      constexpr auto kind = internal::base::created_kind<Cmd>();
+      static_assert(kind < internal::base::object_kinds, "The created object must be deduplicated.");
+      auto& local = m_indices.local();
+      local.key.clear();
+      // Referenced objects are identified by their keys, because their handles may be reused after they're destroyed.
+      const auto resolve = [this](const std::size_t referenced, const std::uint64_t object,
+                                  internal::base::query_key& key) {
+        auto lock = std::unique_lock<std::mutex>{ m_lock };
+        const auto found = m_keys[referenced].find(object);
+        if (found == m_keys[referenced].end())
+        {
+          return false;
+        }
+        key.write(found->second->data(), found->second->size());
+        return true;
+      };
+      if (!output || !internal::base::write_create_info<Cmd>(local.key, device, info, allocator, resolve))
+      {
+        bump(local.bypassed);
+        return next(device, info, allocator, output);
+      }
+      {
+        auto lock = std::unique_lock<std::mutex>{ m_lock };
+        if (const auto found = m_entries.find(local.key.bytes()); found != m_entries.end())
+        {
+          ++found->second.references;
+          *output = internal::base::decode_handle<Handle>(found->second.object);
+          bump(local.reused);
+          return result{ };
+        }
+      }
+      const auto status = next(device, info, allocator, output);
+      if (status != result{ })
+      {
+        return status;
+      }
+      const auto object = internal::base::encode(*output).value;
+      {
+        auto lock = std::unique_lock<std::mutex>{ m_lock };
+        const auto [position, inserted] = m_entries.try_emplace(std::string{ local.key.bytes() }, entry{ object, 1 });
+        // Drivers may return the same handle for objects they consider identical. The handle stays with its first key.
+        if (inserted && !m_keys[kind].try_emplace(object, &position->first).second)
+        {
+          m_entries.erase(position);
+        }
+      }
+      bump(local.created);
+      return status;
+    }
+
+    /**
+     * @brief Release a reference to an immutable object.
+     * @tparam Cmd The called command. This **MUST** be a deduplicated destruction command.
+     * @param object The object to release.
+     * @return True if the object **MUST** be destroyed by the driver. False if the object is still referenced.
+     */
+    template <command Cmd, typename Handle>
+    bool release(const Handle object) {
+      constexpr auto kind = internal::base::destroyed_kind<Cmd>();
+      static_assert(kind < internal::base::object_kinds, "The destroyed object must be deduplicated.");
+      auto lock = std::unique_lock<std::mutex>{ m_lock };
+      auto& keys = m_keys[kind];
+      const auto found = keys.find(internal::base::encode(object).value);
+      if (found == keys.end())
+      {
+        return true;
+      }
+      const auto tracked = m_entries.find(*found->second);
+      if (--tracked->second.references)
+      {
+        return false;
+      }
+      m_entries.erase(tracked);
+      keys.erase(found);
+      return true;
+    }
+
+    /**
+     * @brief Count the objects that are currently shared.
+     * @return The number of distinct live objects tracked by the deduplicator.
+     */
+    std::size_t size() const {
+      auto lock = std::unique_lock<std::mutex>{ m_lock };
+      return m_entries.size();
+    }
+
+    /**
+     * @brief Count the objects that have been created by the driver.
+     * @return The total number of deduplicated calls that created a new object.
+     */
+    std::uint64_t created() const {
+      auto result = std::uint64_t{ 0 };
+      m_indices.for_each([&](const index& current) { result += current.created.load(std::memory_order_relaxed); });
+      return result;
+    }
+
+    /**
+     * @brief Count the calls that reused an existing object.
+     * @return The total number of creation calls that didn't call the driver.
+     */
+    std::uint64_t reused() const {
+      auto result = std::uint64_t{ 0 };
+      m_indices.for_each([&](const index& current) { result += current.reused.load(std::memory_order_relaxed); });
+      return result;
+    }
+
+    /**
+     * @brief Count the calls that couldn't be deduplicated.
+     * @return The total number of creation calls that were forwarded because their `pNext` chains contained an
+     *         unknown structure, or because they referred to objects that aren't tracked.
+     */
+    std::uint64_t bypassed() const {
+      auto result = std::uint64_t{ 0 };
+      m_indices.for_each([&](const index& current) { result += current.bypassed.load(std::memory_order_relaxed); });
+      return result;
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,350 @@
+/**
+ * @file destruction.hpp
+ * @brief Vulkan Deferred Destruction
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_DESTRUCTION_HPP
+#define MEGATECH_VULKAN_DISPATCH_DESTRUCTION_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "tables.hpp"
+
+#include "internal/base/destruction.hpp"
+#include "internal/base/fnv_1a.hpp"
+#include "internal/base/slots.hpp"
+#include "internal/base/submissions.hpp"
+
+namespace megatech::vulkan::dispatch::device {
+
+  /**
+   * @brief A queue that delays object destruction until the device has finished using the objects.
+   * @details Destruction is tracked against a timeline semaphore. Objects destroyed while a frame is recorded are
+   *          batched together, and advance() closes the batch with the timeline value that the frame's last submission
+   *          signals. Once the timeline reaches that value, a background thread destroys the whole batch. For example:
+   *          @code{.cpp}
+   *          using queue = destruction_queue<PFN_vkGetSemaphoreCounterValue>;
+   *          auto dit = intercepted_table<queue::policy>{ ddt };
+   *          auto garbage = queue{ ddt, timeline };
+   *          dit.policy<queue::policy>().set_queue(&garbage);
+   *          dit.intercept<command::vkDestroyBuffer, PFN_vkDestroyBuffer>();
+   *          dit.intercept<command::vkFreeMemory, PFN_vkFreeMemory>();
+   *          dit.intercept<command::vkDestroyDevice, PFN_vkDestroyDevice>();
+   *          // ...record and submit a frame that signals `timeline` with `value`. Then:
+   *          garbage.advance(value);
+   *          @endcode
+   *
+   *          The policy defers every `vkDestroy*` and `vkFree*` command except `vkFreeCommandBuffers` and
+   *          `vkFreeDescriptorSets`, which always pass through. Command and descriptor pools are externally
+   *          synchronized, so their children can't be freed by the background thread, and a deferred free would free
+   *          them a second time if the pool were reset or destroyed first. Instead, callers **SHOULD** recycle pool
+   *          children by resetting their pool once the work using them is complete, or defer destruction of the whole
+   *          pool (which frees its children). Allocation callbacks are passed by address, so they **MUST** remain
+   *          valid until the object is destroyed. `vkDestroyDevice` destroys every deferred object before the device,
+   *          so it **SHOULD** be routed through the policy too.
+   *
+   *          Deferred destructions are called through the table that deferred them, so the queue **MUST** be
+   *          destroyed before that table. The open batch is never destroyed by the background thread, because objects
+   *          in it **MAY** still be used by work that hasn't been submitted. The queue is safe to use concurrently.
+   * @tparam GetCounterValue The function pointer type of `vkGetSemaphoreCounterValue` (i.e.,
+   *                         `PFN_vkGetSemaphoreCounterValue`).
+   */
+  template <internal::base::command_pointer GetCounterValue>
+  class destruction_queue final {
+  public:
+    /**
+     * @brief An interception policy that defers destruction using a destruction_queue.
+     * @details When no queue is attached, the policy costs a single load and branch per call.
+     */
+    class policy final {
+    private:
+      destruction_queue* m_queue{ };
+    public:
+      /**
+       * @brief Defer a destruction command, or continue the chain.
+       * @tparam Cmd The called command.
+       * @param next The remainder of the policy chain.
+       * @param arguments The arguments of the call.
+       * @return The result of `next`. Deferred destructions return nothing.
+       */
+      template <auto Cmd, typename Next, typename... Arguments>
+      decltype(auto) invoke(const Next& next, Arguments... arguments) {
+        using internal::base::named;
+        if (!m_queue)
+        {
+          return next(arguments...);
+        }
+        if constexpr (internal::base::destroys<Cmd>())
+        {
+          m_queue->defer([next, arguments...]() { next(arguments...); });
+        }
+        else if constexpr (named<Cmd>("vkDestroyDevice"))
+        {
+          m_queue->flush();
+          return next(arguments...);
+        }
+        else
+        {
+          return next(arguments...);
+        }
+      }
+
+      /**
+       * @brief Attach a destruction_queue to the policy.
+       * @details This **MUST NOT** be called concurrently with calls through the owning table.
+       * @param queue A pointer to the queue to attach or null.
+       */
+      void set_queue(destruction_queue *const queue) noexcept {
+        m_queue = queue;
+      }
+
+      /**
+       * @brief Retrieve the destruction_queue attached to the policy.
+       * @return A pointer to the attached queue, or null if no queue is attached.
+       */
+      destruction_queue* queue() const noexcept {
+        return m_queue;
+      }
+    };
+  private:
+    using signature = internal::base::counter_value_signature<GetCounterValue>;
+    using result = typename signature::result;
+  public:
+    /**
+     * @brief The semaphore handle type (i.e., `VkSemaphore`).
+     */
+    using semaphore = typename signature::semaphore;
+  private:
+    struct batch final {
+      std::uint64_t value{ };
+      std::vector<std::function<void()>> destructions{ };
+    };
+
+    typename signature::device m_device{ };
+    GetCounterValue m_counter_value{ };
+    semaphore m_timeline{ };
+    std::mutex m_mutex{ };
+    std::condition_variable_any m_advanced{ };
+    // The last batch is always open. Every other batch is closed and waiting for its value.
+    std::deque<batch> m_batches{ };
+    std::mutex m_retirement{ };
+    std::atomic<std::uint64_t> m_pending{ };
+    std::atomic<std::uint64_t> m_destroyed{ };
+    std::jthread m_reaper{ };
+
+    static GetCounterValue resolve(const table& base, const std::uint_least64_t hash) noexcept {
+      const auto pfn = static_cast<const GetCounterValue*>(base.get(hash));
+      return pfn ? *pfn : nullptr;
+    }
+
+    // This must be called with m_retirement held, so that batches are destroyed in order.
+    std::size_t retire(const std::uint64_t limit, const bool everything) {
+      auto ready = std::vector<batch>{ };
+      {
+        auto lock = std::unique_lock<std::mutex>{ m_mutex };
+        while (m_batches.size() > 1 && m_batches.front().value <= limit)
+        {
+          ready.emplace_back(std::move(m_batches.front()));
+          m_batches.pop_front();
+        }
+        if (everything)
+        {
+          ready.emplace_back(std::exchange(m_batches.front(), batch{ }));
+        }
+      }
+      auto count = std::size_t{ 0 };
+      for (auto& current : ready)
+      {
+        for (auto& destruction : current.destructions)
+        {
+          destruction();
+        }
+        count += current.destructions.size();
+      }
+      m_pending.fetch_sub(count, std::memory_order_relaxed);
+      m_destroyed.fetch_add(count, std::memory_order_relaxed);
+      return count;
+    }
+  public:
+    /**
+     * @brief Construct a destruction queue.
+     * @param base The table whose `vkGetSemaphoreCounterValue` (or `vkGetSemaphoreCounterValueKHR`) is used. The
+     *             table's ::VkDevice **MUST** remain valid for the queue's entire lifetime.
+     * @param timeline A timeline semaphore that is signaled by the device as work completes. This **MUST** remain
+     *                 valid until every closed batch has been destroyed. Destroying it through the policy is allowed.
+     * @param interval The interval at which the timeline is polled while closed batches are waiting.
+     * @throw dispatch::error If the table has no ::VkDevice, if the semaphore is null, or if
+     *                        `vkGetSemaphoreCounterValue` was resolved to null.
+     */
+    destruction_queue(const table& base, const semaphore timeline,
+                      const std::chrono::milliseconds interval = std::chrono::milliseconds{ 1 }) :
+    m_device{ base.device() },
+    m_counter_value{ resolve(base, internal::base::fnv_1a_cstr("vkGetSemaphoreCounterValue")) },
+    m_timeline{ timeline } {
+      if (!m_counter_value)
+      {
+        m_counter_value = resolve(base, internal::base::fnv_1a_cstr("vkGetSemaphoreCounterValueKHR"));
+      }
+      if (!m_device || !m_timeline)
+      {
+        throw dispatch::error{ "Deferred destruction requires a table with a VkDevice and a timeline semaphore." };
+      }
+      if (!m_counter_value)
+      {
+        throw dispatch::error{ "Deferred destruction requires \"vkGetSemaphoreCounterValue\"." };
+      }
+      m_batches.emplace_back();
+      m_reaper = std::jthread{ [this, interval](std::stop_token stop) {
+        while (!stop.stop_requested())
+        {
+          {
+            auto lock = std::unique_lock<std::mutex>{ m_mutex };
+            if (m_batches.size() > 1)
+            {
+              m_advanced.wait_for(lock, stop, interval, []() { return false; });
+            }
+            else
+            {
+              m_advanced.wait(lock, stop, [this]() { return m_batches.size() > 1; });
+            }
+          }
+          try
+          {
+            collect();
+          }
+          catch (...)
+          {
+            // Objects that couldn't be destroyed now remain queued for the next attempt or for flush().
+          }
+        }
+      } };
+    }
+
+    /// @cond
+    destruction_queue(const destruction_queue& other) = delete;
+    destruction_queue(destruction_queue&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a destruction queue.
+     * @details The background thread is stopped, and every remaining object is destroyed immediately. The device
+     *          **MUST** have finished using every queued object.
+     */
+    ~destruction_queue() noexcept {
+      m_reaper.request_stop();
+      m_reaper.join();
+      try
+      {
+        flush();
+      }
+      catch (...)
+      {
+        // Destructors must not throw. Any objects that remain are leaked.
+      }
+    }
+
+    /// @cond
+    destruction_queue& operator=(const destruction_queue& rhs) = delete;
+    destruction_queue& operator=(destruction_queue&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Add a destruction to the open batch.
+     * @param destruction A function that destroys one or more objects.
+     */
+    void defer(std::function<void()> destruction) {
+      auto lock = std::unique_lock<std::mutex>{ m_mutex };
+      m_batches.back().destructions.emplace_back(std::move(destruction));
+      m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Close the open batch.
+     * @details If the open batch is empty, this does nothing.
+     * @param value The timeline value after which every object in the batch may be destroyed. Values **MUST NOT**
+     *              decrease between calls.
+     */
+    void advance(const std::uint64_t value) {
+      {
+        auto lock = std::unique_lock<std::mutex>{ m_mutex };
+        if (m_batches.back().destructions.empty())
+        {
+          return;
+        }
+        m_batches.back().value = value;
+        m_batches.emplace_back();
+      }
+      m_advanced.notify_one();
+    }
+
+    /**
+     * @brief Destroy every closed batch whose value the timeline has reached.
+     * @details This is called periodically by the background thread, but it **MAY** also be called directly.
+     * @return The number of destructions that were performed. If the timeline can't be read (e.g., because the device
+     *         was lost), nothing is destroyed.
+     */
+    std::size_t collect() {
+      auto retiring = std::unique_lock<std::mutex>{ m_retirement };
+      {
+        // The timeline is only read while closed batches exist, so it may be destroyed by the final flush.
+        auto lock = std::unique_lock<std::mutex>{ m_mutex };
+        if (m_batches.size() < 2)
+        {
+          return 0;
+        }
+      }
+      auto current = std::uint64_t{ 0 };
+      if (m_counter_value(m_device, m_timeline, &current) != result{ })
+      {
+        return 0;
+      }
+      return retire(current, false);
+    }
+
+    /**
+     * @brief Destroy every queued object immediately, including the open batch.
+     * @details The device **MUST** have finished using every queued object (e.g., after `vkDeviceWaitIdle`).
+     * @return The number of destructions that were performed.
+     */
+    std::size_t flush() {
+      auto retiring = std::unique_lock<std::mutex>{ m_retirement };
+      return retire(std::numeric_limits<std::uint64_t>::max(), true);
+    }
+
+    /**
+     * @brief Count the destructions that are waiting.
+     * @return The number of deferred destructions that haven't been performed.
+     */
+    std::uint64_t pending() const noexcept {
+      return m_pending.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count the destructions that have been performed.
+     * @return The total number of deferred destructions that have been performed.
+     */
+    std::uint64_t destroyed() const noexcept {
+      return m_destroyed.load(std::memory_order_relaxed);
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,387 @@
+/**
+ * @file filtering.hpp
+ * @brief Vulkan Redundant State Filtering
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_FILTERING_HPP
+#define MEGATECH_VULKAN_DISPATCH_FILTERING_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+#include "defs.hpp"
+#include "commands.hpp"
+
+#include "internal/base/arguments.hpp"
+#include "internal/base/dynamic_state.hpp"
+#include "internal/base/per_thread.hpp"
+#include "internal/base/query_cache.hpp"
+#include "internal/base/submissions.hpp"
+
+namespace megatech::vulkan::dispatch::device {
+
+  /**
+   * @brief A per-command buffer state tracker that drops redundant binding and dynamic state commands.
+   * @details A filter remembers the arguments of the last call to each tracked command in each command buffer. A call
+   *          whose arguments are identical to the current state is dropped instead of being recorded. For example:
+   *          @code{.cpp}
+   *          auto filter = state_filter{ };
+   *          auto dit = intercepted_table<state_filter::policy>{ ddt };
+   *          dit.policy<state_filter::policy>().set_filter(&filter);
+   *          dit.intercept<command::vkCmdBindPipeline, PFN_vkCmdBindPipeline>();
+   *          dit.intercept<command::vkCmdSetViewport, PFN_vkCmdSetViewport>();
+   *          dit.intercept<command::vkBeginCommandBuffer, PFN_vkBeginCommandBuffer>();
+   *          dit.intercept<command::vkFreeCommandBuffers, PFN_vkFreeCommandBuffers>();
+   *          // ...and every command that invalidates or releases tracked state.
+   *          @endcode
+   *
+   *          Tracked commands are `vkCmdBindPipeline`, `vkCmdBindDescriptorSets`, `vkCmdBindVertexBuffers`,
+   *          `vkCmdBindIndexBuffer`, and the core and extended dynamic state setters (e.g., `vkCmdSetViewport`,
+   *          `vkCmdSetScissor`, and `vkCmdSetCullMode`). Extension aliases are tracked as their core command. Pipelines
+   *          and descriptor sets are tracked separately for each bind point.
+   *
+   *          Only exact repeats of the last call are dropped, so a call that sets a subset of some state (e.g., a
+   *          single viewport) is always recorded. Binding a different pipeline invalidates all dynamic state because
+   *          the pipeline's static state replaces it. All state is invalidated by `vkBeginCommandBuffer`,
+   *          `vkResetCommandBuffer`, `vkEndCommandBuffer`, `vkCmdExecuteCommands`, and any other command that binds or
+   *          pushes state without being tracked (e.g., `vkCmdPushDescriptorSetKHR` or `vkCmdBindVertexBuffers2`).
+   *          Commands that invalidate state **MUST** be routed through the policy, or reset() **MUST** be called.
+   *
+   *          Invalidation only increments a pair of counters, so resetting a command buffer is constant time. Each
+   *          command buffer's state is released by `vkFreeCommandBuffers` or by `vkDestroyCommandPool`, and its storage
+   *          is released by `vkResetCommandPool`. Pools are only known for command buffers allocated through the policy
+   *          (i.e., by `vkAllocateCommandBuffers`), so the state of any other command buffer is only released when it
+   *          is freed. Each thread keeps its own index of command buffers, so steady-state filtering takes no locks.
+   */
+  class state_filter final {
+  public:
+    /**
+     * @brief An interception policy that drops redundant commands using a state_filter.
+     * @details When no filter is attached, the policy costs a single load and branch per call.
+     */
+    class policy final {
+    private:
+      state_filter* m_filter{ };
+    public:
+      /**
+       * @brief Drop a redundant command, or invalidate or release tracked state, and continue the chain.
+       * @tparam Cmd The called command.
+       * @param next The remainder of the policy chain.
+       * @param arguments The arguments of the call.
+       * @return The result of `next`.
+       */
+      template <command Cmd, typename Next, typename... Arguments>
+      decltype(auto) invoke(const Next& next, Arguments... arguments) {
+        using internal::base::named;
+        if (!m_filter)
+        {
+          return next(arguments...);
+        }
+        if constexpr (internal::base::filtered_slot<Cmd>() < internal::base::filtered_slots)
+        {
+          if (m_filter->admit<Cmd>(arguments...))
+          {
+            next(arguments...);
+          }
+        }
+        else if constexpr (internal::base::invalidates_state<Cmd>())
+        {
+          m_filter->reset(std::get<0>(std::tuple<Arguments...>{ arguments... }));
+          return next(arguments...);
+        }
+        else if constexpr (named<Cmd>("vkAllocateCommandBuffers"))
+        {
+          // On failure, every command buffer is set to null, so nothing is tracked.
+          decltype(auto) result = next(arguments...);
+          m_filter->allocate(arguments...);
+          return result;
+        }
+        else if constexpr (named<Cmd>("vkFreeCommandBuffers"))
+        {
+          m_filter->free(arguments...);
+          return next(arguments...);
+        }
+        else if constexpr (named<Cmd>("vkResetCommandPool"))
+        {
+          m_filter->reset_pool(std::get<1>(std::tuple<Arguments...>{ arguments... }));
+          return next(arguments...);
+        }
+        else if constexpr (named<Cmd>("vkDestroyCommandPool"))
+        {
+          m_filter->destroy_pool(std::get<1>(std::tuple<Arguments...>{ arguments... }));
+          return next(arguments...);
+        }
+        else
+        {
+          return next(arguments...);
+        }
+      }
+
+      /**
+       * @brief Attach a state_filter to the policy.
+       * @details This **MUST NOT** be called concurrently with calls through the owning table.
+       * @param filter A pointer to the filter to attach or null.
+       */
+      void set_filter(state_filter *const filter) noexcept {
+        m_filter = filter;
+      }
+
+      /**
+       * @brief Retrieve the state_filter attached to the policy.
+       * @return A pointer to the attached filter, or null if no filter is attached.
+       */
+      state_filter* filter() const noexcept {
+        return m_filter;
+      }
+    };
+  private:
+    struct slot final {
+      std::uint64_t stamp{ };
+      std::string bytes{ };
+    };
+
+    // A slot is current while its stamp matches the counter of its group. Counters start at 1 so that new slots are
+    // never current.
+    struct tracker final {
+      std::uint64_t pool{ };
+      std::uint64_t bindings{ 1 };
+      std::uint64_t dynamics{ 1 };
+      std::array<slot, internal::base::filtered_slots> slots{ };
+    };
+
+    // Indices are value-initialized by internal::base::per_thread. An index is cleared whenever its generation
+    // doesn't match the filter's, so it never refers to released state.
+    struct index final {
+      std::unordered_map<std::uint64_t, tracker*> trackers;
+      std::uint64_t generation;
+      internal::base::query_key key;
+      std::atomic<std::uint64_t> dropped;
+      std::atomic<std::uint64_t> forwarded;
+    };
+
+    mutable std::mutex m_lock{ };
+    std::unordered_map<std::uint64_t, std::unique_ptr<tracker>> m_trackers{ };
+    std::atomic<std::uint64_t> m_generation{ };
+    internal::base::per_thread<index> m_indices{ };
+
+    static void bump(std::atomic<std::uint64_t>& counter) noexcept {
+      counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    tracker& find(index& local, const std::uint64_t target) {
+      if (const auto generation = m_generation.load(std::memory_order_acquire); local.generation != generation)
+      {
+        local.trackers.clear();
+        local.generation = generation;
+      }
+      if (const auto found = local.trackers.find(target); found != local.trackers.end())
+      {
+        return *found->second;
+      }
+      auto lock = std::unique_lock<std::mutex>{ m_lock };
+      auto& owned = m_trackers[target];
+      if (!owned)
+      {
+        owned = std::make_unique<tracker>();
+      }
+      local.trackers.emplace(target, owned.get());
+      return *owned;
+    }
+
+    // Released trackers may still be indexed by other threads, so the generation is advanced before the lock is
+    // released.
+    template <typename Predicate>
+    void erase_if(Predicate&& predicate) {
+      auto lock = std::unique_lock<std::mutex>{ m_lock };
+      if (std::erase_if(m_trackers, predicate))
+      {
+        m_generation.fetch_add(1, std::memory_order_release);
+      }
+    }
+  public:
+    /**
+     * @brief Construct a state filter that isn't tracking any command buffers.
+     */
+    state_filter() = default;
+
+    /// @cond
+    state_filter(const state_filter& other) = delete;
+    state_filter(state_filter&& other) = delete;
+
+    ~state_filter() noexcept = default;
+
+    state_filter& operator=(const state_filter& rhs) = delete;
+    state_filter& operator=(state_filter&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Determine whether or not a tracked command must be recorded and update the tracked state.
+     * @details The call is assumed to be recorded if this returns true.
+     * @tparam Cmd The called command. This **MUST** be a tracked command.
+     * @param target The command buffer being recorded.
+     * @param arguments The remaining arguments of the call.
+     * @return True if the call changes the command buffer's state. False if the call is redundant.
+     */
+    template <command Cmd, internal::base::handle CommandBuffer, typename... Arguments>
+    bool admit(const CommandBuffer target, const Arguments... arguments) {
+      using internal::base::filtered_slot;
+      using internal::base::named;
+      constexpr auto first = filtered_slot<Cmd>();
+      static_assert(first < internal::base::filtered_slots, "The admitted command must be tracked.");
+      auto& local = m_indices.local();
+      auto& current = find(local, internal::base::encode(target).value);
+      auto position = first;
+      if constexpr (first < internal::base::bind_point_slots)
+      {
+        // Pipelines and descriptor sets are tracked separately for graphics, compute, and all other bind points.
+        const auto point = static_cast<std::size_t>(std::get<0>(std::tuple<Arguments...>{ arguments... }));
+        position += point < 2 ? point : 2;
+      }
+      auto& stamp = first < internal::base::binding_slots ? current.bindings : current.dynamics;
+      local.key.clear();
+      internal::base::serialize_state<Cmd>(local.key, arguments...);
+      auto& tracked = current.slots[position];
+      if (tracked.stamp == stamp && tracked.bytes == local.key.bytes())
+      {
+        bump(local.dropped);
+        return false;
+      }
+      tracked.stamp = stamp;
+      tracked.bytes.assign(local.key.bytes());
+      if constexpr (named<Cmd>("vkCmdBindPipeline"))
+      {
+        ++current.dynamics;
+      }
+      bump(local.forwarded);
+      return true;
+    }
+
+    /**
+     * @brief Invalidate all of a command buffer's tracked state.
+     * @details The next call to each tracked command will be recorded.
+     * @param target The command buffer to reset.
+     */
+    template <internal::base::handle CommandBuffer>
+    void reset(const CommandBuffer target) {
+      auto& current = find(m_indices.local(), internal::base::encode(target).value);
+      ++current.bindings;
+      ++current.dynamics;
+    }
+
+    /**
+     * @brief Associate newly allocated command buffers with their pool.
+     * @param device The device that allocated the command buffers.
+     * @param info The `VkCommandBufferAllocateInfo` used to allocate the command buffers.
+     * @param targets The allocated command buffers. Null elements are ignored.
+     */
+    template <typename Device, typename Info, internal::base::handle CommandBuffer>
+    void allocate(const Device, const Info *const info, const CommandBuffer *const targets) {
+      const auto pool = internal::base::encode(info->commandPool).value;
+      auto& local = m_indices.local();
+      for (auto i = std::uint32_t{ 0 }; i < info->commandBufferCount; ++i)
+      {
+        if (targets[i])
+        {
+          find(local, internal::base::encode(targets[i]).value).pool = pool;
+        }
+      }
+    }
+
+    /**
+     * @brief Release the state of command buffers that are being freed.
+     * @param device The device that owns the command buffers.
+     * @param pool The pool that the command buffers were allocated from.
+     * @param count The number of elements in `targets`.
+     * @param targets The command buffers being freed. Null elements are ignored.
+     */
+    template <typename Device, typename Pool, internal::base::handle CommandBuffer>
+    void free(const Device, const Pool, const std::uint32_t count, const CommandBuffer *const targets) {
+      const auto freed = [&](const auto& entry) {
+        return std::any_of(targets, targets + count, [&](const CommandBuffer target) {
+          return target && internal::base::encode(target).value == entry.first;
+        });
+      };
+      erase_if(freed);
+    }
+
+    /**
+     * @brief Invalidate the state of every command buffer allocated from a pool that is being reset.
+     * @details Tracked arguments are discarded and their storage is released. The command buffers remain tracked.
+     * @param pool The pool being reset.
+     */
+    template <typename Pool>
+    void reset_pool(const Pool pool) {
+      const auto key = internal::base::encode(pool).value;
+      auto lock = std::unique_lock<std::mutex>{ m_lock };
+      for (auto& [target, current] : m_trackers)
+      {
+        if (current->pool == key)
+        {
+          ++current->bindings;
+          ++current->dynamics;
+          for (auto& tracked : current->slots)
+          {
+            tracked.bytes.clear();
+            tracked.bytes.shrink_to_fit();
+          }
+        }
+      }
+    }
+
+    /**
+     * @brief Release the state of every command buffer allocated from a pool that is being destroyed.
+     * @param pool The pool being destroyed. This **MAY** be null.
+     */
+    template <typename Pool>
+    void destroy_pool(const Pool pool) {
+      if (const auto key = internal::base::encode(pool).value; key)
+      {
+        erase_if([&](const auto& entry) { return entry.second->pool == key; });
+      }
+    }
+
+    /**
+     * @brief Count the command buffers whose state is tracked.
+     * @return The number of command buffers that have been recorded into or allocated through the policy and that
+     *         haven't been released.
+     */
+    std::size_t tracked() const {
+      auto lock = std::unique_lock<std::mutex>{ m_lock };
+      return m_trackers.size();
+    }
+
+    /**
+     * @brief Count the calls that have been dropped.
+     * @return The total number of redundant calls that weren't recorded.
+     */
+    std::uint64_t dropped() const {
+      auto result = std::uint64_t{ 0 };
+      m_indices.for_each([&](const index& current) { result += current.dropped.load(std::memory_order_relaxed); });
+      return result;
+    }
+
+    /**
+     * @brief Count the calls that have been recorded.
+     * @return The total number of tracked calls that changed a command buffer's state.
+     */
+    std::uint64_t forwarded() const {
+      auto result = std::uint64_t{ 0 };
+      m_indices.for_each([&](const index& current) { result += current.forwarded.load(std::memory_order_relaxed); });
+      return result;
+    }
+  };
+
+}
+
+#endif
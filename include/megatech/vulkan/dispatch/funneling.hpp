@@ -0,0 +1,787 @@
+/**
+ * @file funneling.hpp
+ * @brief Lock-Free Vulkan Queue Submission Channels
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_FUNNELING_HPP
+#define MEGATECH_VULKAN_DISPATCH_FUNNELING_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "commands.hpp"
+#include "tables.hpp"
+
+#include "internal/base/arguments.hpp"
+#include "internal/base/fnv_1a.hpp"
+#include "internal/base/mpsc_queue.hpp"
+#include "internal/base/submissions.hpp"
+
+namespace megatech::vulkan::dispatch::device {
+
+  /**
+   * @brief The ways in which a submission_funnel can drain its channels.
+   */
+  enum class drain_mode : std::uint8_t {
+    /**
+     * @brief Whichever producer wins a channel's flag drains it.
+     */
+    cooperative,
+    /**
+     * @brief Every channel is drained by a thread of its own.
+     */
+    dedicated
+  };
+
+  /**
+   * @brief A set of per-queue channels that serialize queue operations without locking.
+   * @details `VkQueue` is externally synchronized, so threads that share a queue normally take a mutex around every
+   *          operation on it. A funnel replaces that mutex with a multi-producer single-consumer channel per queue.
+   *          Producers copy their submission into a channel with a single atomic exchange and receive a completion
+   *          in return. A single consumer drains the channel and makes the actual driver calls. Consecutive
+   *          submissions drained together are merged into one call, so contention turns into batching instead of
+   *          waiting. For example:
+   *          @code{.cpp}
+   *          using funnel = submission_funnel<PFN_vkQueueSubmit, PFN_vkQueueSubmit2>;
+   *          auto submissions = funnel{ ddt };
+   *          submissions.add(graphics_queue);
+   *          auto done = submissions.submit(graphics_queue, 1, &info, VK_NULL_HANDLE);
+   *          // ...
+   *          if (done.wait() != VK_SUCCESS) { }
+   *          @endcode
+   *
+   *          In drain_mode::cooperative, the producer that wins a channel's flag drains it, including any work pushed
+   *          while it drains. In drain_mode::dedicated, every channel has a consumer thread, and producers never make
+   *          driver calls.
+   *
+   *          Binary semaphore signals must be submitted before their waits, even across queues. Before an operation
+   *          that waits on semaphores is funneled, the funnel waits until every other channel has sent the pending
+   *          operations that signal any of those semaphores. In drain_mode::cooperative, the waiting producer drains
+   *          those channels itself if no other thread is. Pending signals are tracked in 64 hashed buckets per channel,
+   *          so a wait **MAY** occasionally be ordered after an unrelated signal too.
+   *
+   *          Submissions that can't be copied, because they or their elements extend a `pNext` chain, are funneled by
+   *          reference instead. Their submit() call doesn't return until the driver call is complete. Other operations
+   *          on a queue (e.g., `vkQueuePresentKHR` and `vkQueueBindSparse`) can be serialized with its submissions by
+   *          execute().
+   *
+   *          Every queue **MUST** be added to the funnel before it's used, and every operation on an added queue
+   *          **MUST** go through the funnel. The funnel calls the base table's function pointers directly, so its
+   *          policy **SHOULD** be the last policy of the chain.
+   * @tparam Submit The function pointer type of `vkQueueSubmit` (i.e., `PFN_vkQueueSubmit`).
+   * @tparam Submit2 The function pointer type of `vkQueueSubmit2` (i.e., `PFN_vkQueueSubmit2`).
+   */
+  template <internal::base::command_pointer Submit, internal::base::command_pointer Submit2>
+  class submission_funnel final {
+  public:
+    /**
+     * @brief The result type of a submission (i.e., `VkResult`).
+     */
+    using result = typename internal::base::submit_signature<Submit>::result;
+
+    /**
+     * @brief The queue handle type (i.e., `VkQueue`).
+     */
+    using queue = typename internal::base::submit_signature<Submit>::queue;
+
+    /**
+     * @brief The fence handle type (i.e., `VkFence`).
+     */
+    using fence = typename internal::base::submit_signature<Submit>::fence;
+
+    /**
+     * @brief The submission structure type of `vkQueueSubmit` (i.e., `VkSubmitInfo`).
+     */
+    using submit_info = typename internal::base::submit_signature<Submit>::info;
+
+    /**
+     * @brief The submission structure type of `vkQueueSubmit2` (i.e., `VkSubmitInfo2`).
+     */
+    using submit_info_2 = typename internal::base::submit_signature<Submit2>::info;
+  private:
+    struct state final {
+      std::atomic<bool> done{ };
+      result value{ };
+
+      void complete(const result outcome) noexcept {
+        value = outcome;
+        done.store(true, std::memory_order_release);
+        done.notify_all();
+      }
+    };
+  public:
+    /**
+     * @brief A handle to the outcome of a funneled operation.
+     * @details Completions are cheap to copy. Every copy refers to the same outcome.
+     */
+    class completion final {
+    private:
+      std::shared_ptr<state> m_state{ };
+    public:
+      /// @cond
+      completion() = default;
+
+      explicit completion(std::shared_ptr<state> current) : m_state{ std::move(current) } { }
+      /// @endcond
+
+      /**
+       * @brief Determine whether or not the completion refers to an operation.
+       * @return True if the completion was returned by a submission_funnel. Otherwise false.
+       */
+      bool valid() const noexcept {
+        return m_state != nullptr;
+      }
+
+      /**
+       * @brief Determine whether or not the operation's driver call has returned.
+       * @details This doesn't block. A ready submission has been sent to the driver. It hasn't necessarily executed.
+       * @return True if the operation is complete or if the completion is invalid. Otherwise false.
+       */
+      bool ready() const noexcept {
+        return !m_state || m_state->done.load(std::memory_order_acquire);
+      }
+
+      /**
+       * @brief Block until the operation's driver call has returned.
+       * @return The result of the driver call, or success if the completion is invalid.
+       */
+      result wait() const noexcept {
+        if (!m_state)
+        {
+          return result{ };
+        }
+        m_state->done.wait(false, std::memory_order_acquire);
+        return m_state->value;
+      }
+    };
+
+    /**
+     * @brief An interception policy that routes queue operations through a submission_funnel.
+     * @details Submissions return success once they're copied into a channel. Driver errors are reported by
+     *          submission_funnel::failure(). `vkQueueWaitIdle`, `vkQueueBindSparse`, and `vkQueuePresentKHR` are
+     *          executed by their queue's consumer, and the calling thread waits for them. Like submissions, sparse
+     *          bindings and presentation are ordered after pending signals of the semaphores they wait on.
+     *          `vkDeviceWaitIdle` waits for every channel to drain first. Operations on queues that weren't added to
+     *          the funnel continue the chain directly. When no funnel is attached, the policy costs a single load and
+     *          branch per call.
+     */
+    class policy final {
+    private:
+      submission_funnel* m_funnel{ };
+    public:
+      /**
+       * @brief Funnel a queue operation, or continue the chain.
+       * @tparam Cmd The called command.
+       * @param next The remainder of the policy chain.
+       * @param arguments The arguments of the call.
+       * @return The result of `next` or of the funnel.
+       */
+      template <command Cmd, typename Next, typename... Arguments>
+      decltype(auto) invoke(const Next& next, Arguments... arguments) {
+        using internal::base::named;
+        if (!m_funnel)
+        {
+          return next(arguments...);
+        }
+        if constexpr (named<Cmd>("vkQueueSubmit") || named<Cmd>("vkQueueSubmit2") || named<Cmd>("vkQueueSubmit2KHR"))
+        {
+          if (!m_funnel->contains(std::get<0>(std::tuple<Arguments...>{ arguments... })))
+          {
+            return next(arguments...);
+          }
+          // Deferred submissions succeed here. Submissions funneled by reference are already complete.
+          auto done = m_funnel->submit(arguments...);
+          return done.ready() ? done.wait() : result{ };
+        }
+        else if constexpr (named<Cmd>("vkQueueWaitIdle") || named<Cmd>("vkQueueBindSparse") ||
+                           named<Cmd>("vkQueuePresentKHR"))
+        {
+          const auto target = std::get<0>(std::tuple<Arguments...>{ arguments... });
+          if (!m_funnel->contains(target))
+          {
+            return next(arguments...);
+          }
+          if constexpr (named<Cmd>("vkQueueBindSparse"))
+          {
+            m_funnel->await_signals(target, std::get<1>(std::tuple<Arguments...>{ arguments... }),
+                                    std::get<2>(std::tuple<Arguments...>{ arguments... }));
+          }
+          else if constexpr (named<Cmd>("vkQueuePresentKHR"))
+          {
+            m_funnel->await_signals(target, 1, std::get<1>(std::tuple<Arguments...>{ arguments... }));
+          }
+          return m_funnel->execute(target, [&]() { return next(arguments...); }).wait();
+        }
+        else if constexpr (named<Cmd>("vkDeviceWaitIdle"))
+        {
+          m_funnel->finish();
+          return next(arguments...);
+        }
+        else
+        {
+          return next(arguments...);
+        }
+      }
+
+      /**
+       * @brief Attach a submission_funnel to the policy.
+       * @details This **MUST NOT** be called concurrently with calls through the owning table.
+       * @param funnel A pointer to the funnel to attach or null.
+       */
+      void set_funnel(submission_funnel *const funnel) noexcept {
+        m_funnel = funnel;
+      }
+
+      /**
+       * @brief Retrieve the submission_funnel attached to the policy.
+       * @return A pointer to the attached funnel, or null if no funnel is attached.
+       */
+      submission_funnel* funnel() const noexcept {
+        return m_funnel;
+      }
+    };
+  private:
+    using legacy_submission = internal::base::owned_submission<submit_info>;
+    using modern_submission = internal::base::owned_submission<submit_info_2>;
+
+    enum class kind : std::uint8_t {
+      legacy,
+      modern,
+      call
+    };
+
+    static constexpr auto semaphore_buckets = std::size_t{ 64 };
+
+    struct operation final : public internal::base::mpsc_link {
+      kind type{ };
+      std::uint64_t signals{ };
+      std::vector<legacy_submission> legacy{ };
+      std::vector<modern_submission> modern{ };
+      fence signal{ };
+      std::function<result()> call{ };
+      std::shared_ptr<state> outcome{ std::make_shared<state>() };
+    };
+
+    struct channel final {
+      queue target{ };
+      internal::base::mpsc_queue<operation> operations{ };
+      // Producers increment this after linking an operation, and the consumer decrements it after popping one. A
+      // positive count means that there's a linked operation that hasn't been popped.
+      std::atomic<std::int64_t> linked{ };
+      std::atomic_flag draining{ };
+      // Producers count operations before linking them, and the consumer counts operations once they're sent. Every
+      // operation linked before a producer reads `pushed` has been sent once `sent` reaches that value.
+      std::atomic<std::uint64_t> pushed{ };
+      std::atomic<std::uint64_t> sent{ };
+      // The number of linked operations that haven't been sent and that signal a semaphore in each bucket.
+      std::array<std::atomic<std::uint32_t>, semaphore_buckets> signals{ };
+      std::atomic<bool> stopping{ };
+      std::thread consumer{ };
+      // Only the consumer touches these.
+      std::vector<std::unique_ptr<operation>> run{ };
+      std::vector<submit_info> legacy_infos{ };
+      std::vector<submit_info_2> modern_infos{ };
+    };
+
+    Submit m_submit{ };
+    Submit2 m_submit2{ };
+    drain_mode m_mode{ };
+    std::unordered_map<queue, std::unique_ptr<channel>> m_channels{ };
+    std::atomic<result> m_failure{ };
+    std::atomic<std::uint64_t> m_operations{ };
+    std::atomic<std::uint64_t> m_submissions{ };
+
+    template <typename Pointer>
+    static Pointer resolve(const table& base, const std::uint_least64_t hash) noexcept {
+      const auto pfn = static_cast<const Pointer*>(base.get(hash));
+      return pfn ? *pfn : nullptr;
+    }
+
+    channel& find(const queue target) const {
+      const auto found = m_channels.find(target);
+      if (found == m_channels.end())
+      {
+        throw dispatch::error{ "The queue hasn't been added to the submission funnel." };
+      }
+      return *found->second;
+    }
+
+    template <typename Semaphore>
+    static std::uint64_t bucket(const Semaphore semaphore) noexcept {
+      // Fibonacci hashing spreads aligned handles across the buckets.
+      const auto value = internal::base::encode(semaphore).value;
+      return std::uint64_t{ 1 } << ((value * 0x9e3779b97f4a7c15) >> 58);
+    }
+
+    // This accepts any structure with semaphore waits (e.g., VkSubmitInfo, VkSubmitInfo2, VkBindSparseInfo, or
+    // VkPresentInfoKHR).
+    template <typename Info>
+    static std::uint64_t wait_buckets(const std::uint32_t count, const Info *const infos) noexcept {
+      auto result = std::uint64_t{ 0 };
+      for (auto i = std::uint32_t{ 0 }; i < count; ++i)
+      {
+        if constexpr (requires { infos[i].pWaitSemaphoreInfos; })
+        {
+          for (auto j = std::uint32_t{ 0 }; j < infos[i].waitSemaphoreInfoCount; ++j)
+          {
+            result |= bucket(infos[i].pWaitSemaphoreInfos[j].semaphore);
+          }
+        }
+        else
+        {
+          for (auto j = std::uint32_t{ 0 }; j < infos[i].waitSemaphoreCount; ++j)
+          {
+            result |= bucket(infos[i].pWaitSemaphores[j]);
+          }
+        }
+      }
+      return result;
+    }
+
+    template <typename Info>
+    static std::uint64_t signal_buckets(const std::uint32_t count, const Info *const infos) noexcept {
+      auto result = std::uint64_t{ 0 };
+      for (auto i = std::uint32_t{ 0 }; i < count; ++i)
+      {
+        if constexpr (requires { infos[i].pSignalSemaphoreInfos; })
+        {
+          for (auto j = std::uint32_t{ 0 }; j < infos[i].signalSemaphoreInfoCount; ++j)
+          {
+            result |= bucket(infos[i].pSignalSemaphoreInfos[j].semaphore);
+          }
+        }
+        else
+        {
+          for (auto j = std::uint32_t{ 0 }; j < infos[i].signalSemaphoreCount; ++j)
+          {
+            result |= bucket(infos[i].pSignalSemaphores[j]);
+          }
+        }
+      }
+      return result;
+    }
+
+    static bool pending(const channel& current, const std::uint64_t mask) noexcept {
+      for (auto i = std::size_t{ 0 }; i < semaphore_buckets; ++i)
+      {
+        if ((mask >> i) & 1 && current.signals[i].load())
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void order(const channel& current, const std::uint64_t mask) {
+      if (!mask)
+      {
+        return;
+      }
+      for (const auto& [target, other] : m_channels)
+      {
+        if (other.get() == &current || !pending(*other, mask))
+        {
+          continue;
+        }
+        const auto expected = other->pushed.load();
+        if (m_mode == drain_mode::cooperative)
+        {
+          cooperate(*other);
+        }
+        for (auto observed = other->sent.load(); observed < expected; observed = other->sent.load())
+        {
+          other->sent.wait(observed);
+        }
+      }
+    }
+
+    void mark_sent(channel& current, const std::uint64_t count) noexcept {
+      current.sent.fetch_add(count);
+      current.sent.notify_all();
+    }
+
+    void record(const result outcome) noexcept {
+      if (outcome != result{ })
+      {
+        auto expected = result{ };
+        m_failure.compare_exchange_strong(expected, outcome, std::memory_order_relaxed);
+      }
+    }
+
+    void send(channel& current) {
+      if (current.run.empty())
+      {
+        return;
+      }
+      // Only the last operation of a run can have a fence. The fence signals after every merged batch completes.
+      const auto signal = current.run.back()->signal;
+      auto outcome = result{ };
+      if (current.run.front()->type == kind::modern)
+      {
+        current.modern_infos.clear();
+        for (const auto& pending : current.run)
+        {
+          for (const auto& submission : pending->modern)
+          {
+            current.modern_infos.emplace_back(submission.info());
+          }
+        }
+        outcome = m_submit2(current.target, static_cast<std::uint32_t>(current.modern_infos.size()),
+                            current.modern_infos.data(), signal);
+      }
+      else
+      {
+        current.legacy_infos.clear();
+        for (const auto& pending : current.run)
+        {
+          for (const auto& submission : pending->legacy)
+          {
+            current.legacy_infos.emplace_back(submission.info());
+          }
+        }
+        outcome = m_submit(current.target, static_cast<std::uint32_t>(current.legacy_infos.size()),
+                           current.legacy_infos.data(), signal);
+      }
+      m_submissions.fetch_add(1, std::memory_order_relaxed);
+      record(outcome);
+      for (const auto& pending : current.run)
+      {
+        for (auto i = std::size_t{ 0 }; i < semaphore_buckets; ++i)
+        {
+          if ((pending->signals >> i) & 1)
+          {
+            current.signals[i].fetch_sub(1);
+          }
+        }
+        pending->outcome->complete(outcome);
+      }
+      mark_sent(current, current.run.size());
+      current.run.clear();
+    }
+
+    void drain(channel& current) {
+      while (auto next = current.operations.pop())
+      {
+        current.linked.fetch_sub(1);
+        if (!current.run.empty() && next->type != current.run.front()->type)
+        {
+          send(current);
+        }
+        if (next->type == kind::call)
+        {
+          next->outcome->complete(next->call());
+          mark_sent(current, 1);
+          continue;
+        }
+        const auto fenced = next->signal != fence{ };
+        current.run.emplace_back(std::move(next));
+        if (fenced)
+        {
+          send(current);
+        }
+      }
+      send(current);
+    }
+
+    void cooperate(channel& current) {
+      // Clearing the flag and then reading the count pairs with incrementing the count and then testing the flag.
+      // Either the drainer sees a new operation or its producer wins the flag.
+      while (!current.draining.test_and_set())
+      {
+        drain(current);
+        current.draining.clear();
+        if (current.linked.load() <= 0)
+        {
+          return;
+        }
+      }
+    }
+
+    void consume(channel& current) {
+      while (!current.stopping.load())
+      {
+        drain(current);
+        if (const auto observed = current.linked.load(); observed <= 0 && !current.stopping.load())
+        {
+          current.linked.wait(observed);
+        }
+      }
+      drain(current);
+    }
+
+    completion enqueue(channel& current, std::unique_ptr<operation> pending) {
+      auto done = completion{ pending->outcome };
+      for (auto i = std::size_t{ 0 }; i < semaphore_buckets; ++i)
+      {
+        if ((pending->signals >> i) & 1)
+        {
+          current.signals[i].fetch_add(1);
+        }
+      }
+      current.pushed.fetch_add(1);
+      current.operations.push(std::move(pending));
+      m_operations.fetch_add(1, std::memory_order_relaxed);
+      current.linked.fetch_add(1);
+      if (m_mode == drain_mode::dedicated)
+      {
+        current.linked.notify_one();
+      }
+      else
+      {
+        cooperate(current);
+      }
+      return done;
+    }
+
+    template <typename Info>
+    completion funnel(const queue target, const std::uint32_t count, const Info *const infos, const fence signal) {
+      constexpr auto modern_kind = std::is_same_v<Info, submit_info_2>;
+      auto& current = find(target);
+      order(current, wait_buckets(count, infos));
+      auto pending = std::make_unique<operation>();
+      const auto copyable = std::all_of(infos, infos + count, [](const Info& info) {
+        return internal::base::owned_submission<Info>::copyable(info);
+      });
+      if (!copyable)
+      {
+        pending->type = kind::call;
+        pending->call = [this, target, count, infos, signal]() {
+          m_submissions.fetch_add(1, std::memory_order_relaxed);
+          auto outcome = result{ };
+          if constexpr (modern_kind)
+          {
+            outcome = m_submit2(target, count, infos, signal);
+          }
+          else
+          {
+            outcome = m_submit(target, count, infos, signal);
+          }
+          record(outcome);
+          return outcome;
+        };
+        auto done = enqueue(current, std::move(pending));
+        // The operation refers to the caller's structures, so it has to complete before they go out of scope.
+        done.wait();
+        return done;
+      }
+      pending->type = modern_kind ? kind::modern : kind::legacy;
+      pending->signal = signal;
+      pending->signals = signal_buckets(count, infos);
+      auto& submissions = [&]() -> auto& {
+        if constexpr (modern_kind)
+        {
+          return pending->modern;
+        }
+        else
+        {
+          return pending->legacy;
+        }
+      }();
+      submissions.resize(count);
+      for (auto i = std::uint32_t{ 0 }; i < count; ++i)
+      {
+        submissions[i].assign(infos[i]);
+      }
+      return enqueue(current, std::move(pending));
+    }
+  public:
+    /**
+     * @brief Construct a submission funnel.
+     * @param base The table whose `vkQueueSubmit` and `vkQueueSubmit2` (or `vkQueueSubmit2KHR`) are used to submit.
+     *             The table's ::VkDevice **MUST** remain valid for the funnel's entire lifetime.
+     * @param mode The way in which the funnel's channels are drained.
+     * @throw dispatch::error If `vkQueueSubmit` was resolved to null.
+     */
+    explicit submission_funnel(const table& base, const drain_mode mode = drain_mode::cooperative) :
+    m_submit{ resolve<Submit>(base, internal::base::fnv_1a_cstr("vkQueueSubmit")) },
+    m_submit2{ resolve<Submit2>(base, internal::base::fnv_1a_cstr("vkQueueSubmit2")) },
+    m_mode{ mode } {
+      if (!m_submit)
+      {
+        throw dispatch::error{ "Submission funneling requires \"vkQueueSubmit\"." };
+      }
+      if (!m_submit2)
+      {
+        m_submit2 = resolve<Submit2>(base, internal::base::fnv_1a_cstr("vkQueueSubmit2KHR"));
+      }
+    }
+
+    /// @cond
+    submission_funnel(const submission_funnel& other) = delete;
+    submission_funnel(submission_funnel&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a submission funnel.
+     * @details Every channel is drained, and every consumer thread is joined. Operations **MUST NOT** be funneled
+     *          concurrently with destruction.
+     */
+    ~submission_funnel() noexcept {
+      for (auto& [target, current] : m_channels)
+      {
+        if (current->consumer.joinable())
+        {
+          current->stopping.store(true);
+          current->linked.fetch_add(1);
+          current->linked.notify_one();
+          current->consumer.join();
+        }
+        else
+        {
+          drain(*current);
+        }
+      }
+    }
+
+    /// @cond
+    submission_funnel& operator=(const submission_funnel& rhs) = delete;
+    submission_funnel& operator=(submission_funnel&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Create a channel for a queue.
+     * @details In drain_mode::dedicated, this starts the channel's consumer thread. Adding a queue that already has a
+     *          channel does nothing. This **MUST NOT** be called concurrently with any other method of the funnel.
+     * @param target The queue to add.
+     */
+    void add(const queue target) {
+      auto& current = m_channels[target];
+      if (current)
+      {
+        return;
+      }
+      current = std::make_unique<channel>();
+      current->target = target;
+      if (m_mode == drain_mode::dedicated)
+      {
+        current->consumer = std::thread{ [this, added = current.get()]() { consume(*added); } };
+      }
+    }
+
+    /**
+     * @brief Determine whether or not a queue has a channel.
+     * @param target The queue to check.
+     * @return True if `target` was added to the funnel. Otherwise false.
+     */
+    bool contains(const queue target) const noexcept {
+      return m_channels.contains(target);
+    }
+
+    /**
+     * @brief Funnel a `vkQueueSubmit`.
+     * @param target The queue to submit to. This **MUST** have been added to the funnel.
+     * @param count The number of elements in `infos`.
+     * @param infos The batches to submit.
+     * @param signal A fence to signal or null.
+     * @return A completion that becomes ready when the submission's driver call returns.
+     * @throw dispatch::error If `target` wasn't added to the funnel.
+     */
+    completion submit(const queue target, const std::uint32_t count, const submit_info *const infos,
+                      const fence signal) {
+      return funnel(target, count, infos, signal);
+    }
+
+    /**
+     * @brief Funnel a `vkQueueSubmit2`.
+     * @param target The queue to submit to. This **MUST** have been added to the funnel.
+     * @param count The number of elements in `infos`.
+     * @param infos The batches to submit.
+     * @param signal A fence to signal or null.
+     * @return A completion that becomes ready when the submission's driver call returns.
+     * @throw dispatch::error If `target` wasn't added to the funnel or if `vkQueueSubmit2` is unavailable.
+     */
+    completion submit(const queue target, const std::uint32_t count, const submit_info_2 *const infos,
+                      const fence signal) {
+      if (!m_submit2)
+      {
+        throw dispatch::error{ "The submission funnel has no \"vkQueueSubmit2\"." };
+      }
+      return funnel(target, count, infos, signal);
+    }
+
+    /**
+     * @brief Funnel an arbitrary operation on a queue.
+     * @details The operation runs on the queue's consumer, in order with the queue's other operations. Anything it
+     *          refers to **MUST** remain valid until its completion is ready.
+     * @param target The queue to operate on. This **MUST** have been added to the funnel.
+     * @param function The operation. This **MUST** return the result type.
+     * @return A completion that becomes ready when the operation returns.
+     * @throw dispatch::error If `target` wasn't added to the funnel.
+     */
+    template <typename Function>
+    completion execute(const queue target, Function&& function) {
+      auto& current = find(target);
+      auto pending = std::make_unique<operation>();
+      pending->type = kind::call;
+      pending->call = std::forward<Function>(function);
+      return enqueue(current, std::move(pending));
+    }
+
+    /**
+     * @brief Block until other channels have sent the pending signals of the semaphores that operations wait on.
+     * @details submit() does this automatically. It **SHOULD** be called before an operation that waits on semaphores
+     *          is passed to execute().
+     * @param target The queue that the operations will be funneled to. This **MUST** have been added to the funnel.
+     * @param count The number of elements in `infos`.
+     * @param infos The operations' structures (e.g., `VkBindSparseInfo` or `VkPresentInfoKHR`).
+     * @throw dispatch::error If `target` wasn't added to the funnel.
+     */
+    template <typename Info>
+    void await_signals(const queue target, const std::uint32_t count, const Info *const infos) {
+      order(find(target), wait_buckets(count, infos));
+    }
+
+    /**
+     * @brief Block until every operation funneled so far has been sent to the driver.
+     */
+    void finish() {
+      for (const auto& [target, current] : m_channels)
+      {
+        execute(target, []() { return result{ }; }).wait();
+      }
+    }
+
+    /**
+     * @brief Retrieve the first error returned by a driver call.
+     * @return The first unsuccessful result, or success if every driver call succeeded.
+     */
+    result failure() const noexcept {
+      return m_failure.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count the operations that have been funneled.
+     * @return The total number of submissions and executed operations accepted by the funnel.
+     */
+    std::uint64_t operations() const noexcept {
+      return m_operations.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count the submissions that have been made to the driver.
+     * @return The total number of `vkQueueSubmit` and `vkQueueSubmit2` calls made by the funnel.
+     */
+    std::uint64_t submissions() const noexcept {
+      return m_submissions.load(std::memory_order_relaxed);
+    }
+  };
+
+}
+
+#endif
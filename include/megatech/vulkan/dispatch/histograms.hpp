@@ -0,0 +1,346 @@
+/**
+ * @file histograms.hpp
+ * @brief Vulkan Command Latency Histograms
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_HISTOGRAMS_HPP
+#define MEGATECH_VULKAN_DISPATCH_HISTOGRAMS_HPP
+
+#include <cstddef>
+#include <cinttypes>
+#include <cmath>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <mutex>
+
+#include "defs.hpp"
+#include "commands.hpp"
+
+#include "internal/base/per_thread.hpp"
+#include "internal/base/timestamp.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+  /**
+   * @brief A snapshot of the latency distribution of a single Vulkan command.
+   * @details Latencies are recorded into log-linear buckets in the style of HDR histograms. Every power of 2 is split
+   *          into 8 linear sub-buckets, so any reported value is within 12.5% of the true value. Values from 0 to
+   *          2<sup>64</sup> - 1 ticks are representable.
+   */
+  class latency_histogram final {
+  public:
+    /**
+     * @brief The number of linear sub-buckets per power of 2.
+     */
+    static constexpr std::size_t sub_buckets{ 8 };
+
+    /**
+     * @brief The total number of buckets.
+     */
+    static constexpr std::size_t bucket_count{ (64 - 2) * sub_buckets };
+
+    /**
+     * @brief Compute the bucket that a value in ticks is recorded into.
+     * @param ticks A value in ticks.
+     * @return The index of the bucket containing `ticks`.
+     */
+    static constexpr std::size_t bucket(const std::uint64_t ticks) noexcept {
+      if (ticks < sub_buckets)
+      {
+        return ticks;
+      }
+      const auto msb = static_cast<std::size_t>(std::bit_width(ticks)) - 1;
+      const auto shift = msb - 3;
+      return (msb - 2) * sub_buckets + ((ticks >> shift) & (sub_buckets - 1));
+    }
+
+    /**
+     * @brief Compute the smallest value in ticks recorded into a bucket.
+     * @param index The index of a bucket.
+     * @return The lower bound of the bucket.
+     */
+    static constexpr std::uint64_t lower_bound(const std::size_t index) noexcept {
+      if (index < sub_buckets)
+      {
+        return index;
+      }
+      const auto msb = index / sub_buckets + 2;
+      return (sub_buckets + index % sub_buckets) << (msb - 3);
+    }
+
+    /**
+     * @brief Compute the number of distinct values in ticks recorded into a bucket.
+     * @param index The index of a bucket.
+     * @return The width of the bucket.
+     */
+    static constexpr std::uint64_t width(const std::size_t index) noexcept {
+      if (index < sub_buckets)
+      {
+        return 1;
+      }
+      return std::uint64_t{ 1 } << (index / sub_buckets - 1);
+    }
+  private:
+    std::array<std::uint64_t, bucket_count> m_buckets{ };
+    std::uint64_t m_count{ };
+    std::uint64_t m_sum{ };
+    std::uint64_t m_max{ };
+    double m_ns_per_tick{ 1.0 };
+  public:
+    /**
+     * @brief Construct an empty histogram.
+     */
+    latency_histogram() = default;
+
+    /**
+     * @brief Construct a histogram from raw bucket data.
+     * @param buckets The number of samples in each bucket.
+     * @param sum The sum of all samples in ticks.
+     * @param max The largest sample in ticks.
+     * @param ns_per_tick The calibrated length of a tick in nanoseconds.
+     */
+    latency_histogram(const std::array<std::uint64_t, bucket_count>& buckets, const std::uint64_t sum,
+                      const std::uint64_t max, const double ns_per_tick) :
+    m_buckets{ buckets }, m_sum{ sum }, m_max{ max }, m_ns_per_tick{ ns_per_tick } {
+      for (const auto value : m_buckets)
+      {
+        m_count += value;
+      }
+    }
+
+    /**
+     * @brief Retrieve the number of samples.
+     * @return The number of recorded calls.
+     */
+    std::uint64_t count() const noexcept {
+      return m_count;
+    }
+
+    /**
+     * @brief Retrieve the number of samples in a bucket.
+     * @param index The index of a bucket. This **MUST** be less than ::bucket_count.
+     * @return The number of recorded calls in the bucket.
+     */
+    std::uint64_t samples(const std::size_t index) const noexcept {
+      return m_buckets[index];
+    }
+
+    /**
+     * @brief Retrieve the mean latency.
+     * @return The mean latency in nanoseconds, or zero if the histogram is empty.
+     */
+    double mean() const noexcept {
+      return m_count ? m_sum * m_ns_per_tick / m_count : 0.0;
+    }
+
+    /**
+     * @brief Retrieve the maximum latency.
+     * @return The exact maximum latency in nanoseconds, or zero if the histogram is empty.
+     */
+    double max() const noexcept {
+      return m_max * m_ns_per_tick;
+    }
+
+    /**
+     * @brief Compute a latency percentile.
+     * @param percentile A percentile in the range [0, 100]. Values outside of this range are clamped.
+     * @return The midpoint, in nanoseconds, of the bucket containing the requested percentile. This is never larger
+     *         than ::max(). If the histogram is empty, zero is returned.
+     */
+    double percentile(const double percentile) const noexcept {
+      if (!m_count)
+      {
+        return 0.0;
+      }
+      const auto clamped = std::clamp(percentile, 0.0, 100.0);
+      const auto rank = std::max(std::uint64_t{ 1 },
+                                 static_cast<std::uint64_t>(std::ceil(clamped / 100.0 * static_cast<double>(m_count))));
+      auto cumulative = std::uint64_t{ 0 };
+      for (auto i = std::size_t{ 0 }; i < bucket_count; ++i)
+      {
+        cumulative += m_buckets[i];
+        if (cumulative >= rank)
+        {
+          const auto midpoint = lower_bound(i) + (width(i) - 1) / 2.0;
+          return std::min(midpoint * m_ns_per_tick, max());
+        }
+      }
+      return max();
+    }
+  };
+
+  /**
+   * @brief A set of per-command latency histograms suitable for always-on use.
+   * @details Each thread records into its own buckets. Bucket arrays are only allocated for commands that a thread
+   *          actually calls. Recording a sample costs a few relaxed stores to thread-owned memory. Histograms are
+   *          merged lazily when a snapshot is requested.
+   *
+   *          Resetting is lock-free. A reset advances a generation number. Each thread clears its own buckets the next
+   *          time it records a sample, and buckets belonging to older generations are ignored by snapshots.
+   * @tparam Command The command enumeration type of the level being measured (e.g., device::command).
+   * @tparam Count The number of commands at the level being measured.
+   */
+  template <typename Command, std::size_t Count>
+  class basic_latency_histograms final {
+  private:
+    struct buckets final {
+      std::array<std::atomic<std::uint64_t>, latency_histogram::bucket_count> counts{ };
+      std::atomic<std::uint64_t> sum{ };
+      std::atomic<std::uint64_t> max{ };
+    };
+
+    // Blocks are value-initialized by internal::base::per_thread.
+    struct block final {
+      std::array<std::atomic<buckets*>, Count> commands;
+      std::atomic<std::uint64_t> generation;
+
+      ~block() noexcept {
+        for (auto& current : commands)
+        {
+          delete current.load(std::memory_order_relaxed);
+        }
+      }
+    };
+
+    static void add(std::atomic<std::uint64_t>& value, const std::uint64_t amount) noexcept {
+      value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    internal::base::per_thread<block> m_blocks{ };
+    std::atomic<std::uint64_t> m_generation{ };
+    mutable std::mutex m_mutex{ };
+    mutable internal::base::timestamp_calibration m_calibration{ };
+
+    void clear(block& current, const std::uint64_t generation) noexcept {
+      for (auto& command : current.commands)
+      {
+        if (const auto data = command.load(std::memory_order_relaxed); data)
+        {
+          for (auto& count : data->counts)
+          {
+            count.store(0, std::memory_order_relaxed);
+          }
+          data->sum.store(0, std::memory_order_relaxed);
+          data->max.store(0, std::memory_order_relaxed);
+        }
+      }
+      current.generation.store(generation, std::memory_order_release);
+    }
+  public:
+    /**
+     * @brief Construct a set of empty histograms.
+     */
+    basic_latency_histograms() = default;
+
+    /// @cond
+    basic_latency_histograms(const basic_latency_histograms& other) = delete;
+    basic_latency_histograms(basic_latency_histograms&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a set of histograms.
+     */
+    ~basic_latency_histograms() noexcept = default;
+
+    /// @cond
+    basic_latency_histograms& operator=(const basic_latency_histograms& rhs) = delete;
+    basic_latency_histograms& operator=(basic_latency_histograms&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Record a sample on the calling thread.
+     * @param cmd The command that was called. This **MUST** be a valid `Command`.
+     * @param ticks The duration of the call in internal::base::timestamp() ticks.
+     */
+    void record(const Command cmd, const std::uint64_t ticks) {
+      auto& current = m_blocks.local();
+      if (const auto generation = m_generation.load(std::memory_order_relaxed);
+          current.generation.load(std::memory_order_relaxed) != generation) [[unlikely]]
+      {
+        clear(current, generation);
+      }
+      auto& slot = current.commands[static_cast<std::size_t>(cmd)];
+      auto data = slot.load(std::memory_order_relaxed);
+      if (!data) [[unlikely]]
+      {
+        data = new buckets{ };
+        slot.store(data, std::memory_order_release);
+      }
+      add(data->counts[latency_histogram::bucket(ticks)], 1);
+      add(data->sum, ticks);
+      if (ticks > data->max.load(std::memory_order_relaxed))
+      {
+        data->max.store(ticks, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @brief Merge the samples of all threads for a single command.
+     * @details This is safe to call concurrently with ::record() but **MUST NOT** be called concurrently with
+     *          ::reset().
+     * @param cmd The command to retrieve a histogram for. This **MUST** be a valid `Command`.
+     * @return A histogram containing every sample recorded for `cmd` since construction or the last call to
+     *         ::reset().
+     */
+    latency_histogram snapshot(const Command cmd) const {
+      const auto index = static_cast<std::size_t>(cmd);
+      const auto generation = m_generation.load(std::memory_order_relaxed);
+      auto merged = std::array<std::uint64_t, latency_histogram::bucket_count>{ };
+      auto sum = std::uint64_t{ 0 };
+      auto max = std::uint64_t{ 0 };
+      m_blocks.for_each([&](const block& current) {
+        if (current.generation.load(std::memory_order_acquire) != generation)
+        {
+          return;
+        }
+        if (const auto data = current.commands[index].load(std::memory_order_acquire); data)
+        {
+          for (auto i = std::size_t{ 0 }; i < merged.size(); ++i)
+          {
+            merged[i] += data->counts[i].load(std::memory_order_relaxed);
+          }
+          sum += data->sum.load(std::memory_order_relaxed);
+          max = std::max(max, data->max.load(std::memory_order_relaxed));
+        }
+      });
+      auto lock = std::unique_lock{ m_mutex };
+      m_calibration.update();
+      return latency_histogram{ merged, sum, max, m_calibration.nanoseconds(1) };
+    }
+
+    /**
+     * @brief Discard all samples.
+     * @details This **MUST NOT** be called concurrently with ::snapshot().
+     */
+    void reset() noexcept {
+      m_generation.fetch_add(1, std::memory_order_relaxed);
+    }
+  };
+
+namespace instance {
+
+  /**
+   * @brief Latency histograms for instance-level Vulkan commands.
+   */
+  using latency_histograms = basic_latency_histograms<command, MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT>;
+
+}
+
+namespace device {
+
+  /**
+   * @brief Latency histograms for device-level Vulkan commands.
+   */
+  using latency_histograms = basic_latency_histograms<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT>;
+
+}
+
+}
+
+#endif
@@ -0,0 +1,378 @@
+/**
+ * @file hooked_tables.hpp
+ * @brief Hooked Vulkan Dispatch Tables
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_HOOKED_TABLES_HPP
+#define MEGATECH_VULKAN_DISPATCH_HOOKED_TABLES_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <utility>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "commands.hpp"
+#include "tables.hpp"
+
+#include "internal/base/hooks.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+  /**
+   * @brief The type of a callback invoked before a Vulkan command.
+   * @details Pre-call hooks receive a copy of every argument of the call (e.g., `void(VkQueue, std::uint32_t,
+   *          const VkSubmitInfo*, VkFence)` for `PFN_vkQueueSubmit`).
+   * @tparam Pointer The function pointer type of the hooked command.
+   */
+  template <internal::base::command_pointer Pointer>
+  using pre_hook = typename internal::base::hook_signature<Pointer>::pre;
+
+  /**
+   * @brief The type of a callback invoked after a Vulkan command.
+   * @details Post-call hooks receive the result of the call, if the command has one, followed by a copy of every
+   *          argument of the call (e.g., `void(VkResult, VkQueue, std::uint32_t, const VkSubmitInfo*, VkFence)` for
+   *          `PFN_vkQueueSubmit`).
+   * @tparam Pointer The function pointer type of the hooked command.
+   */
+  template <internal::base::command_pointer Pointer>
+  using post_hook = typename internal::base::hook_signature<Pointer>::post;
+
+namespace instance {
+
+  /**
+   * @brief An instance-level dispatch table with runtime pre-call and post-call hooks.
+   * @details Hooked tables expose the same interface as table. Initially, every entry is identical to the
+   *          corresponding entry of the table used to construct it, and calls through it cost exactly as much as calls
+   *          through the base table. Attaching the first hook to a command replaces its entry with a pointer to a
+   *          thunk. The thunk calls each pre-call hook in the order it was attached, then calls the original function
+   *          pointer, and then calls each post-call hook in the order it was attached. For example:
+   *          @code{.cpp}
+   *          auto iht = hooked_table{ idt };
+   *          iht.add_post_hook<command::vkEnumeratePhysicalDevices, PFN_vkEnumeratePhysicalDevices>(
+   *            [](VkResult result, VkInstance, std::uint32_t*, VkPhysicalDevice*) { check(result); }
+   *          );
+   *          // Retrieve and call "vkEnumeratePhysicalDevices" through iht as usual.
+   *          @endcode
+   *
+   *          Hooks replace a Vulkan layer for targeted instrumentation, validation, and optimization passes without
+   *          slowing down every other command. Thunks are bound to their table. At most
+   *          `MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS` hooked tables of each level may exist at once. Function
+   *          pointers retrieved from a hooked table **MUST NOT** be called after the table is destroyed.
+   */
+  class hooked_table final {
+  private:
+    VkInstance m_instance{ };
+    internal::base::hooks<command, MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT> m_hooks;
+  public:
+    /**
+     * @brief Construct a hooked table.
+     * @details Hooked tables do not have an ownership relationship with the table they are constructed from. The
+     *          lifetime of `base` **MAY** end immediately after construction.
+     * @param base The table to hook. The table shares ownership of the base table's ::VkInstance, and so it **MUST**
+     *             remain valid for the table's entire lifetime.
+     * @throw dispatch::error If there are no free hook slots.
+     */
+    explicit hooked_table(const table& base);
+
+    /// @cond
+    hooked_table(const hooked_table& other) = delete;
+    hooked_table(hooked_table&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a hooked table.
+     */
+    ~hooked_table() noexcept = default;
+
+    /// @cond
+    hooked_table& operator=(const hooked_table& rhs) = delete;
+    hooked_table& operator=(hooked_table&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Attach a callback to be invoked before every call to a command.
+     * @details If the command was resolved to null, the hook is discarded and the entry remains null. Hooks **MUST
+     *          NOT** be attached or cleared concurrently with ::get() or with calls through the table.
+     * @tparam Cmd The ::command to hook.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkEnumeratePhysicalDevices`).
+     * @param hook The callback to attach.
+     * @throw dispatch::error If `Cmd` was previously hooked with a different `Pointer` type.
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void add_pre_hook(pre_hook<Pointer> hook) {
+      m_hooks.add_pre<Cmd, Pointer>(std::move(hook));
+    }
+
+    /**
+     * @brief Attach a callback to be invoked after every call to a command.
+     * @details If the command was resolved to null, the hook is discarded and the entry remains null. Hooks **MUST
+     *          NOT** be attached or cleared concurrently with ::get() or with calls through the table.
+     * @tparam Cmd The ::command to hook.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkEnumeratePhysicalDevices`).
+     * @param hook The callback to attach.
+     * @throw dispatch::error If `Cmd` was previously hooked with a different `Pointer` type.
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void add_post_hook(post_hook<Pointer> hook) {
+      m_hooks.add_post<Cmd, Pointer>(std::move(hook));
+    }
+
+    /**
+     * @brief Detach every hook from a command and restore its original function pointer.
+     * @details This **MUST NOT** be called concurrently with ::get() or with calls through the table.
+     * @tparam Cmd The ::command to clear.
+     */
+    template <command Cmd>
+    void clear_hooks() noexcept {
+      m_hooks.clear<Cmd>();
+    }
+
+    /**
+     * @brief Determine whether or not a command is hooked.
+     * @param cmd The ::command to check.
+     * @return True if calls to `cmd` are routed through a thunk. Otherwise false.
+     */
+    bool hooked(const command cmd) const noexcept;
+
+    /**
+     * @brief Retrieve the ::VkInstance used to construct the table.
+     * @return The ::VkInstance handle that was used to construct the table.
+     */
+    VkInstance instance() const;
+
+    /**
+     * @brief Retrieve the size of the table.
+     * @return The number of commands held in the table.
+     */
+    constexpr std::size_t size() const noexcept {
+      return MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT;
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* get(const command cmd) const {
+      if (static_cast<std::size_t>(cmd) >= size())
+      {
+        throw dispatch::error{ "The input command is outside the valid range of possible instance commnds." };
+      }
+      return m_hooks.slot(static_cast<std::size_t>(cmd));
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* operator()(const command cmd) const {
+      return get(cmd);
+    }
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case dispatch::internal::base::fnv_1a_cstr(#name): return get(command::name);
+/// @endcond
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash A 64-bit FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* get(const std::uint_least64_t hash) const noexcept {
+      switch (hash)
+      {
+      MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_LIST
+      default:
+        return nullptr;
+      }
+    }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash A 64-bit FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* operator()(const std::uint_least64_t hash) const noexcept {
+      return get(hash);
+    }
+  };
+
+}
+
+namespace device {
+
+  /**
+   * @brief A device-level dispatch table with runtime pre-call and post-call hooks.
+   * @see instance::hooked_table
+   */
+  class hooked_table final {
+  private:
+    VkInstance m_instance{ };
+    VkDevice m_device{ };
+    internal::base::hooks<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT> m_hooks;
+  public:
+    /**
+     * @brief Construct a hooked table.
+     * @details Hooked tables do not have an ownership relationship with the table they are constructed from. The
+     *          lifetime of `base` **MAY** end immediately after construction.
+     * @param base The table to hook. The table shares ownership of the base table's ::VkInstance and ::VkDevice, and
+     *             so they **MUST** remain valid for the table's entire lifetime.
+     * @throw dispatch::error If there are no free hook slots.
+     */
+    explicit hooked_table(const table& base);
+
+    /// @cond
+    hooked_table(const hooked_table& other) = delete;
+    hooked_table(hooked_table&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a hooked table.
+     */
+    ~hooked_table() noexcept = default;
+
+    /// @cond
+    hooked_table& operator=(const hooked_table& rhs) = delete;
+    hooked_table& operator=(hooked_table&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Attach a callback to be invoked before every call to a command.
+     * @tparam Cmd The ::command to hook.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkQueueSubmit`).
+     * @param hook The callback to attach.
+     * @throw dispatch::error If `Cmd` was previously hooked with a different `Pointer` type.
+     * @see instance::hooked_table::add_pre_hook()
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void add_pre_hook(pre_hook<Pointer> hook) {
+      m_hooks.add_pre<Cmd, Pointer>(std::move(hook));
+    }
+
+    /**
+     * @brief Attach a callback to be invoked after every call to a command.
+     * @tparam Cmd The ::command to hook.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkQueueSubmit`).
+     * @param hook The callback to attach.
+     * @throw dispatch::error If `Cmd` was previously hooked with a different `Pointer` type.
+     * @see instance::hooked_table::add_post_hook()
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void add_post_hook(post_hook<Pointer> hook) {
+      m_hooks.add_post<Cmd, Pointer>(std::move(hook));
+    }
+
+    /**
+     * @brief Detach every hook from a command and restore its original function pointer.
+     * @tparam Cmd The ::command to clear.
+     * @see instance::hooked_table::clear_hooks()
+     */
+    template <command Cmd>
+    void clear_hooks() noexcept {
+      m_hooks.clear<Cmd>();
+    }
+
+    /**
+     * @brief Determine whether or not a command is hooked.
+     * @param cmd The ::command to check.
+     * @return True if calls to `cmd` are routed through a thunk. Otherwise false.
+     */
+    bool hooked(const command cmd) const noexcept;
+
+    /**
+     * @brief Retrieve the ::VkInstance used to construct the table.
+     * @return The ::VkInstance handle that was used to construct the table.
+     */
+    VkInstance instance() const;
+
+    /**
+     * @brief Retrieve the ::VkDevice used to construct the table.
+     * @return The ::VkDevice handle that was used to construct the table if any. Null is returned in all other
+     *         cases.
+     */
+    VkDevice device() const;
+
+    /**
+     * @brief Retrieve the size of the table.
+     * @return The number of commands held in the table.
+     */
+    constexpr std::size_t size() const noexcept {
+      return MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT;
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* get(const command cmd) const {
+      if (static_cast<std::size_t>(cmd) >= size())
+      {
+        throw dispatch::error{ "The input command is outside the valid range of possible device commnds." };
+      }
+      return m_hooks.slot(static_cast<std::size_t>(cmd));
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* operator()(const command cmd) const {
+      return get(cmd);
+    }
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case dispatch::internal::base::fnv_1a_cstr(#name): return get(command::name);
+/// @endcond
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* get(const std::uint_least64_t hash) const noexcept {
+      switch (hash)
+      {
+      MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+      default:
+        return nullptr;
+      }
+    }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* operator()(const std::uint_least64_t hash) const noexcept {
+      return get(hash);
+    }
+  };
+
+}
+
+}
+
+#endif
@@ -0,0 +1,450 @@
+/**
+ * @file instrumented_tables.hpp
+ * @brief Instrumented Vulkan Dispatch Tables
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INSTRUMENTED_TABLES_HPP
+#define MEGATECH_VULKAN_DISPATCH_INSTRUMENTED_TABLES_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "commands.hpp"
+#include "counters.hpp"
+#include "histograms.hpp"
+#include "profiler.hpp"
+#include "tables.hpp"
+#include "tracer.hpp"
+
+#include "internal/base/instrumentation.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+namespace instance {
+
+  /**
+   * @brief An instance-level dispatch table that counts calls to selected Vulkan commands.
+   * @details Instrumented tables expose the same interface as table. Initially, every entry is identical to the
+   *          corresponding entry of the table used to construct it. Calling ::instrument() replaces an entry with a
+   *          pointer to a thunk. Each thunk increments a per-thread counter for its command and then tail-calls the
+   *          original function pointer. This costs a few nanoseconds per call and requires no Vulkan layer.
+   *
+   *          Because the library is not generated with Vulkan command signatures, clients select the commands to
+   *          instrument and provide their function pointer types. For example:
+   *          @code{.cpp}
+   *          auto iit = instrumented_table{ idt };
+   *          iit.instrument<command::vkGetPhysicalDeviceProperties, PFN_vkGetPhysicalDeviceProperties>();
+   *          // Retrieve and call "vkGetPhysicalDeviceProperties" through iit as usual.
+   *          const auto count = iit.counters().count(command::vkGetPhysicalDeviceProperties);
+   *          @endcode
+   *
+   *          Thunks are bound to their table. At most `MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS` instrumented
+   *          tables of each level may exist at once. Function pointers retrieved from an instrumented table **MUST
+   *          NOT** be called after the table is destroyed.
+   */
+  class instrumented_table final {
+  private:
+    VkInstance m_instance{ };
+    internal::base::instrumentation<command, MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT> m_instrumentation;
+  public:
+    /**
+     * @brief Construct an instrumented table.
+     * @details Instrumented tables do not have an ownership relationship with the table they are constructed from.
+     *          The lifetime of `base` **MAY** end immediately after construction.
+     * @param base The table to instrument. The table shares ownership of the base table's ::VkInstance, and so it
+     *             **MUST** remain valid for the table's entire lifetime.
+     * @throw dispatch::error If there are no free instrumentation slots.
+     */
+    explicit instrumented_table(const table& base);
+
+    /// @cond
+    instrumented_table(const instrumented_table& other) = delete;
+    instrumented_table(instrumented_table&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy an instrumented table.
+     */
+    ~instrumented_table() noexcept = default;
+
+    /// @cond
+    instrumented_table& operator=(const instrumented_table& rhs) = delete;
+    instrumented_table& operator=(instrumented_table&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Route calls to a command through a counting thunk.
+     * @details If the command was resolved to null, the entry remains null. Instrumenting a command that is already
+     *          instrumented has no effect. This **MUST NOT** be called concurrently with ::get().
+     * @tparam Cmd The ::command to instrument.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkDestroyInstance`).
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void instrument() {
+      m_instrumentation.instrument<Cmd, Pointer>();
+    }
+
+    /**
+     * @brief Restore a command's original function pointer.
+     * @details Calls already counted are retained. This **MUST NOT** be called concurrently with ::get().
+     * @tparam Cmd The ::command to restore.
+     */
+    template <command Cmd>
+    void restore() noexcept {
+      m_instrumentation.restore<Cmd>();
+    }
+
+    /**
+     * @brief Determine whether or not a command is instrumented.
+     * @param cmd The ::command to check.
+     * @return True if calls to `cmd` are routed through a thunk. Otherwise false.
+     */
+    bool instrumented(const command cmd) const noexcept;
+
+    /**
+     * @brief Retrieve the table's call counters.
+     * @return A reference to the counters updated by the table's thunks.
+     */
+    const call_counters& counters() const noexcept;
+
+    /**
+     * @brief Retrieve the table's call counters.
+     * @return A reference to the counters updated by the table's thunks.
+     */
+    call_counters& counters() noexcept;
+
+    /**
+     * @brief Attach a call_tracer to the table.
+     * @details While a tracer is attached, every call made through an instrumented command is timed and recorded
+     *          into it. Passing null detaches the current tracer. Multiple tables **MAY** share a tracer. This is safe
+     *          to call concurrently with calls through the table's thunks.
+     * @param tracer A pointer to the tracer to attach or null. The tracer **MUST** remain valid until it is detached
+     *               and all in-flight calls have returned.
+     */
+    void set_tracer(call_tracer *const tracer) noexcept;
+
+    /**
+     * @brief Retrieve the call_tracer attached to the table.
+     * @return A pointer to the attached tracer, or null if no tracer is attached.
+     */
+    call_tracer* tracer() const noexcept;
+
+    /**
+     * @brief Attach a set of latency_histograms to the table.
+     * @details While histograms are attached, every call made through an instrumented command is timed and recorded
+     *          into them. Passing null detaches the current histograms. Multiple tables **MAY** share histograms. This
+     *          is safe to call concurrently with calls through the table's thunks.
+     * @param histograms A pointer to the histograms to attach or null. The histograms **MUST** remain valid until they
+     *                   are detached and all in-flight calls have returned.
+     */
+    void set_histograms(latency_histograms *const histograms) noexcept;
+
+    /**
+     * @brief Retrieve the latency_histograms attached to the table.
+     * @return A pointer to the attached histograms, or null if no histograms are attached.
+     */
+    latency_histograms* histograms() const noexcept;
+
+    /**
+     * @brief Attach a call_site_profiler to the table.
+     * @details While a profiler is attached, every call made through an instrumented command is timed and attributed
+     *          to the code that made it. Passing null detaches the current profiler. Multiple tables **MAY** share a
+     *          profiler. This is safe to call concurrently with calls through the table's thunks.
+     * @param profiler A pointer to the profiler to attach or null. The profiler **MUST** remain valid until it is
+     *                 detached and all in-flight calls have returned.
+     */
+    void set_profiler(call_site_profiler *const profiler) noexcept;
+
+    /**
+     * @brief Retrieve the call_site_profiler attached to the table.
+     * @return A pointer to the attached profiler, or null if no profiler is attached.
+     */
+    call_site_profiler* profiler() const noexcept;
+
+    /**
+     * @brief Retrieve the ::VkInstance used to construct the table.
+     * @return The ::VkInstance handle that was used to construct the table.
+     */
+    VkInstance instance() const;
+
+    /**
+     * @brief Retrieve the size of the table.
+     * @return The number of commands held in the table.
+     */
+    constexpr std::size_t size() const noexcept {
+      return MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT;
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* get(const command cmd) const {
+      if (static_cast<std::size_t>(cmd) >= size())
+      {
+        throw dispatch::error{ "The input command is outside the valid range of possible instance commnds." };
+      }
+      return m_instrumentation.slot(static_cast<std::size_t>(cmd));
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* operator()(const command cmd) const {
+      return get(cmd);
+    }
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case dispatch::internal::base::fnv_1a_cstr(#name): return get(command::name);
+/// @endcond
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash A 64-bit FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* get(const std::uint_least64_t hash) const noexcept {
+      switch (hash)
+      {
+      MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_LIST
+      default:
+        return nullptr;
+      }
+    }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash A 64-bit FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* operator()(const std::uint_least64_t hash) const noexcept {
+      return get(hash);
+    }
+  };
+
+}
+
+namespace device {
+
+  /**
+   * @brief A device-level dispatch table that counts calls to selected Vulkan commands.
+   * @see instance::instrumented_table
+   */
+  class instrumented_table final {
+  private:
+    VkInstance m_instance{ };
+    VkDevice m_device{ };
+    internal::base::instrumentation<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT> m_instrumentation;
+  public:
+    /**
+     * @brief Construct an instrumented table.
+     * @details Instrumented tables do not have an ownership relationship with the table they are constructed from.
+     *          The lifetime of `base` **MAY** end immediately after construction.
+     * @param base The table to instrument. The table shares ownership of the base table's ::VkInstance and
+     *             ::VkDevice, and so they **MUST** remain valid for the table's entire lifetime.
+     * @throw dispatch::error If there are no free instrumentation slots.
+     */
+    explicit instrumented_table(const table& base);
+
+    /// @cond
+    instrumented_table(const instrumented_table& other) = delete;
+    instrumented_table(instrumented_table&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy an instrumented table.
+     */
+    ~instrumented_table() noexcept = default;
+
+    /// @cond
+    instrumented_table& operator=(const instrumented_table& rhs) = delete;
+    instrumented_table& operator=(instrumented_table&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Route calls to a command through a counting thunk.
+     * @tparam Cmd The ::command to instrument.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkQueueSubmit`).
+     * @see instance::instrumented_table::instrument()
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void instrument() {
+      m_instrumentation.instrument<Cmd, Pointer>();
+    }
+
+    /**
+     * @brief Restore a command's original function pointer.
+     * @tparam Cmd The ::command to restore.
+     * @see instance::instrumented_table::restore()
+     */
+    template <command Cmd>
+    void restore() noexcept {
+      m_instrumentation.restore<Cmd>();
+    }
+
+    /**
+     * @brief Determine whether or not a command is instrumented.
+     * @param cmd The ::command to check.
+     * @return True if calls to `cmd` are routed through a thunk. Otherwise false.
+     */
+    bool instrumented(const command cmd) const noexcept;
+
+    /**
+     * @brief Retrieve the table's call counters.
+     * @return A reference to the counters updated by the table's thunks.
+     */
+    const call_counters& counters() const noexcept;
+
+    /**
+     * @brief Retrieve the table's call counters.
+     * @return A reference to the counters updated by the table's thunks.
+     */
+    call_counters& counters() noexcept;
+
+    /**
+     * @brief Attach a call_tracer to the table.
+     * @details While a tracer is attached, every call made through an instrumented command is timed and recorded
+     *          into it. Passing null detaches the current tracer. Multiple tables **MAY** share a tracer. This is safe
+     *          to call concurrently with calls through the table's thunks.
+     * @param tracer A pointer to the tracer to attach or null. The tracer **MUST** remain valid until it is detached
+     *               and all in-flight calls have returned.
+     */
+    void set_tracer(call_tracer *const tracer) noexcept;
+
+    /**
+     * @brief Retrieve the call_tracer attached to the table.
+     * @return A pointer to the attached tracer, or null if no tracer is attached.
+     */
+    call_tracer* tracer() const noexcept;
+
+    /**
+     * @brief Attach a set of latency_histograms to the table.
+     * @details While histograms are attached, every call made through an instrumented command is timed and recorded
+     *          into them. Passing null detaches the current histograms. Multiple tables **MAY** share histograms. This
+     *          is safe to call concurrently with calls through the table's thunks.
+     * @param histograms A pointer to the histograms to attach or null. The histograms **MUST** remain valid until they
+     *                   are detached and all in-flight calls have returned.
+     */
+    void set_histograms(latency_histograms *const histograms) noexcept;
+
+    /**
+     * @brief Retrieve the latency_histograms attached to the table.
+     * @return A pointer to the attached histograms, or null if no histograms are attached.
+     */
+    latency_histograms* histograms() const noexcept;
+
+    /**
+     * @brief Attach a call_site_profiler to the table.
+     * @details While a profiler is attached, every call made through an instrumented command is timed and attributed
+     *          to the code that made it. Passing null detaches the current profiler. Multiple tables **MAY** share a
+     *          profiler. This is safe to call concurrently with calls through the table's thunks.
+     * @param profiler A pointer to the profiler to attach or null. The profiler **MUST** remain valid until it is
+     *                 detached and all in-flight calls have returned.
+     */
+    void set_profiler(call_site_profiler *const profiler) noexcept;
+
+    /**
+     * @brief Retrieve the call_site_profiler attached to the table.
+     * @return A pointer to the attached profiler, or null if no profiler is attached.
+     */
+    call_site_profiler* profiler() const noexcept;
+
+    /**
+     * @brief Retrieve the ::VkInstance used to construct the table.
+     * @return The ::VkInstance handle that was used to construct the table.
+     */
+    VkInstance instance() const;
+
+    /**
+     * @brief Retrieve the ::VkDevice used to construct the table.
+     * @return The ::VkDevice handle that was used to construct the table if any. Null is returned in all other
+     *         cases.
+     */
+    VkDevice device() const;
+
+    /**
+     * @brief Retrieve the size of the table.
+     * @return The number of commands held in the table.
+     */
+    constexpr std::size_t size() const noexcept {
+      return MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT;
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* get(const command cmd) const {
+      if (static_cast<std::size_t>(cmd) >= size())
+      {
+        throw dispatch::error{ "The input command is outside the valid range of possible device commnds." };
+      }
+      return m_instrumentation.slot(static_cast<std::size_t>(cmd));
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* operator()(const command cmd) const {
+      return get(cmd);
+    }
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case dispatch::internal::base::fnv_1a_cstr(#name): return get(command::name);
+/// @endcond
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* get(const std::uint_least64_t hash) const noexcept {
+      switch (hash)
+      {
+      MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+      default:
+        return nullptr;
+      }
+    }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* operator()(const std::uint_least64_t hash) const noexcept {
+      return get(hash);
+    }
+  };
+
+}
+
+}
+
+#endif
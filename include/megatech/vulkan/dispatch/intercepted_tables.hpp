@@ -0,0 +1,419 @@
+/**
+ * @file intercepted_tables.hpp
+ * @brief Intercepted Vulkan Dispatch Tables
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERCEPTED_TABLES_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERCEPTED_TABLES_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <utility>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "commands.hpp"
+#include "tables.hpp"
+#include "policies.hpp"
+
+#include "internal/base/interception.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+namespace instance {
+
+  /**
+   * @brief An instance-level dispatch table that passes calls through a compile-time chain of policies.
+   * @details A policy is a default-constructible type with a member template of the form:
+   *          @code{.cpp}
+   *          template <command Cmd, typename Next, typename... Arguments>
+   *          decltype(auto) invoke(const Next& next, Arguments... arguments);
+   *          @endcode
+   *          `next(arguments...)` continues the chain and eventually calls the Vulkan command. A policy **MAY**
+   *          inspect or modify the arguments, act on the result, or return without calling `next` at all. Policies are
+   *          applied in the order they are listed, so the first policy is the outermost. Each policy type **MUST**
+   *          appear at most once.
+   *
+   *          Calls made through ::call() have the whole chain inlined at the call site. For code that retrieves
+   *          function pointers from the table, ::intercept() replaces an entry with a thunk into which the chain is
+   *          inlined instead. No policy is ever called through a function pointer. For example:
+   *          @code{.cpp}
+   *          auto iit = intercepted_table<counting_policy, tracing_policy>{ idt };
+   *          iit.call<command::vkEnumeratePhysicalDevices, PFN_vkEnumeratePhysicalDevices>(instance, &sz, nullptr);
+   *          const auto count = iit.policy<counting_policy>().counters().count(command::vkEnumeratePhysicalDevices);
+   *          @endcode
+   *
+   *          An intercepted_table with no policies binds no slot, never installs a thunk, and ::call() compiles to
+   *          the same load and indirect call as a plain table access. Builds can therefore select the policy list
+   *          with the preprocessor and pay nothing when interception is disabled.
+   *
+   *          When there is at least one policy, at most `MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS` tables with
+   *          the same policy list may exist at once.
+   * @tparam Policies The policies to apply, from outermost to innermost.
+   */
+  template <typename... Policies>
+  class intercepted_table final {
+  private:
+    VkInstance m_instance{ };
+    internal::base::interception<command, MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT, Policies...> m_interception;
+  public:
+    /**
+     * @brief Construct an intercepted table.
+     * @details Intercepted tables do not have an ownership relationship with the table they are constructed from.
+     *          The lifetime of `base` **MAY** end immediately after construction.
+     * @param base The table to intercept. The table shares ownership of the base table's ::VkInstance, and so it
+     *             **MUST** remain valid for the table's entire lifetime.
+     * @throw dispatch::error If there are no free interception slots.
+     */
+    explicit intercepted_table(const table& base) : m_instance{ base.instance() }, m_interception{ base } { }
+
+    /// @cond
+    intercepted_table(const intercepted_table& other) = delete;
+    intercepted_table(intercepted_table&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy an intercepted table.
+     */
+    ~intercepted_table() noexcept = default;
+
+    /// @cond
+    intercepted_table& operator=(const intercepted_table& rhs) = delete;
+    intercepted_table& operator=(intercepted_table&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Call a command through the policy chain.
+     * @tparam Cmd The ::command to call. The command **MUST NOT** have been resolved to null.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkEnumeratePhysicalDevices`).
+     * @param arguments The arguments of the call.
+     * @return The result of the call (or of the policy that short-circuited it).
+     */
+    template <command Cmd, internal::base::command_pointer Pointer, typename... Arguments>
+    decltype(auto) call(Arguments&&... arguments) {
+      return m_interception.template call<Cmd, Pointer>(MEGATECH_VULKAN_DISPATCH_RETURN_ADDRESS(),
+                                                         std::forward<Arguments>(arguments)...);
+    }
+
+    /**
+     * @brief Route calls to a command through a thunk that applies the policy chain.
+     * @details If the command was resolved to null, or if there are no policies, the entry is unchanged. This **MUST
+     *          NOT** be called concurrently with ::get().
+     * @tparam Cmd The ::command to intercept.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkEnumeratePhysicalDevices`).
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void intercept() {
+      m_interception.template intercept<Cmd, Pointer>();
+    }
+
+    /**
+     * @brief Restore a command's original function pointer.
+     * @details This **MUST NOT** be called concurrently with ::get().
+     * @tparam Cmd The ::command to restore.
+     */
+    template <command Cmd>
+    void restore() noexcept {
+      m_interception.template restore<Cmd>();
+    }
+
+    /**
+     * @brief Determine whether or not a command is intercepted.
+     * @param cmd The ::command to check.
+     * @return True if calls to `cmd` through retrieved function pointers are routed through a thunk. Otherwise false.
+     */
+    bool intercepted(const command cmd) const noexcept {
+      return m_interception.intercepted(cmd);
+    }
+
+    /**
+     * @brief Retrieve one of the table's policies.
+     * @tparam Policy The type of the policy to retrieve.
+     * @return A reference to the policy.
+     */
+    template <typename Policy>
+    const Policy& policy() const noexcept {
+      return m_interception.template policy<Policy>();
+    }
+
+    /**
+     * @brief Retrieve one of the table's policies.
+     * @tparam Policy The type of the policy to retrieve.
+     * @return A reference to the policy.
+     */
+    template <typename Policy>
+    Policy& policy() noexcept {
+      return m_interception.template policy<Policy>();
+    }
+
+    /**
+     * @brief Retrieve the ::VkInstance used to construct the table.
+     * @return The ::VkInstance handle that was used to construct the table.
+     */
+    VkInstance instance() const {
+      return m_instance;
+    }
+
+    /**
+     * @brief Retrieve the size of the table.
+     * @return The number of commands held in the table.
+     */
+    constexpr std::size_t size() const noexcept {
+      return MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT;
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* get(const command cmd) const {
+      if (static_cast<std::size_t>(cmd) >= size())
+      {
+        throw dispatch::error{ "The input command is outside the valid range of possible instance commnds." };
+      }
+      return m_interception.slot(static_cast<std::size_t>(cmd));
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* operator()(const command cmd) const {
+      return get(cmd);
+    }
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case dispatch::internal::base::fnv_1a_cstr(#name): return get(command::name);
+/// @endcond
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash A 64-bit FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* get(const std::uint_least64_t hash) const noexcept {
+      switch (hash)
+      {
+      MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_LIST
+      default:
+        return nullptr;
+      }
+    }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash A 64-bit FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* operator()(const std::uint_least64_t hash) const noexcept {
+      return get(hash);
+    }
+  };
+
+}
+
+namespace device {
+
+  /**
+   * @brief A device-level dispatch table that passes calls through a compile-time chain of policies.
+   * @tparam Policies The policies to apply, from outermost to innermost.
+   * @see instance::intercepted_table
+   */
+  template <typename... Policies>
+  class intercepted_table final {
+  private:
+    VkInstance m_instance{ };
+    VkDevice m_device{ };
+    internal::base::interception<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT, Policies...> m_interception;
+  public:
+    /**
+     * @brief Construct an intercepted table.
+     * @details Intercepted tables do not have an ownership relationship with the table they are constructed from.
+     *          The lifetime of `base` **MAY** end immediately after construction.
+     * @param base The table to intercept. The table shares ownership of the base table's ::VkInstance and
+     *             ::VkDevice, and so they **MUST** remain valid for the table's entire lifetime.
+     * @throw dispatch::error If there are no free interception slots.
+     */
+    explicit intercepted_table(const table& base) :
+    m_instance{ base.instance() }, m_device{ base.device() }, m_interception{ base } { }
+
+    /// @cond
+    intercepted_table(const intercepted_table& other) = delete;
+    intercepted_table(intercepted_table&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy an intercepted table.
+     */
+    ~intercepted_table() noexcept = default;
+
+    /// @cond
+    intercepted_table& operator=(const intercepted_table& rhs) = delete;
+    intercepted_table& operator=(intercepted_table&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Call a command through the policy chain.
+     * @tparam Cmd The ::command to call. The command **MUST NOT** have been resolved to null.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkCmdDraw`).
+     * @param arguments The arguments of the call.
+     * @return The result of the call (or of the policy that short-circuited it).
+     * @see instance::intercepted_table::call()
+     */
+    template <command Cmd, internal::base::command_pointer Pointer, typename... Arguments>
+    decltype(auto) call(Arguments&&... arguments) {
+      return m_interception.template call<Cmd, Pointer>(MEGATECH_VULKAN_DISPATCH_RETURN_ADDRESS(),
+                                                         std::forward<Arguments>(arguments)...);
+    }
+
+    /**
+     * @brief Route calls to a command through a thunk that applies the policy chain.
+     * @tparam Cmd The ::command to intercept.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkCmdDraw`).
+     * @see instance::intercepted_table::intercept()
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void intercept() {
+      m_interception.template intercept<Cmd, Pointer>();
+    }
+
+    /**
+     * @brief Restore a command's original function pointer.
+     * @tparam Cmd The ::command to restore.
+     * @see instance::intercepted_table::restore()
+     */
+    template <command Cmd>
+    void restore() noexcept {
+      m_interception.template restore<Cmd>();
+    }
+
+    /**
+     * @brief Determine whether or not a command is intercepted.
+     * @param cmd The ::command to check.
+     * @return True if calls to `cmd` through retrieved function pointers are routed through a thunk. Otherwise false.
+     */
+    bool intercepted(const command cmd) const noexcept {
+      return m_interception.intercepted(cmd);
+    }
+
+    /**
+     * @brief Retrieve one of the table's policies.
+     * @tparam Policy The type of the policy to retrieve.
+     * @return A reference to the policy.
+     */
+    template <typename Policy>
+    const Policy& policy() const noexcept {
+      return m_interception.template policy<Policy>();
+    }
+
+    /**
+     * @brief Retrieve one of the table's policies.
+     * @tparam Policy The type of the policy to retrieve.
+     * @return A reference to the policy.
+     */
+    template <typename Policy>
+    Policy& policy() noexcept {
+      return m_interception.template policy<Policy>();
+    }
+
+    /**
+     * @brief Retrieve the ::VkInstance used to construct the table.
+     * @return The ::VkInstance handle that was used to construct the table.
+     */
+    VkInstance instance() const {
+      return m_instance;
+    }
+
+    /**
+     * @brief Retrieve the ::VkDevice used to construct the table.
+     * @return The ::VkDevice handle that was used to construct the table if any. Null is returned in all other
+     *         cases.
+     */
+    VkDevice device() const {
+      return m_device;
+    }
+
+    /**
+     * @brief Retrieve the size of the table.
+     * @return The number of commands held in the table.
+     */
+    constexpr std::size_t size() const noexcept {
+      return MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT;
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* get(const command cmd) const {
+      if (static_cast<std::size_t>(cmd) >= size())
+      {
+        throw dispatch::error{ "The input command is outside the valid range of possible device commnds." };
+      }
+      return m_interception.slot(static_cast<std::size_t>(cmd));
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* operator()(const command cmd) const {
+      return get(cmd);
+    }
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case dispatch::internal::base::fnv_1a_cstr(#name): return get(command::name);
+/// @endcond
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* get(const std::uint_least64_t hash) const noexcept {
+      switch (hash)
+      {
+      MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+      default:
+        return nullptr;
+      }
+    }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* operator()(const std::uint_least64_t hash) const noexcept {
+      return get(hash);
+    }
+  };
+
+}
+
+}
+
+#endif
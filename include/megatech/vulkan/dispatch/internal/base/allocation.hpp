@@ -0,0 +1,82 @@
+/// @cond INTERNAL
+/**
+ * @file allocation.hpp
+ * @brief Host Allocation Helpers
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_ALLOCATION_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_ALLOCATION_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <string_view>
+
+#include "../../defs.hpp"
+#include "../../commands.hpp"
+
+#include "slots.hpp"
+#include "submissions.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The number of values of `VkSystemAllocationScope`.
+   */
+  inline constexpr std::size_t allocation_scopes{ 5 };
+
+  /**
+   * @brief The value of `VK_SYSTEM_ALLOCATION_SCOPE_COMMAND`.
+   */
+  inline constexpr std::size_t command_allocation_scope{ 0 };
+
+  /**
+   * @brief Determine whether or not a command accepts allocation callbacks.
+   * @details `vkAllocateCommandBuffers`, `vkAllocateDescriptorSets`, `vkFreeCommandBuffers`, and
+   *          `vkFreeDescriptorSets` are excluded. Their objects are allocated from pools, so they never receive
+   *          callbacks.
+   * @tparam Cmd The command to check.
+   * @return True if the name of `Cmd` begins with `vkCreate`, `vkDestroy`, `vkAllocate`, or `vkFree` and `Cmd` isn't
+   *         a pool child command. Otherwise false.
+   */
+  template <auto Cmd>
+  consteval bool allocates() {
+    const auto name = std::string_view{ to_string(Cmd) };
+    return (name.starts_with("vkCreate") || name.starts_with("vkDestroy") || name.starts_with("vkAllocate") ||
+            name.starts_with("vkFree")) && !named<Cmd>("vkAllocateCommandBuffers") &&
+           !named<Cmd>("vkAllocateDescriptorSets") && !named<Cmd>("vkFreeCommandBuffers") &&
+           !named<Cmd>("vkFreeDescriptorSets");
+  }
+
+  /**
+   * @brief The types involved in a host allocation callback.
+   * @tparam Pointer The function pointer type of the allocation callback (i.e., `PFN_vkAllocationFunction`).
+   */
+  template <command_pointer Pointer>
+  struct allocation_signature;
+
+  template <typename Scope>
+  struct allocation_signature<void* (MEGATECH_VULKAN_DISPATCH_API_PTR*)(void*, std::size_t, std::size_t,
+                                                                        Scope)> final {
+    using scope = Scope;
+  };
+
+  /**
+   * @brief The types involved in an internal allocation notification.
+   * @tparam Pointer The function pointer type of the notification (i.e., `PFN_vkInternalAllocationNotification`).
+   */
+  template <command_pointer Pointer>
+  struct notification_signature;
+
+  template <typename Type, typename Scope>
+  struct notification_signature<void (MEGATECH_VULKAN_DISPATCH_API_PTR*)(void*, std::size_t, Type, Scope)> final {
+    using type = Type;
+    using scope = Scope;
+  };
+
+}
+
+#endif
+/// @endcond
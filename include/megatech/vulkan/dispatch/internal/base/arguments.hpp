@@ -0,0 +1,94 @@
+/// @cond INTERNAL
+/**
+ * @file arguments.hpp
+ * @brief Vulkan Command Argument Encoding
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_ARGUMENTS_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_ARGUMENTS_HPP
+
+#include <cinttypes>
+
+#include <bit>
+#include <type_traits>
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief A concept describing types that are complete at the point of use.
+   */
+  template <typename Type>
+  concept complete = requires { sizeof(Type); };
+
+  /**
+   * @brief A concept describing Vulkan handle types.
+   * @details Dispatchable handles, and non-dispatchable handles on 64-bit platforms, are pointers to incomplete
+   *          structures (e.g., `VkDevice_T*`). Non-dispatchable handles on 32-bit platforms are plain integers and are
+   *          treated as such.
+   */
+  template <typename Type>
+  concept handle = std::is_pointer_v<Type> && std::is_class_v<std::remove_pointer_t<Type>> &&
+                   !complete<std::remove_pointer_t<Type>>;
+
+  /**
+   * @brief An enumeration of the kinds of encoded arguments.
+   */
+  enum class argument_kind : std::uint8_t {
+    integer,
+    floating,
+    handle,
+    pointer,
+    payload
+  };
+
+  /**
+   * @brief A single fixed-size encoded argument.
+   * @details Integers (including enumerations, flags, and booleans) are stored by value. Floating point values are
+   *          stored as the bits of a double. Handles are stored as their raw 64-bit value, which serves as the handle's
+   *          identity. For any other pointer, encode() only stores whether or not it was null.
+   *
+   *          Captured calls may instead store a pointer as a payload. Its value is the byte offset of a copy of the
+   *          pointed-to data within the record, which is immediately preceded by the 64-bit number of elements it
+   *          holds and its 64-bit size in bytes.
+   */
+  struct encoded_argument final {
+    argument_kind kind;
+    std::uint8_t reserved[7];
+    std::uint64_t value;
+  };
+
+  static_assert(sizeof(encoded_argument) == 16, "Encoded arguments must be tightly packed.");
+
+  template <typename Type>
+  encoded_argument encode(const Type value) noexcept {
+    auto result = encoded_argument{ };
+    if constexpr (handle<Type>)
+    {
+      result.kind = argument_kind::handle;
+      result.value = reinterpret_cast<std::uintptr_t>(value);
+    }
+    else if constexpr (std::is_pointer_v<Type>)
+    {
+      result.kind = argument_kind::pointer;
+      result.value = value != nullptr;
+    }
+    else if constexpr (std::is_floating_point_v<Type>)
+    {
+      result.kind = argument_kind::floating;
+      result.value = std::bit_cast<std::uint64_t>(static_cast<double>(value));
+    }
+    else
+    {
+      static_assert(std::is_integral_v<Type> || std::is_enum_v<Type>, "Arguments must be scalars or pointers.");
+      result.kind = argument_kind::integer;
+      result.value = static_cast<std::uint64_t>(value);
+    }
+    return result;
+  }
+
+}
+
+#endif
+/// @endcond
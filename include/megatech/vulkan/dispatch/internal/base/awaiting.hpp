@@ -0,0 +1,73 @@
+/// @cond INTERNAL
+/**
+ * @file awaiting.hpp
+ * @brief Asynchronous Waiting Helpers
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_AWAITING_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_AWAITING_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include "../../defs.hpp"
+
+#include "slots.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The types involved in `vkGetFenceStatus`.
+   * @tparam Pointer The function pointer type of the command (i.e., `PFN_vkGetFenceStatus`).
+   */
+  template <command_pointer Pointer>
+  struct fence_status_signature;
+
+  template <typename Result, typename Device, typename Fence>
+  struct fence_status_signature<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Device, Fence)> final {
+    using result = Result;
+    using device = Device;
+    using fence = Fence;
+  };
+
+  /**
+   * @brief The types involved in `vkWaitSemaphores`.
+   * @tparam Pointer The function pointer type of the command (i.e., `PFN_vkWaitSemaphores`).
+   */
+  template <command_pointer Pointer>
+  struct wait_semaphores_signature;
+
+  template <typename Result, typename Device, typename Info>
+  struct wait_semaphores_signature<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Device, const Info*,
+                                                                            std::uint64_t)> final {
+    using result = Result;
+    using device = Device;
+    using info = Info;
+  };
+
+  /**
+   * @brief The value of `VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO`.
+   */
+  inline constexpr std::int32_t semaphore_wait_info_type{ 1000207004 };
+
+  /**
+   * @brief The value of `VK_SEMAPHORE_WAIT_ANY_BIT`.
+   */
+  inline constexpr std::uint32_t semaphore_wait_any{ 0x1 };
+
+  /**
+   * @brief The value of `VK_NOT_READY`.
+   */
+  inline constexpr std::int32_t not_ready{ 1 };
+
+  /**
+   * @brief The value of `VK_TIMEOUT`.
+   */
+  inline constexpr std::int32_t timeout{ 2 };
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,85 @@
+/// @cond INTERNAL
+/**
+ * @file barriers.hpp
+ * @brief Pipeline Barrier Helpers
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_BARRIERS_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_BARRIERS_HPP
+
+#include <cinttypes>
+
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+
+#include "../../defs.hpp"
+#include "../../commands.hpp"
+
+#include "slots.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief Determine whether or not a command is recorded into a command buffer.
+   * @tparam Cmd The command to check.
+   * @return True if the name of `Cmd` begins with `vkCmd`. Otherwise false.
+   */
+  template <auto Cmd>
+  consteval bool recorded() {
+    return std::string_view{ to_string(Cmd) }.starts_with("vkCmd");
+  }
+
+  /**
+   * @brief The types involved in `vkCmdPipelineBarrier`.
+   * @tparam Pointer The function pointer type of the barrier command (i.e., `PFN_vkCmdPipelineBarrier`).
+   */
+  template <command_pointer Pointer>
+  struct barrier_signature;
+
+  template <typename CommandBuffer, typename Stages, typename Dependencies, typename Memory, typename Buffer,
+            typename Image>
+  struct barrier_signature<void (MEGATECH_VULKAN_DISPATCH_API_PTR*)(CommandBuffer, Stages, Stages, Dependencies,
+                                                                    std::uint32_t, const Memory*, std::uint32_t,
+                                                                    const Buffer*, std::uint32_t, const Image*)> final {
+    using command_buffer = CommandBuffer;
+    using stages = Stages;
+    using dependencies = Dependencies;
+    using memory_barrier = Memory;
+    using buffer_barrier = Buffer;
+    using image_barrier = Image;
+  };
+
+  /**
+   * @brief The types involved in `vkCmdPipelineBarrier2`.
+   * @tparam Pointer The function pointer type of the barrier command (i.e., `PFN_vkCmdPipelineBarrier2`).
+   */
+  template <command_pointer Pointer>
+  struct barrier2_signature;
+
+  template <typename CommandBuffer, typename Info>
+  struct barrier2_signature<void (MEGATECH_VULKAN_DISPATCH_API_PTR*)(CommandBuffer, const Info*)> final {
+    using command_buffer = CommandBuffer;
+    using dependency_info = Info;
+    using memory_barrier = std::remove_cv_t<std::remove_pointer_t<decltype(Info{ }.pMemoryBarriers)>>;
+    using buffer_barrier = std::remove_cv_t<std::remove_pointer_t<decltype(Info{ }.pBufferMemoryBarriers)>>;
+    using image_barrier = std::remove_cv_t<std::remove_pointer_t<decltype(Info{ }.pImageMemoryBarriers)>>;
+  };
+
+  /**
+   * @brief Determine whether or not any element of an array extends a `pNext` chain.
+   * @param elements The array to check. This **MAY** be null if `count` is 0.
+   * @param count The number of elements in `elements`.
+   * @return True if any element's `pNext` isn't null. Otherwise false.
+   */
+  template <typename Element>
+  bool any_chained(const Element *const elements, const std::uint32_t count) noexcept {
+    return std::any_of(elements, elements + count, [](const Element& element) { return element.pNext != nullptr; });
+  }
+
+}
+
+#endif
+/// @endcond
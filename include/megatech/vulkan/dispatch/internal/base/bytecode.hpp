@@ -0,0 +1,176 @@
+/// @cond INTERNAL
+/**
+ * @file bytecode.hpp
+ * @brief Deferred Command Bytecode Encoding
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_BYTECODE_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_BYTECODE_HPP
+
+#include <cstddef>
+#include <cinttypes>
+#include <cstring>
+
+#include <array>
+#include <type_traits>
+#include <utility>
+
+#include "../../defs.hpp"
+#include "../../error.hpp"
+#include "../../commands.hpp"
+
+#include "arguments.hpp"
+#include "payloads.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The type of a function that decodes an instruction and calls its command.
+   * @details The first argument is a pointer to the command's function pointer (i.e., the result of a table's `get()`).
+   *          The second argument is the command buffer to record into.
+   */
+  using replay_function = void (*)(const void*, void*, const std::byte*);
+
+  /**
+   * @brief The header of an encoded command.
+   * @details A header is followed by one 8-byte word per argument (excluding the command buffer) and then by the
+   *          payloads of any pointer arguments. Scalars and handles are stored in their word. Pointer words hold the
+   *          offset of their payload, in words, from the start of the instruction, or zero for null pointers. Each
+   *          payload is followed by the payloads of its nested pointer members, which are rewritten to refer to them.
+   */
+  struct instruction final {
+    replay_function replay;
+    std::uint32_t words;
+    std::uint16_t command;
+    std::uint16_t arguments;
+  };
+
+  /**
+   * @brief The size of an instruction header in 8-byte words.
+   */
+  inline constexpr std::size_t instruction_words{ (sizeof(instruction) + sizeof(std::uint64_t) - 1) /
+                                                  sizeof(std::uint64_t) };
+
+  /**
+   * @brief Determine whether or not every argument of a command can be encoded.
+   * @tparam Cmd The command to check.
+   * @tparam Arguments The parameter types of the command, excluding the command buffer.
+   * @return True if every argument of `Cmd` is copyable(). Otherwise false.
+   */
+  template <auto Cmd, typename... Arguments>
+  consteval bool encodable() {
+    for (const auto current : copyable<Cmd, Arguments...>())
+    {
+      if (!current)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Compute the size of an encoded call.
+   * @param extents The payload extents of the call's arguments.
+   * @return The size, in 8-byte words, of the call's instruction.
+   */
+  template <std::size_t Count>
+  constexpr std::size_t instruction_size(const std::array<payload_extent, Count>& extents) noexcept {
+    auto result = instruction_words + Count;
+    for (const auto& extent : extents)
+    {
+      result += words_of(extent.bytes);
+    }
+    return result;
+  }
+
+  /**
+   * @brief Encode a call.
+   * @param destination The storage of the instruction. This **MUST** be 8-byte aligned and hold at least
+   *                    `instruction_size(extents)` words.
+   * @param header The instruction's header. Its `words` and `arguments` members are overwritten.
+   * @param extents The payload extents of the call's arguments.
+   * @param arguments The arguments of the call, excluding the command buffer.
+   */
+  template <typename... Arguments>
+  void encode_instruction(std::byte *const destination, instruction header,
+                          const std::array<payload_extent, sizeof...(Arguments)>& extents,
+                          const Arguments... arguments) {
+    header.words = static_cast<std::uint32_t>(instruction_size(extents));
+    header.arguments = static_cast<std::uint16_t>(sizeof...(Arguments));
+    std::memcpy(destination, &header, sizeof(header));
+    auto index = std::size_t{ 0 };
+    auto payload = instruction_words + sizeof...(Arguments);
+    const auto write = [&]<typename Type>(const Type value) {
+      auto word = std::uint64_t{ };
+      if constexpr (std::is_pointer_v<Type> && !handle<Type>)
+      {
+        if (value)
+        {
+          word = payload;
+          copy_payload(destination + payload * sizeof(std::uint64_t), value, extents[index]);
+          payload += words_of(extents[index].bytes);
+        }
+      }
+      else
+      {
+        static_assert(sizeof(Type) <= sizeof(word), "Scalar arguments must fit in a single word.");
+        std::memcpy(&word, &value, sizeof(Type));
+      }
+      std::memcpy(destination + (instruction_words + index) * sizeof(std::uint64_t), &word, sizeof(word));
+      ++index;
+    };
+    (write(arguments), ...);
+  }
+
+  /**
+   * @brief Decode a single argument of an instruction.
+   * @tparam Type The type of the argument.
+   * @param source The instruction.
+   * @param index The index of the argument, excluding the command buffer.
+   * @return The decoded argument. Pointers refer to payloads within `source`.
+   */
+  template <typename Type>
+  Type decode_argument(const std::byte *const source, const std::size_t index) noexcept {
+    auto word = std::uint64_t{ };
+    std::memcpy(&word, source + (instruction_words + index) * sizeof(std::uint64_t), sizeof(word));
+    if constexpr (std::is_pointer_v<Type> && !handle<Type>)
+    {
+      return word ? reinterpret_cast<Type>(source + word * sizeof(std::uint64_t)) : nullptr;
+    }
+    else
+    {
+      auto value = Type{ };
+      std::memcpy(&value, &word, sizeof(Type));
+      return value;
+    }
+  }
+
+  /**
+   * @brief Decode an instruction and call its command.
+   * @tparam CommandBuffer The command buffer handle type (i.e., `VkCommandBuffer`).
+   * @tparam Arguments The remaining parameter types of the command.
+   * @param slot A pointer to the command's function pointer.
+   * @param target The command buffer to record into.
+   * @param source The instruction.
+   * @throw dispatch::error If the command was resolved to null.
+   */
+  template <typename CommandBuffer, typename... Arguments>
+  void replay_instruction(const void *const slot, void *const target, const std::byte *const source) {
+    using pointer = void (MEGATECH_VULKAN_DISPATCH_API_PTR*)(CommandBuffer, Arguments...);
+    const auto pfn = slot ? *static_cast<const pointer*>(slot) : nullptr;
+    if (!pfn)
+    {
+      throw dispatch::error{ "A command that was resolved to null cannot be replayed." };
+    }
+    [&]<std::size_t... Indices>(std::index_sequence<Indices...>) {
+      pfn(static_cast<CommandBuffer>(target), decode_argument<Arguments>(source, Indices)...);
+    }(std::index_sequence_for<Arguments...>{ });
+  }
+
+}
+
+#endif
+/// @endcond
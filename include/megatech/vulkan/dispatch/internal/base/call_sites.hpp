@@ -0,0 +1,64 @@
+/// @cond INTERNAL
+/**
+ * @file call_sites.hpp
+ * @brief Call Site Propagation
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_CALL_SITES_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_CALL_SITES_HPP
+
+/**
+ * @def MEGATECH_VULKAN_DISPATCH_RETURN_ADDRESS
+ * @brief Retrieve the return address of the current function.
+ */
+#if defined(_MSC_VER) && !defined(__clang__)
+  #include <intrin.h>
+  #define MEGATECH_VULKAN_DISPATCH_RETURN_ADDRESS() (_ReturnAddress())
+#else
+  #define MEGATECH_VULKAN_DISPATCH_RETURN_ADDRESS() (__builtin_return_address(0))
+#endif
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The call site of the innermost intercepted call on the current thread, or null.
+   */
+  inline thread_local const void* current_call_site{ };
+
+  /**
+   * @brief A concept describing interception policies that consume call sites.
+   * @details Interception only publishes call sites when at least one policy of the chain satisfies this concept.
+   *          Otherwise, no thread-local storage is touched.
+   */
+  template <typename Type>
+  concept call_site_consumer = Type::consumes_call_sites;
+
+  /**
+   * @brief A scope that publishes a call site for the duration of an intercepted call.
+   * @details Scopes nest, so intercepted calls made by policies restore the outer call site when they return.
+   */
+  class call_site_scope final {
+  private:
+    const void* m_previous{ current_call_site };
+  public:
+    explicit call_site_scope(const void *const site) noexcept {
+      current_call_site = site;
+    }
+
+    call_site_scope(const call_site_scope& other) = delete;
+    call_site_scope(call_site_scope&& other) = delete;
+
+    ~call_site_scope() noexcept {
+      current_call_site = m_previous;
+    }
+
+    call_site_scope& operator=(const call_site_scope& rhs) = delete;
+    call_site_scope& operator=(call_site_scope&& rhs) = delete;
+  };
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,315 @@
+/// @cond INTERNAL
+/**
+ * @file deduplication.hpp
+ * @brief Immutable Object Keys
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_DEDUPLICATION_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_DEDUPLICATION_HPP
+
+#include <cstddef>
+#include <cinttypes>
+#include <cstring>
+
+#include <array>
+#include <type_traits>
+
+#include "../../defs.hpp"
+#include "../../commands.hpp"
+
+#include "query_cache.hpp"
+#include "submissions.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The number of kinds of objects that can be deduplicated.
+   */
+  inline constexpr std::size_t object_kinds{ 4 };
+
+  /**
+   * @brief Determine which kind of object a command creates.
+   * @tparam Cmd The command to check.
+   * @return The index of the kind of object created by `Cmd`, or object_kinds if `Cmd` isn't `vkCreateShaderModule`,
+   *         `vkCreateSampler`, `vkCreateDescriptorSetLayout`, or `vkCreatePipelineLayout`.
+   */
+  template <auto Cmd>
+  consteval std::size_t created_kind() {
+    if (named<Cmd>("vkCreateShaderModule"))
+    {
+      return 0;
+    }
+    if (named<Cmd>("vkCreateSampler"))
+    {
+      return 1;
+    }
+    if (named<Cmd>("vkCreateDescriptorSetLayout"))
+    {
+      return 2;
+    }
+    if (named<Cmd>("vkCreatePipelineLayout"))
+    {
+      return 3;
+    }
+    return object_kinds;
+  }
+
+  /**
+   * @brief Determine which kind of object a command destroys.
+   * @tparam Cmd The command to check.
+   * @return The index of the kind of object destroyed by `Cmd`, or object_kinds if `Cmd` doesn't destroy an object
+   *         that can be deduplicated. Indices match created_kind().
+   */
+  template <auto Cmd>
+  consteval std::size_t destroyed_kind() {
+    if (named<Cmd>("vkDestroyShaderModule"))
+    {
+      return 0;
+    }
+    if (named<Cmd>("vkDestroySampler"))
+    {
+      return 1;
+    }
+    if (named<Cmd>("vkDestroyDescriptorSetLayout"))
+    {
+      return 2;
+    }
+    if (named<Cmd>("vkDestroyPipelineLayout"))
+    {
+      return 3;
+    }
+    return object_kinds;
+  }
+
+  /**
+   * @brief Convert the identity of a handle back to a handle.
+   * @tparam Type The handle type.
+   * @param value The raw 64-bit value of the handle, as produced by encode().
+   * @return The handle.
+   */
+  template <typename Type>
+  Type decode_handle(const std::uint64_t value) noexcept {
+    if constexpr (std::is_pointer_v<Type>)
+    {
+      return reinterpret_cast<Type>(static_cast<std::uintptr_t>(value));
+    }
+    else
+    {
+      return static_cast<Type>(value);
+    }
+  }
+
+  // These mirror the layouts of the chained structures that immutable object keys understand. Every Vulkan structure
+  // begins with the same header as VkBaseInStructure.
+  struct chain_header final {
+    std::int32_t type;
+    const void* next;
+  };
+
+  struct chained_reduction_mode final {
+    chain_header header;
+    std::int32_t mode;
+  };
+
+  struct chained_conversion final {
+    chain_header header;
+    std::uint64_t conversion;
+  };
+
+  struct chained_border_color final {
+    chain_header header;
+    std::array<std::uint32_t, 4> color;
+    std::int32_t format;
+  };
+
+  struct chained_binding_flags final {
+    chain_header header;
+    std::uint32_t count;
+    const std::uint32_t* flags;
+  };
+
+  /**
+   * @brief The value of `VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO`.
+   */
+  inline constexpr std::int32_t sampler_reduction_mode_type{ 1000130001 };
+
+  /**
+   * @brief The value of `VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO`.
+   */
+  inline constexpr std::int32_t sampler_conversion_type{ 1000156001 };
+
+  /**
+   * @brief The value of `VK_STRUCTURE_TYPE_SAMPLER_CUSTOM_BORDER_COLOR_CREATE_INFO_EXT`.
+   */
+  inline constexpr std::int32_t sampler_border_color_type{ 1000287000 };
+
+  /**
+   * @brief The value of `VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO`.
+   */
+  inline constexpr std::int32_t binding_flags_type{ 1000161000 };
+
+  /**
+   * @brief Append the contents of a `pNext` chain to a key.
+   * @details Only `VkSamplerReductionModeCreateInfo`, `VkSamplerYcbcrConversionInfo`,
+   *          `VkSamplerCustomBorderColorCreateInfoEXT`, and `VkDescriptorSetLayoutBindingFlagsCreateInfo` are
+   *          understood. The layout of any other structure is unknown, so it can't be compared by content.
+   * @param key The key to append to.
+   * @param next The first structure of the chain or null.
+   * @return True if every structure in the chain was appended. False if the chain contains an unknown structure.
+   */
+  inline bool write_chain(query_key& key, const void* next) {
+    while (next)
+    {
+      auto header = chain_header{ };
+      std::memcpy(&header, next, sizeof(header));
+      key.write(header.type);
+      switch (header.type)
+      {
+      case sampler_reduction_mode_type:
+        {
+          auto chained = chained_reduction_mode{ };
+          std::memcpy(&chained, next, sizeof(chained));
+          key.write(chained.mode);
+        }
+        break;
+      case sampler_conversion_type:
+        {
+          auto chained = chained_conversion{ };
+          std::memcpy(&chained, next, sizeof(chained));
+          key.write(chained.conversion);
+        }
+        break;
+      case sampler_border_color_type:
+        {
+          auto chained = chained_border_color{ };
+          std::memcpy(&chained, next, sizeof(chained));
+          key.write(chained.color.data(), chained.color.size());
+          key.write(chained.format);
+        }
+        break;
+      case binding_flags_type:
+        {
+          auto chained = chained_binding_flags{ };
+          std::memcpy(&chained, next, sizeof(chained));
+          key.write(chained.flags, chained.count);
+        }
+        break;
+      default:
+        return false;
+      }
+      next = header.next;
+    }
+    return true;
+  }
+
+  /**
+   * @brief The kind of samplers. This matches created_kind().
+   */
+  inline constexpr std::size_t sampler_kind{ 1 };
+
+  /**
+   * @brief The kind of descriptor set layouts. This matches created_kind().
+   */
+  inline constexpr std::size_t set_layout_kind{ 2 };
+
+  /**
+   * @brief Append everything that determines the object created by a call to a key.
+   * @details Keys include the device, the allocation callbacks (by address), the created object's type, and the full
+   *          contents of the creation structure: SPIR-V code, bindings, immutable samplers, set layouts, push constant
+   *          ranges, and every supported structure in the `pNext` chain (see write_chain()).
+   *
+   *          Immutable samplers and set layouts are written by `resolve`, which appends the key of the object that a
+   *          handle refers to. Handles can be reused once their objects are destroyed, so they can't identify content
+   *          on their own.
+   * @tparam Cmd The called command. created_kind() **MUST** be less than object_kinds for this command.
+   * @tparam Resolve The type of `resolve`. It **MUST** accept an object kind, a handle's identity (see encode()), and
+   *                 a key, and return a `bool`.
+   * @param key The key to append to.
+   * @param device The device that creates the object.
+   * @param info The creation structure of the object.
+   * @param allocator The allocation callbacks of the call or null.
+   * @param resolve A function that appends the key of a referenced object to a key. It returns false if the object's
+   *                key is unknown.
+   * @return True if the key was written. False if the call can't be deduplicated.
+   */
+  template <auto Cmd, typename Device, typename Info, typename Allocator, typename Resolve>
+  bool write_create_info(query_key& key, const Device device, const Info *const info, const Allocator *const allocator,
+                         const Resolve& resolve) {
+    static_assert(created_kind<Cmd>() < object_kinds, "Only immutable object creation can be deduplicated.");
+    key.write(device);
+    key.write(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(allocator)));
+    key.write(Cmd);
+    if (!info || !write_chain(key, info->pNext))
+    {
+      return false;
+    }
+    key.write(info->flags);
+    if constexpr (named<Cmd>("vkCreateShaderModule"))
+    {
+      key.write(info->pCode, info->codeSize / sizeof(*info->pCode));
+    }
+    else if constexpr (named<Cmd>("vkCreateSampler"))
+    {
+      key.write(info->magFilter);
+      key.write(info->minFilter);
+      key.write(info->mipmapMode);
+      key.write(info->addressModeU);
+      key.write(info->addressModeV);
+      key.write(info->addressModeW);
+      key.write(info->mipLodBias);
+      key.write(info->anisotropyEnable);
+      key.write(info->maxAnisotropy);
+      key.write(info->compareEnable);
+      key.write(info->compareOp);
+      key.write(info->minLod);
+      key.write(info->maxLod);
+      key.write(info->borderColor);
+      key.write(info->unnormalizedCoordinates);
+    }
+    else if constexpr (named<Cmd>("vkCreateDescriptorSetLayout"))
+    {
+      key.write(info->bindingCount);
+      for (auto i = std::uint32_t{ 0 }; i < info->bindingCount; ++i)
+      {
+        const auto& binding = info->pBindings[i];
+        key.write(binding.binding);
+        key.write(binding.descriptorType);
+        key.write(binding.descriptorCount);
+        key.write(binding.stageFlags);
+        key.write(binding.pImmutableSamplers != nullptr);
+        for (auto j = std::uint32_t{ 0 }; binding.pImmutableSamplers && j < binding.descriptorCount; ++j)
+        {
+          if (!resolve(sampler_kind, encode(binding.pImmutableSamplers[j]).value, key))
+          {
+            return false;
+          }
+        }
+      }
+    }
+    else
+    {
+      key.write(info->setLayoutCount);
+      for (auto i = std::uint32_t{ 0 }; i < info->setLayoutCount; ++i)
+      {
+        // Null set layouts are valid with VK_EXT_graphics_pipeline_library. They're distinct from any known key.
+        const auto set_layout = encode(info->pSetLayouts[i]).value;
+        if (!set_layout)
+        {
+          key.write(std::uint64_t{ 0 });
+        }
+        else if (!resolve(set_layout_kind, set_layout, key))
+        {
+          return false;
+        }
+      }
+      key.write(info->pPushConstantRanges, info->pushConstantRangeCount);
+    }
+    return true;
+  }
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,84 @@
+/// @cond INTERNAL
+/**
+ * @file descriptors.hpp
+ * @brief Descriptor Update Helpers
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_DESCRIPTORS_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_DESCRIPTORS_HPP
+
+#include <cinttypes>
+
+#include <type_traits>
+
+#include "../../defs.hpp"
+
+#include "slots.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The types involved in a descriptor update command.
+   * @tparam Pointer The function pointer type of the update command (e.g., `PFN_vkUpdateDescriptorSets`).
+   */
+  template <command_pointer Pointer>
+  struct update_signature;
+
+  template <typename Device, typename Write, typename Copy>
+  struct update_signature<void (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Device, std::uint32_t, const Write*, std::uint32_t,
+                                                                   const Copy*)> final {
+    using device = Device;
+    using write = Write;
+    using copy = Copy;
+    using image_info = std::remove_cv_t<std::remove_pointer_t<decltype(Write{ }.pImageInfo)>>;
+    using buffer_info = std::remove_cv_t<std::remove_pointer_t<decltype(Write{ }.pBufferInfo)>>;
+    using texel_view = std::remove_cv_t<std::remove_pointer_t<decltype(Write{ }.pTexelBufferView)>>;
+  };
+
+  /**
+   * @brief The array that holds the descriptors of a write.
+   */
+  enum class descriptor_payload : std::uint8_t {
+    none,
+    image,
+    buffer,
+    texel_view
+  };
+
+  /**
+   * @brief Determine which array holds the descriptors of a write.
+   * @details Only the core descriptor types are classified. Other types (e.g., inline uniform blocks and acceleration
+   *          structures) are written through a `pNext` chain and are reported as descriptor_payload::none.
+   * @param type A `VkDescriptorType`.
+   * @return The array that `type` reads from.
+   */
+  template <typename Type>
+  constexpr descriptor_payload payload_of(const Type type) noexcept {
+    // These are the values of VK_DESCRIPTOR_TYPE_SAMPLER through VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT.
+    switch (static_cast<std::int64_t>(type))
+    {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+    case 10:
+      return descriptor_payload::image;
+    case 4:
+    case 5:
+      return descriptor_payload::texel_view;
+    case 6:
+    case 7:
+    case 8:
+    case 9:
+      return descriptor_payload::buffer;
+    default:
+      return descriptor_payload::none;
+    }
+  }
+
+}
+
+#endif
+/// @endcond
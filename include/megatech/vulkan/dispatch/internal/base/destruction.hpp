@@ -0,0 +1,59 @@
+/// @cond INTERNAL
+/**
+ * @file destruction.hpp
+ * @brief Deferred Destruction Helpers
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_DESTRUCTION_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_DESTRUCTION_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <string_view>
+
+#include "../../defs.hpp"
+#include "../../commands.hpp"
+
+#include "slots.hpp"
+#include "submissions.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief Determine whether or not a command's effects can be deferred until the device is done with its arguments.
+   * @details `vkFreeCommandBuffers` and `vkFreeDescriptorSets` are excluded. Their pools are externally synchronized,
+   *          so freeing their children from another thread would race with the thread that owns the pool, and the
+   *          children would be freed twice if the pool were reset or destroyed first.
+   * @tparam Cmd The command to check.
+   * @return True if the name of `Cmd` begins with `vkDestroy` or `vkFree` and `Cmd` isn't `vkDestroyDevice`,
+   *         `vkFreeCommandBuffers`, or `vkFreeDescriptorSets`. Otherwise false.
+   */
+  template <auto Cmd>
+  consteval bool destroys() {
+    const auto name = std::string_view{ to_string(Cmd) };
+    return (name.starts_with("vkDestroy") || name.starts_with("vkFree")) && !named<Cmd>("vkDestroyDevice") &&
+           !named<Cmd>("vkFreeCommandBuffers") && !named<Cmd>("vkFreeDescriptorSets");
+  }
+
+  /**
+   * @brief The types involved in `vkGetSemaphoreCounterValue`.
+   * @tparam Pointer The function pointer type of the command (i.e., `PFN_vkGetSemaphoreCounterValue`).
+   */
+  template <command_pointer Pointer>
+  struct counter_value_signature;
+
+  template <typename Result, typename Device, typename Semaphore>
+  struct counter_value_signature<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Device, Semaphore,
+                                                                            std::uint64_t*)> final {
+    using result = Result;
+    using device = Device;
+    using semaphore = Semaphore;
+  };
+
+}
+
+#endif
+/// @endcond
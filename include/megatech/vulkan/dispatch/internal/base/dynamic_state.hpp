@@ -0,0 +1,134 @@
+/// @cond INTERNAL
+/**
+ * @file dynamic_state.hpp
+ * @brief Command Buffer State Tracking Helpers
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_DYNAMIC_STATE_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_DYNAMIC_STATE_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <array>
+#include <string_view>
+#include <type_traits>
+
+#include "../../defs.hpp"
+#include "../../commands.hpp"
+
+#include "arguments.hpp"
+#include "query_cache.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The commands whose effects are tracked by state filters.
+   * @details Extension aliases (e.g., `vkCmdSetCullModeEXT`) are tracked as their core command. The first four
+   *          commands are bindings. The remainder set dynamic state.
+   */
+  inline constexpr auto filtered_commands = std::array<std::string_view, 25>{
+    "vkCmdBindPipeline", "vkCmdBindDescriptorSets", "vkCmdBindVertexBuffers", "vkCmdBindIndexBuffer",
+    "vkCmdSetViewport", "vkCmdSetScissor", "vkCmdSetLineWidth", "vkCmdSetDepthBias", "vkCmdSetBlendConstants",
+    "vkCmdSetDepthBounds", "vkCmdSetStencilCompareMask", "vkCmdSetStencilWriteMask", "vkCmdSetStencilReference",
+    "vkCmdSetCullMode", "vkCmdSetFrontFace", "vkCmdSetPrimitiveTopology", "vkCmdSetDepthTestEnable",
+    "vkCmdSetDepthWriteEnable", "vkCmdSetDepthCompareOp", "vkCmdSetDepthBoundsTestEnable",
+    "vkCmdSetStencilTestEnable", "vkCmdSetStencilOp", "vkCmdSetRasterizerDiscardEnable", "vkCmdSetDepthBiasEnable",
+    "vkCmdSetPrimitiveRestartEnable"
+  };
+
+  /**
+   * @brief The number of state slots required to track a command buffer.
+   * @details `vkCmdBindPipeline` and `vkCmdBindDescriptorSets` are tracked separately for graphics, compute, and every
+   *          other bind point.
+   */
+  inline constexpr std::size_t filtered_slots{ filtered_commands.size() + 4 };
+
+  /**
+   * @brief The number of slots that are selected by a bind point.
+   */
+  inline constexpr std::size_t bind_point_slots{ 6 };
+
+  /**
+   * @brief The number of slots that track bindings rather than dynamic state.
+   */
+  inline constexpr std::size_t binding_slots{ bind_point_slots + 2 };
+
+  /**
+   * @brief Find the slot that tracks a command.
+   * @tparam Cmd The command to find.
+   * @return The index of the first slot that tracks `Cmd`, or ::filtered_slots if `Cmd` isn't tracked.
+   */
+  template <auto Cmd>
+  consteval std::size_t filtered_slot() {
+    auto name = std::string_view{ to_string(Cmd) };
+    if (name.ends_with("EXT"))
+    {
+      name.remove_suffix(3);
+    }
+    for (auto i = std::size_t{ 0 }; i < filtered_commands.size(); ++i)
+    {
+      if (filtered_commands[i] == name)
+      {
+        return i < 2 ? i * 3 : i + 4;
+      }
+    }
+    return filtered_slots;
+  }
+
+  /**
+   * @brief Determine whether or not a command invalidates the tracked state of a command buffer.
+   * @details This is conservative. Any command that binds, pushes, or inherits state that isn't tracked exactly, or that
+   *          leaves state undefined, invalidates everything.
+   * @tparam Cmd The command to check.
+   * @return True if `Cmd` invalidates tracked state. Otherwise false.
+   */
+  template <auto Cmd>
+  consteval bool invalidates_state() {
+    const auto name = std::string_view{ to_string(Cmd) };
+    if (filtered_slot<Cmd>() < filtered_slots)
+    {
+      return false;
+    }
+    return name == "vkBeginCommandBuffer" || name == "vkResetCommandBuffer" || name == "vkEndCommandBuffer" ||
+           name.starts_with("vkCmdBind") || name.starts_with("vkCmdPushDescriptor") ||
+           name.starts_with("vkCmdSetDescriptorBuffer") || name.starts_with("vkCmdExecute") ||
+           name.starts_with("vkCmdSetDepthBias") || name.find("WithCount") != std::string_view::npos;
+  }
+
+  /**
+   * @brief Serialize the arguments of a filtered command.
+   * @details Pointer arguments are serialized by content. Their length is taken from the nearest preceding `uint32_t`
+   *          argument, which is how every tracked command passes array lengths, except for `vkCmdSetBlendConstants`
+   *          which always passes four values.
+   * @tparam Cmd The command being serialized.
+   * @param key The key to append to.
+   * @param arguments The arguments of the call, excluding the command buffer.
+   */
+  template <auto Cmd, typename... Arguments>
+  void serialize_state(query_key& key, const Arguments... arguments) {
+    constexpr auto constants = std::string_view{ to_string(Cmd) } == "vkCmdSetBlendConstants";
+    auto count = std::size_t{ constants ? 4U : 0U };
+    const auto write = [&]<typename Type>(const Type value) {
+      if constexpr (std::is_pointer_v<Type> && !handle<Type>)
+      {
+        key.write(value, value ? count : 0);
+      }
+      else
+      {
+        key.write(value);
+        if constexpr (std::is_same_v<Type, std::uint32_t>)
+        {
+          count = value;
+        }
+      }
+    };
+    (write(arguments), ...);
+  }
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,196 @@
+/// @cond INTERNAL
+/**
+ * @file hooks.hpp
+ * @brief Generic Hooked Dispatch Table Implementation
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_HOOKS_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_HOOKS_HPP
+
+#include <cstddef>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../../defs.hpp"
+#include "../../error.hpp"
+
+#include "probes.hpp"
+#include "slots.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The types of the callbacks that may be attached to a Vulkan command.
+   * @details Pre-call hooks receive the call's arguments. Post-call hooks receive the call's result (if it has one)
+   *          followed by the call's arguments.
+   * @tparam Pointer The function pointer type of the hooked command.
+   */
+  template <command_pointer Pointer>
+  struct hook_signature;
+
+  template <typename Result, typename... Arguments>
+  struct hook_signature<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)> final {
+    using pre = std::function<void(Arguments...)>;
+    using post = std::function<void(Result, Arguments...)>;
+  };
+
+  template <typename... Arguments>
+  struct hook_signature<void (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)> final {
+    using pre = std::function<void(Arguments...)>;
+    using post = std::function<void(Arguments...)>;
+  };
+
+  /**
+   * @brief The common implementation of hooked dispatch tables.
+   * @details A command only receives a thunk once a hook is attached to it. Every other entry remains the function
+   *          pointer resolved by the base table. Each live hooked table binds itself to one of a fixed number of
+   *          global slots, which is how its thunks find their hooks.
+   * @tparam Command The command enumeration type of the level being hooked.
+   * @tparam Count The number of commands at the level being hooked.
+   */
+  template <typename Command, std::size_t Count>
+  class hooks final {
+  private:
+    using bindings = slots<hooks>;
+
+    class list_base {
+    public:
+      virtual ~list_base() noexcept = default;
+    };
+
+    template <typename Result, typename... Arguments>
+    class list final : public list_base {
+    public:
+      using signature = hook_signature<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)>;
+
+      std::vector<typename signature::pre> pre{ };
+      std::vector<typename signature::post> post{ };
+    };
+
+    std::array<PFN_vkVoidFunction, Count> m_pfns{ };
+    std::array<PFN_vkVoidFunction, Count> m_targets{ };
+    std::array<std::unique_ptr<list_base>, Count> m_lists{ };
+    std::size_t m_slot{ bindings::count };
+
+    template <std::size_t Slot, Command Cmd, typename Result, typename... Arguments>
+    static MEGATECH_VULKAN_DISPATCH_API_ATTR Result MEGATECH_VULKAN_DISPATCH_API_CALL thunk(Arguments... arguments) {
+      using pointer = Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...);
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      MEGATECH_VULKAN_DISPATCH_PROBE_SCOPE(Cmd, arguments...);
+      const auto self = bindings::template get<Slot>();
+      const auto& current = static_cast<const list<Result, Arguments...>&>(*self->m_lists[index]);
+      for (const auto& hook : current.pre)
+      {
+        hook(arguments...);
+      }
+      const auto target = reinterpret_cast<pointer>(self->m_targets[index]);
+      if constexpr (std::is_void_v<Result>)
+      {
+        target(arguments...);
+        for (const auto& hook : current.post)
+        {
+          hook(arguments...);
+        }
+      }
+      else
+      {
+        const auto result = target(arguments...);
+        for (const auto& hook : current.post)
+        {
+          hook(result, arguments...);
+        }
+        return result;
+      }
+    }
+
+    template <Command Cmd, typename Result, typename... Arguments>
+    list<Result, Arguments...>* acquire(Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)) {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The hooked command must be valid.");
+      static const auto thunks = []<std::size_t... Slots>(std::index_sequence<Slots...>) {
+        return std::array<PFN_vkVoidFunction, bindings::count>{
+          reinterpret_cast<PFN_vkVoidFunction>(&thunk<Slots, Cmd, Result, Arguments...>)...
+        };
+      }(std::make_index_sequence<bindings::count>{});
+      if (!m_targets[index])
+      {
+        return nullptr;
+      }
+      if (!m_lists[index])
+      {
+        m_lists[index] = std::make_unique<list<Result, Arguments...>>();
+        m_pfns[index] = thunks[m_slot];
+      }
+      const auto result = dynamic_cast<list<Result, Arguments...>*>(m_lists[index].get());
+      if (!result)
+      {
+        throw dispatch::error{ "The command is already hooked with a different function pointer type." };
+      }
+      return result;
+    }
+  public:
+    template <typename Table>
+    explicit hooks(const Table& base) {
+      for (auto i = std::size_t{ 0 }; i < Count; ++i)
+      {
+        m_targets[i] = *reinterpret_cast<const PFN_vkVoidFunction*>(base.get(static_cast<Command>(i)));
+      }
+      m_pfns = m_targets;
+      m_slot = bindings::bind(this);
+    }
+
+    hooks(const hooks& other) = delete;
+    hooks(hooks&& other) = delete;
+
+    ~hooks() noexcept {
+      bindings::release(m_slot);
+    }
+
+    hooks& operator=(const hooks& rhs) = delete;
+    hooks& operator=(hooks&& rhs) = delete;
+
+    template <Command Cmd, command_pointer Pointer>
+    void add_pre(typename hook_signature<Pointer>::pre hook) {
+      if (const auto current = acquire<Cmd>(static_cast<Pointer>(nullptr)); current)
+      {
+        current->pre.emplace_back(std::move(hook));
+      }
+    }
+
+    template <Command Cmd, command_pointer Pointer>
+    void add_post(typename hook_signature<Pointer>::post hook) {
+      if (const auto current = acquire<Cmd>(static_cast<Pointer>(nullptr)); current)
+      {
+        current->post.emplace_back(std::move(hook));
+      }
+    }
+
+    template <Command Cmd>
+    void clear() noexcept {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The cleared command must be valid.");
+      m_pfns[index] = m_targets[index];
+      m_lists[index].reset();
+    }
+
+    bool hooked(const Command cmd) const noexcept {
+      const auto index = static_cast<std::size_t>(cmd);
+      return index < Count && m_lists[index] != nullptr;
+    }
+
+    const PFN_vkVoidFunction* slot(const std::size_t index) const noexcept {
+      return &m_pfns[index];
+    }
+  };
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,204 @@
+/// @cond INTERNAL
+/**
+ * @file instrumentation.hpp
+ * @brief Generic Instrumented Dispatch Table Implementation
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_INSTRUMENTATION_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_INSTRUMENTATION_HPP
+
+#include <cstddef>
+
+#include <array>
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+#include "../../defs.hpp"
+#include "../../error.hpp"
+#include "../../counters.hpp"
+#include "../../histograms.hpp"
+#include "../../profiler.hpp"
+#include "../../tracer.hpp"
+
+#include "probes.hpp"
+#include "slots.hpp"
+#include "timestamp.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The common implementation of instrumented dispatch tables.
+   * @details Each live instrumented table binds itself to one of a fixed number of global slots. A thunk retrieves
+   *          its table from its slot, records the call, and then tail-calls the original function pointer. When an
+   *          observer (a call_tracer, a set of latency histograms, or a call_site_profiler) is attached, the call is timed instead and the
+   *          thunk no longer tail-calls.
+   * @tparam Command The command enumeration type of the level being instrumented.
+   * @tparam Count The number of commands at the level being instrumented.
+   */
+  template <typename Command, std::size_t Count>
+  class instrumentation final {
+  private:
+    using bindings = slots<instrumentation>;
+
+    std::array<PFN_vkVoidFunction, Count> m_pfns{ };
+    std::array<PFN_vkVoidFunction, Count> m_targets{ };
+    basic_call_counters<Command, Count> m_counters{ };
+    std::atomic<call_tracer*> m_tracer{ };
+    std::atomic<basic_latency_histograms<Command, Count>*> m_histograms{ };
+    std::atomic<call_site_profiler*> m_profiler{ };
+    std::size_t m_slot{ bindings::count };
+
+    template <Command Cmd>
+    class observation final {
+    private:
+      call_tracer* m_tracer{ };
+      basic_latency_histograms<Command, Count>* m_histograms{ };
+      call_site_profiler* m_profiler{ };
+      const void* m_site{ };
+      std::uint64_t m_start{ timestamp() };
+    public:
+      observation(call_tracer *const tracer, basic_latency_histograms<Command, Count> *const histograms,
+                  call_site_profiler *const profiler, const void *const site) :
+      m_tracer{ tracer }, m_histograms{ histograms }, m_profiler{ profiler }, m_site{ site } { }
+
+      observation(const observation& other) = delete;
+      observation(observation&& other) = delete;
+
+      ~observation() noexcept {
+        const auto end = timestamp();
+        if (m_tracer)
+        {
+          m_tracer->record(Cmd, m_start, end);
+        }
+        if (m_histograms)
+        {
+          m_histograms->record(Cmd, end - m_start);
+        }
+        if (m_profiler)
+        {
+          m_profiler->record(Cmd, m_site, end - m_start);
+        }
+      }
+
+      observation& operator=(const observation& rhs) = delete;
+      observation& operator=(observation&& rhs) = delete;
+    };
+
+    template <std::size_t Slot, Command Cmd, typename Result, typename... Arguments>
+    static MEGATECH_VULKAN_DISPATCH_API_ATTR Result MEGATECH_VULKAN_DISPATCH_API_CALL thunk(Arguments... arguments) {
+      using pointer = Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...);
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      MEGATECH_VULKAN_DISPATCH_PROBE_SCOPE(Cmd, arguments...);
+      const auto self = bindings::template get<Slot>();
+      self->m_counters.increment(Cmd);
+      const auto target = reinterpret_cast<pointer>(self->m_targets[index]);
+      const auto tracer = self->m_tracer.load(std::memory_order_acquire);
+      const auto histograms = self->m_histograms.load(std::memory_order_acquire);
+      const auto profiler = self->m_profiler.load(std::memory_order_acquire);
+      if (tracer || histograms || profiler) [[unlikely]]
+      {
+        // The observation is completed after the call returns but before the thunk does. The thunk's return address
+        // is the call site in the client's code.
+        const auto site = MEGATECH_VULKAN_DISPATCH_RETURN_ADDRESS();
+        const auto current = observation<Cmd>{ tracer, histograms, profiler, site };
+        return target(arguments...);
+      }
+      return target(arguments...);
+    }
+
+    template <Command Cmd, typename Result, typename... Arguments>
+    PFN_vkVoidFunction select(Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)) const {
+      static const auto thunks = []<std::size_t... Slots>(std::index_sequence<Slots...>) {
+        return std::array<PFN_vkVoidFunction, bindings::count>{
+          reinterpret_cast<PFN_vkVoidFunction>(&thunk<Slots, Cmd, Result, Arguments...>)...
+        };
+      }(std::make_index_sequence<bindings::count>{});
+      return thunks[m_slot];
+    }
+  public:
+    template <typename Table>
+    explicit instrumentation(const Table& base) {
+      for (auto i = std::size_t{ 0 }; i < Count; ++i)
+      {
+        m_targets[i] = *reinterpret_cast<const PFN_vkVoidFunction*>(base.get(static_cast<Command>(i)));
+      }
+      m_pfns = m_targets;
+      m_slot = bindings::bind(this);
+    }
+
+    instrumentation(const instrumentation& other) = delete;
+    instrumentation(instrumentation&& other) = delete;
+
+    ~instrumentation() noexcept {
+      bindings::release(m_slot);
+    }
+
+    instrumentation& operator=(const instrumentation& rhs) = delete;
+    instrumentation& operator=(instrumentation&& rhs) = delete;
+
+    template <Command Cmd, command_pointer Pointer>
+    void instrument() {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The instrumented command must be valid.");
+      if (m_targets[index])
+      {
+        m_pfns[index] = select<Cmd>(static_cast<Pointer>(nullptr));
+      }
+    }
+
+    template <Command Cmd>
+    void restore() noexcept {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The restored command must be valid.");
+      m_pfns[index] = m_targets[index];
+    }
+
+    bool instrumented(const Command cmd) const noexcept {
+      const auto index = static_cast<std::size_t>(cmd);
+      return index < Count && m_pfns[index] != m_targets[index];
+    }
+
+    const PFN_vkVoidFunction* slot(const std::size_t index) const noexcept {
+      return &m_pfns[index];
+    }
+
+    const basic_call_counters<Command, Count>& counters() const noexcept {
+      return m_counters;
+    }
+
+    basic_call_counters<Command, Count>& counters() noexcept {
+      return m_counters;
+    }
+
+    void set_tracer(call_tracer *const tracer) noexcept {
+      m_tracer.store(tracer, std::memory_order_release);
+    }
+
+    call_tracer* tracer() const noexcept {
+      return m_tracer.load(std::memory_order_acquire);
+    }
+
+    void set_histograms(basic_latency_histograms<Command, Count> *const histograms) noexcept {
+      m_histograms.store(histograms, std::memory_order_release);
+    }
+
+    basic_latency_histograms<Command, Count>* histograms() const noexcept {
+      return m_histograms.load(std::memory_order_acquire);
+    }
+
+    void set_profiler(call_site_profiler *const profiler) noexcept {
+      m_profiler.store(profiler, std::memory_order_release);
+    }
+
+    call_site_profiler* profiler() const noexcept {
+      return m_profiler.load(std::memory_order_acquire);
+    }
+  };
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,184 @@
+/// @cond INTERNAL
+/**
+ * @file interception.hpp
+ * @brief Generic Intercepted Dispatch Table Implementation
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_INTERCEPTION_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_INTERCEPTION_HPP
+
+#include <cstddef>
+
+#include <array>
+#include <tuple>
+#include <utility>
+
+#include "../../defs.hpp"
+
+#include "call_sites.hpp"
+#include "probes.hpp"
+#include "slots.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The common implementation of intercepted dispatch tables.
+   * @details Every call is passed through a chain of policies. Each policy's `invoke<Cmd>(next, arguments...)` member
+   *          receives a callable that continues the chain. The final link calls the original function pointer.
+   *          Because every link is a template, the entire chain is visible to the compiler and is inlined into
+   *          ::call() and into the thunks installed by ::intercept().
+   *
+   *          When there are no policies, no slot is bound and no thunk is ever installed.
+   *
+   *          When a policy is a call_site_consumer, each entry point publishes its call site before entering the
+   *          chain. Thunks publish their own return address, which is always the client's call site because thunks are
+   *          only ever called through function pointers. ::call() publishes the site that its caller passes in.
+   * @tparam Command The command enumeration type of the level being intercepted.
+   * @tparam Count The number of commands at the level being intercepted.
+   * @tparam Policies The interception policies, from outermost to innermost.
+   */
+  template <typename Command, std::size_t Count, typename... Policies>
+  class interception final {
+  private:
+    using bindings = slots<interception>;
+
+    static constexpr bool empty{ sizeof...(Policies) == 0 };
+    static constexpr bool sited{ (call_site_consumer<Policies> || ...) };
+
+    std::array<PFN_vkVoidFunction, Count> m_pfns{ };
+    std::array<PFN_vkVoidFunction, Count> m_targets{ };
+    std::tuple<Policies...> m_policies{ };
+    std::size_t m_slot{ bindings::count };
+
+    template <Command Cmd, std::size_t Link, typename Result, typename... Arguments>
+    Result chain(Arguments... arguments) {
+      if constexpr (Link == sizeof...(Policies))
+      {
+        using pointer = Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...);
+        return reinterpret_cast<pointer>(m_targets[static_cast<std::size_t>(Cmd)])(arguments...);
+      }
+      else
+      {
+        const auto next = [this](Arguments... forwarded) -> Result {
+          return chain<Cmd, Link + 1, Result, Arguments...>(forwarded...);
+        };
+        return std::get<Link>(m_policies).template invoke<Cmd>(next, arguments...);
+      }
+    }
+
+    template <std::size_t Slot, Command Cmd, typename Result, typename... Arguments>
+    static MEGATECH_VULKAN_DISPATCH_API_ATTR Result MEGATECH_VULKAN_DISPATCH_API_CALL thunk(Arguments... arguments) {
+      MEGATECH_VULKAN_DISPATCH_PROBE_SCOPE(Cmd, arguments...);
+      if constexpr (sited)
+      {
+        const auto site = call_site_scope{ MEGATECH_VULKAN_DISPATCH_RETURN_ADDRESS() };
+        return bindings::template get<Slot>()->template chain<Cmd, 0, Result, Arguments...>(arguments...);
+      }
+      else
+      {
+        return bindings::template get<Slot>()->template chain<Cmd, 0, Result, Arguments...>(arguments...);
+      }
+    }
+
+    template <Command Cmd, typename Result, typename... Arguments>
+    PFN_vkVoidFunction select(Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)) const {
+      static const auto thunks = []<std::size_t... Slots>(std::index_sequence<Slots...>) {
+        return std::array<PFN_vkVoidFunction, bindings::count>{
+          reinterpret_cast<PFN_vkVoidFunction>(&thunk<Slots, Cmd, Result, Arguments...>)...
+        };
+      }(std::make_index_sequence<bindings::count>{});
+      return thunks[m_slot];
+    }
+
+    template <Command Cmd, typename Result, typename... Parameters, typename... Arguments>
+    Result enter(Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Parameters...), [[maybe_unused]] const void *const site,
+                 Arguments&&... arguments) {
+      if constexpr (sited)
+      {
+        const auto scope = call_site_scope{ site };
+        return chain<Cmd, 0, Result, Parameters...>(std::forward<Arguments>(arguments)...);
+      }
+      else
+      {
+        return chain<Cmd, 0, Result, Parameters...>(std::forward<Arguments>(arguments)...);
+      }
+    }
+  public:
+    template <typename Table>
+    explicit interception(const Table& base) {
+      for (auto i = std::size_t{ 0 }; i < Count; ++i)
+      {
+        m_targets[i] = *reinterpret_cast<const PFN_vkVoidFunction*>(base.get(static_cast<Command>(i)));
+      }
+      m_pfns = m_targets;
+      if constexpr (!empty)
+      {
+        m_slot = bindings::bind(this);
+      }
+    }
+
+    interception(const interception& other) = delete;
+    interception(interception&& other) = delete;
+
+    ~interception() noexcept {
+      if constexpr (!empty)
+      {
+        bindings::release(m_slot);
+      }
+    }
+
+    interception& operator=(const interception& rhs) = delete;
+    interception& operator=(interception&& rhs) = delete;
+
+    template <Command Cmd, command_pointer Pointer>
+    void intercept() {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The intercepted command must be valid.");
+      if constexpr (!empty)
+      {
+        if (m_targets[index])
+        {
+          m_pfns[index] = select<Cmd>(static_cast<Pointer>(nullptr));
+        }
+      }
+    }
+
+    template <Command Cmd>
+    void restore() noexcept {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The restored command must be valid.");
+      m_pfns[index] = m_targets[index];
+    }
+
+    bool intercepted(const Command cmd) const noexcept {
+      const auto index = static_cast<std::size_t>(cmd);
+      return index < Count && m_pfns[index] != m_targets[index];
+    }
+
+    template <Command Cmd, command_pointer Pointer, typename... Arguments>
+    decltype(auto) call(const void *const site, Arguments&&... arguments) {
+      static_assert(static_cast<std::size_t>(Cmd) < Count, "The called command must be valid.");
+      return enter<Cmd>(static_cast<Pointer>(nullptr), site, std::forward<Arguments>(arguments)...);
+    }
+
+    template <typename Policy>
+    const Policy& policy() const noexcept {
+      return std::get<Policy>(m_policies);
+    }
+
+    template <typename Policy>
+    Policy& policy() noexcept {
+      return std::get<Policy>(m_policies);
+    }
+
+    const PFN_vkVoidFunction* slot(const std::size_t index) const noexcept {
+      return &m_pfns[index];
+    }
+  };
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,429 @@
+/// @cond INTERNAL
+/**
+ * @file memoization.hpp
+ * @brief Generic Memoizing Dispatch Table Implementation
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_MEMOIZATION_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_MEMOIZATION_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../../defs.hpp"
+
+#include "arguments.hpp"
+#include "probes.hpp"
+#include "slots.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief Determine whether or not an output structure extends a chain.
+   * @param output A pointer to an output structure.
+   * @return True if the structure has a non-null `pNext` member. Otherwise false.
+   */
+  template <typename Output>
+  bool chained(const Output *const output) noexcept {
+    if constexpr (requires { output->pNext; })
+    {
+      return output->pNext != nullptr;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  /**
+   * @brief The shape of a memoizable Vulkan query.
+   * @details A query is memoizable if its outputs are determined entirely by its other arguments. There are two
+   *          shapes:
+   *          - Single queries return a structure through their last argument (e.g.,
+   *            `vkGetPhysicalDeviceFormatProperties`). They **MAY** return a `VkResult`.
+   *          - Enumerations return an array through their last argument and its length through their second to last
+   *            argument (e.g., `vkGetPhysicalDeviceQueueFamilyProperties`). They **MUST NOT** return a result.
+   *
+   *          Every other argument is part of the key.
+   * @tparam Pointer The function pointer type of the query.
+   */
+  template <command_pointer Pointer>
+  struct query_shape;
+
+  template <typename Result, typename... Arguments>
+  struct query_shape<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)> final {
+    using arguments = std::tuple<Arguments...>;
+    using output_pointer = std::tuple_element_t<sizeof...(Arguments) - 1, arguments>;
+    using output = std::remove_pointer_t<output_pointer>;
+
+    static constexpr bool enumeration{ []() {
+      if constexpr (sizeof...(Arguments) >= 3)
+      {
+        return std::is_same_v<std::tuple_element_t<sizeof...(Arguments) - 2, arguments>, std::uint32_t*>;
+      }
+      else
+      {
+        return false;
+      }
+    }() };
+    static constexpr std::size_t keys{ sizeof...(Arguments) - (enumeration ? 2 : 1) };
+
+    static_assert(std::is_pointer_v<output_pointer> && !std::is_const_v<output>,
+                  "The last argument of a memoized query must be an output pointer.");
+    static_assert(!enumeration || std::is_void_v<Result>, "Memoized enumerations must not return a result.");
+
+    /**
+     * @brief Whether or not every key argument is a scalar or a handle.
+     * @details encode() reduces other pointers to null or non-null, so queries whose inputs are structures (e.g.,
+     *          `vkGetPhysicalDeviceImageFormatProperties2`) can only be keyed by a function that reads those
+     *          structures.
+     */
+    static constexpr bool keyed_by_value{ []<std::size_t... Indices>(std::index_sequence<Indices...>) {
+      return ((!std::is_pointer_v<std::tuple_element_t<Indices, arguments>> ||
+               handle<std::tuple_element_t<Indices, arguments>>) && ...);
+    }(std::make_index_sequence<keys>{ }) };
+
+    using pointer = Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...);
+
+    struct single final {
+      std::conditional_t<std::is_void_v<Result>, bool, Result> result{ };
+      output structure{ };
+    };
+
+    /**
+     * @brief The type of a stored query result.
+     */
+    using value = std::conditional_t<enumeration, std::vector<output>, single>;
+
+    /**
+     * @brief Determine whether or not a call must bypass the cache entirely.
+     * @details Outputs that extend a `pNext` chain can't be copied, so they're never stored or served.
+     */
+    static bool bypass(Arguments... arguments) noexcept {
+      const auto all = std::tuple<Arguments...>{ arguments... };
+      const auto destination = std::get<sizeof...(Arguments) - 1>(all);
+      if constexpr (enumeration)
+      {
+        const auto count = std::get<sizeof...(Arguments) - 2>(all);
+        return destination && std::any_of(destination, destination + *count, [](const output& element) {
+          return chained(&element);
+        });
+      }
+      else
+      {
+        return chained(destination);
+      }
+    }
+
+    /**
+     * @brief Determine whether or not a call that missed the cache can fill it.
+     * @details Filling an enumeration requires an element to copy `sType` from, so count-only calls can't.
+     */
+    static bool fillable(Arguments... arguments) noexcept {
+      if constexpr (enumeration)
+      {
+        const auto all = std::tuple<Arguments...>{ arguments... };
+        return std::get<sizeof...(Arguments) - 1>(all) && *std::get<sizeof...(Arguments) - 2>(all);
+      }
+      else
+      {
+        return true;
+      }
+    }
+
+    /**
+     * @brief Compute a query result by calling the original function pointer.
+     */
+    static value fill(const pointer target, Arguments... arguments) {
+      const auto all = std::tuple<Arguments...>{ arguments... };
+      const auto destination = std::get<sizeof...(Arguments) - 1>(all);
+      return [&]<std::size_t... Indices>(std::index_sequence<Indices...>) {
+        auto result = value{ };
+        if constexpr (enumeration)
+        {
+          auto size = std::uint32_t{ 0 };
+          target(std::get<Indices>(all)..., &size, nullptr);
+          result.resize(size, *destination);
+          target(std::get<Indices>(all)..., &size, result.data());
+          result.resize(size);
+        }
+        else
+        {
+          result.structure = *destination;
+          if constexpr (std::is_void_v<Result>)
+          {
+            target(std::get<Indices>(all)..., &result.structure);
+          }
+          else
+          {
+            result.result = target(std::get<Indices>(all)..., &result.structure);
+          }
+        }
+        return result;
+      }(std::make_index_sequence<keys>{ });
+    }
+
+    /**
+     * @brief Determine whether or not a computed result may be stored.
+     * @details `VK_ERROR_OUT_OF_HOST_MEMORY` (-1) and `VK_ERROR_OUT_OF_DEVICE_MEMORY` (-2) may not be repeated. Every
+     *          other result of an immutable query is as immutable as its output.
+     */
+    static bool storable(const value& current) noexcept {
+      if constexpr (!enumeration && !std::is_void_v<Result>)
+      {
+        const auto result = static_cast<std::int64_t>(current.result);
+        return result != -1 && result != -2;
+      }
+      else
+      {
+        static_cast<void>(current);
+        return true;
+      }
+    }
+
+    /**
+     * @brief Copy a query result to a call's outputs.
+     * @return The stored result of the query, if it has one.
+     */
+    static Result copy(const value& current, Arguments... arguments) {
+      const auto all = std::tuple<Arguments...>{ arguments... };
+      const auto destination = std::get<sizeof...(Arguments) - 1>(all);
+      if constexpr (enumeration)
+      {
+        const auto count = std::get<sizeof...(Arguments) - 2>(all);
+        if (!destination)
+        {
+          *count = static_cast<std::uint32_t>(current.size());
+          return;
+        }
+        *count = std::min(*count, static_cast<std::uint32_t>(current.size()));
+        std::copy_n(current.begin(), *count, destination);
+      }
+      else
+      {
+        *destination = current.structure;
+        if constexpr (!std::is_void_v<Result>)
+        {
+          return current.result;
+        }
+      }
+    }
+  };
+
+  /**
+   * @brief The common implementation of memoizing dispatch tables.
+   * @details Each memoized command receives a thunk that looks up its key arguments in a per-command, append-only
+   *          hash table. On a miss, the thunk calls the original function pointer and publishes the result with a
+   *          single compare-and-swap. On a hit, the result is copied out without calling into the loader or the
+   *          driver. Readers never take a lock. Entries are only freed when the memoization is destroyed.
+   *
+   *          Output structures that extend a `pNext` chain can't be copied without knowledge of every structure in
+   *          the chain, so those calls always bypass the cache.
+   * @tparam Command The command enumeration type of the level being memoized.
+   * @tparam Count The number of commands at the level being memoized.
+   * @tparam Buckets The number of hash buckets per memoized command. This **MUST** be a power of 2.
+   */
+  template <typename Command, std::size_t Count, std::size_t Buckets = 64>
+  class memoization final {
+  private:
+    using bindings = slots<memoization>;
+
+    static_assert(Buckets > 0 && (Buckets & (Buckets - 1)) == 0, "The bucket count must be a power of 2.");
+
+    struct node_base {
+      std::uint64_t hash{ };
+      node_base* next{ };
+
+      virtual ~node_base() noexcept = default;
+    };
+
+    template <std::size_t Keys, typename Value>
+    struct node final : public node_base {
+      std::array<std::uint64_t, Keys> key{ };
+      Value value{ };
+    };
+
+    class cache final {
+    public:
+      std::array<std::atomic<node_base*>, Buckets> buckets{ };
+
+      ~cache() noexcept {
+        for (auto& bucket : buckets)
+        {
+          for (auto current = bucket.load(std::memory_order_acquire); current;)
+          {
+            const auto next = current->next;
+            delete current;
+            current = next;
+          }
+        }
+      }
+    };
+
+    std::array<PFN_vkVoidFunction, Count> m_pfns{ };
+    std::array<PFN_vkVoidFunction, Count> m_targets{ };
+    std::array<std::unique_ptr<cache>, Count> m_caches{ };
+    std::size_t m_slot{ bindings::count };
+
+    template <std::size_t Keys>
+    static std::uint64_t hash(const std::array<std::uint64_t, Keys>& key) noexcept {
+      // This is the 64-bit FNV-1a offset basis, followed by a SplitMix64 style mix of each key.
+      auto result = std::uint64_t{ 0xcbf29ce484222325 };
+      for (auto value : key)
+      {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+        result = (result ^ value ^ (value >> 31)) * 0x100000001b3;
+      }
+      return result;
+    }
+
+    template <typename Value, std::size_t Keys>
+    static const Value* find(const cache& current, const std::uint64_t digest,
+                             const std::array<std::uint64_t, Keys>& key) noexcept {
+      for (auto entry = current.buckets[digest & (Buckets - 1)].load(std::memory_order_acquire); entry;
+           entry = entry->next)
+      {
+        if (entry->hash == digest)
+        {
+          const auto& candidate = static_cast<const node<Keys, Value>&>(*entry);
+          if (candidate.key == key)
+          {
+            return &candidate.value;
+          }
+        }
+      }
+      return nullptr;
+    }
+
+    template <typename Value, std::size_t Keys>
+    static const Value* publish(cache& current, const std::uint64_t digest, const std::array<std::uint64_t, Keys>& key,
+                                Value&& value) {
+      auto entry = std::make_unique<node<Keys, Value>>();
+      entry->hash = digest;
+      entry->key = key;
+      entry->value = std::move(value);
+      auto& bucket = current.buckets[digest & (Buckets - 1)];
+      auto head = bucket.load(std::memory_order_acquire);
+      do
+      {
+        entry->next = head;
+      }
+      while (!bucket.compare_exchange_weak(head, entry.get(), std::memory_order_acq_rel, std::memory_order_acquire));
+      return &entry.release()->value;
+    }
+
+    template <std::size_t Slot, Command Cmd, typename Result, typename... Arguments>
+    static MEGATECH_VULKAN_DISPATCH_API_ATTR Result MEGATECH_VULKAN_DISPATCH_API_CALL thunk(Arguments... arguments) {
+      using shape = query_shape<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)>;
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      MEGATECH_VULKAN_DISPATCH_PROBE_SCOPE(Cmd, arguments...);
+      const auto self = bindings::template get<Slot>();
+      const auto target = reinterpret_cast<typename shape::pointer>(self->m_targets[index]);
+      if (shape::bypass(arguments...))
+      {
+        return target(arguments...);
+      }
+      auto& current = *self->m_caches[index];
+      const auto all = std::tuple<Arguments...>{ arguments... };
+      const auto key = [&]<std::size_t... Indices>(std::index_sequence<Indices...>) {
+        return std::array<std::uint64_t, shape::keys>{ encode(std::get<Indices>(all)).value... };
+      }(std::make_index_sequence<shape::keys>{ });
+      const auto digest = hash(key);
+      auto found = find<typename shape::value>(current, digest, key);
+      if (!found)
+      {
+        if (!shape::fillable(arguments...))
+        {
+          return target(arguments...);
+        }
+        auto fill = shape::fill(target, arguments...);
+        if (!shape::storable(fill))
+        {
+          return shape::copy(fill, arguments...);
+        }
+        found = publish(current, digest, key, std::move(fill));
+      }
+      return shape::copy(*found, arguments...);
+    }
+
+    template <Command Cmd, typename Result, typename... Arguments>
+    void install(Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)) {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The memoized command must be valid.");
+      static const auto thunks = []<std::size_t... Slots>(std::index_sequence<Slots...>) {
+        return std::array<PFN_vkVoidFunction, bindings::count>{
+          reinterpret_cast<PFN_vkVoidFunction>(&thunk<Slots, Cmd, Result, Arguments...>)...
+        };
+      }(std::make_index_sequence<bindings::count>{});
+      if (!m_targets[index])
+      {
+        return;
+      }
+      if (!m_caches[index])
+      {
+        m_caches[index] = std::make_unique<cache>();
+      }
+      m_pfns[index] = thunks[m_slot];
+    }
+  public:
+    template <typename Table>
+    explicit memoization(const Table& base) {
+      for (auto i = std::size_t{ 0 }; i < Count; ++i)
+      {
+        m_targets[i] = *reinterpret_cast<const PFN_vkVoidFunction*>(base.get(static_cast<Command>(i)));
+      }
+      m_pfns = m_targets;
+      m_slot = bindings::bind(this);
+    }
+
+    memoization(const memoization& other) = delete;
+    memoization(memoization&& other) = delete;
+
+    ~memoization() noexcept {
+      bindings::release(m_slot);
+    }
+
+    memoization& operator=(const memoization& rhs) = delete;
+    memoization& operator=(memoization&& rhs) = delete;
+
+    template <Command Cmd, command_pointer Pointer>
+    void memoize() {
+      static_assert(query_shape<Pointer>::keyed_by_value,
+                    "Every key argument of a memoized query must be a scalar or a handle.");
+      install<Cmd>(static_cast<Pointer>(nullptr));
+    }
+
+    template <Command Cmd>
+    void restore() noexcept {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The restored command must be valid.");
+      // The cache is retained, since other threads may still be reading it.
+      m_pfns[index] = m_targets[index];
+    }
+
+    bool memoized(const Command cmd) const noexcept {
+      const auto index = static_cast<std::size_t>(cmd);
+      return index < Count && m_pfns[index] != m_targets[index];
+    }
+
+    const PFN_vkVoidFunction* slot(const std::size_t index) const noexcept {
+      return &m_pfns[index];
+    }
+  };
+
+}
+
+#endif
+/// @endcond
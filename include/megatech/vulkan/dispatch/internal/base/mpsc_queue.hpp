@@ -0,0 +1,112 @@
+/// @cond INTERNAL
+/**
+ * @file mpsc_queue.hpp
+ * @brief Intrusive Multi-Producer Single-Consumer Queue
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_MPSC_QUEUE_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The link embedded in every node of an mpsc_queue.
+   */
+  struct mpsc_link {
+    std::atomic<mpsc_link*> next{ };
+  };
+
+  /**
+   * @brief An unbounded intrusive multi-producer single-consumer queue.
+   * @details This is Dmitry Vyukov's non-intrusive MPSC queue adapted to intrusive nodes. Pushing is a single atomic
+   *          exchange and never blocks. Popping is wait-free, but a pop **MAY** spuriously report an empty queue while
+   *          a producer is between its exchange and its link store. Only one thread may pop at a time.
+   *
+   *          The queue owns every pushed node until it is popped.
+   * @tparam Node The node type. This **MUST** publicly derive from mpsc_link.
+   */
+  template <typename Node>
+  class mpsc_queue final {
+  private:
+    mpsc_link m_stub{ };
+    std::atomic<mpsc_link*> m_tail{ &m_stub };
+    mpsc_link* m_head{ &m_stub };
+
+    void push(mpsc_link *const link) noexcept {
+      link->next.store(nullptr, std::memory_order_relaxed);
+      const auto previous = m_tail.exchange(link, std::memory_order_acq_rel);
+      previous->next.store(link, std::memory_order_release);
+    }
+  public:
+    mpsc_queue() = default;
+
+    mpsc_queue(const mpsc_queue& other) = delete;
+    mpsc_queue(mpsc_queue&& other) = delete;
+
+    ~mpsc_queue() noexcept {
+      while (pop())
+      { }
+    }
+
+    mpsc_queue& operator=(const mpsc_queue& rhs) = delete;
+    mpsc_queue& operator=(mpsc_queue&& rhs) = delete;
+
+    /**
+     * @brief Append a node to the queue.
+     * @details This is safe to call concurrently with any other operation.
+     * @param node The node to append.
+     */
+    void push(std::unique_ptr<Node> node) noexcept {
+      static_assert(std::is_base_of_v<mpsc_link, Node>, "Queue nodes must derive from mpsc_link.");
+      push(static_cast<mpsc_link*>(node.release()));
+    }
+
+    /**
+     * @brief Remove the oldest node from the queue.
+     * @details This **MUST NOT** be called concurrently with itself.
+     * @return The oldest node, or null if the queue is (or appears to be) empty.
+     */
+    std::unique_ptr<Node> pop() noexcept {
+      auto head = m_head;
+      auto next = head->next.load(std::memory_order_acquire);
+      if (head == &m_stub)
+      {
+        if (!next)
+        {
+          return nullptr;
+        }
+        m_head = next;
+        head = next;
+        next = next->next.load(std::memory_order_acquire);
+      }
+      if (next)
+      {
+        m_head = next;
+        return std::unique_ptr<Node>{ static_cast<Node*>(head) };
+      }
+      if (head != m_tail.load(std::memory_order_acquire))
+      {
+        // A producer has exchanged the tail but hasn't linked its node yet.
+        return nullptr;
+      }
+      push(&m_stub);
+      next = head->next.load(std::memory_order_acquire);
+      if (next)
+      {
+        m_head = next;
+        return std::unique_ptr<Node>{ static_cast<Node*>(head) };
+      }
+      return nullptr;
+    }
+  };
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,632 @@
+/// @cond INTERNAL
+/**
+ * @file payloads.hpp
+ * @brief Pointer Payload Metadata
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_PAYLOADS_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_PAYLOADS_HPP
+
+#include <cstddef>
+#include <cinttypes>
+#include <cstring>
+
+#include <array>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "../../defs.hpp"
+#include "../../error.hpp"
+#include "../../commands.hpp"
+
+#include "arguments.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief Convert a size in bytes to a size in 8-byte words.
+   * @param bytes The size to convert.
+   * @return The smallest number of words that can hold `bytes`.
+   */
+  constexpr std::size_t words_of(const std::size_t bytes) noexcept {
+    return (bytes + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+  }
+
+  /**
+   * @brief A payload length indicating a NUL-terminated string.
+   */
+  inline constexpr std::size_t terminated{ SIZE_MAX };
+
+  /**
+   * @brief Determine whether or not every structure passed to a command is described by visit_payloads().
+   * @details The generator emits no structure metadata, so this is maintained by hand. A command is only listed when
+   *          every pointer member of every structure it accepts, other than `pNext`, is visited by visit_payloads(),
+   *          and every handle member is visited by visit_handles(). Commands that take no structures don't need to be
+   *          listed.
+   * @tparam Cmd The command to check.
+   * @return True if the structure payloads of `Cmd` can be copied. Otherwise false.
+   */
+  template <auto Cmd>
+  consteval bool described() {
+    constexpr auto names = std::to_array<std::string_view>({
+      // Structures without pointer members.
+      "vkCmdSetViewport", "vkCmdSetScissor", "vkCmdSetViewportWithCount", "vkCmdSetViewportWithCountEXT",
+      "vkCmdSetScissorWithCount", "vkCmdSetScissorWithCountEXT", "vkCmdSetDiscardRectangleEXT",
+      "vkCmdSetExclusiveScissorNV", "vkCmdSetViewportWScalingNV", "vkCmdCopyBuffer", "vkCmdCopyImage",
+      "vkCmdBlitImage", "vkCmdCopyBufferToImage", "vkCmdCopyImageToBuffer", "vkCmdResolveImage",
+      "vkCmdClearColorImage", "vkCmdClearDepthStencilImage", "vkCmdClearAttachments", "vkCmdPipelineBarrier",
+      "vkCmdWaitEvents", "vkCmdNextSubpass2", "vkCmdNextSubpass2KHR", "vkCmdEndRenderPass2", "vkCmdEndRenderPass2KHR",
+      "vkCmdSetFragmentShadingRateKHR", "vkCmdDrawMultiEXT", "vkCmdDrawMultiIndexedEXT", "vkCmdSetVertexInputEXT",
+      "vkCmdSetColorBlendEquationEXT", "vkCmdSetColorBlendAdvancedEXT", "vkCmdBeginConditionalRenderingEXT",
+      "vkCmdBindDescriptorBuffersEXT", "vkCmdTraceRaysKHR",
+      // VkRenderPassBeginInfo::pClearValues.
+      "vkCmdBeginRenderPass", "vkCmdBeginRenderPass2", "vkCmdBeginRenderPass2KHR",
+      // VkRenderingInfo::pColorAttachments, pDepthAttachment, and pStencilAttachment.
+      "vkCmdBeginRendering", "vkCmdBeginRenderingKHR",
+      // VkDependencyInfo::pMemoryBarriers, pBufferMemoryBarriers, and pImageMemoryBarriers.
+      "vkCmdPipelineBarrier2", "vkCmdPipelineBarrier2KHR", "vkCmdSetEvent2", "vkCmdSetEvent2KHR", "vkCmdWaitEvents2",
+      "vkCmdWaitEvents2KHR",
+      // The pRegions members of copy, blit, and resolve information.
+      "vkCmdCopyBuffer2", "vkCmdCopyBuffer2KHR", "vkCmdCopyImage2", "vkCmdCopyImage2KHR", "vkCmdBlitImage2",
+      "vkCmdBlitImage2KHR", "vkCmdCopyBufferToImage2", "vkCmdCopyBufferToImage2KHR", "vkCmdCopyImageToBuffer2",
+      "vkCmdCopyImageToBuffer2KHR", "vkCmdResolveImage2", "vkCmdResolveImage2KHR",
+      // VkWriteDescriptorSet::pImageInfo, pBufferInfo, and pTexelBufferView.
+      "vkCmdPushDescriptorSet", "vkCmdPushDescriptorSetKHR",
+      // VkSampleLocationsInfoEXT::pSampleLocations.
+      "vkCmdSetSampleLocationsEXT",
+      // VkDebugUtilsLabelEXT::pLabelName and VkDebugMarkerMarkerInfoEXT::pMarkerName.
+      "vkCmdBeginDebugUtilsLabelEXT", "vkCmdInsertDebugUtilsLabelEXT", "vkCmdDebugMarkerBeginEXT",
+      "vkCmdDebugMarkerInsertEXT"
+    });
+    const auto name = std::string_view{ to_string(Cmd) };
+    for (const auto& current : names)
+    {
+      if (current == name)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Visit the pointer members of a structure.
+   * @details Each known pointer member of `value` is passed to `visit` along with the number of elements it refers
+   *          to. Members that refer to strings are passed with a length of ::terminated. Lengths are read from `value`
+   *          before `visit` is called, so `visit` **MAY** change the member. Descriptor writes only visit the member
+   *          selected by their descriptor type.
+   * @tparam Structure The type of `value`. This **MAY** be const.
+   * @tparam Visitor The type of `visit`. It **MUST** accept a (possibly const) reference to a pointer member and a
+   *                 `std::size_t` count.
+   * @param value The structure to visit.
+   * @param visit The function to call for each pointer member.
+   * @throw dispatch::error If `value` has a non-null `pNext` or a descriptor type that isn't described.
+   */
+  template <typename Structure, typename Visitor>
+  void visit_payloads(Structure& value, Visitor&& visit) {
+    if constexpr (requires { value.pNext; })
+    {
+      if (value.pNext)
+      {
+        throw dispatch::error{ "Structures with extension chains cannot be copied." };
+      }
+    }
+    if constexpr (requires { value.pClearValues; })
+    {
+      visit(value.pClearValues, value.clearValueCount);
+    }
+    if constexpr (requires { value.pColorAttachments; value.pDepthAttachment; value.pStencilAttachment; })
+    {
+      visit(value.pColorAttachments, value.colorAttachmentCount);
+      visit(value.pDepthAttachment, 1);
+      visit(value.pStencilAttachment, 1);
+    }
+    if constexpr (requires { value.pMemoryBarriers; value.pBufferMemoryBarriers; value.pImageMemoryBarriers; })
+    {
+      visit(value.pMemoryBarriers, value.memoryBarrierCount);
+      visit(value.pBufferMemoryBarriers, value.bufferMemoryBarrierCount);
+      visit(value.pImageMemoryBarriers, value.imageMemoryBarrierCount);
+    }
+    if constexpr (requires { value.pRegions; })
+    {
+      visit(value.pRegions, value.regionCount);
+    }
+    if constexpr (requires { value.pSampleLocations; })
+    {
+      visit(value.pSampleLocations, value.sampleLocationsCount);
+    }
+    if constexpr (requires { value.pLabelName; })
+    {
+      visit(value.pLabelName, terminated);
+    }
+    if constexpr (requires { value.pMarkerName; })
+    {
+      visit(value.pMarkerName, terminated);
+    }
+    if constexpr (requires { value.pImageInfo; value.pBufferInfo; value.pTexelBufferView; })
+    {
+      // The unused members of a descriptor write may hold any value, so only the selected member is visited.
+      switch (static_cast<std::int64_t>(value.descriptorType))
+      {
+      case 0: // VK_DESCRIPTOR_TYPE_SAMPLER
+      case 1: // VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+      case 2: // VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+      case 3: // VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+      case 10: // VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
+        visit(value.pImageInfo, value.descriptorCount);
+        break;
+      case 4: // VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+      case 5: // VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+        visit(value.pTexelBufferView, value.descriptorCount);
+        break;
+      case 6: // VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+      case 7: // VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+      case 8: // VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+      case 9: // VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+        visit(value.pBufferInfo, value.descriptorCount);
+        break;
+      default:
+        throw dispatch::error{ "Descriptor writes of this type cannot be copied." };
+      }
+    }
+  }
+
+  /**
+   * @brief Visit the handle members of a structure.
+   * @details This covers the handle members of every structure accepted by a described() command. Handles within
+   *          arrays (e.g., `VkWriteDescriptorSet::pTexelBufferView`) are visited as payloads instead.
+   * @tparam Structure The type of `value`. This **MAY** be const.
+   * @tparam Visitor The type of `visit`. It **MUST** accept a (possibly const) reference to a handle member.
+   * @param value The structure to visit.
+   * @param visit The function to call for each handle member.
+   */
+  template <typename Structure, typename Visitor>
+  void visit_handles(Structure& value, Visitor&& visit) {
+    // Non-dispatchable handles are integers on 32-bit platforms, and they're treated as such.
+    const auto member = [&](auto& current) {
+      if constexpr (handle<std::remove_cvref_t<decltype(current)>>)
+      {
+        visit(current);
+      }
+    };
+    if constexpr (requires { value.renderPass; })
+    {
+      member(value.renderPass);
+    }
+    if constexpr (requires { value.framebuffer; })
+    {
+      member(value.framebuffer);
+    }
+    if constexpr (requires { value.imageView; })
+    {
+      member(value.imageView);
+    }
+    if constexpr (requires { value.resolveImageView; })
+    {
+      member(value.resolveImageView);
+    }
+    if constexpr (requires { value.sampler; })
+    {
+      member(value.sampler);
+    }
+    if constexpr (requires { value.buffer; })
+    {
+      member(value.buffer);
+    }
+    if constexpr (requires { value.image; })
+    {
+      member(value.image);
+    }
+    if constexpr (requires { value.srcBuffer; })
+    {
+      member(value.srcBuffer);
+    }
+    if constexpr (requires { value.dstBuffer; })
+    {
+      member(value.dstBuffer);
+    }
+    if constexpr (requires { value.srcImage; })
+    {
+      member(value.srcImage);
+    }
+    if constexpr (requires { value.dstImage; })
+    {
+      member(value.dstImage);
+    }
+    if constexpr (requires { value.dstSet; })
+    {
+      member(value.dstSet);
+    }
+  }
+
+  /**
+   * @brief Resolve the length of a nested payload.
+   * @param values The payload.
+   * @param length The length passed by visit_payloads().
+   * @return The number of elements in `values`.
+   */
+  template <typename Element>
+  std::size_t length_of(const Element *const values, const std::size_t length) noexcept {
+    if constexpr (std::is_same_v<Element, char>)
+    {
+      if (length == terminated)
+      {
+        return std::strlen(values) + 1;
+      }
+    }
+    return length;
+  }
+
+  /**
+   * @brief Measure the payloads referred to by the pointer members of an array of elements.
+   * @param values The elements to measure.
+   * @param count The number of elements in `values`.
+   * @return The size, in bytes, of every nested payload of `values`. Each payload is padded to a multiple of 8 bytes.
+   * @throw dispatch::error If a nested structure cannot be copied (see visit_payloads()).
+   */
+  template <typename Element>
+  std::size_t nested_size(const Element *const values, const std::size_t count) {
+    auto result = std::size_t{ 0 };
+    if constexpr (std::is_class_v<Element>)
+    {
+      for (auto i = std::size_t{ 0 }; i < count; ++i)
+      {
+        visit_payloads(values[i], [&]<typename Nested>(const Nested *const member, const std::size_t length) {
+          if (member)
+          {
+            const auto elements = length_of(member, length);
+            result += words_of(sizeof(Nested) * elements) * sizeof(std::uint64_t) + nested_size(member, elements);
+          }
+        });
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @brief Copy the payloads referred to by the pointer members of an array of copied elements.
+   * @details Each nested payload is copied to `destination` and the member that referred to it is updated to refer to
+   *          the copy. When `origin` isn't zero, members instead hold the offset of their copy from `origin` (see
+   *          relocate_nested()).
+   * @param copies The elements whose members are updated.
+   * @param count The number of elements in `copies`.
+   * @param destination The storage of the nested payloads. This **MUST** be 8-byte aligned and hold at least
+   *                    `nested_size(copies, count)` bytes.
+   * @param origin The address that copies are relative to, or zero for absolute addresses.
+   * @return A pointer past the last copied payload.
+   */
+  template <typename Element>
+  std::byte* copy_nested(Element *const copies, const std::size_t count, std::byte* destination,
+                         const std::uintptr_t origin = 0) {
+    if constexpr (std::is_class_v<Element>)
+    {
+      for (auto i = std::size_t{ 0 }; i < count; ++i)
+      {
+        visit_payloads(copies[i], [&]<typename Nested>(const Nested*& member, const std::size_t length) {
+          if (member)
+          {
+            const auto elements = length_of(member, length);
+            const auto copy = reinterpret_cast<Nested*>(destination);
+            std::memcpy(copy, member, sizeof(Nested) * elements);
+            destination = copy_nested(copy, elements, destination + words_of(sizeof(Nested) * elements) *
+                                                                   sizeof(std::uint64_t), origin);
+            member = reinterpret_cast<const Nested*>(reinterpret_cast<std::uintptr_t>(copy) - origin);
+          }
+        });
+      }
+    }
+    return destination;
+  }
+
+  /**
+   * @brief Locate a payload within a payload area.
+   * @details This is used to read payloads that were copied with a non-zero origin (see copy_nested()) from untrusted
+   *          storage (e.g., a file).
+   * @tparam Element The type of the payload's elements.
+   * @param area The payload area.
+   * @param offset The offset of the payload from the start of `area`, in bytes.
+   * @param length The number of elements in the payload, or ::terminated if the payload is a string.
+   * @return A pointer to the payload and the number of elements it holds.
+   * @throw dispatch::error If the payload isn't aligned or isn't entirely within `area`.
+   */
+  template <typename Element>
+  std::pair<Element*, std::size_t> locate_payload(const std::span<std::byte> area, const std::uint64_t offset,
+                                                  std::size_t length) {
+    if (offset % sizeof(std::uint64_t) || offset > area.size())
+    {
+      throw dispatch::error{ "The recorded payload is out of bounds." };
+    }
+    const auto values = reinterpret_cast<Element*>(area.data() + offset);
+    const auto remaining = area.size() - offset;
+    if constexpr (std::is_same_v<Element, char>)
+    {
+      if (length == terminated)
+      {
+        const auto end = static_cast<const char*>(std::memchr(values, '\0', remaining));
+        if (!end)
+        {
+          throw dispatch::error{ "The recorded string is not terminated." };
+        }
+        length = static_cast<std::size_t>(end - values) + 1;
+      }
+    }
+    if (length > remaining / sizeof(Element))
+    {
+      throw dispatch::error{ "The recorded payload is out of bounds." };
+    }
+    return { values, length };
+  }
+
+  /**
+   * @brief Convert the relative pointer members written by copy_nested() back to addresses and translate handles.
+   * @param copies The elements whose members are updated.
+   * @param count The number of elements in `copies`.
+   * @param area The payload area that the members of `copies` are relative to. Every nested payload **MUST** lie
+   *             within it.
+   * @param translate A function that accepts a reference to a handle and replaces it.
+   * @throw dispatch::error If a nested payload isn't entirely within `area`, or if a nested structure cannot be copied
+   *                        (see visit_payloads()).
+   */
+  template <typename Element, typename Translate>
+  void relocate_nested(Element *const copies, const std::size_t count, const std::span<std::byte> area,
+                       const Translate& translate) {
+    for (auto i = std::size_t{ 0 }; i < count; ++i)
+    {
+      if constexpr (handle<Element>)
+      {
+        translate(copies[i]);
+      }
+      else if constexpr (std::is_class_v<Element>)
+      {
+        visit_handles(copies[i], translate);
+        visit_payloads(copies[i], [&]<typename Nested>(const Nested*& member, const std::size_t length) {
+          if (member)
+          {
+            const auto [copy, elements] = locate_payload<Nested>(area, reinterpret_cast<std::uintptr_t>(member),
+                                                                 length);
+            relocate_nested(copy, elements, area, translate);
+            member = copy;
+          }
+        });
+      }
+    }
+  }
+
+  /**
+   * @brief The extent of a single pointer argument's payload.
+   */
+  struct payload_extent final {
+    /**
+     * @brief The number of elements whose nested payloads and handles are followed.
+     */
+    std::size_t count;
+
+    /**
+     * @brief The size, in bytes, of the pointed-to array itself.
+     */
+    std::size_t span;
+
+    /**
+     * @brief The size, in bytes, of the array and every nested payload. This is a multiple of 8.
+     */
+    std::size_t bytes;
+  };
+
+  /**
+   * @brief Determine the length of fixed-size array parameters of a command.
+   * @details A handful of commands take fixed-size scalar arrays with no length argument (e.g., the four floats of
+   *          `vkCmdSetBlendConstants`). Every other uncounted pointer refers to a single element.
+   * @tparam Cmd The command to check.
+   * @return The number of elements in each uncounted scalar array parameter of `Cmd`.
+   */
+  template <auto Cmd>
+  consteval std::size_t fixed_extent() {
+    const auto name = std::string_view{ to_string(Cmd) };
+    if (name == "vkCmdSetBlendConstants")
+    {
+      return 4;
+    }
+    if (name.starts_with("vkCmdSetFragmentShadingRate"))
+    {
+      return 2;
+    }
+    return 1;
+  }
+
+  /**
+   * @brief Determine whether or not a command takes a strided array.
+   * @details `vkCmdDrawMultiEXT` and `vkCmdDrawMultiIndexedEXT` take an array whose elements are `stride` bytes apart.
+   *          The stride follows the array, so it can't be inferred by payload_extents()'s single pass.
+   * @tparam Cmd The command to check.
+   * @return True if `Cmd` takes a strided array. Otherwise false.
+   */
+  template <auto Cmd>
+  consteval bool strided() {
+    return std::string_view{ to_string(Cmd) }.starts_with("vkCmdDrawMulti");
+  }
+
+  /**
+   * @brief Determine which arguments of a command can be copied.
+   * @details Scalars and handles can always be copied. Outputs, pointers to pointers (e.g., `ppBuildRangeInfos`),
+   *          untyped payloads without a preceding size (e.g., descriptor update template data), and structures whose
+   *          pointer members aren't described (see described()) can't be copied.
+   * @tparam Cmd The command to check.
+   * @tparam Arguments The parameter types of the command.
+   * @return An array holding true for each argument of `Cmd` that can be copied.
+   */
+  template <auto Cmd, typename... Arguments>
+  consteval std::array<bool, sizeof...(Arguments)> copyable() {
+    const auto templated = std::string_view{ to_string(Cmd) }.find("WithTemplate") != std::string_view::npos;
+    auto result = std::array<bool, sizeof...(Arguments)>{ };
+    auto index = std::size_t{ 0 };
+    auto sized = false;
+    const auto check = [&]<typename Type>(std::type_identity<Type>) {
+      result[index] = true;
+      if constexpr (std::is_pointer_v<Type> && !handle<Type>)
+      {
+        using pointee = std::remove_pointer_t<Type>;
+        using element = std::remove_cv_t<pointee>;
+        if constexpr (!std::is_const_v<pointee> || (std::is_pointer_v<element> && !handle<element>))
+        {
+          result[index] = false;
+        }
+        else if constexpr (std::is_void_v<element>)
+        {
+          result[index] = sized && !templated;
+        }
+        else if constexpr (std::is_class_v<element> || std::is_union_v<element>)
+        {
+          result[index] = described<Cmd>();
+        }
+      }
+      sized = std::is_same_v<Type, std::uint32_t> || std::is_same_v<Type, std::uint64_t>;
+      ++index;
+    };
+    (check(std::type_identity<Arguments>{ }), ...);
+    return result;
+  }
+
+  /**
+   * @brief Measure a payload.
+   * @param values The payload to measure, or null.
+   * @param count The number of elements in `values`, or the number of bytes in `values` if it is untyped.
+   * @return The extent of the payload, including its nested payloads.
+   * @throw dispatch::error If a structure in the payload cannot be copied (see visit_payloads()).
+   */
+  template <typename Element>
+  payload_extent extent_of(const Element *const values, const std::size_t count) {
+    if (!values)
+    {
+      return { };
+    }
+    if constexpr (std::is_void_v<Element>)
+    {
+      return { 0, count, words_of(count) * sizeof(std::uint64_t) };
+    }
+    else
+    {
+      const auto span = sizeof(Element) * count;
+      return { count, span, words_of(span) * sizeof(std::uint64_t) + nested_size(values, count) };
+    }
+  }
+
+  /**
+   * @brief Compute the payload extent of each argument of a call.
+   * @details Vulkan passes array lengths immediately before arrays, so the length of a pointer argument is inferred
+   *          from the nearest preceding non-pointer argument:
+   *          - `const void*` payloads (e.g., push constants) are as many bytes as the preceding integer.
+   *          - `const char*` payloads are NUL-terminated strings.
+   *          - Other payloads are arrays whose length is the preceding `uint32_t`. If there isn't one, the payload is a
+   *            single element, or a fixed-size array of scalars (see fixed_extent()).
+   *
+   *          Strided arrays (see strided()) and sample masks, whose length is `ceil(samples / 32)`, are measured
+   *          separately. The pointer members of structures are followed as described by visit_payloads().
+   * @tparam Cmd The called command.
+   * @param arguments The arguments of the call. The leading command buffer **MAY** be omitted.
+   * @return The extent of each argument's payload. Non-pointer arguments, null pointers, and arguments that aren't
+   *         copyable() have no payload.
+   * @throw dispatch::error If a structure in the call cannot be copied (see visit_payloads()).
+   */
+  template <auto Cmd, typename... Arguments>
+  std::array<payload_extent, sizeof...(Arguments)> payload_extents(const Arguments... arguments) {
+    auto result = std::array<payload_extent, sizeof...(Arguments)>{ };
+    auto counted = false;
+    auto sized = false;
+    auto count = std::uint64_t{ 0 };
+    const auto measure = [&]<std::size_t Index, typename Type>(std::integral_constant<std::size_t, Index>,
+                                                               const Type value) {
+      if constexpr (std::is_pointer_v<Type> && !handle<Type>)
+      {
+        using element = std::remove_cv_t<std::remove_pointer_t<Type>>;
+        if constexpr (!copyable<Cmd, Arguments...>()[Index])
+        {
+          return;
+        }
+        else if constexpr (std::is_void_v<element>)
+        {
+          result[Index] = extent_of(value, sized ? count : 0);
+        }
+        else if constexpr (std::is_same_v<element, char>)
+        {
+          result[Index] = extent_of(value, value ? std::strlen(value) + 1 : 0);
+        }
+        else if constexpr (std::is_class_v<element> || std::is_union_v<element>)
+        {
+          result[Index] = extent_of(value, counted ? count : 1);
+        }
+        else
+        {
+          result[Index] = extent_of(value, counted ? count : fixed_extent<Cmd>());
+        }
+      }
+      else
+      {
+        // Arrays are only counted by uint32_t. The byte sizes of untyped payloads can also be VkDeviceSize.
+        counted = std::is_same_v<Type, std::uint32_t>;
+        sized = counted || std::is_same_v<Type, std::uint64_t>;
+        if constexpr (std::is_same_v<Type, std::uint32_t> || std::is_same_v<Type, std::uint64_t>)
+        {
+          count = value;
+        }
+      }
+    };
+    [&]<std::size_t... Indices>(std::index_sequence<Indices...>) {
+      (measure(std::integral_constant<std::size_t, Indices>{ }, arguments), ...);
+    }(std::index_sequence_for<Arguments...>{ });
+    if constexpr (strided<Cmd>())
+    {
+      // ([commandBuffer,] drawCount, pInfo, instanceCount, firstInstance, stride[, pVertexOffset]). Multi-draw
+      // elements are flat.
+      constexpr auto first = std::size_t{ handle<std::tuple_element_t<0, std::tuple<Arguments...>>> };
+      const auto values = std::tuple<const Arguments...>{ arguments... };
+      const auto draws = static_cast<std::size_t>(std::get<first>(values));
+      const auto stride = static_cast<std::size_t>(std::get<first + 4>(values));
+      using element = std::remove_cv_t<std::remove_pointer_t<std::tuple_element_t<first + 1,
+                                                                                  std::tuple<Arguments...>>>>;
+      const auto span = std::get<first + 1>(values) && draws ? stride * (draws - 1) + sizeof(element) : 0;
+      result[first + 1] = { 0, span, words_of(span) * sizeof(std::uint64_t) };
+      if constexpr (sizeof...(Arguments) > first + 5)
+      {
+        result[first + 5] = extent_of(std::get<first + 5>(values), 1);
+      }
+    }
+    else if constexpr (std::string_view{ to_string(Cmd) } == "vkCmdSetSampleMaskEXT")
+    {
+      // ([commandBuffer,] samples, pSampleMask).
+      constexpr auto first = std::size_t{ handle<std::tuple_element_t<0, std::tuple<Arguments...>>> };
+      const auto values = std::tuple<const Arguments...>{ arguments... };
+      const auto samples = static_cast<std::size_t>(std::get<first>(values));
+      result[first + 1] = extent_of(std::get<first + 1>(values), (samples + 31) / 32);
+    }
+    return result;
+  }
+
+  /**
+   * @brief Copy a payload.
+   * @param destination The storage of the copy. This **MUST** be 8-byte aligned and hold at least `extent.bytes`
+   *                    bytes.
+   * @param values The payload to copy. This **MUST NOT** be null.
+   * @param extent The extent of `values`, as computed by payload_extents().
+   * @param origin The address that nested pointers are relative to, or zero for absolute addresses (see
+   *               copy_nested()).
+   */
+  template <typename Element>
+  void copy_payload(std::byte *const destination, const Element *const values, const payload_extent& extent,
+                    const std::uintptr_t origin = 0) {
+    std::memcpy(destination, values, extent.span);
+    if constexpr (!std::is_void_v<Element>)
+    {
+      copy_nested(reinterpret_cast<std::remove_cv_t<Element>*>(destination), extent.count,
+                  destination + words_of(extent.span) * sizeof(std::uint64_t), origin);
+    }
+  }
+
+}
+
+#endif
+/// @endcond
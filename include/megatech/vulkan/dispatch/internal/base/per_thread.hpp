@@ -0,0 +1,202 @@
+/// @cond INTERNAL
+/**
+ * @file per_thread.hpp
+ * @brief Lock-Free Per-Thread Storage
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_PER_THREAD_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_PER_THREAD_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <atomic>
+#include <concepts>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The assumed size of a cache line in bytes.
+   * @details This is used instead of `std::hardware_destructive_interference_size` because the latter is not
+   *          guaranteed to be ABI stable between compiler versions.
+   */
+  inline constexpr std::size_t cache_line_size{ 64 };
+
+  /**
+   * @brief A set of objects with one instance per thread.
+   * @details Each thread that calls ::local() receives its own cache-line aligned instance of `Type`. Instances are
+   *          held in an intrusive singly-linked list that only ever grows. Readers may traverse the list with
+   *          ::for_each() at any time without blocking writers.
+   *
+   *          When a thread exits, its instance is released but not destroyed. The next thread to call ::local() will
+   *          adopt a released instance (with its previous contents intact) before allocating a new one. As a result,
+   *          the number of instances is bounded by the maximum number of threads that concurrently use the object,
+   *          and values accumulated by exited threads are never lost.
+   *
+   *          The hot path of ::local() is a single comparison against a thread-local cache.
+   * @tparam Type The type of the per-thread values. This **MUST** be default constructible.
+   */
+  template <std::default_initializable Type>
+  class per_thread final {
+  private:
+    struct alignas(cache_line_size) node final {
+      Type value{ };
+      std::atomic<bool> active{ true };
+      node* next{ };
+    };
+
+    struct state final {
+      std::atomic<node*> head{ };
+
+      ~state() noexcept {
+        auto current = head.load(std::memory_order_acquire);
+        while (current)
+        {
+          delete std::exchange(current, current->next);
+        }
+      }
+    };
+
+    struct binding final {
+      std::uint64_t id{ };
+      std::weak_ptr<state> owner{ };
+      node* entry{ };
+    };
+
+    class bindings final {
+    private:
+      std::vector<binding> m_bindings{ };
+    public:
+      bindings() = default;
+
+      bindings(const bindings& other) = delete;
+      bindings(bindings&& other) = delete;
+
+      ~bindings() noexcept {
+        for (auto& current : m_bindings)
+        {
+          // Only release entries whose owner is still alive. If the owner has already been destroyed, the entry no
+          // longer exists.
+          if (const auto owner = current.owner.lock(); owner)
+          {
+            current.entry->active.store(false, std::memory_order_release);
+          }
+        }
+      }
+
+      bindings& operator=(const bindings& rhs) = delete;
+      bindings& operator=(bindings&& rhs) = delete;
+
+      node* find(const std::uint64_t id) const noexcept {
+        for (const auto& current : m_bindings)
+        {
+          if (current.id == id)
+          {
+            return current.entry;
+          }
+        }
+        return nullptr;
+      }
+
+      void bind(const std::uint64_t id, const std::shared_ptr<state>& owner, node *const entry) {
+        std::erase_if(m_bindings, [](const binding& current) { return current.owner.expired(); });
+        m_bindings.emplace_back(id, owner, entry);
+      }
+    };
+
+    struct cache final {
+      std::uint64_t id{ };
+      node* entry{ };
+    };
+
+    static inline std::atomic<std::uint64_t> s_next_id{ 1 };
+    static inline thread_local cache t_cache{ };
+    static inline thread_local bindings t_bindings{ };
+
+    std::shared_ptr<state> m_state{ std::make_shared<state>() };
+    std::uint64_t m_id{ s_next_id.fetch_add(1, std::memory_order_relaxed) };
+
+    node* acquire() {
+      auto entry = t_bindings.find(m_id);
+      if (!entry)
+      {
+        for (auto current = m_state->head.load(std::memory_order_acquire); current && !entry; current = current->next)
+        {
+          auto expected = false;
+          if (current->active.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+          {
+            entry = current;
+          }
+        }
+        if (!entry)
+        {
+          entry = new node{ };
+          entry->next = m_state->head.load(std::memory_order_relaxed);
+          while (!m_state->head.compare_exchange_weak(entry->next, entry, std::memory_order_release,
+                                                      std::memory_order_relaxed));
+        }
+        t_bindings.bind(m_id, m_state, entry);
+      }
+      t_cache = cache{ m_id, entry };
+      return entry;
+    }
+  public:
+    per_thread() = default;
+
+    per_thread(const per_thread& other) = delete;
+    per_thread(per_thread&& other) = delete;
+
+    ~per_thread() noexcept = default;
+
+    per_thread& operator=(const per_thread& rhs) = delete;
+    per_thread& operator=(per_thread&& rhs) = delete;
+
+    /**
+     * @brief Retrieve the calling thread's instance.
+     * @return A reference to an instance of `Type` that is exclusively owned by the calling thread.
+     */
+    Type& local() {
+      if (const auto& current = t_cache; current.id == m_id) [[likely]]
+      {
+        return current.entry->value;
+      }
+      return acquire()->value;
+    }
+
+    /**
+     * @brief Apply a function to every instance.
+     * @details Instances owned by other threads **MAY** be modified concurrently. `function` **MUST** only perform
+     *          operations on them that are safe under those conditions (e.g., relaxed atomic loads).
+     * @param function A function that accepts a `const Type&`.
+     */
+    template <typename Function>
+    void for_each(Function&& function) const {
+      for (auto current = m_state->head.load(std::memory_order_acquire); current; current = current->next)
+      {
+        function(std::as_const(current->value));
+      }
+    }
+
+    /**
+     * @brief Apply a function to every instance.
+     * @param function A function that accepts a `Type&`.
+     * @see for_each(Function&&) const
+     */
+    template <typename Function>
+    void for_each(Function&& function) {
+      for (auto current = m_state->head.load(std::memory_order_acquire); current; current = current->next)
+      {
+        function(current->value);
+      }
+    }
+  };
+
+}
+
+#endif
+/// @endcond
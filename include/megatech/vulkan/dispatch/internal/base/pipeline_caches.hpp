@@ -0,0 +1,91 @@
+/// @cond INTERNAL
+/**
+ * @file pipeline_caches.hpp
+ * @brief Pipeline and Pipeline Cache Helpers
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_PIPELINE_CACHES_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_PIPELINE_CACHES_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include "../../defs.hpp"
+
+#include "slots.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The value of `VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO`.
+   */
+  inline constexpr int pipeline_cache_create_info_type{ 17 };
+
+  /**
+   * @brief The value of `VK_INCOMPLETE`.
+   */
+  inline constexpr int incomplete_result{ 5 };
+
+  /**
+   * @brief The types involved in pipeline cache commands.
+   * @details The remaining pipeline cache commands are described in terms of the types of `vkCreatePipelineCache`, so
+   *          a single function pointer type is enough to name all of them.
+   * @tparam Pointer The function pointer type of `vkCreatePipelineCache` (i.e., `PFN_vkCreatePipelineCache`).
+   */
+  template <command_pointer Pointer>
+  struct pipeline_cache_signature;
+
+  template <typename Result, typename Device, typename Info, typename Allocator, typename Cache>
+  struct pipeline_cache_signature<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Device, const Info*, const Allocator*,
+                                                                             Cache*)> final {
+    using result = Result;
+    using device = Device;
+    using info = Info;
+    using allocator = Allocator;
+    using cache = Cache;
+    using destroy = void (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Device, Cache, const Allocator*);
+    using data = Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Device, Cache, std::size_t*, void*);
+    using merge = Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Device, Cache, std::uint32_t, const Cache*);
+  };
+
+  /**
+   * @brief The types involved in a pipeline creation command.
+   * @details Ray tracing pipeline creation takes an additional deferred operation before the pipeline cache. The
+   *          `deferred` type is void for every other command.
+   * @tparam Pointer The function pointer type of the creation command (e.g., `PFN_vkCreateComputePipelines`).
+   */
+  template <command_pointer Pointer>
+  struct pipeline_signature;
+
+  template <typename Result, typename Device, typename Cache, typename Info, typename Allocator, typename Pipeline>
+  struct pipeline_signature<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Device, Cache, std::uint32_t, const Info*,
+                                                                       const Allocator*, Pipeline*)> final {
+    using result = Result;
+    using device = Device;
+    using cache = Cache;
+    using info = Info;
+    using allocator = Allocator;
+    using pipeline = Pipeline;
+    using deferred = void;
+  };
+
+  template <typename Result, typename Device, typename Deferred, typename Cache, typename Info, typename Allocator,
+            typename Pipeline>
+  struct pipeline_signature<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Device, Deferred, Cache, std::uint32_t,
+                                                                       const Info*, const Allocator*,
+                                                                       Pipeline*)> final {
+    using result = Result;
+    using device = Device;
+    using cache = Cache;
+    using info = Info;
+    using allocator = Allocator;
+    using pipeline = Pipeline;
+    using deferred = Deferred;
+  };
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,146 @@
+/// @cond INTERNAL
+/**
+ * @file probes.hpp
+ * @brief USDT Tracepoints
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_PROBES_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_PROBES_HPP
+
+#include <cinttypes>
+
+#include <type_traits>
+
+#include "../../commands.hpp"
+
+/**
+ * @def MEGATECH_VULKAN_DISPATCH_USDT
+ * @brief Whether or not thunks contain USDT (SystemTap/DTrace style) static tracepoints.
+ * @details This is defined to 1 by the build system when the "usdt" option is enabled. It **MUST** be consistent
+ *          across all translation units.
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_USDT
+  #define MEGATECH_VULKAN_DISPATCH_USDT (0)
+#endif
+
+/**
+ * @def MEGATECH_VULKAN_DISPATCH_PROBE
+ * @brief Emit a USDT probe named `megatech_vulkan_dispatch:<name>`.
+ * @details Each probe carries three arguments: the command's level (1 for instance commands, and 2 for device
+ *          commands), the command's value, and the command's first (dispatchable handle) argument. When no tracer is
+ *          attached, a probe is a single `nop`. When USDT support is disabled, this expands to nothing.
+ *
+ *          Probes are placed in the thunks of instrumented, hooked, and intercepted tables. Since those thunks are
+ *          templates, the probes appear in the binary that instantiates them, which is usually the application. For
+ *          example:
+ *          @code{.sh}
+ *          bpftrace -e 'usdt:./app:megatech_vulkan_dispatch:entry { @calls[arg1] = count(); }'
+ *          @endcode
+ */
+#if MEGATECH_VULKAN_DISPATCH_USDT
+  #include <sys/sdt.h>
+  #define MEGATECH_VULKAN_DISPATCH_PROBE(name, level, command, handle) \
+    DTRACE_PROBE3(megatech_vulkan_dispatch, name, level, command, handle)
+#else
+  #define MEGATECH_VULKAN_DISPATCH_PROBE(name, level, command, handle)
+#endif
+
+/**
+ * @def MEGATECH_VULKAN_DISPATCH_PROBE_SCOPE
+ * @brief Emit an "entry" probe immediately and an "exit" probe at the end of the enclosing scope.
+ * @details When USDT support is disabled, this expands to an empty statement so that thunks remain tail calls.
+ */
+#if MEGATECH_VULKAN_DISPATCH_USDT
+  #define MEGATECH_VULKAN_DISPATCH_PROBE_SCOPE(cmd, ...) \
+    const auto megatech_vulkan_dispatch_probe_scope = \
+      ::megatech::vulkan::dispatch::internal::base::probe_scope<cmd>{ \
+        ::megatech::vulkan::dispatch::internal::base::probe_handle(__VA_ARGS__) \
+      }
+#else
+  #define MEGATECH_VULKAN_DISPATCH_PROBE_SCOPE(cmd, ...) static_cast<void>(0)
+#endif
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief Determine the level value reported by probes for a command enumeration.
+   * @tparam Command The command enumeration of a command's level.
+   * @return The command's level (1 for instance commands, and 2 for device commands).
+   */
+  template <typename Command>
+  constexpr std::uint16_t probe_level() noexcept {
+    if constexpr (std::is_same_v<Command, instance::command>)
+    {
+      return 1;
+    }
+    else
+    {
+      static_assert(std::is_same_v<Command, device::command>, "Only instance and device commands can be probed.");
+      return 2;
+    }
+  }
+
+  /**
+   * @brief Convert the first argument of a call into a value that can be passed to a probe.
+   * @return 0.
+   */
+  inline std::uint64_t probe_handle() noexcept {
+    return 0;
+  }
+
+  /**
+   * @brief Convert the first argument of a call into a value that can be passed to a probe.
+   * @param first The first argument of a call.
+   * @return The first argument as an integer if it is a handle or an integer. Otherwise 0.
+   */
+  template <typename First, typename... Rest>
+  std::uint64_t probe_handle(const First first, const Rest...) noexcept {
+    if constexpr (std::is_pointer_v<First>)
+    {
+      return reinterpret_cast<std::uintptr_t>(first);
+    }
+    else if constexpr (std::is_integral_v<First>)
+    {
+      return static_cast<std::uint64_t>(first);
+    }
+    else
+    {
+      return 0;
+    }
+  }
+
+#if MEGATECH_VULKAN_DISPATCH_USDT
+  /**
+   * @brief A scope guard that emits "entry" and "exit" probes for a command.
+   * @tparam Cmd The command being called.
+   */
+  template <auto Cmd>
+  class probe_scope final {
+  private:
+    static constexpr std::uint16_t level{ probe_level<decltype(Cmd)>() };
+    static constexpr std::uint16_t command{ static_cast<std::uint16_t>(Cmd) };
+
+    std::uint64_t m_handle{ };
+  public:
+    explicit probe_scope(const std::uint64_t handle) : m_handle{ handle } {
+      MEGATECH_VULKAN_DISPATCH_PROBE(entry, level, command, m_handle);
+    }
+
+    probe_scope(const probe_scope& other) = delete;
+    probe_scope(probe_scope&& other) = delete;
+
+    ~probe_scope() noexcept {
+      MEGATECH_VULKAN_DISPATCH_PROBE(exit, level, command, m_handle);
+    }
+
+    probe_scope& operator=(const probe_scope& rhs) = delete;
+    probe_scope& operator=(probe_scope&& rhs) = delete;
+  };
+#endif
+
+}
+
+#endif
+/// @endcond
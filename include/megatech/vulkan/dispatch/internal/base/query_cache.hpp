@@ -0,0 +1,329 @@
+/// @cond INTERNAL
+/**
+ * @file query_cache.hpp
+ * @brief Generic Keyed Query Cache Implementation
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_QUERY_CACHE_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_QUERY_CACHE_HPP
+
+#include <cstddef>
+#include <cinttypes>
+#include <cstring>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "../../defs.hpp"
+#include "../../error.hpp"
+
+#include "arguments.hpp"
+#include "memoization.hpp"
+#include "probes.hpp"
+#include "sharded_map.hpp"
+#include "slots.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief A byte string that identifies the inputs of a query.
+   * @details Key functions append every input that determines a query's result. Two calls with equal keys **MUST**
+   *          produce equal results.
+   */
+  class query_key final {
+  private:
+    std::string m_bytes{ };
+
+    void append(const void *const data, const std::size_t size) {
+      m_bytes.append(static_cast<const char*>(data), size);
+    }
+  public:
+    /**
+     * @brief Append a scalar or a handle.
+     * @param value The value to append.
+     */
+    template <typename Type>
+    requires std::is_arithmetic_v<Type> || std::is_enum_v<Type> || handle<Type>
+    void write(const Type value) {
+      const auto encoded = encode(value).value;
+      append(&encoded, sizeof(encoded));
+    }
+
+    /**
+     * @brief Append a NUL-terminated string.
+     * @param value The string to append. This **MAY** be null, which is distinct from an empty string.
+     */
+    void write(const char *const value) {
+      const auto size = value ? std::strlen(value) : std::size_t{ 0 };
+      write(static_cast<std::uint64_t>(value ? size : ~std::uint64_t{ 0 }));
+      append(value, size);
+    }
+
+    /**
+     * @brief Append an array of flat values.
+     * @param values The array to append. This **MAY** be null if `count` is 0.
+     * @param count The number of elements in `values`.
+     */
+    template <typename Type>
+    requires std::is_trivially_copyable_v<Type>
+    void write(const Type *const values, const std::size_t count) {
+      write(static_cast<std::uint64_t>(count));
+      if (count)
+      {
+        append(values, sizeof(Type) * count);
+      }
+    }
+
+    /**
+     * @brief Append the object representation of a flat structure.
+     * @details The structure **MUST NOT** contain pointers other than a null `pNext`. Pointer members are hashed by
+     *          address, not by content, so a reused address with new content would produce a stale result. Padding
+     *          bytes are also included, so structures **SHOULD** be value-initialized.
+     * @param value The structure to append.
+     */
+    template <typename Type>
+    requires std::is_trivially_copyable_v<Type>
+    void write_bytes(const Type& value) {
+      append(&value, sizeof(Type));
+    }
+
+    /**
+     * @brief Discard the key's contents.
+     */
+    void clear() noexcept {
+      m_bytes.clear();
+    }
+
+    /**
+     * @brief Retrieve the key's contents.
+     * @return A view of the key's bytes.
+     */
+    std::string_view bytes() const noexcept {
+      return m_bytes;
+    }
+  };
+
+  /**
+   * @brief The type of a function that computes the key of a call.
+   * @details Key functions receive a key to append to, followed by a copy of every argument of the call. They return
+   *          false if the call can't be cached (e.g., because an input extends a `pNext` chain).
+   * @tparam Pointer The function pointer type of the cached command.
+   */
+  template <command_pointer Pointer>
+  struct key_signature;
+
+  template <typename Result, typename... Arguments>
+  struct key_signature<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)> final {
+    using type = std::function<bool(query_key&, Arguments...)>;
+  };
+
+  /**
+   * @brief The common implementation of keyed query caches.
+   * @details This is similar to memoization, except that the key of a call is an arbitrary byte string and results are
+   *          stored in a sharded_map. Queries with pointer inputs (e.g., create infos) can be cached by supplying a
+   *          key function that serializes the pointed-to contents. Queries whose key arguments are all scalars or
+   *          handles don't need one. Unlike memoization, entries can be cleared while other threads read the cache.
+   * @tparam Command The command enumeration type of the level being cached.
+   * @tparam Count The number of commands at the level being cached.
+   * @tparam Shards The number of shards in each command's map.
+   */
+  template <typename Command, std::size_t Count, std::size_t Shards = 16>
+  class query_cache final {
+  private:
+    using bindings = slots<query_cache>;
+
+    class store_base {
+    public:
+      virtual ~store_base() noexcept = default;
+
+      virtual void clear() noexcept = 0;
+      virtual std::size_t size() const noexcept = 0;
+    };
+
+    template <typename Pointer>
+    class store final : public store_base {
+    public:
+      using shape = query_shape<Pointer>;
+
+      typename key_signature<Pointer>::type key{ };
+      sharded_map<typename shape::value, Shards> entries{ };
+
+      explicit store(typename key_signature<Pointer>::type function) : key{ std::move(function) } { }
+
+      void clear() noexcept override {
+        entries.clear();
+      }
+
+      std::size_t size() const noexcept override {
+        return entries.size();
+      }
+    };
+
+    std::array<PFN_vkVoidFunction, Count> m_pfns{ };
+    std::array<PFN_vkVoidFunction, Count> m_targets{ };
+    std::array<std::unique_ptr<store_base>, Count> m_stores{ };
+    std::size_t m_slot{ bindings::count };
+
+    template <std::size_t Slot, Command Cmd, typename Result, typename... Arguments>
+    static MEGATECH_VULKAN_DISPATCH_API_ATTR Result MEGATECH_VULKAN_DISPATCH_API_CALL thunk(Arguments... arguments) {
+      using pointer = Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...);
+      using shape = query_shape<pointer>;
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      MEGATECH_VULKAN_DISPATCH_PROBE_SCOPE(Cmd, arguments...);
+      const auto self = bindings::template get<Slot>();
+      const auto target = reinterpret_cast<pointer>(self->m_targets[index]);
+      if (shape::bypass(arguments...))
+      {
+        return target(arguments...);
+      }
+      auto& current = static_cast<store<pointer>&>(*self->m_stores[index]);
+      // Keys are rebuilt in place so that steady-state lookups don't allocate.
+      thread_local auto key = query_key{ };
+      key.clear();
+      if (!current.key(key, arguments...))
+      {
+        return target(arguments...);
+      }
+      if constexpr (std::is_void_v<Result>)
+      {
+        if (current.entries.visit(key.bytes(), [&](const typename shape::value& value) {
+              shape::copy(value, arguments...);
+            }))
+        {
+          return;
+        }
+      }
+      else
+      {
+        auto result = Result{ };
+        if (current.entries.visit(key.bytes(), [&](const typename shape::value& value) {
+              result = shape::copy(value, arguments...);
+            }))
+        {
+          return result;
+        }
+      }
+      if (!shape::fillable(arguments...))
+      {
+        return target(arguments...);
+      }
+      auto found = shape::fill(target, arguments...);
+      if (shape::storable(found))
+      {
+        auto stored = found;
+        current.entries.insert(key.bytes(), std::move(stored));
+      }
+      return shape::copy(found, arguments...);
+    }
+
+    template <typename Result, typename... Arguments>
+    static bool default_key(query_key& key, Arguments... arguments) {
+      using shape = query_shape<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)>;
+      const auto all = std::tuple<Arguments...>{ arguments... };
+      [&]<std::size_t... Indices>(std::index_sequence<Indices...>) {
+        (key.write(std::get<Indices>(all)), ...);
+      }(std::make_index_sequence<shape::keys>{ });
+      return true;
+    }
+
+    template <Command Cmd, typename Result, typename... Arguments>
+    void install(Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...),
+                 typename key_signature<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)>::type key) {
+      using pointer = Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...);
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The cached command must be valid.");
+      static const auto thunks = []<std::size_t... Slots>(std::index_sequence<Slots...>) {
+        return std::array<PFN_vkVoidFunction, bindings::count>{
+          reinterpret_cast<PFN_vkVoidFunction>(&thunk<Slots, Cmd, Result, Arguments...>)...
+        };
+      }(std::make_index_sequence<bindings::count>{});
+      if (!m_targets[index])
+      {
+        return;
+      }
+      if (m_stores[index] && !dynamic_cast<store<pointer>*>(m_stores[index].get()))
+      {
+        throw dispatch::error{ "The command is already cached with a different function pointer type." };
+      }
+      m_stores[index] = std::make_unique<store<pointer>>(std::move(key));
+      m_pfns[index] = thunks[m_slot];
+    }
+  public:
+    template <typename Table>
+    explicit query_cache(const Table& base) {
+      for (auto i = std::size_t{ 0 }; i < Count; ++i)
+      {
+        m_targets[i] = *reinterpret_cast<const PFN_vkVoidFunction*>(base.get(static_cast<Command>(i)));
+      }
+      m_pfns = m_targets;
+      m_slot = bindings::bind(this);
+    }
+
+    query_cache(const query_cache& other) = delete;
+    query_cache(query_cache&& other) = delete;
+
+    ~query_cache() noexcept {
+      bindings::release(m_slot);
+    }
+
+    query_cache& operator=(const query_cache& rhs) = delete;
+    query_cache& operator=(query_cache&& rhs) = delete;
+
+    template <Command Cmd, command_pointer Pointer>
+    void cache() {
+      install<Cmd>(static_cast<Pointer>(nullptr), []<typename Result, typename... Arguments>(
+                     Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)) {
+        return typename key_signature<Pointer>::type{ &default_key<Result, Arguments...> };
+      }(static_cast<Pointer>(nullptr)));
+    }
+
+    template <Command Cmd, command_pointer Pointer>
+    void cache(typename key_signature<Pointer>::type key) {
+      install<Cmd>(static_cast<Pointer>(nullptr), std::move(key));
+    }
+
+    template <Command Cmd>
+    void restore() noexcept {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The restored command must be valid.");
+      m_pfns[index] = m_targets[index];
+      m_stores[index].reset();
+    }
+
+    template <Command Cmd>
+    void clear() noexcept {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The cleared command must be valid.");
+      if (m_stores[index])
+      {
+        m_stores[index]->clear();
+      }
+    }
+
+    bool cached(const Command cmd) const noexcept {
+      const auto index = static_cast<std::size_t>(cmd);
+      return index < Count && m_pfns[index] != m_targets[index];
+    }
+
+    std::size_t entries(const Command cmd) const noexcept {
+      const auto index = static_cast<std::size_t>(cmd);
+      return index < Count && m_stores[index] ? m_stores[index]->size() : 0;
+    }
+
+    const PFN_vkVoidFunction* slot(const std::size_t index) const noexcept {
+      return &m_pfns[index];
+    }
+  };
+
+}
+
+#endif
+/// @endcond
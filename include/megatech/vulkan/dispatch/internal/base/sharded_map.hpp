@@ -0,0 +1,148 @@
+/// @cond INTERNAL
+/**
+ * @file sharded_map.hpp
+ * @brief Sharded Concurrent Hash Map
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_SHARDED_MAP_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_SHARDED_MAP_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief Compute a 64-bit FNV-1a hash of a byte string at runtime.
+   * @param bytes The bytes to hash.
+   * @return A 64-bit FNV-1a hash value.
+   * @see fnv_1a_cstr(const char *const)
+   */
+  inline std::uint64_t fnv_1a_bytes(const std::string_view bytes) noexcept {
+    auto hash = std::uint64_t{ 0xcbf29ce484222325 };
+    for (const auto byte : bytes)
+    {
+      hash ^= static_cast<unsigned char>(byte);
+      hash *= 0x100000001b3;
+    }
+    return hash;
+  }
+
+  /**
+   * @brief A concurrent hash map keyed by byte strings.
+   * @details Keys are distributed across a fixed number of independently locked shards by their hash. Readers take a
+   *          shared lock on a single shard, so readers never block each other and writers only block readers of the
+   *          same shard. Lookups by `std::string_view` never allocate.
+   * @tparam Value The type of the mapped values.
+   * @tparam Shards The number of shards. This **MUST** be a power of 2.
+   */
+  template <typename Value, std::size_t Shards = 16>
+  class sharded_map final {
+  private:
+    static_assert(Shards > 0 && (Shards & (Shards - 1)) == 0, "The shard count must be a power of 2.");
+
+    struct transparent_hash final {
+      using is_transparent = void;
+
+      std::size_t operator()(const std::string_view key) const noexcept {
+        return static_cast<std::size_t>(fnv_1a_bytes(key));
+      }
+    };
+
+    struct shard final {
+      mutable std::shared_mutex mutex{ };
+      std::unordered_map<std::string, Value, transparent_hash, std::equal_to<>> entries{ };
+    };
+
+    std::array<shard, Shards> m_shards{ };
+
+    shard& shard_of(const std::string_view key) noexcept {
+      // The high bits select the shard so that they're independent of the low bits used by each shard's buckets.
+      return m_shards[(fnv_1a_bytes(key) >> 32) & (Shards - 1)];
+    }
+
+    const shard& shard_of(const std::string_view key) const noexcept {
+      return m_shards[(fnv_1a_bytes(key) >> 32) & (Shards - 1)];
+    }
+  public:
+    sharded_map() = default;
+
+    sharded_map(const sharded_map& other) = delete;
+    sharded_map(sharded_map&& other) = delete;
+
+    ~sharded_map() noexcept = default;
+
+    sharded_map& operator=(const sharded_map& rhs) = delete;
+    sharded_map& operator=(sharded_map&& rhs) = delete;
+
+    /**
+     * @brief Invoke a function on the value mapped to a key, if there is one.
+     * @details The function is invoked while the key's shard is locked for reading. It **MUST NOT** access the map.
+     * @param key The key to look up.
+     * @param function The function to invoke with a `const Value&`.
+     * @return True if the key was found. Otherwise false.
+     */
+    template <typename Function>
+    bool visit(const std::string_view key, Function&& function) const {
+      const auto& current = shard_of(key);
+      auto lock = std::shared_lock{ current.mutex };
+      if (const auto found = current.entries.find(key); found != current.entries.end())
+      {
+        std::invoke(std::forward<Function>(function), found->second);
+        return true;
+      }
+      return false;
+    }
+
+    /**
+     * @brief Map a key to a value if the key isn't already mapped.
+     * @param key The key to insert.
+     * @param value The value to insert.
+     */
+    void insert(const std::string_view key, Value&& value) {
+      auto& current = shard_of(key);
+      auto lock = std::unique_lock{ current.mutex };
+      current.entries.try_emplace(std::string{ key }, std::move(value));
+    }
+
+    /**
+     * @brief Remove every entry from the map.
+     */
+    void clear() noexcept {
+      for (auto& current : m_shards)
+      {
+        auto lock = std::unique_lock{ current.mutex };
+        current.entries.clear();
+      }
+    }
+
+    /**
+     * @brief Count the entries in the map.
+     * @return The number of entries in the map at some point during the call.
+     */
+    std::size_t size() const noexcept {
+      auto result = std::size_t{ 0 };
+      for (const auto& current : m_shards)
+      {
+        auto lock = std::shared_lock{ current.mutex };
+        result += current.entries.size();
+      }
+      return result;
+    }
+  };
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,79 @@
+/// @cond INTERNAL
+/**
+ * @file slots.hpp
+ * @brief Global Thunk Binding Slots
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_SLOTS_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_SLOTS_HPP
+
+#include <cstddef>
+
+#include <array>
+#include <atomic>
+#include <type_traits>
+
+#include "../../error.hpp"
+
+/**
+ * @def MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS
+ * @brief The maximum number of thunk-based tables of each kind and level that may exist simultaneously.
+ * @details Each slot requires a separate instantiation of every thunk, so increasing this value increases code size.
+ *          This can be overridden at the client's choice but it **MUST** be consistent across all translation units.
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS
+  #define MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS (8)
+#endif
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief A concept describing Vulkan command function pointer types (e.g., `PFN_vkQueueSubmit`).
+   */
+  template <typename Pointer>
+  concept command_pointer = std::is_pointer_v<Pointer> && std::is_function_v<std::remove_pointer_t<Pointer>>;
+
+  /**
+   * @brief A fixed set of global slots binding thunks to the object that owns them.
+   * @details Thunks are ordinary functions with the signature of the Vulkan command they replace, so they cannot
+   *          carry state. Instead, every thunk is instantiated once per slot and retrieves its owner from its slot.
+   * @tparam Owner The type of object bound to the slots. Each distinct type receives its own set of slots.
+   */
+  template <typename Owner>
+  class slots final {
+  private:
+    static inline std::array<std::atomic<Owner*>, MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS> s_bound{ };
+  public:
+    static constexpr std::size_t count{ MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS };
+
+    slots() = delete;
+
+    static std::size_t bind(Owner *const owner) {
+      for (auto i = std::size_t{ 0 }; i < count; ++i)
+      {
+        auto expected = static_cast<Owner*>(nullptr);
+        if (s_bound[i].compare_exchange_strong(expected, owner, std::memory_order_acq_rel))
+        {
+          return i;
+        }
+      }
+      throw dispatch::error{ "There are no free thunk slots. At most MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS "
+                             "tables of each kind and level may exist simultaneously." };
+    }
+
+    static void release(const std::size_t slot) noexcept {
+      s_bound[slot].store(nullptr, std::memory_order_release);
+    }
+
+    template <std::size_t Slot>
+    static Owner* get() noexcept {
+      return s_bound[Slot].load(std::memory_order_acquire);
+    }
+  };
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,196 @@
+/// @cond INTERNAL
+/**
+ * @file submissions.hpp
+ * @brief Queue Submission Helpers
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_SUBMISSIONS_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_SUBMISSIONS_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "../../defs.hpp"
+#include "../../commands.hpp"
+
+#include "slots.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief Determine whether or not a command has a given name.
+   * @details This allows policies to special-case commands that **MAY** be absent from the generated command list
+   *          (e.g., `vkQueueSubmit2` when generating for Vulkan 1.2) without naming their enumerators.
+   * @tparam Cmd The command to check.
+   * @param name The name to compare to.
+   * @return True if `Cmd` is named `name`. Otherwise false.
+   */
+  template <auto Cmd>
+  consteval bool named(const std::string_view name) {
+    return name == to_string(Cmd);
+  }
+
+  /**
+   * @brief The types involved in a queue submission command.
+   * @tparam Pointer The function pointer type of the submission command (e.g., `PFN_vkQueueSubmit`).
+   */
+  template <command_pointer Pointer>
+  struct submit_signature;
+
+  template <typename Result, typename Queue, typename Info, typename Fence>
+  struct submit_signature<Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Queue, std::uint32_t, const Info*, Fence)> final {
+    using result = Result;
+    using queue = Queue;
+    using info = Info;
+    using fence = Fence;
+  };
+
+  /**
+   * @brief A deep copy of a `VkSubmitInfo` or `VkSubmitInfo2`.
+   * @details Every array referenced by the submission is copied into storage owned by the copy. Storage is retained
+   *          when a copy is reassigned, so reusing copies doesn't allocate in the steady state. The copied
+   *          structure's `pNext` **MUST** be null, as **MUST** every `pNext` of its elements.
+   * @tparam Info The submission structure type.
+   */
+  template <typename Info>
+  class owned_submission final {
+  private:
+    template <typename Pointer>
+    using storage = std::vector<std::remove_cv_t<std::remove_pointer_t<Pointer>>>;
+
+    static constexpr bool legacy{ requires(const Info& info) { info.pWaitDstStageMask; } };
+
+    template <typename Pointer>
+    static void copy(storage<Pointer>& destination, const Pointer source, const std::uint32_t count) {
+      destination.assign(source, source + count);
+    }
+
+    template <typename Current>
+    struct legacy_arrays final {
+      storage<decltype(Current{ }.pWaitSemaphores)> waits{ };
+      storage<decltype(Current{ }.pWaitDstStageMask)> stages{ };
+      storage<decltype(Current{ }.pCommandBuffers)> buffers{ };
+      storage<decltype(Current{ }.pSignalSemaphores)> signals{ };
+    };
+
+    template <typename Current>
+    struct modern_arrays final {
+      storage<decltype(Current{ }.pWaitSemaphoreInfos)> waits{ };
+      storage<decltype(Current{ }.pCommandBufferInfos)> buffers{ };
+      storage<decltype(Current{ }.pSignalSemaphoreInfos)> signals{ };
+    };
+
+    Info m_info{ };
+    std::conditional_t<legacy, legacy_arrays<Info>, modern_arrays<Info>> m_arrays{ };
+  public:
+    /**
+     * @brief Determine whether or not a submission can be copied.
+     * @param info The submission to check.
+     * @return True if neither the submission nor any of its elements extend a `pNext` chain. Otherwise false.
+     */
+    static bool copyable(const Info& info) noexcept {
+      if (info.pNext)
+      {
+        return false;
+      }
+      if constexpr (legacy)
+      {
+        return true;
+      }
+      else
+      {
+        const auto chained = [](const auto& element) { return element.pNext != nullptr; };
+        return std::none_of(info.pWaitSemaphoreInfos, info.pWaitSemaphoreInfos + info.waitSemaphoreInfoCount,
+                            chained) &&
+               std::none_of(info.pCommandBufferInfos, info.pCommandBufferInfos + info.commandBufferInfoCount,
+                            chained) &&
+               std::none_of(info.pSignalSemaphoreInfos, info.pSignalSemaphoreInfos + info.signalSemaphoreInfoCount,
+                            chained);
+      }
+    }
+
+    /**
+     * @brief Replace the copy's contents.
+     * @param info The submission to copy. This **MUST** be copyable().
+     */
+    void assign(const Info& info) {
+      m_info = info;
+      if constexpr (legacy)
+      {
+        copy(m_arrays.waits, info.pWaitSemaphores, info.waitSemaphoreCount);
+        copy(m_arrays.stages, info.pWaitDstStageMask, info.waitSemaphoreCount);
+        copy(m_arrays.buffers, info.pCommandBuffers, info.commandBufferCount);
+        copy(m_arrays.signals, info.pSignalSemaphores, info.signalSemaphoreCount);
+        m_info.pWaitSemaphores = m_arrays.waits.data();
+        m_info.pWaitDstStageMask = m_arrays.stages.data();
+        m_info.pCommandBuffers = m_arrays.buffers.data();
+        m_info.pSignalSemaphores = m_arrays.signals.data();
+      }
+      else
+      {
+        copy(m_arrays.waits, info.pWaitSemaphoreInfos, info.waitSemaphoreInfoCount);
+        copy(m_arrays.buffers, info.pCommandBufferInfos, info.commandBufferInfoCount);
+        copy(m_arrays.signals, info.pSignalSemaphoreInfos, info.signalSemaphoreInfoCount);
+        m_info.pWaitSemaphoreInfos = m_arrays.waits.data();
+        m_info.pCommandBufferInfos = m_arrays.buffers.data();
+        m_info.pSignalSemaphoreInfos = m_arrays.signals.data();
+      }
+    }
+
+    /**
+     * @brief Retrieve the copied submission.
+     * @return A submission that references the copy's storage.
+     */
+    const Info& info() const noexcept {
+      return m_info;
+    }
+
+    /**
+     * @brief Determine whether or not the submission signals a semaphore.
+     * @param semaphore The semaphore handle to check.
+     * @return True if `semaphore` is among the submission's signal operations. Otherwise false.
+     */
+    template <typename Semaphore>
+    bool signals(const Semaphore semaphore) const noexcept {
+      if constexpr (legacy)
+      {
+        return std::find(m_arrays.signals.begin(), m_arrays.signals.end(), semaphore) != m_arrays.signals.end();
+      }
+      else
+      {
+        return std::any_of(m_arrays.signals.begin(), m_arrays.signals.end(), [&](const auto& element) {
+          return element.semaphore == semaphore;
+        });
+      }
+    }
+
+    /**
+     * @brief Invoke a function on every semaphore a submission waits on.
+     * @param info The submission to inspect.
+     * @param function The function to invoke with each semaphore handle.
+     */
+    template <typename Function>
+    static void for_each_wait(const Info& info, Function&& function) {
+      if constexpr (legacy)
+      {
+        std::for_each(info.pWaitSemaphores, info.pWaitSemaphores + info.waitSemaphoreCount, function);
+      }
+      else
+      {
+        std::for_each(info.pWaitSemaphoreInfos, info.pWaitSemaphoreInfos + info.waitSemaphoreInfoCount,
+                      [&](const auto& element) { function(element.semaphore); });
+      }
+    }
+  };
+
+}
+
+#endif
+/// @endcond
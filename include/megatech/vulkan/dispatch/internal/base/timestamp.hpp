@@ -0,0 +1,87 @@
+/// @cond INTERNAL
+/**
+ * @file timestamp.hpp
+ * @brief Low Overhead Timestamps
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_TIMESTAMP_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_TIMESTAMP_HPP
+
+#include <cinttypes>
+
+#include <chrono>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  #include <intrin.h>
+  #define MEGATECH_VULKAN_DISPATCH_INTERNAL_HAS_TSC (1)
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #include <x86intrin.h>
+  #define MEGATECH_VULKAN_DISPATCH_INTERNAL_HAS_TSC (1)
+#endif
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief Read a monotonic timestamp as cheaply as possible.
+   * @details On x86 this reads the time-stamp counter. Modern x86 processors provide an invariant TSC, so the result
+   *          is monotonic and ticks at a constant rate. On other architectures this falls back to
+   *          `std::chrono::steady_clock` and the result is in nanoseconds. In either case, the rate **MUST** be
+   *          calibrated (see ::timestamp_calibration) before converting ticks to time.
+   * @return A timestamp in implementation defined ticks.
+   */
+  inline std::uint64_t timestamp() noexcept {
+#ifdef MEGATECH_VULKAN_DISPATCH_INTERNAL_HAS_TSC
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+  }
+
+  /**
+   * @brief A linear mapping from ::timestamp() ticks to `std::chrono::steady_clock` nanoseconds.
+   * @details The mapping is established between a reference point recorded at construction and the most recent
+   *          call to ::update(). Longer intervals yield more accurate rates.
+   */
+  class timestamp_calibration final {
+  private:
+    std::uint64_t m_origin_ticks{ timestamp() };
+    std::int64_t m_origin_ns{ std::chrono::steady_clock::now().time_since_epoch().count() };
+    double m_ns_per_tick{ 1.0 };
+  public:
+    /**
+     * @brief Update the rate using the current time as the second reference point.
+     */
+    void update() noexcept {
+      const auto ticks = timestamp();
+      const auto ns = std::chrono::steady_clock::now().time_since_epoch().count();
+      if (ticks > m_origin_ticks && ns > m_origin_ns)
+      {
+        m_ns_per_tick = static_cast<double>(ns - m_origin_ns) / static_cast<double>(ticks - m_origin_ticks);
+      }
+    }
+
+    /**
+     * @brief Convert a duration in ticks to nanoseconds.
+     * @param ticks A number of ticks.
+     * @return The equivalent number of nanoseconds.
+     */
+    double nanoseconds(const std::uint64_t ticks) const noexcept {
+      return static_cast<double>(ticks) * m_ns_per_tick;
+    }
+
+    /**
+     * @brief Convert a timestamp to nanoseconds since the reference point.
+     * @param ticks A value returned by ::timestamp().
+     * @return The number of nanoseconds between the reference point and `ticks`. This **MAY** be negative.
+     */
+    double since_origin(const std::uint64_t ticks) const noexcept {
+      return (static_cast<double>(ticks) - static_cast<double>(m_origin_ticks)) * m_ns_per_tick;
+    }
+  };
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,222 @@
+/// @cond INTERNAL
+/**
+ * @file trampolines.hpp
+ * @brief Named Per-Command Trampolines
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_TRAMPOLINES_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_TRAMPOLINES_HPP
+
+#include <cstddef>
+
+#include <array>
+#include <type_traits>
+#include <utility>
+
+#include "../../defs.hpp"
+#include "../../commands.hpp"
+
+#include "probes.hpp"
+#include "slots.hpp"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+  #include <intrin.h>
+  #define MEGATECH_VULKAN_DISPATCH_NOINLINE __declspec(noinline)
+  #define MEGATECH_VULKAN_DISPATCH_ALWAYS_INLINE __forceinline
+#else
+  #define MEGATECH_VULKAN_DISPATCH_NOINLINE __attribute__((noinline))
+  #define MEGATECH_VULKAN_DISPATCH_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief Prevent the compiler from moving memory accesses across the call site or eliminating the code after it.
+   */
+  MEGATECH_VULKAN_DISPATCH_ALWAYS_INLINE void compiler_barrier() noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+    _ReadWriteBarrier();
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+  }
+
+  /**
+   * @brief Forward a call from a trampoline to the function pointer it replaced.
+   * @details The compiler barrier following the call prevents the compiler from turning it into a tail call. This
+   *          keeps the trampoline's frame, and so its name, on the stack while the target runs.
+   * @tparam Owner The type of the object that owns the trampoline.
+   * @tparam Slot The slot that the owner is bound to.
+   * @tparam Cmd The command being called.
+   * @tparam Result The result type of the command.
+   * @tparam Arguments The argument types of the command.
+   * @param arguments The arguments of the call.
+   * @return The result of the call.
+   */
+  template <typename Owner, std::size_t Slot, auto Cmd, typename Result, typename... Arguments>
+  MEGATECH_VULKAN_DISPATCH_ALWAYS_INLINE Result relay(Arguments... arguments) {
+    using pointer = Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...);
+    MEGATECH_VULKAN_DISPATCH_PROBE_SCOPE(Cmd, arguments...);
+    const auto target = reinterpret_cast<pointer>(Owner::template target<Slot>(static_cast<std::size_t>(Cmd)));
+    if constexpr (std::is_void_v<Result>)
+    {
+      target(arguments...);
+      compiler_barrier();
+    }
+    else
+    {
+      const auto result = target(arguments...);
+      compiler_barrier();
+      return result;
+    }
+  }
+
+  /**
+   * @brief A mapping from a command to its named trampoline.
+   * @details Every specialization provides `symbol`, the unqualified name of the trampoline, and `pointer`, a
+   *          variable template yielding the trampoline's address for a given owner, slot, and signature.
+   * @tparam Cmd The command to map.
+   */
+  template <auto Cmd>
+  struct trampoline;
+
+}
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_TRAMPOLINE(level, name) \
+  template <typename Owner, std::size_t Slot, typename Result, typename... Arguments> \
+  MEGATECH_VULKAN_DISPATCH_NOINLINE MEGATECH_VULKAN_DISPATCH_API_ATTR Result MEGATECH_VULKAN_DISPATCH_API_CALL \
+  mvd_trampoline_##name(Arguments... arguments) { \
+    return relay<Owner, Slot, dispatch::level::command::name, Result, Arguments...>(arguments...); \
+  }
+
+#define MEGATECH_VULKAN_DISPATCH_TRAMPOLINE_SPECIALIZATION(level, name) \
+  template <> \
+  struct trampoline<dispatch::level::command::name> final { \
+    static constexpr const char* symbol{ "mvd_trampoline_" #name }; \
+    template <typename Owner, std::size_t Slot, typename Result, typename... Arguments> \
+    static constexpr auto pointer = &trampolines::level::mvd_trampoline_##name<Owner, Slot, Result, Arguments...>; \
+  };
+/// @endcond
+
+namespace megatech::vulkan::dispatch::internal::base::trampolines::instance {
+
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) MEGATECH_VULKAN_DISPATCH_TRAMPOLINE(instance, name)
+  MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_LIST
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+}
+
+namespace megatech::vulkan::dispatch::internal::base::trampolines::device {
+
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) MEGATECH_VULKAN_DISPATCH_TRAMPOLINE(device, name)
+  MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+}
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) MEGATECH_VULKAN_DISPATCH_TRAMPOLINE_SPECIALIZATION(instance, name)
+  MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_LIST
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) MEGATECH_VULKAN_DISPATCH_TRAMPOLINE_SPECIALIZATION(device, name)
+  MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+}
+
+#undef MEGATECH_VULKAN_DISPATCH_TRAMPOLINE_SPECIALIZATION
+#undef MEGATECH_VULKAN_DISPATCH_TRAMPOLINE
+#undef MEGATECH_VULKAN_DISPATCH_ALWAYS_INLINE
+#undef MEGATECH_VULKAN_DISPATCH_NOINLINE
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief The common implementation of trampoline dispatch tables.
+   * @details A command only receives a trampoline once it is routed. Every other entry remains the function pointer
+   *          resolved by the base table. Each live routing binds itself to one of a fixed number of global slots,
+   *          which is how its trampolines find their targets.
+   * @tparam Command The command enumeration type of the level being routed.
+   * @tparam Count The number of commands at the level being routed.
+   */
+  template <typename Command, std::size_t Count>
+  class routing final {
+  private:
+    using bindings = slots<routing>;
+
+    std::array<PFN_vkVoidFunction, Count> m_pfns{ };
+    std::array<PFN_vkVoidFunction, Count> m_targets{ };
+    std::size_t m_slot{ bindings::count };
+
+    template <Command Cmd, typename Result, typename... Arguments>
+    void install(Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(Arguments...)) noexcept {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The routed command must be valid.");
+      static const auto addresses = []<std::size_t... Slots>(std::index_sequence<Slots...>) {
+        return std::array<PFN_vkVoidFunction, bindings::count>{
+          reinterpret_cast<PFN_vkVoidFunction>(trampoline<Cmd>::template pointer<routing, Slots, Result,
+                                                                                 Arguments...>)...
+        };
+      }(std::make_index_sequence<bindings::count>{});
+      if (m_targets[index])
+      {
+        m_pfns[index] = addresses[m_slot];
+      }
+    }
+  public:
+    template <typename Table>
+    explicit routing(const Table& base) {
+      for (auto i = std::size_t{ 0 }; i < Count; ++i)
+      {
+        m_targets[i] = *reinterpret_cast<const PFN_vkVoidFunction*>(base.get(static_cast<Command>(i)));
+      }
+      m_pfns = m_targets;
+      m_slot = bindings::bind(this);
+    }
+
+    routing(const routing& other) = delete;
+    routing(routing&& other) = delete;
+
+    ~routing() noexcept {
+      bindings::release(m_slot);
+    }
+
+    routing& operator=(const routing& rhs) = delete;
+    routing& operator=(routing&& rhs) = delete;
+
+    template <std::size_t Slot>
+    static PFN_vkVoidFunction target(const std::size_t index) noexcept {
+      return bindings::template get<Slot>()->m_targets[index];
+    }
+
+    template <Command Cmd, command_pointer Pointer>
+    void route() noexcept {
+      install<Cmd>(static_cast<Pointer>(nullptr));
+    }
+
+    template <Command Cmd>
+    void restore() noexcept {
+      constexpr auto index = static_cast<std::size_t>(Cmd);
+      static_assert(index < Count, "The restored command must be valid.");
+      m_pfns[index] = m_targets[index];
+    }
+
+    bool routed(const Command cmd) const noexcept {
+      const auto index = static_cast<std::size_t>(cmd);
+      return index < Count && m_pfns[index] != m_targets[index];
+    }
+
+    const PFN_vkVoidFunction* slot(const std::size_t index) const noexcept {
+      return &m_pfns[index];
+    }
+  };
+
+}
+
+#endif
+/// @endcond
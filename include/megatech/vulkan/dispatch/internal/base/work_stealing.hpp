@@ -0,0 +1,180 @@
+/// @cond INTERNAL
+/**
+ * @file work_stealing.hpp
+ * @brief Work-Stealing Thread Pools
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_WORK_STEALING_HPP
+#define MEGATECH_VULKAN_DISPATCH_INTERNAL_BASE_WORK_STEALING_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "per_thread.hpp"
+
+namespace megatech::vulkan::dispatch::internal::base {
+
+  /**
+   * @brief A fixed-size pool of threads that balance work by stealing it from each other.
+   * @details Each worker owns a double-ended queue. Tasks submitted by a worker are pushed onto its own queue, and
+   *          other tasks are distributed round-robin. A worker runs the newest task in its own queue first, and steals
+   *          the oldest task from another worker's queue when its own is empty. Idle workers sleep until a task is
+   *          submitted.
+   *
+   *          Queues are guarded by their own mutexes, so workers only contend when stealing. Every submitted task is
+   *          run before the pool is destroyed.
+   * @tparam Task The type of tasks. This **MUST** be move constructible and invocable with no arguments.
+   */
+  template <std::move_constructible Task>
+  requires std::invocable<Task&>
+  class work_stealing_pool final {
+  private:
+    struct alignas(cache_line_size) worker_queue final {
+      std::mutex mutex{ };
+      std::deque<Task> tasks{ };
+    };
+
+    struct identity final {
+      const work_stealing_pool* pool{ };
+      std::size_t index{ };
+    };
+
+    static inline thread_local identity t_identity{ };
+
+    std::unique_ptr<worker_queue[]> m_queues{ };
+    std::size_t m_size{ };
+    std::atomic<std::size_t> m_next{ };
+    std::atomic<std::size_t> m_pending{ };
+    std::mutex m_sleep_mutex{ };
+    std::condition_variable_any m_wake{ };
+    std::vector<std::jthread> m_workers{ };
+
+    std::optional<Task> take(const std::size_t index) {
+      {
+        auto& own = m_queues[index];
+        auto lock = std::unique_lock{ own.mutex };
+        if (!own.tasks.empty())
+        {
+          auto result = std::optional<Task>{ std::move(own.tasks.back()) };
+          own.tasks.pop_back();
+          m_pending.fetch_sub(1, std::memory_order_relaxed);
+          return result;
+        }
+      }
+      for (auto offset = std::size_t{ 1 }; offset < m_size; ++offset)
+      {
+        auto& victim = m_queues[(index + offset) % m_size];
+        auto lock = std::unique_lock{ victim.mutex, std::try_to_lock };
+        if (lock && !victim.tasks.empty())
+        {
+          auto result = std::optional<Task>{ std::move(victim.tasks.front()) };
+          victim.tasks.pop_front();
+          m_pending.fetch_sub(1, std::memory_order_relaxed);
+          return result;
+        }
+      }
+      return std::nullopt;
+    }
+
+    void work(const std::stop_token stop, const std::size_t index) {
+      t_identity = identity{ this, index };
+      while (true)
+      {
+        if (auto task = take(index); task)
+        {
+          (*task)();
+          continue;
+        }
+        // Stealing uses try_lock, so a task may be missed while another worker holds its queue. Pending counts every
+        // queued task, so the worker only sleeps when there is truly nothing to do.
+        if (m_pending.load(std::memory_order_acquire))
+        {
+          std::this_thread::yield();
+          continue;
+        }
+        if (stop.stop_requested())
+        {
+          return;
+        }
+        auto lock = std::unique_lock{ m_sleep_mutex };
+        m_wake.wait(lock, stop, [this]() { return m_pending.load(std::memory_order_acquire) > 0; });
+      }
+    }
+  public:
+    /**
+     * @brief Construct a work-stealing pool.
+     * @param size The number of worker threads. This **MUST** be greater than zero.
+     */
+    explicit work_stealing_pool(const std::size_t size) :
+    m_queues{ std::make_unique<worker_queue[]>(size) },
+    m_size{ size } {
+      m_workers.reserve(size);
+      for (auto i = std::size_t{ 0 }; i < size; ++i)
+      {
+        m_workers.emplace_back([this, i](const std::stop_token stop) { work(stop, i); });
+      }
+    }
+
+    work_stealing_pool(const work_stealing_pool& other) = delete;
+    work_stealing_pool(work_stealing_pool&& other) = delete;
+
+    ~work_stealing_pool() noexcept {
+      // Workers drain every queue before they observe the stop request.
+      for (auto& worker : m_workers)
+      {
+        worker.request_stop();
+      }
+      m_workers.clear();
+    }
+
+    work_stealing_pool& operator=(const work_stealing_pool& rhs) = delete;
+    work_stealing_pool& operator=(work_stealing_pool&& rhs) = delete;
+
+    /**
+     * @brief Submit a task to the pool.
+     * @details This is safe to call concurrently, including from tasks.
+     * @param task The task to run.
+     */
+    void submit(Task task) {
+      const auto index = t_identity.pool == this ? t_identity.index :
+                                                   m_next.fetch_add(1, std::memory_order_relaxed) % m_size;
+      {
+        auto& target = m_queues[index];
+        auto lock = std::unique_lock{ target.mutex };
+        target.tasks.emplace_back(std::move(task));
+        m_pending.fetch_add(1, std::memory_order_release);
+      }
+      // Taking the sleep mutex orders the increment before any worker's check of its wait predicate.
+      {
+        auto lock = std::unique_lock{ m_sleep_mutex };
+      }
+      m_wake.notify_one();
+    }
+
+    /**
+     * @brief Retrieve the number of worker threads.
+     * @return The number of workers in the pool.
+     */
+    std::size_t size() const noexcept {
+      return m_size;
+    }
+  };
+
+}
+
+#endif
+/// @endcond
@@ -0,0 +1,403 @@
+/**
+ * @file pipeline_caches.hpp
+ * @brief Vulkan Persistent Pipeline Caches
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_PIPELINE_CACHES_HPP
+#define MEGATECH_VULKAN_DISPATCH_PIPELINE_CACHES_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "tables.hpp"
+
+#include "internal/base/fnv_1a.hpp"
+#include "internal/base/per_thread.hpp"
+#include "internal/base/pipeline_caches.hpp"
+#include "internal/base/slots.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+  /**
+   * @brief A file that persists the contents of a pipeline cache for a single driver.
+   * @details Pipeline cache data is only usable by the driver that produced it, so each file is named after the
+   *          vendor ID, device ID, and `pipelineCacheUUID` of a physical device. Data read from a file is also checked
+   *          against the header that every Vulkan pipeline cache begins with, because some drivers crash instead of
+   *          rejecting foreign data.
+   *
+   *          Files are read with a memory mapping where one is available. They are written to a temporary file in the
+   *          same directory that is then renamed over the old file, so readers (including other processes) only ever
+   *          see complete files.
+   */
+  class pipeline_cache_file final {
+  private:
+    struct mapping;
+
+    std::filesystem::path m_path{ };
+    std::uint32_t m_vendor{ };
+    std::uint32_t m_device{ };
+    std::array<std::uint8_t, 16> m_uuid{ };
+    std::unique_ptr<mapping> m_mapping{ };
+  public:
+    /**
+     * @brief Construct a pipeline cache file.
+     * @details The file isn't accessed until it is read or written.
+     * @param directory The directory that holds the file. It is created when the file is written, if necessary.
+     * @param vendor The `vendorID` of the physical device.
+     * @param device The `deviceID` of the physical device.
+     * @param uuid The `pipelineCacheUUID` of the physical device.
+     */
+    pipeline_cache_file(const std::filesystem::path& directory, const std::uint32_t vendor, const std::uint32_t device,
+                        const std::span<const std::uint8_t, 16> uuid);
+
+    /// @cond
+    pipeline_cache_file(const pipeline_cache_file& other) = delete;
+    pipeline_cache_file(pipeline_cache_file&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a pipeline cache file.
+     * @details Any data that was read from the file is unmapped.
+     */
+    ~pipeline_cache_file() noexcept;
+
+    /// @cond
+    pipeline_cache_file& operator=(const pipeline_cache_file& rhs) = delete;
+    pipeline_cache_file& operator=(pipeline_cache_file&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Retrieve the path of the file.
+     * @return The path of the file within its directory.
+     */
+    const std::filesystem::path& path() const noexcept;
+
+    /**
+     * @brief Read the contents of the file.
+     * @details A missing, unreadable, or incompatible file is treated as an empty pipeline cache. The previous result
+     *          of read() is invalidated.
+     * @return The pipeline cache data held by the file. This remains valid until the next read or until the file
+     *         object is destroyed, even if the file is replaced in the meantime.
+     */
+    std::span<const std::byte> read();
+
+    /**
+     * @brief Replace the contents of the file.
+     * @details This is safe to call concurrently, including from other processes. The last replacement wins. Where
+     *          POSIX file APIs are available, the new contents and the rename are both synchronized to storage before
+     *          this returns.
+     * @param data The pipeline cache data to write.
+     * @throw dispatch::error If the directory can't be created, if the file can't be written, or if the replacement
+     *                        can't be synchronized.
+     */
+    void write(const std::span<const std::byte> data) const;
+  };
+
+}
+
+namespace megatech::vulkan::dispatch::device {
+
+  /**
+   * @brief A pipeline cache that persists across runs and that can be used by many threads without contention.
+   * @details A manager loads a pipeline_cache_file into a merged ::VkPipelineCache when it is constructed. Each thread
+   *          that retrieves a cache with local() receives its own ::VkPipelineCache, which starts with the loaded data.
+   *          Pipelines created by different threads therefore never contend for a single cache's internal lock. For
+   *          example:
+   *          @code{.cpp}
+   *          using manager = pipeline_cache_manager<PFN_vkCreatePipelineCache>;
+   *          auto properties = VkPhysicalDeviceProperties{ };
+   *          vkGetPhysicalDeviceProperties(physical_device, &properties);
+   *          auto caches = manager{ ddt, properties, "pipeline-caches" };
+   *          // On any thread:
+   *          vkCreateGraphicsPipelines(device, caches.local(), 1, &info, nullptr, &pipeline);
+   *          // At a convenient point (and automatically on destruction):
+   *          caches.save();
+   *          @endcode
+   *
+   *          Per-thread caches that have been retrieved since the last merge are merged into the merged cache by a
+   *          background thread at a fixed interval, and failed background merges are discarded. save() merges every
+   *          per-thread cache, so pipelines created after a thread's last call to local() are never lost. Per-thread
+   *          caches are retained when their threads exit and are adopted by later threads.
+   *
+   *          The manager is safe to use concurrently. It **MUST NOT** be destroyed while pipelines are being created
+   *          with its caches.
+   * @tparam Create The function pointer type of `vkCreatePipelineCache` (i.e., `PFN_vkCreatePipelineCache`).
+   */
+  template <internal::base::command_pointer Create>
+  class pipeline_cache_manager final {
+  private:
+    using signature = internal::base::pipeline_cache_signature<Create>;
+  public:
+    /**
+     * @brief The result type of pipeline cache commands (i.e., `VkResult`).
+     */
+    using result = typename signature::result;
+
+    /**
+     * @brief The pipeline cache handle type (i.e., `VkPipelineCache`).
+     */
+    using cache = typename signature::cache;
+
+    /**
+     * @brief The pipeline cache creation structure type (i.e., `VkPipelineCacheCreateInfo`).
+     */
+    using create_info = typename signature::info;
+  private:
+    // Locals are value-initialized by internal::base::per_thread.
+    struct local_cache final {
+      std::atomic<cache> handle;
+      std::atomic<bool> used;
+    };
+
+    typename signature::device m_device{ };
+    Create m_create{ };
+    typename signature::destroy m_destroy{ };
+    typename signature::data m_data{ };
+    typename signature::merge m_merge{ };
+    pipeline_cache_file m_file;
+    std::span<const std::byte> m_initial{ };
+    cache m_cache{ };
+    mutable std::mutex m_mutex{ };
+    std::vector<cache> m_sources{ };
+    std::uint64_t m_merged{ };
+    internal::base::per_thread<local_cache> m_locals{ };
+    std::jthread m_merger{ };
+
+    template <typename Pointer>
+    static Pointer resolve(const table& base, const std::uint_least64_t hash) noexcept {
+      const auto pfn = static_cast<const Pointer*>(base.get(hash));
+      return pfn ? *pfn : nullptr;
+    }
+
+    cache create(const std::span<const std::byte> initial) const {
+      auto info = create_info{ };
+      info.sType = static_cast<decltype(info.sType)>(internal::base::pipeline_cache_create_info_type);
+      info.initialDataSize = initial.size();
+      info.pInitialData = initial.data();
+      auto created = cache{ };
+      if (m_create(m_device, &info, nullptr, &created) == result{ })
+      {
+        return created;
+      }
+      // Drivers may reject stale data instead of ignoring it. An empty cache is still useful.
+      info.initialDataSize = 0;
+      info.pInitialData = nullptr;
+      created = cache{ };
+      if (initial.empty() || m_create(m_device, &info, nullptr, &created) != result{ })
+      {
+        throw dispatch::error{ "A pipeline cache could not be created." };
+      }
+      return created;
+    }
+
+    // m_mutex must be held.
+    void merge_locals(const bool everything) {
+      m_sources.clear();
+      m_locals.for_each([&](local_cache& current) {
+        if (current.used.exchange(false, std::memory_order_acq_rel) || everything)
+        {
+          if (const auto handle = current.handle.load(std::memory_order_acquire); handle)
+          {
+            m_sources.emplace_back(handle);
+          }
+        }
+      });
+      if (m_sources.empty())
+      {
+        return;
+      }
+      if (m_merge(m_device, m_cache, static_cast<std::uint32_t>(m_sources.size()), m_sources.data()) != result{ })
+      {
+        throw dispatch::error{ "Per-thread pipeline caches could not be merged." };
+      }
+      m_merged += m_sources.size();
+    }
+  public:
+    /**
+     * @brief Construct a pipeline cache manager.
+     * @tparam Properties The physical device properties type (i.e., `VkPhysicalDeviceProperties`).
+     * @param base The table whose pipeline cache commands are used. The table's ::VkDevice **MUST** remain valid for
+     *             the manager's entire lifetime.
+     * @param properties The properties of the table's physical device. These select the manager's cache file.
+     * @param directory The directory that holds cache files.
+     * @param interval The interval between background merges. If this is zero, per-thread caches are only merged by
+     *                 merge() and save().
+     * @throw dispatch::error If the table has no ::VkDevice, if any of `vkCreatePipelineCache`,
+     *                        `vkDestroyPipelineCache`, `vkGetPipelineCacheData`, or `vkMergePipelineCaches` was
+     *                        resolved to null, or if the merged cache can't be created.
+     */
+    template <typename Properties>
+    pipeline_cache_manager(const table& base, const Properties& properties, const std::filesystem::path& directory,
+                           const std::chrono::milliseconds interval = std::chrono::milliseconds{ 1000 }) :
+    m_device{ base.device() },
+    m_create{ resolve<Create>(base, internal::base::fnv_1a_cstr("vkCreatePipelineCache")) },
+    m_destroy{ resolve<typename signature::destroy>(base, internal::base::fnv_1a_cstr("vkDestroyPipelineCache")) },
+    m_data{ resolve<typename signature::data>(base, internal::base::fnv_1a_cstr("vkGetPipelineCacheData")) },
+    m_merge{ resolve<typename signature::merge>(base, internal::base::fnv_1a_cstr("vkMergePipelineCaches")) },
+    m_file{ directory, properties.vendorID, properties.deviceID, properties.pipelineCacheUUID } {
+      if (!m_device)
+      {
+        throw dispatch::error{ "Pipeline cache management requires a table with a VkDevice." };
+      }
+      if (!m_create || !m_destroy || !m_data || !m_merge)
+      {
+        throw dispatch::error{ "Pipeline cache management requires \"vkCreatePipelineCache\", "
+                               "\"vkDestroyPipelineCache\", \"vkGetPipelineCacheData\", and "
+                               "\"vkMergePipelineCaches\"." };
+      }
+      m_initial = m_file.read();
+      m_cache = create(m_initial);
+      if (interval.count() > 0)
+      {
+        m_merger = std::jthread{ [this, interval](std::stop_token stop) {
+          auto mutex = std::mutex{ };
+          auto condition = std::condition_variable_any{ };
+          auto lock = std::unique_lock{ mutex };
+          while (!condition.wait_for(lock, stop, interval, [&]() { return stop.stop_requested(); }))
+          {
+            try
+            {
+              merge();
+            }
+            catch (const dispatch::error&)
+            {
+              // save() merges every per-thread cache regardless, so a failed merge only delays persistence.
+            }
+          }
+        } };
+      }
+    }
+
+    /// @cond
+    pipeline_cache_manager(const pipeline_cache_manager& other) = delete;
+    pipeline_cache_manager(pipeline_cache_manager&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a pipeline cache manager.
+     * @details The background thread is stopped, the caches are saved, and every ::VkPipelineCache is destroyed.
+     *          Errors are discarded.
+     */
+    ~pipeline_cache_manager() noexcept {
+      if (m_merger.joinable())
+      {
+        m_merger.request_stop();
+        m_merger.join();
+      }
+      try
+      {
+        save();
+      }
+      catch (...)
+      {
+        // Destructors must not throw. Losing cache contents only costs recompilation.
+      }
+      m_locals.for_each([this](local_cache& current) {
+        m_destroy(m_device, current.handle.load(std::memory_order_acquire), nullptr);
+      });
+      m_destroy(m_device, m_cache, nullptr);
+    }
+
+    /// @cond
+    pipeline_cache_manager& operator=(const pipeline_cache_manager& rhs) = delete;
+    pipeline_cache_manager& operator=(pipeline_cache_manager&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Retrieve the calling thread's pipeline cache.
+     * @details The cache is created on the thread's first call. Subsequent calls only mark it for the next
+     *          background merge.
+     * @return A ::VkPipelineCache owned by the manager. This **SHOULD** only be used by the calling thread.
+     * @throw dispatch::error If the cache can't be created.
+     */
+    cache local() {
+      auto& current = m_locals.local();
+      auto handle = current.handle.load(std::memory_order_relaxed);
+      if (!handle)
+      {
+        handle = create(m_initial);
+        current.handle.store(handle, std::memory_order_release);
+      }
+      if (!current.used.load(std::memory_order_relaxed))
+      {
+        current.used.store(true, std::memory_order_release);
+      }
+      return handle;
+    }
+
+    /**
+     * @brief Merge every per-thread cache that has been retrieved since the last merge into the merged cache.
+     * @throw dispatch::error If the caches can't be merged.
+     */
+    void merge() {
+      auto lock = std::unique_lock{ m_mutex };
+      merge_locals(false);
+    }
+
+    /**
+     * @brief Merge every per-thread cache into the merged cache and write it to the manager's file.
+     * @throw dispatch::error If the caches can't be merged, if the merged cache's data can't be retrieved, or if the
+     *                        file can't be written.
+     */
+    void save() {
+      auto data = std::vector<std::byte>{ };
+      {
+        auto lock = std::unique_lock{ m_mutex };
+        merge_locals(true);
+        // The cache can grow between the size query and the data query if the driver adds to it concurrently.
+        auto status = static_cast<result>(internal::base::incomplete_result);
+        while (status == static_cast<result>(internal::base::incomplete_result))
+        {
+          auto size = std::size_t{ 0 };
+          if (m_data(m_device, m_cache, &size, nullptr) != result{ })
+          {
+            throw dispatch::error{ "The size of the merged pipeline cache could not be retrieved." };
+          }
+          data.resize(size);
+          status = m_data(m_device, m_cache, &size, data.data());
+          data.resize(size);
+        }
+        if (status != result{ })
+        {
+          throw dispatch::error{ "The data of the merged pipeline cache could not be retrieved." };
+        }
+      }
+      m_file.write(data);
+    }
+
+    /**
+     * @brief Count the per-thread cache merges.
+     * @return The total number of per-thread caches merged into the merged cache, counting each merge of each cache.
+     */
+    std::uint64_t merged() const {
+      auto lock = std::unique_lock{ m_mutex };
+      return m_merged;
+    }
+
+    /**
+     * @brief Retrieve the path of the manager's cache file.
+     * @return The path of the file that the manager loads from and saves to.
+     */
+    const std::filesystem::path& path() const noexcept {
+      return m_file.path();
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,265 @@
+/**
+ * @file policies.hpp
+ * @brief Vulkan Command Interception Policies
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_POLICIES_HPP
+#define MEGATECH_VULKAN_DISPATCH_POLICIES_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include "defs.hpp"
+#include "commands.hpp"
+#include "counters.hpp"
+#include "histograms.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
+
+#include "internal/base/call_sites.hpp"
+#include "internal/base/timestamp.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+  /**
+   * @brief An interception policy that counts calls.
+   * @details This is the compile-time equivalent of an instrumented_table.
+   * @tparam Command The command enumeration type of the level being intercepted.
+   * @tparam Count The number of commands at the level being intercepted.
+   */
+  template <typename Command, std::size_t Count>
+  class basic_counting_policy final {
+  private:
+    basic_call_counters<Command, Count> m_counters{ };
+  public:
+    /**
+     * @brief Count a call and continue the chain.
+     * @tparam Cmd The called command.
+     * @param next The remainder of the policy chain.
+     * @param arguments The arguments of the call.
+     * @return The result of `next`.
+     */
+    template <Command Cmd, typename Next, typename... Arguments>
+    decltype(auto) invoke(const Next& next, Arguments... arguments) {
+      m_counters.increment(Cmd);
+      return next(arguments...);
+    }
+
+    /**
+     * @brief Retrieve the policy's call counters.
+     * @return A reference to the counters updated by the policy.
+     */
+    const basic_call_counters<Command, Count>& counters() const noexcept {
+      return m_counters;
+    }
+
+    /**
+     * @brief Retrieve the policy's call counters.
+     * @return A reference to the counters updated by the policy.
+     */
+    basic_call_counters<Command, Count>& counters() noexcept {
+      return m_counters;
+    }
+  };
+
+  /**
+   * @brief An interception policy that records calls into a call_tracer.
+   * @details When no tracer is attached, the policy costs a single load and branch per call.
+   */
+  class tracing_policy final {
+  private:
+    call_tracer* m_tracer{ };
+  public:
+    /**
+     * @brief Time a call, if a tracer is attached, and continue the chain.
+     * @tparam Cmd The called command.
+     * @param next The remainder of the policy chain.
+     * @param arguments The arguments of the call.
+     * @return The result of `next`.
+     */
+    template <auto Cmd, typename Next, typename... Arguments>
+    decltype(auto) invoke(const Next& next, Arguments... arguments) {
+      if (!m_tracer) [[likely]]
+      {
+        return next(arguments...);
+      }
+      struct span final {
+        call_tracer* tracer{ };
+        std::uint64_t start{ internal::base::timestamp() };
+
+        ~span() noexcept {
+          tracer->record(Cmd, start, internal::base::timestamp());
+        }
+      };
+      const auto current = span{ m_tracer };
+      return next(arguments...);
+    }
+
+    /**
+     * @brief Attach a call_tracer to the policy.
+     * @details This **MUST NOT** be called concurrently with calls through the owning table.
+     * @param tracer A pointer to the tracer to attach or null.
+     */
+    void set_tracer(call_tracer *const tracer) noexcept {
+      m_tracer = tracer;
+    }
+
+    /**
+     * @brief Retrieve the call_tracer attached to the policy.
+     * @return A pointer to the attached tracer, or null if no tracer is attached.
+     */
+    call_tracer* tracer() const noexcept {
+      return m_tracer;
+    }
+  };
+
+  /**
+   * @brief An interception policy that records call latencies into a set of histograms.
+   * @details When no histograms are attached, the policy costs a single load and branch per call.
+   * @tparam Command The command enumeration type of the level being intercepted.
+   * @tparam Count The number of commands at the level being intercepted.
+   */
+  template <typename Command, std::size_t Count>
+  class basic_timing_policy final {
+  private:
+    basic_latency_histograms<Command, Count>* m_histograms{ };
+  public:
+    /**
+     * @brief Time a call, if histograms are attached, and continue the chain.
+     * @tparam Cmd The called command.
+     * @param next The remainder of the policy chain.
+     * @param arguments The arguments of the call.
+     * @return The result of `next`.
+     */
+    template <Command Cmd, typename Next, typename... Arguments>
+    decltype(auto) invoke(const Next& next, Arguments... arguments) {
+      if (!m_histograms) [[likely]]
+      {
+        return next(arguments...);
+      }
+      struct span final {
+        basic_latency_histograms<Command, Count>* histograms{ };
+        std::uint64_t start{ internal::base::timestamp() };
+
+        ~span() noexcept {
+          histograms->record(Cmd, internal::base::timestamp() - start);
+        }
+      };
+      const auto current = span{ m_histograms };
+      return next(arguments...);
+    }
+
+    /**
+     * @brief Attach a set of latency histograms to the policy.
+     * @details This **MUST NOT** be called concurrently with calls through the owning table.
+     * @param histograms A pointer to the histograms to attach or null.
+     */
+    void set_histograms(basic_latency_histograms<Command, Count> *const histograms) noexcept {
+      m_histograms = histograms;
+    }
+
+    /**
+     * @brief Retrieve the latency histograms attached to the policy.
+     * @return A pointer to the attached histograms, or null if no histograms are attached.
+     */
+    basic_latency_histograms<Command, Count>* histograms() const noexcept {
+      return m_histograms;
+    }
+  };
+
+  /**
+   * @brief An interception policy that attributes call time to call sites with a call_site_profiler.
+   * @details The recorded call site is published by the intercepted table's entry point rather than read inside the
+   *          policy, so it doesn't depend on how much of the chain the compiler inlines. For thunks installed by
+   *          `intercept()` this is the code that called the retrieved function pointer. For `call()` it is the return
+   *          address of `call()` (i.e., the caller's code, or the caller of the function that contains the call if
+   *          `call()` is inlined). Outside of an intercepted table, the policy falls back to its own return address.
+   *          When no profiler is attached, the policy costs a single load and branch per call.
+   */
+  class call_site_policy final {
+  private:
+    call_site_profiler* m_profiler{ };
+  public:
+    /**
+     * @brief Call site policies consume the call sites published by intercepted tables.
+     */
+    static constexpr bool consumes_call_sites{ true };
+
+    /**
+     * @brief Time a call, if a profiler is attached, and continue the chain.
+     * @tparam Cmd The called command.
+     * @param next The remainder of the policy chain.
+     * @param arguments The arguments of the call.
+     * @return The result of `next`.
+     */
+    template <auto Cmd, typename Next, typename... Arguments>
+    decltype(auto) invoke(const Next& next, Arguments... arguments) {
+      if (!m_profiler) [[likely]]
+      {
+        return next(arguments...);
+      }
+      struct span final {
+        call_site_profiler* profiler{ };
+        const void* site{ };
+        std::uint64_t start{ internal::base::timestamp() };
+
+        ~span() noexcept {
+          profiler->record(Cmd, site, internal::base::timestamp() - start);
+        }
+      };
+      const auto published = internal::base::current_call_site;
+      const auto current = span{ m_profiler, published ? published : MEGATECH_VULKAN_DISPATCH_RETURN_ADDRESS() };
+      return next(arguments...);
+    }
+
+    /**
+     * @brief Attach a call_site_profiler to the policy.
+     * @details This **MUST NOT** be called concurrently with calls through the owning table.
+     * @param profiler A pointer to the profiler to attach or null.
+     */
+    void set_profiler(call_site_profiler *const profiler) noexcept {
+      m_profiler = profiler;
+    }
+
+    /**
+     * @brief Retrieve the call_site_profiler attached to the policy.
+     * @return A pointer to the attached profiler, or null if no profiler is attached.
+     */
+    call_site_profiler* profiler() const noexcept {
+      return m_profiler;
+    }
+  };
+
+namespace instance {
+
+  /**
+   * @brief A policy that counts calls to instance-level Vulkan commands.
+   */
+  using counting_policy = basic_counting_policy<command, MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT>;
+
+  /**
+   * @brief A policy that records the latency of calls to instance-level Vulkan commands.
+   */
+  using timing_policy = basic_timing_policy<command, MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT>;
+
+}
+
+namespace device {
+
+  /**
+   * @brief A policy that counts calls to device-level Vulkan commands.
+   */
+  using counting_policy = basic_counting_policy<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT>;
+
+  /**
+   * @brief A policy that records the latency of calls to device-level Vulkan commands.
+   */
+  using timing_policy = basic_timing_policy<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT>;
+
+}
+
+}
+
+#endif
@@ -0,0 +1,175 @@
+/**
+ * @file profiler.hpp
+ * @brief Vulkan Command Call-Site Profiler
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_PROFILER_HPP
+#define MEGATECH_VULKAN_DISPATCH_PROFILER_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "defs.hpp"
+#include "commands.hpp"
+
+#include "internal/base/call_sites.hpp"
+#include "internal/base/timestamp.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+  /**
+   * @brief A profiler that attributes Vulkan command time to the code that made each call.
+   * @details Every recorded call is keyed by its call site (the return address of the thunk that received it) and its
+   *          command. Calls and cumulative time are accumulated in a fixed-capacity, open-addressed hash map. Inserting
+   *          a new key takes a single compare-and-swap and updating an existing key takes two atomic additions, so
+   *          recording never blocks. When the map is full, calls from new keys are dropped and counted.
+   *
+   *          Addresses are symbolized with `dladdr()` when ::report() is called. Symbols from stripped or static
+   *          code are reported as a module name and offset, which can be passed to `addr2line`.
+   *
+   *          Keys pack the call site into 48 bits. This holds for user-space addresses on every supported 64-bit
+   *          platform.
+   */
+  class call_site_profiler final {
+  public:
+    /**
+     * @brief The accumulated cost of a single call site.
+     */
+    struct call_site final {
+      /**
+       * @brief The return address of the call.
+       */
+      const void* address{ };
+
+      /**
+       * @brief The level of the called command (1 for instance commands, and 2 for device commands).
+       */
+      std::uint16_t level{ };
+
+      /**
+       * @brief The value of the called command.
+       */
+      std::uint16_t command{ };
+
+      /**
+       * @brief The name of the called command.
+       */
+      std::string name{ };
+
+      /**
+       * @brief The number of calls made from the call site.
+       */
+      std::uint64_t calls{ };
+
+      /**
+       * @brief The total time spent in the command, in nanoseconds, when called from the call site.
+       */
+      double nanoseconds{ };
+
+      /**
+       * @brief A human readable description of the call site (e.g., "engine::submit_frame()+0x4c (libengine.so)").
+       */
+      std::string symbol{ };
+    };
+  private:
+    // Entries are zero-initialized. A key of 0 marks an empty entry.
+    struct entry final {
+      std::atomic<std::uint64_t> key;
+      std::atomic<std::uint64_t> calls;
+      std::atomic<std::uint64_t> ticks;
+    };
+
+    template <typename Command>
+    static constexpr std::uint64_t level_of() noexcept {
+      if constexpr (std::is_same_v<Command, instance::command>)
+      {
+        return 1;
+      }
+      else
+      {
+        static_assert(std::is_same_v<Command, device::command>, "Only instance and device commands can be profiled.");
+        return 2;
+      }
+    }
+
+    static constexpr std::uint64_t site_mask{ (std::uint64_t{ 1 } << 48) - 1 };
+
+    static_assert(MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT < (1 << 14) &&
+                  MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT < (1 << 14),
+                  "Every command must fit in the 14 command bits of a call site key.");
+
+    std::unique_ptr<entry[]> m_entries{ };
+    std::size_t m_mask{ };
+    std::atomic<std::uint64_t> m_dropped{ };
+    mutable std::mutex m_mutex{ };
+    mutable internal::base::timestamp_calibration m_calibration{ };
+
+    void record(const std::uint64_t key, const std::uint64_t ticks) noexcept;
+  public:
+    /**
+     * @brief Construct a profiler.
+     * @param capacity The maximum number of distinct (call site, command) pairs. This is rounded up to a power of 2.
+     * @throw dispatch::error If `capacity` is zero.
+     */
+    explicit call_site_profiler(const std::size_t capacity = 4096);
+
+    /// @cond
+    call_site_profiler(const call_site_profiler& other) = delete;
+    call_site_profiler(call_site_profiler&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a profiler.
+     */
+    ~call_site_profiler() noexcept = default;
+
+    /// @cond
+    call_site_profiler& operator=(const call_site_profiler& rhs) = delete;
+    call_site_profiler& operator=(call_site_profiler&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Record a call.
+     * @tparam Command The command enumeration of the called command's level.
+     * @param cmd The called command.
+     * @param site The return address of the call.
+     * @param ticks The duration of the call in internal::base::timestamp() ticks.
+     */
+    template <typename Command>
+    void record(const Command cmd, const void *const site, const std::uint64_t ticks) noexcept {
+      const auto address = reinterpret_cast<std::uintptr_t>(site) & site_mask;
+      record((address << 16) | (level_of<Command>() << 14) | static_cast<std::uint64_t>(cmd), ticks);
+    }
+
+    /**
+     * @brief Produce a symbolized report of every recorded call site.
+     * @details This is safe to call concurrently with ::record().
+     * @return A list of call sites sorted from the most to the least total time.
+     */
+    std::vector<call_site> report() const;
+
+    /**
+     * @brief Discard all recorded calls.
+     * @details This **MUST NOT** be called concurrently with ::record().
+     */
+    void reset() noexcept;
+
+    /**
+     * @brief Retrieve the number of calls that were dropped because the map was full.
+     * @return The number of dropped calls.
+     */
+    std::uint64_t dropped() const noexcept;
+  };
+
+}
+
+#endif
@@ -0,0 +1,348 @@
+/**
+ * @file recording.hpp
+ * @brief Deferred Vulkan Command Recording
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_RECORDING_HPP
+#define MEGATECH_VULKAN_DISPATCH_RECORDING_HPP
+
+#include <cstddef>
+#include <cinttypes>
+#include <cstring>
+
+#include <array>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "commands.hpp"
+
+#include "internal/base/arguments.hpp"
+#include "internal/base/barriers.hpp"
+#include "internal/base/bytecode.hpp"
+#include "internal/base/fnv_1a.hpp"
+#include "internal/base/slots.hpp"
+
+namespace megatech::vulkan::dispatch::device {
+
+  /**
+   * @brief An arena-backed stream of recorded `vkCmd*` calls that can be replayed into command buffers.
+   * @details Streams stand in for command buffers. A stream's command_buffer() is passed to commands retrieved from a
+   *          deferred_table, which encode each call into the stream without calling the driver. The stream can later
+   *          be replayed into any number of real command buffers through any table. For example:
+   *          @code{.cpp}
+   *          auto dt = deferred_table{ };
+   *          dt.defer<command::vkCmdDraw, PFN_vkCmdDraw>();
+   *          auto stream = command_stream{ };
+   *          const auto vkCmdDraw = *reinterpret_cast<const PFN_vkCmdDraw*>(dt.get(command::vkCmdDraw));
+   *          vkCmdDraw(stream.command_buffer<VkCommandBuffer>(), 3, 1, 0, 0);
+   *          // Later, and possibly on another thread or more than once.
+   *          stream.replay(ddt, command_buffer);
+   *          @endcode
+   *
+   *          Each call is encoded as a header, one 8-byte word per argument, and a copy of every pointer argument's
+   *          payload. The length of an array argument is taken from the preceding count argument, as in the Vulkan
+   *          signature of every `vkCmd*` command. Payloads are copied deeply, so no memory passed to a recorded call
+   *          needs to outlive it. The pointer members of structures (e.g., `VkRenderPassBeginInfo::pClearValues` or
+   *          `VkDependencyInfo::pImageMemoryBarriers`) are described by hand, because the generator emits no structure
+   *          metadata. Commands that take undescribed structures can't be deferred, and calls whose structures have a
+   *          non-null `pNext` throw instead of being recorded. Handles are recorded by value.
+   *
+   *          Instructions are allocated from fixed-size chunks that are retained by clear(), so re-recording a stream
+   *          doesn't allocate once it has reached its steady-state size. Recording into a stream **MUST** be externally
+   *          synchronized. Replaying doesn't modify a stream and **MAY** happen concurrently on any number of threads.
+   */
+  class command_stream final {
+  private:
+    struct chunk final {
+      std::unique_ptr<std::byte[]> data{ };
+      std::size_t capacity{ };
+      std::size_t used{ };
+    };
+
+    std::vector<chunk> m_chunks{ };
+    std::size_t m_active{ };
+    std::size_t m_chunk_size{ };
+    std::size_t m_size{ };
+
+    std::byte* allocate(const std::size_t bytes) {
+      if (!m_chunks.empty() && m_chunks[m_active].capacity - m_chunks[m_active].used >= bytes)
+      {
+        const auto result = m_chunks[m_active].data.get() + m_chunks[m_active].used;
+        m_chunks[m_active].used += bytes;
+        return result;
+      }
+      // Chunks after the active chunk are empty. Oversized instructions receive a dedicated chunk.
+      const auto next = m_chunks.empty() ? 0 : m_active + 1;
+      if (next == m_chunks.size() || m_chunks[next].capacity < bytes)
+      {
+        const auto capacity = bytes > m_chunk_size ? bytes : m_chunk_size;
+        auto fresh = chunk{ std::make_unique_for_overwrite<std::byte[]>(capacity), capacity, 0 };
+        m_chunks.insert(m_chunks.begin() + next, std::move(fresh));
+      }
+      m_active = next;
+      m_chunks[m_active].used = bytes;
+      return m_chunks[m_active].data.get();
+    }
+  public:
+    /**
+     * @brief Construct an empty stream.
+     * @param chunk_size The size, in bytes, of each chunk of the stream's arena. Calls that don't fit in a single chunk
+     *                   are allocated separately.
+     * @throw dispatch::error If `chunk_size` is 0.
+     */
+    explicit command_stream(const std::size_t chunk_size = 64 * 1024) :
+    m_chunk_size{ internal::base::words_of(chunk_size) * sizeof(std::uint64_t) } {
+      if (!chunk_size)
+      {
+        throw dispatch::error{ "The chunk size of a command stream must be greater than 0." };
+      }
+    }
+
+    /// @cond
+    command_stream(const command_stream& other) = delete;
+    command_stream(command_stream&& other) = delete;
+
+    ~command_stream() noexcept = default;
+
+    command_stream& operator=(const command_stream& rhs) = delete;
+    command_stream& operator=(command_stream&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Retrieve a handle that identifies the stream to commands retrieved from a deferred_table.
+     * @details The handle **MUST NOT** be passed to the driver.
+     * @tparam CommandBuffer The command buffer handle type (i.e., `VkCommandBuffer`).
+     * @return A command buffer handle referring to the stream.
+     */
+    template <internal::base::handle CommandBuffer>
+    CommandBuffer command_buffer() noexcept {
+      return reinterpret_cast<CommandBuffer>(this);
+    }
+
+    /**
+     * @brief Encode a call.
+     * @details This is normally called by commands retrieved from a deferred_table.
+     * @tparam Cmd The called command. This **MUST** be a `vkCmd*` command.
+     * @param target The command buffer argument of the call. It isn't recorded.
+     * @param arguments The remaining arguments of the call.
+     * @throw dispatch::error If a structure in the call has a non-null `pNext` or otherwise cannot be copied. Nothing
+     *                        is recorded in that case.
+     */
+    template <command Cmd, internal::base::handle CommandBuffer, typename... Arguments>
+    void record([[maybe_unused]] const CommandBuffer target, const Arguments... arguments) {
+      static_assert(internal::base::recorded<Cmd>(), "Only vkCmd* commands can be recorded.");
+      static_assert(static_cast<std::size_t>(Cmd) <= UINT16_MAX, "The recorded command must fit in an instruction.");
+      static_assert(internal::base::encodable<Cmd, Arguments...>(), "The payloads of the command cannot be copied.");
+      const auto extents = internal::base::payload_extents<Cmd>(arguments...);
+      const auto words = internal::base::instruction_size(extents);
+      if (words > UINT32_MAX)
+      {
+        throw dispatch::error{ "The recorded call is too large to encode." };
+      }
+      auto header = internal::base::instruction{ };
+      header.replay = &internal::base::replay_instruction<CommandBuffer, Arguments...>;
+      header.command = static_cast<std::uint16_t>(Cmd);
+      internal::base::encode_instruction(allocate(words * sizeof(std::uint64_t)), header, extents, arguments...);
+      ++m_size;
+    }
+
+    /**
+     * @brief Record every call in the stream into a command buffer.
+     * @details Calls are made through `table` in the order in which they were recorded. This is safe to call
+     *          concurrently with other replays of the stream.
+     * @tparam Table The type of `table`. This **MAY** be any dispatch table that retrieves device commands (e.g.,
+     *               table or intercepted_table).
+     * @tparam CommandBuffer The command buffer handle type (i.e., `VkCommandBuffer`).
+     * @param table The table whose function pointers are called.
+     * @param target The command buffer to record into. It **MUST** be in the recording state.
+     * @throw dispatch::error If a recorded command was resolved to null by `table`.
+     */
+    template <typename Table, internal::base::handle CommandBuffer>
+    void replay(const Table& table, const CommandBuffer target) const {
+      const auto chunks = m_chunks.empty() ? 0 : m_active + 1;
+      for (auto i = std::size_t{ 0 }; i < chunks; ++i)
+      {
+        const auto data = m_chunks[i].data.get();
+        for (auto offset = std::size_t{ 0 }; offset < m_chunks[i].used;)
+        {
+          auto header = internal::base::instruction{ };
+          std::memcpy(&header, data + offset, sizeof(header));
+          header.replay(table.get(static_cast<command>(header.command)), target, data + offset);
+          offset += header.words * sizeof(std::uint64_t);
+        }
+      }
+    }
+
+    /**
+     * @brief Discard every recorded call.
+     * @details The stream's memory is retained for reuse. This **MUST NOT** be called concurrently with replay().
+     */
+    void clear() noexcept {
+      for (auto& current : m_chunks)
+      {
+        current.used = 0;
+      }
+      m_active = 0;
+      m_size = 0;
+    }
+
+    /**
+     * @brief Count the recorded calls.
+     * @return The number of calls recorded since construction or the last call to clear().
+     */
+    std::size_t size() const noexcept {
+      return m_size;
+    }
+
+    /**
+     * @brief Measure the recorded calls.
+     * @return The number of bytes used by the recorded calls.
+     */
+    std::size_t bytes() const noexcept {
+      auto result = std::size_t{ 0 };
+      for (const auto& current : m_chunks)
+      {
+        result += current.used;
+      }
+      return result;
+    }
+  };
+
+  /**
+   * @brief A device-level dispatch table whose commands record into a command_stream instead of calling the driver.
+   * @details Deferred tables expose the same interface as table, but every entry is null until it is deferred. A
+   *          deferred entry encodes each call into the command_stream identified by its command buffer argument. The
+   *          table has no device and makes no driver calls, so recording can happen before command pools or command
+   *          buffers exist. Deferred tables hold no per-stream state and **MAY** be shared between threads.
+   */
+  class deferred_table final {
+  private:
+    std::array<PFN_vkVoidFunction, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT> m_pfns{ };
+
+    template <command Cmd, typename CommandBuffer, typename... Arguments>
+    static MEGATECH_VULKAN_DISPATCH_API_ATTR void MEGATECH_VULKAN_DISPATCH_API_CALL thunk(CommandBuffer target,
+                                                                                          Arguments... arguments) {
+      reinterpret_cast<command_stream*>(target)->record<Cmd>(target, arguments...);
+    }
+
+    template <command Cmd, typename Result, typename CommandBuffer, typename... Arguments>
+    void install(Result (MEGATECH_VULKAN_DISPATCH_API_PTR*)(CommandBuffer, Arguments...)) noexcept {
+      static_assert(std::is_void_v<Result>, "Only commands without results can be deferred.");
+      m_pfns[static_cast<std::size_t>(Cmd)] =
+        reinterpret_cast<PFN_vkVoidFunction>(&thunk<Cmd, CommandBuffer, Arguments...>);
+    }
+  public:
+    /**
+     * @brief Construct a deferred table with no deferred commands.
+     */
+    deferred_table() = default;
+
+    /// @cond
+    deferred_table(const deferred_table& other) = delete;
+    deferred_table(deferred_table&& other) = delete;
+
+    ~deferred_table() noexcept = default;
+
+    deferred_table& operator=(const deferred_table& rhs) = delete;
+    deferred_table& operator=(deferred_table&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Record calls to a command into command streams.
+     * @details This **MUST NOT** be called concurrently with ::get() or with calls through the table. Commands whose
+     *          payloads can't be copied (e.g., `vkCmdBuildAccelerationStructuresKHR`) are rejected at compile time.
+     * @tparam Cmd The ::command to defer. This **MUST** be a `vkCmd*` command.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkCmdDraw`).
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void defer() noexcept {
+      static_assert(internal::base::recorded<Cmd>(), "Only vkCmd* commands can be deferred.");
+      install<Cmd>(static_cast<Pointer>(nullptr));
+    }
+
+    /**
+     * @brief Determine whether or not a command is deferred.
+     * @param cmd The ::command to check.
+     * @return True if calls to `cmd` are recorded into command streams. Otherwise false.
+     */
+    bool deferred(const command cmd) const noexcept {
+      return static_cast<std::size_t>(cmd) < size() && m_pfns[static_cast<std::size_t>(cmd)];
+    }
+
+    /**
+     * @brief Retrieve the size of the table.
+     * @return The number of commands held in the table.
+     */
+    constexpr std::size_t size() const noexcept {
+      return MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT;
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value is null unless the
+     *         command is deferred.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* get(const command cmd) const {
+      if (static_cast<std::size_t>(cmd) >= size())
+      {
+        throw dispatch::error{ "The input command is outside the valid range of possible device commnds." };
+      }
+      return &m_pfns[static_cast<std::size_t>(cmd)];
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value is null unless the
+     *         command is deferred.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* operator()(const command cmd) const {
+      return get(cmd);
+    }
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case dispatch::internal::base::fnv_1a_cstr(#name): return get(command::name);
+/// @endcond
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* get(const std::uint_least64_t hash) const noexcept {
+      switch (hash)
+      {
+      MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+      default:
+        return nullptr;
+      }
+    }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* operator()(const std::uint_least64_t hash) const noexcept {
+      return get(hash);
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * @file statistics.hpp
+ * @brief Vulkan Dispatch Table Construction Statistics
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_STATISTICS_HPP
+#define MEGATECH_VULKAN_DISPATCH_STATISTICS_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <array>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "defs.hpp"
+#include "commands.hpp"
+
+#include "internal/base/timestamp.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+  /**
+   * @brief An enumeration of dispatch table levels.
+   */
+  enum class table_level : std::uint8_t {
+    global,
+    instance,
+    device
+  };
+
+  /**
+   * @brief A sink for statistics gathered while constructing dispatch tables.
+   * @details Every table constructor has an overload that accepts a construction_statistics object. That overload
+   *          times itself and each individual call to the loader, and then records the results here. Statistics
+   *          accumulate across every table constructed with the same sink. For example:
+   *          @code{.cpp}
+   *          auto statistics = construction_statistics{ };
+   *          auto ddt = device::table{ gdt, idt, device, statistics };
+   *          const auto summary = statistics.report(table_level::device);
+   *          // Forward summary.nanoseconds, summary.slowest, etc. to startup telemetry.
+   *          @endcode
+   *
+   *          Recording takes a lock, but it happens once per table. Constructors that don't accept a sink are
+   *          unchanged.
+   */
+  class construction_statistics final {
+  public:
+    /**
+     * @brief The accumulated cost of resolving a single command.
+     */
+    struct resolution final {
+      /**
+       * @brief The name of the command.
+       */
+      const char* name{ };
+
+      /**
+       * @brief The number of times the command was resolved.
+       */
+      std::uint64_t count{ };
+
+      /**
+       * @brief The number of times the command was resolved to null.
+       */
+      std::uint64_t null_count{ };
+
+      /**
+       * @brief The total time, in nanoseconds, spent resolving the command.
+       */
+      double nanoseconds{ };
+    };
+
+    /**
+     * @brief A summary of every table constructed at a single level.
+     */
+    struct summary final {
+      /**
+       * @brief The number of tables constructed.
+       */
+      std::uint64_t tables{ };
+
+      /**
+       * @brief The total number of calls made to loader commands (e.g., `vkGetDeviceProcAddr`).
+       */
+      std::uint64_t loader_calls{ };
+
+      /**
+       * @brief The total number of table entries that were resolved to null.
+       */
+      std::uint64_t null_slots{ };
+
+      /**
+       * @brief The total time, in nanoseconds, spent constructing tables.
+       */
+      double nanoseconds{ };
+
+      /**
+       * @brief The commands that took the most total time to resolve, from the slowest to the fastest.
+       */
+      std::vector<resolution> slowest{ };
+    };
+  private:
+    struct level_statistics final {
+      std::uint64_t tables{ };
+      std::uint64_t loader_calls{ };
+      std::uint64_t null_slots{ };
+      std::uint64_t ticks{ };
+      std::vector<std::uint64_t> resolution_ticks{ };
+      std::vector<std::uint64_t> resolution_counts{ };
+      std::vector<std::uint64_t> null_counts{ };
+    };
+
+    mutable std::mutex m_mutex{ };
+    mutable internal::base::timestamp_calibration m_calibration{ };
+    std::array<level_statistics, 3> m_levels{ };
+  public:
+    /**
+     * @brief Construct an empty set of statistics.
+     */
+    construction_statistics() = default;
+
+    /// @cond
+    construction_statistics(const construction_statistics& other) = delete;
+    construction_statistics(construction_statistics&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a set of statistics.
+     */
+    ~construction_statistics() noexcept = default;
+
+    /// @cond
+    construction_statistics& operator=(const construction_statistics& rhs) = delete;
+    construction_statistics& operator=(construction_statistics&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Record the construction of a table.
+     * @details This is called by table constructors. It is safe to call concurrently.
+     * @param level The level of the constructed table.
+     * @param ticks The duration of each command's resolution in internal::base::timestamp() ticks. This is indexed by
+     *              command value.
+     * @param pfns The resolved function pointers. This is indexed by command value.
+     * @param loader_calls The number of calls made to loader commands.
+     * @param total The duration of the table's construction in internal::base::timestamp() ticks.
+     * @throw dispatch::error If the sizes of `ticks` and `pfns` differ.
+     */
+    void record(const table_level level, const std::span<const std::uint64_t> ticks,
+                const std::span<const PFN_vkVoidFunction> pfns, const std::uint64_t loader_calls,
+                const std::uint64_t total);
+
+    /**
+     * @brief Summarize every table constructed at a level.
+     * @param level The level to summarize.
+     * @param slowest The maximum number of commands to report in summary::slowest.
+     * @return A summary of the level.
+     */
+    summary report(const table_level level, const std::size_t slowest = 8) const;
+
+    /**
+     * @brief Discard all recorded statistics.
+     */
+    void reset() noexcept;
+  };
+
+}
+
+#endif
@@ -18,6 +18,8 @@
 
 namespace megatech::vulkan::dispatch {
 
+  class construction_statistics;
+
 namespace global {
 
   /**
@@ -26,6 +28,8 @@ namespace global {
   class table final {
   private:
     std::array<PFN_vkVoidFunction, MEGATECH_VULKAN_DISPATCH_GLOBAL_COMMAND_COUNT> m_pfns{ };
+
+    table(construction_statistics *const statistics, const PFN_vkGetInstanceProcAddr global);
   public:
     /**
      * @brief Construct a table.
@@ -39,6 +43,15 @@ namespace global {
      */
     explicit table(const PFN_vkGetInstanceProcAddr global);
 
+    /**
+     * @brief Construct a table and record statistics about its construction.
+     * @param global A global loader function that behaves like the standard `vkGetInstanceProcAddr()` function.
+     * @param statistics A sink for construction statistics.
+     * @throw dispatch::error If the value of `global` is null.
+     * @see table(const PFN_vkGetInstanceProcAddr)
+     */
+    table(const PFN_vkGetInstanceProcAddr global, construction_statistics& statistics);
+
     /**
      * @brief Copy a table.
      * @param other The table to copy.
@@ -201,6 +214,9 @@ namespace instance {
   private:
     VkInstance m_instance{ };
     std::array<PFN_vkVoidFunction, MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT> m_pfns{ };
+
+    table(construction_statistics *const statistics, const megatech::vulkan::dispatch::global::table& global,
+          const VkInstance instance);
   public:
     /**
      * @brief Construct a table.
@@ -213,6 +229,17 @@ namespace instance {
      */
     table(const megatech::vulkan::dispatch::global::table& global, const VkInstance instance);
 
+    /**
+     * @brief Construct a table and record statistics about its construction.
+     * @param global A reference to a global::table.
+     * @param instance A valid ::VkInstance handle.
+     * @param statistics A sink for construction statistics.
+     * @throw dispatch::error If the value of instance is `VK_NULL_HANDLE`.
+     * @see table(const megatech::vulkan::dispatch::global::table&, const VkInstance)
+     */
+    table(const megatech::vulkan::dispatch::global::table& global, const VkInstance instance,
+          construction_statistics& statistics);
+
     /**
      * @brief Copy a table.
      * @param other The table to copy.
@@ -326,6 +353,14 @@ namespace device {
     VkInstance m_instance{ };
     VkDevice m_device{ };
     std::array<PFN_vkVoidFunction, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT> m_pfns{ };
+
+    table(construction_statistics *const statistics, const megatech::vulkan::dispatch::global::table& global,
+          const megatech::vulkan::dispatch::instance::table& instance, const VkDevice device);
+    table(construction_statistics *const statistics, const megatech::vulkan::dispatch::global::table& global,
+          const VkInstance instance);
+    table(construction_statistics *const statistics, const megatech::vulkan::dispatch::global::table& global,
+          const megatech::vulkan::dispatch::instance::table& instance);
+    table(construction_statistics *const statistics, const table& base, const VkDevice device);
   public:
     /**
      * @brief Construct a table.
@@ -341,6 +376,18 @@ namespace device {
     table(const megatech::vulkan::dispatch::global::table& global,
           const megatech::vulkan::dispatch::instance::table& instance, const VkDevice device);
 
+    /**
+     * @brief Construct a table and record statistics about its construction.
+     * @param global A reference to a global::table.
+     * @param instance A reference to an instance::table.
+     * @param device A valid ::VkDevice handle.
+     * @param statistics A sink for construction statistics.
+     * @throw dispatch::error If the value of `device` is null.
+     */
+    table(const megatech::vulkan::dispatch::global::table& global,
+          const megatech::vulkan::dispatch::instance::table& instance, const VkDevice device,
+          construction_statistics& statistics);
+
     /**
      * @brief Construct a table from a ::VkInstance handle.
      * @details Generally, you should prefer to construct device dispatch tables on a per device basis. Properly
@@ -365,6 +412,17 @@ namespace device {
      */
     table(const megatech::vulkan::dispatch::global::table& global, const VkInstance instance);
 
+    /**
+     * @brief Construct a table from a ::VkInstance handle and record statistics about its construction.
+     * @param global A reference to a global::table.
+     * @param instance A valid ::VkInstance handle.
+     * @param statistics A sink for construction statistics.
+     * @throw dispatch::error If the value of `instance` is null.
+     * @see table(const megatech::vulkan::dispatch::global::table&, const VkInstance)
+     */
+    table(const megatech::vulkan::dispatch::global::table& global, const VkInstance instance,
+          construction_statistics& statistics);
+
     /**
      * @brief Construct a table from an instance-level table.
      * @param global A reference to a global::table.
@@ -375,6 +433,16 @@ namespace device {
     table(const megatech::vulkan::dispatch::global::table& global,
           const megatech::vulkan::dispatch::instance::table& instance);
 
+    /**
+     * @brief Construct a table from an instance-level table and record statistics about its construction.
+     * @param global A reference to a global::table.
+     * @param instance A reference to an instance::table.
+     * @param statistics A sink for construction statistics.
+     * @see table(const megatech::vulkan::dispatch::global::table&, const VkInstance)
+     */
+    table(const megatech::vulkan::dispatch::global::table& global,
+          const megatech::vulkan::dispatch::instance::table& instance, construction_statistics& statistics);
+
     /**
      * @brief Construct a table by extending an existing table with a ::VkDevice.
      * @param base A base table. This **MUST** be derived from a ::VkInstance and have a null ::VkDevice. The
@@ -386,6 +454,17 @@ namespace device {
      */
     table(const table& base, const VkDevice device);
 
+    /**
+     * @brief Construct a table by extending an existing table with a ::VkDevice and record statistics about its
+     *        construction.
+     * @param base A base table. This **MUST** be derived from a ::VkInstance and have a null ::VkDevice.
+     * @param device A ::VkDevice to create the extended table from.
+     * @param statistics A sink for construction statistics.
+     * @throw dispatch::error If the base table already has a ::VkDevice loaded or if `device` is null.
+     * @see table(const table&, const VkDevice)
+     */
+    table(const table& base, const VkDevice device, construction_statistics& statistics);
+
     /**
      * @brief Copy a table.
      * @param other The table to copy.
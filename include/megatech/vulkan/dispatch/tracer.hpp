@@ -0,0 +1,181 @@
+/**
+ * @file tracer.hpp
+ * @brief Vulkan Command Call Tracer
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_TRACER_HPP
+#define MEGATECH_VULKAN_DISPATCH_TRACER_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include "defs.hpp"
+#include "commands.hpp"
+
+#include "internal/base/per_thread.hpp"
+#include "internal/base/timestamp.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+  /**
+   * @brief A low overhead tracer that records the duration of Vulkan command calls.
+   * @details Each thread records events into its own fixed-capacity, single-producer/single-consumer ring buffer.
+   *          Recording an event never blocks and never allocates (except for the first event on each thread). When a
+   *          ring buffer is full, new events are dropped and counted rather than overwriting unread events.
+   *
+   *          Events are streamed to disk in the Chrome trace-event JSON array format by ::drain(). This format can be
+   *          loaded by `chrome://tracing`, the Perfetto UI, and Perfetto's trace processor. Draining can happen on
+   *          demand or periodically on a background thread owned by the tracer.
+   *
+   *          Timestamps are taken with the time-stamp counter where available. The counter is calibrated against
+   *          `std::chrono::steady_clock` every time events are drained.
+   */
+  class call_tracer final {
+  public:
+    /**
+     * @brief A single recorded call.
+     */
+    struct event final {
+      /**
+       * @brief The timestamp, in ticks, at which the call began.
+       */
+      std::uint64_t start{ };
+
+      /**
+       * @brief The timestamp, in ticks, at which the call ended.
+       */
+      std::uint64_t end{ };
+
+      /**
+       * @brief A small integer identifying the thread that made the call.
+       */
+      std::uint32_t thread{ };
+
+      /**
+       * @brief The level of the called command (1 for instance commands, and 2 for device commands).
+       */
+      std::uint16_t level{ };
+
+      /**
+       * @brief The value of the called command.
+       */
+      std::uint16_t command{ };
+    };
+  private:
+    // Rings are value-initialized by internal::base::per_thread. Default member initializers are omitted because
+    // they would make the type appear non-default-constructible until call_tracer is complete.
+    struct ring final {
+      std::unique_ptr<event[]> events;
+      std::uint64_t mask;
+      std::atomic<std::uint64_t> head;
+      std::atomic<std::uint64_t> tail;
+      std::atomic<std::uint64_t> dropped;
+    };
+
+    internal::base::per_thread<ring> m_rings{ };
+    std::size_t m_capacity{ };
+    std::mutex m_mutex{ };
+    std::ofstream m_output{ };
+    bool m_empty{ true };
+    internal::base::timestamp_calibration m_calibration{ };
+    std::jthread m_drainer{ };
+
+    template <typename Command>
+    static constexpr std::uint16_t level_of() noexcept {
+      if constexpr (std::is_same_v<Command, instance::command>)
+      {
+        return 1;
+      }
+      else
+      {
+        static_assert(std::is_same_v<Command, device::command>, "Only instance and device commands can be traced.");
+        return 2;
+      }
+    }
+
+    static std::uint32_t thread_index() noexcept;
+
+    void allocate(ring& current);
+    void write(const event& current);
+  public:
+    /**
+     * @brief Construct a tracer.
+     * @param path The path of the trace file to create. If the file already exists, it is truncated.
+     * @param capacity The capacity, in events, of each thread's ring buffer. This is rounded up to a power of 2.
+     * @param interval The interval at which a background thread drains the ring buffers. If this is zero, no
+     *                 background thread is started and ::drain() **MUST** be called by the client.
+     * @throw dispatch::error If the trace file cannot be opened or if `capacity` is zero.
+     */
+    explicit call_tracer(const std::filesystem::path& path, const std::size_t capacity = 65536,
+                         const std::chrono::milliseconds interval = std::chrono::milliseconds{ 0 });
+
+    /// @cond
+    call_tracer(const call_tracer& other) = delete;
+    call_tracer(call_tracer&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a tracer.
+     * @details Any remaining events are drained and the trace file is completed and closed. The tracer **MUST NOT**
+     *          be destroyed while calls are still being recorded.
+     */
+    ~call_tracer() noexcept;
+
+    /// @cond
+    call_tracer& operator=(const call_tracer& rhs) = delete;
+    call_tracer& operator=(call_tracer&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Record a call on the calling thread.
+     * @tparam Command The command enumeration of the called command's level.
+     * @param cmd The called command.
+     * @param start The value of internal::base::timestamp() immediately before the call.
+     * @param end The value of internal::base::timestamp() immediately after the call.
+     */
+    template <typename Command>
+    void record(const Command cmd, const std::uint64_t start, const std::uint64_t end) {
+      auto& current = m_rings.local();
+      if (!current.events) [[unlikely]]
+      {
+        allocate(current);
+      }
+      const auto head = current.head.load(std::memory_order_relaxed);
+      if (head - current.tail.load(std::memory_order_acquire) > current.mask) [[unlikely]]
+      {
+        current.dropped.store(current.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+      }
+      current.events[head & current.mask] = event{ start, end, thread_index(), level_of<Command>(),
+                                                    static_cast<std::uint16_t>(cmd) };
+      current.head.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Write all pending events to the trace file.
+     * @details This is safe to call concurrently with ::record() and with itself.
+     * @return The number of events written.
+     */
+    std::size_t drain();
+
+    /**
+     * @brief Retrieve the number of events that were dropped because a ring buffer was full.
+     * @return The total number of dropped events across all threads.
+     */
+    std::uint64_t dropped() const;
+  };
+
+}
+
+#endif
@@ -0,0 +1,370 @@
+/**
+ * @file trampoline_tables.hpp
+ * @brief Trampoline Vulkan Dispatch Tables
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#ifndef MEGATECH_VULKAN_DISPATCH_TRAMPOLINE_TABLES_HPP
+#define MEGATECH_VULKAN_DISPATCH_TRAMPOLINE_TABLES_HPP
+
+#include <cstddef>
+#include <cinttypes>
+
+#include <filesystem>
+
+#include "defs.hpp"
+#include "error.hpp"
+#include "commands.hpp"
+#include "tables.hpp"
+
+#include "internal/base/trampolines.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+namespace instance {
+
+  /**
+   * @brief An instance-level dispatch table that routes calls through named, per-command trampolines.
+   * @details Trampoline tables expose the same interface as table. Initially, every entry is identical to the
+   *          corresponding entry of the table used to construct it. Routing a command replaces its entry with a pointer
+   *          to a trampoline named after the command (e.g., `mvd_trampoline_vkEnumeratePhysicalDevices`). The
+   *          trampoline calls the original function pointer and returns its result, but it is never inlined and never
+   *          tail calls its target. As a result, its frame remains on the stack while the target runs, and sampling
+   *          profilers (e.g., `perf`) attribute time spent in drivers without symbols to the command that was called.
+   *          For example:
+   *          @code{.cpp}
+   *          auto itt = trampoline_table{ idt };
+   *          itt.route<command::vkEnumeratePhysicalDevices, PFN_vkEnumeratePhysicalDevices>();
+   *          itt.write_perf_map();
+   *          // Retrieve and call "vkEnumeratePhysicalDevices" through itt as usual.
+   *          @endcode
+   *
+   *          Each routed call costs one additional call and one additional load. Call stacks are only recovered
+   *          through trampolines when the profiler can unwind them (e.g., with `-fno-omit-frame-pointer` or with
+   *          `perf record --call-graph=dwarf`). Trampolines are bound to their table. At most
+   *          `MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS` trampoline tables of each level may exist at once.
+   *          Function pointers retrieved from a trampoline table **MUST NOT** be called after the table is destroyed.
+   */
+  class trampoline_table final {
+  private:
+    VkInstance m_instance{ };
+    internal::base::routing<command, MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT> m_routing;
+  public:
+    /**
+     * @brief Construct a trampoline table.
+     * @details Trampoline tables do not have an ownership relationship with the table they are constructed from. The
+     *          lifetime of `base` **MAY** end immediately after construction.
+     * @param base The table to route. The table shares ownership of the base table's ::VkInstance, and so it **MUST**
+     *             remain valid for the table's entire lifetime.
+     * @throw dispatch::error If there are no free trampoline slots.
+     */
+    explicit trampoline_table(const table& base);
+
+    /// @cond
+    trampoline_table(const trampoline_table& other) = delete;
+    trampoline_table(trampoline_table&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a trampoline table.
+     */
+    ~trampoline_table() noexcept = default;
+
+    /// @cond
+    trampoline_table& operator=(const trampoline_table& rhs) = delete;
+    trampoline_table& operator=(trampoline_table&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Route calls to a command through its named trampoline.
+     * @details If the command was resolved to null, the entry remains null. Commands **MUST NOT** be routed or
+     *          restored concurrently with ::get() or with calls through the table.
+     * @tparam Cmd The ::command to route.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkEnumeratePhysicalDevices`).
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void route() noexcept {
+      m_routing.route<Cmd, Pointer>();
+    }
+
+    /**
+     * @brief Restore the original function pointer of a command.
+     * @details This **MUST NOT** be called concurrently with ::get() or with calls through the table.
+     * @tparam Cmd The ::command to restore.
+     */
+    template <command Cmd>
+    void restore() noexcept {
+      m_routing.restore<Cmd>();
+    }
+
+    /**
+     * @brief Determine whether or not a command is routed.
+     * @param cmd The ::command to check.
+     * @return True if calls to `cmd` are routed through a trampoline. Otherwise false.
+     */
+    bool routed(const command cmd) const noexcept;
+
+    /**
+     * @brief Write the address ranges of every routed trampoline to the process's `perf` map file.
+     * @details The file is `/tmp/perf-<pid>.map`. Each line has the form `<start> <size> <symbol>`, where `<start>` and
+     *          `<size>` are hexadecimal. `perf` reads these files to name code that is not backed by a symbol table.
+     *          Other profilers and trace viewers that accept `perf` maps will also resolve trampoline names from it.
+     *          Entries already present in the file are kept, but an entry for a trampoline's address replaces any
+     *          earlier entry for the same address. Writing the map repeatedly never duplicates entries.
+     *          Trampolines are sized using the dynamic symbol table. Trampolines whose size cannot be determined (e.g.,
+     *          because the executable that instantiated them was not linked with `-rdynamic`) are skipped.
+     * @return The number of entries written.
+     * @throw dispatch::error If the map cannot be written.
+     */
+    std::size_t write_perf_map() const;
+
+    /**
+     * @brief Write the address ranges of every routed trampoline to a `perf` map file.
+     * @param path The path of the file to write to.
+     * @return The number of entries written.
+     * @throw dispatch::error If the map cannot be written.
+     * @see write_perf_map() const
+     */
+    std::size_t write_perf_map(const std::filesystem::path& path) const;
+
+    /**
+     * @brief Retrieve the ::VkInstance used to construct the table.
+     * @return The ::VkInstance handle that was used to construct the table.
+     */
+    VkInstance instance() const;
+
+    /**
+     * @brief Retrieve the size of the table.
+     * @return The number of commands held in the table.
+     */
+    constexpr std::size_t size() const noexcept {
+      return MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT;
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* get(const command cmd) const {
+      if (static_cast<std::size_t>(cmd) >= size())
+      {
+        throw dispatch::error{ "The input command is outside the valid range of possible instance commnds." };
+      }
+      return m_routing.slot(static_cast<std::size_t>(cmd));
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* operator()(const command cmd) const {
+      return get(cmd);
+    }
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case dispatch::internal::base::fnv_1a_cstr(#name): return get(command::name);
+/// @endcond
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash A 64-bit FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* get(const std::uint_least64_t hash) const noexcept {
+      switch (hash)
+      {
+      MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_LIST
+      default:
+        return nullptr;
+      }
+    }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash A 64-bit FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* operator()(const std::uint_least64_t hash) const noexcept {
+      return get(hash);
+    }
+  };
+
+}
+
+namespace device {
+
+  /**
+   * @brief A device-level dispatch table that routes calls through named, per-command trampolines.
+   * @see instance::trampoline_table
+   */
+  class trampoline_table final {
+  private:
+    VkInstance m_instance{ };
+    VkDevice m_device{ };
+    internal::base::routing<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT> m_routing;
+  public:
+    /**
+     * @brief Construct a trampoline table.
+     * @details Trampoline tables do not have an ownership relationship with the table they are constructed from. The
+     *          lifetime of `base` **MAY** end immediately after construction.
+     * @param base The table to route. The table shares ownership of the base table's ::VkInstance and ::VkDevice, and
+     *             so they **MUST** remain valid for the table's entire lifetime.
+     * @throw dispatch::error If there are no free trampoline slots.
+     */
+    explicit trampoline_table(const table& base);
+
+    /// @cond
+    trampoline_table(const trampoline_table& other) = delete;
+    trampoline_table(trampoline_table&& other) = delete;
+    /// @endcond
+
+    /**
+     * @brief Destroy a trampoline table.
+     */
+    ~trampoline_table() noexcept = default;
+
+    /// @cond
+    trampoline_table& operator=(const trampoline_table& rhs) = delete;
+    trampoline_table& operator=(trampoline_table&& rhs) = delete;
+    /// @endcond
+
+    /**
+     * @brief Route calls to a command through its named trampoline.
+     * @tparam Cmd The ::command to route.
+     * @tparam Pointer The function pointer type of `Cmd` (e.g., `PFN_vkCmdDraw`).
+     * @see instance::trampoline_table::route()
+     */
+    template <command Cmd, internal::base::command_pointer Pointer>
+    void route() noexcept {
+      m_routing.route<Cmd, Pointer>();
+    }
+
+    /**
+     * @brief Restore the original function pointer of a command.
+     * @tparam Cmd The ::command to restore.
+     * @see instance::trampoline_table::restore()
+     */
+    template <command Cmd>
+    void restore() noexcept {
+      m_routing.restore<Cmd>();
+    }
+
+    /**
+     * @brief Determine whether or not a command is routed.
+     * @param cmd The ::command to check.
+     * @return True if calls to `cmd` are routed through a trampoline. Otherwise false.
+     */
+    bool routed(const command cmd) const noexcept;
+
+    /**
+     * @brief Write the address ranges of every routed trampoline to the process's `perf` map file.
+     * @return The number of entries written.
+     * @throw dispatch::error If the map cannot be written.
+     * @see instance::trampoline_table::write_perf_map() const
+     */
+    std::size_t write_perf_map() const;
+
+    /**
+     * @brief Write the address ranges of every routed trampoline to a `perf` map file.
+     * @param path The path of the file to write to.
+     * @return The number of entries written.
+     * @throw dispatch::error If the map cannot be written.
+     * @see instance::trampoline_table::write_perf_map() const
+     */
+    std::size_t write_perf_map(const std::filesystem::path& path) const;
+
+    /**
+     * @brief Retrieve the ::VkInstance used to construct the table.
+     * @return The ::VkInstance handle that was used to construct the table.
+     */
+    VkInstance instance() const;
+
+    /**
+     * @brief Retrieve the ::VkDevice used to construct the table.
+     * @return The ::VkDevice handle that was used to construct the table if any. Null is returned in all other
+     *         cases.
+     */
+    VkDevice device() const;
+
+    /**
+     * @brief Retrieve the size of the table.
+     * @return The number of commands held in the table.
+     */
+    constexpr std::size_t size() const noexcept {
+      return MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT;
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* get(const command cmd) const {
+      if (static_cast<std::size_t>(cmd) >= size())
+      {
+        throw dispatch::error{ "The input command is outside the valid range of possible device commnds." };
+      }
+      return m_routing.slot(static_cast<std::size_t>(cmd));
+    }
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param cmd The ::command to resolve.
+     * @return A generic read-only pointer to the desired Vulkan ::command. The pointed-to value **MAY** be null.
+     * @throw dispatch::error If the value of `cmd` isn't valid.
+     * @see table::get(const command) const
+     */
+    const void* operator()(const command cmd) const {
+      return get(cmd);
+    }
+
+/// @cond
+#define MEGATECH_VULKAN_DISPATCH_COMMAND(name) case dispatch::internal::base::fnv_1a_cstr(#name): return get(command::name);
+/// @endcond
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* get(const std::uint_least64_t hash) const noexcept {
+      switch (hash)
+      {
+      MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+      default:
+        return nullptr;
+      }
+    }
+
+#undef MEGATECH_VULKAN_DISPATCH_COMMAND
+
+    /**
+     * @brief Retrieve a pointer to a function pointer in the table.
+     * @param hash An FNV-1a hash of the name of the ::command to retrieve.
+     * @return A generic read-only pointer to the desired Vulkan ::command if it is found. Otherwise null.
+     * @see table::get(const std::uint_least64_t) const
+     */
+    const void* operator()(const std::uint_least64_t hash) const noexcept {
+      return get(hash);
+    }
+  };
+
+}
+
+}
+
+#endif
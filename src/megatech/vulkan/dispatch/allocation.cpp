@@ -0,0 +1,483 @@
+/**
+ * @file allocation.cpp
+ * @brief Vulkan Pooled Host Allocation
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#include "megatech/vulkan/dispatch/allocation.hpp"
+
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "megatech/vulkan/dispatch/internal/base/per_thread.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+namespace {
+
+  constexpr auto arena_chunk_size = std::size_t{ 64 * 1024 };
+  // Larger command allocations would waste most of a chunk, so they fall back to operator new instead.
+  constexpr auto arena_limit = arena_chunk_size / 4;
+  constexpr auto slab_size = std::size_t{ 64 * 1024 };
+  constexpr auto smallest_block = std::size_t{ 64 };
+  constexpr auto size_classes = std::size_t{ 7 };
+  constexpr auto largest_block = smallest_block << (size_classes - 1);
+  constexpr auto cached_blocks = std::size_t{ 64 };
+  constexpr auto transferred_blocks = std::size_t{ 32 };
+
+  enum class source : std::uint16_t {
+    arena,
+    pool,
+    system
+  };
+
+  // Every allocation is immediately preceded by a header that records where it came from.
+  struct alignas(32) header final {
+    void* origin;
+    std::size_t size;
+    std::uint32_t scope;
+    source from;
+    std::uint16_t size_class;
+  };
+
+  static_assert(sizeof(header) == 32, "Allocation headers must preserve the alignment of the memory they precede.");
+
+  struct alignas(internal::base::cache_line_size) arena_chunk final {
+    std::atomic<std::size_t> live{ };
+    std::size_t offset{ };
+    std::array<std::byte, arena_chunk_size> data;
+  };
+
+  struct free_block final {
+    free_block* next;
+  };
+
+  // The number of bytes that must be reserved for an allocation that begins at an address aligned to the header.
+  std::size_t footprint(const std::size_t size, const std::size_t alignment) noexcept {
+    return size + sizeof(header) + (alignment > alignof(header) ? alignment - alignof(header) : 0);
+  }
+
+  std::byte* align_up(std::byte *const address, const std::size_t alignment) noexcept {
+    const auto value = reinterpret_cast<std::uintptr_t>(address);
+    return address + (((value + alignment - 1) & ~(alignment - 1)) - value);
+  }
+
+  std::byte* place(std::byte *const begin, const std::size_t size, const std::size_t alignment, const source from,
+                   void *const origin, const std::size_t size_class) noexcept {
+    const auto memory = align_up(begin + sizeof(header), std::max(alignment, alignof(header)));
+    const auto entry = new (memory - sizeof(header)) header{ };
+    entry->origin = origin;
+    entry->size = size;
+    entry->from = from;
+    entry->size_class = static_cast<std::uint16_t>(size_class);
+    return memory;
+  }
+
+  header* header_of(void *const memory) noexcept {
+    return std::launder(reinterpret_cast<header*>(static_cast<std::byte*>(memory) - sizeof(header)));
+  }
+
+  std::size_t block_size(const std::size_t size_class) noexcept {
+    return smallest_block << size_class;
+  }
+
+  std::size_t scope_index(const std::size_t scope) noexcept {
+    return std::min(scope, internal::base::allocation_scopes - 1);
+  }
+
+  void add(std::atomic<std::uint64_t>& counter, const std::uint64_t value) noexcept {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+}
+
+  struct host_memory_pool::implementation final {
+    // Arenas are value-initialized by internal::base::per_thread.
+    struct arena final {
+      std::vector<arena_chunk*> chunks;
+      arena_chunk* current;
+    };
+
+    struct free_list final {
+      free_block* head;
+      std::size_t count;
+    };
+
+    struct cache final {
+      std::array<free_list, size_classes> lists;
+    };
+
+    struct scope_counters final {
+      std::atomic<std::uint64_t> allocations;
+      std::atomic<std::uint64_t> reallocations;
+      std::atomic<std::uint64_t> frees;
+      std::atomic<std::uint64_t> allocated_bytes;
+      std::atomic<std::uint64_t> freed_bytes;
+      std::atomic<std::uint64_t> internal_allocated_bytes;
+      std::atomic<std::uint64_t> internal_freed_bytes;
+    };
+
+    struct counters final {
+      std::array<scope_counters, internal::base::allocation_scopes> scopes;
+    };
+
+    struct size_class final {
+      std::mutex mutex{ };
+      free_block* head{ };
+      std::vector<std::byte*> slabs{ };
+    };
+
+    internal::base::per_thread<arena> arenas{ };
+    internal::base::per_thread<cache> caches{ };
+    internal::base::per_thread<counters> statistics{ };
+    std::array<size_class, size_classes> classes{ };
+
+    implementation() = default;
+
+    implementation(const implementation& other) = delete;
+    implementation(implementation&& other) = delete;
+
+    ~implementation() noexcept {
+      arenas.for_each([](arena& current) {
+        for (const auto chunk : current.chunks)
+        {
+          delete chunk;
+        }
+      });
+      for (auto& current : classes)
+      {
+        for (const auto slab : current.slabs)
+        {
+          ::operator delete(slab, std::align_val_t{ internal::base::cache_line_size });
+        }
+      }
+    }
+
+    implementation& operator=(const implementation& rhs) = delete;
+    implementation& operator=(implementation&& rhs) = delete;
+
+    static std::byte* bump(arena_chunk *const chunk, const std::size_t size, const std::size_t alignment) noexcept {
+      if (!chunk)
+      {
+        return nullptr;
+      }
+      const auto end = chunk->data.data() + chunk->data.size();
+      const auto begin = align_up(chunk->data.data() + chunk->offset, alignof(header));
+      if (begin > end || static_cast<std::size_t>(end - begin) < footprint(size, alignment))
+      {
+        return nullptr;
+      }
+      const auto memory = place(begin, size, alignment, source::arena, chunk, 0);
+      chunk->offset = static_cast<std::size_t>((memory + size) - chunk->data.data());
+      chunk->live.fetch_add(1, std::memory_order_relaxed);
+      return memory;
+    }
+
+    std::byte* allocate_arena(const std::size_t size, const std::size_t alignment) {
+      auto& local = arenas.local();
+      // A chunk whose allocations have all been freed can be rewound. Frees release their accesses to the chunk.
+      if (local.current && !local.current->live.load(std::memory_order_acquire))
+      {
+        local.current->offset = 0;
+      }
+      if (const auto memory = bump(local.current, size, alignment); memory)
+      {
+        return memory;
+      }
+      auto next = static_cast<arena_chunk*>(nullptr);
+      for (const auto chunk : local.chunks)
+      {
+        if (chunk != local.current && !chunk->live.load(std::memory_order_acquire))
+        {
+          next = chunk;
+          break;
+        }
+      }
+      if (!next)
+      {
+        local.chunks.reserve(local.chunks.size() + 1);
+        next = new (std::nothrow) arena_chunk;
+        if (!next)
+        {
+          return nullptr;
+        }
+        local.chunks.push_back(next);
+      }
+      next->offset = 0;
+      local.current = next;
+      return bump(next, size, alignment);
+    }
+
+    bool refill(const std::size_t index, free_list& list) {
+      auto& shared = classes[index];
+      auto lock = std::unique_lock<std::mutex>{ shared.mutex };
+      while (shared.head && list.count < transferred_blocks)
+      {
+        const auto block = shared.head;
+        shared.head = block->next;
+        block->next = list.head;
+        list.head = block;
+        ++list.count;
+      }
+      if (list.head)
+      {
+        return true;
+      }
+      shared.slabs.reserve(shared.slabs.size() + 1);
+      const auto slab = static_cast<std::byte*>(::operator new(slab_size,
+                                                               std::align_val_t{ internal::base::cache_line_size },
+                                                               std::nothrow));
+      if (!slab)
+      {
+        return false;
+      }
+      shared.slabs.push_back(slab);
+      const auto size = block_size(index);
+      for (auto offset = std::size_t{ 0 }; offset + size <= slab_size; offset += size)
+      {
+        const auto block = new (slab + offset) free_block{ list.head };
+        list.head = block;
+        ++list.count;
+      }
+      return true;
+    }
+
+    std::byte* allocate_pool(const std::size_t size, const std::size_t alignment, const std::size_t index) {
+      auto& list = caches.local().lists[index];
+      if (!list.head && !refill(index, list))
+      {
+        return nullptr;
+      }
+      const auto block = list.head;
+      list.head = block->next;
+      --list.count;
+      return place(reinterpret_cast<std::byte*>(block), size, alignment, source::pool, block, index);
+    }
+
+    void free_pool(void *const origin, const std::size_t index) noexcept {
+      const auto block = new (origin) free_block{ };
+      try
+      {
+        auto& list = caches.local().lists[index];
+        block->next = list.head;
+        list.head = block;
+        if (++list.count <= cached_blocks)
+        {
+          return;
+        }
+        // Return the oldest half of the cache so that a thread that only frees doesn't hoard blocks.
+        auto& shared = classes[index];
+        auto kept = list.head;
+        for (auto i = std::size_t{ 1 }; i < list.count - transferred_blocks; ++i)
+        {
+          kept = kept->next;
+        }
+        auto returned = kept->next;
+        kept->next = nullptr;
+        list.count -= transferred_blocks;
+        auto lock = std::unique_lock<std::mutex>{ shared.mutex };
+        while (returned)
+        {
+          const auto current = returned;
+          returned = current->next;
+          current->next = shared.head;
+          shared.head = current;
+        }
+      }
+      catch (...)
+      {
+        // The calling thread's cache couldn't be created, so the block is returned to the shared list directly.
+        auto& shared = classes[index];
+        auto lock = std::unique_lock<std::mutex>{ shared.mutex };
+        block->next = shared.head;
+        shared.head = block;
+      }
+    }
+
+    void* allocate(const std::size_t size, const std::size_t alignment, const std::size_t scope) noexcept {
+      if (!size || size > std::numeric_limits<std::size_t>::max() / 2 || alignment > arena_chunk_size)
+      {
+        return nullptr;
+      }
+      const auto needed = footprint(size, alignment);
+      try
+      {
+        if (scope == internal::base::command_allocation_scope && needed <= arena_limit)
+        {
+          return allocate_arena(size, alignment);
+        }
+        if (needed <= largest_block)
+        {
+          auto index = std::size_t{ 0 };
+          while (block_size(index) < needed)
+          {
+            ++index;
+          }
+          return allocate_pool(size, alignment, index);
+        }
+      }
+      catch (...)
+      {
+        return nullptr;
+      }
+      const auto origin = static_cast<std::byte*>(::operator new(needed, std::align_val_t{ alignof(header) },
+                                                                 std::nothrow));
+      return origin ? place(origin, size, alignment, source::system, origin, 0) : nullptr;
+    }
+
+    void release(void *const memory) noexcept {
+      const auto entry = header_of(memory);
+      switch (entry->from)
+      {
+      case source::arena:
+        static_cast<arena_chunk*>(entry->origin)->live.fetch_sub(1, std::memory_order_release);
+        break;
+      case source::pool:
+        free_pool(entry->origin, entry->size_class);
+        break;
+      case source::system:
+        ::operator delete(entry->origin, std::align_val_t{ alignof(header) });
+        break;
+      }
+    }
+
+    scope_counters* local_counters(const std::size_t scope) noexcept {
+      try
+      {
+        return &statistics.local().scopes[scope_index(scope)];
+      }
+      catch (...)
+      {
+        return nullptr;
+      }
+    }
+  };
+
+  host_memory_pool::host_memory_pool() :
+  m_implementation{ std::make_unique<implementation>() } { }
+
+  host_memory_pool::~host_memory_pool() noexcept = default;
+
+  void* host_memory_pool::allocate(const std::size_t size, const std::size_t alignment,
+                                   const std::size_t scope) noexcept {
+    const auto memory = m_implementation->allocate(size, alignment, scope);
+    if (memory)
+    {
+      header_of(memory)->scope = static_cast<std::uint32_t>(scope_index(scope));
+      if (const auto counters = m_implementation->local_counters(scope); counters)
+      {
+        add(counters->allocations, 1);
+        add(counters->allocated_bytes, size);
+      }
+    }
+    return memory;
+  }
+
+  void* host_memory_pool::reallocate(void *const original, const std::size_t size, const std::size_t alignment,
+                                     const std::size_t scope) noexcept {
+    if (!original)
+    {
+      return allocate(size, alignment, scope);
+    }
+    if (!size)
+    {
+      free(original);
+      return nullptr;
+    }
+    const auto entry = header_of(original);
+    const auto previous = entry->size;
+    const auto previous_scope = entry->scope;
+    auto memory = original;
+    // Pool blocks are usually larger than the allocations they hold, so growing within a block is free.
+    const auto fits = entry->from == source::pool &&
+                      static_cast<std::byte*>(original) + size <= static_cast<std::byte*>(entry->origin) +
+                                                                  block_size(entry->size_class);
+    if (fits)
+    {
+      entry->size = size;
+    }
+    else
+    {
+      memory = m_implementation->allocate(size, alignment, scope);
+      if (!memory)
+      {
+        return nullptr;
+      }
+      header_of(memory)->scope = static_cast<std::uint32_t>(scope_index(scope));
+      std::memcpy(memory, original, std::min(previous, size));
+      m_implementation->release(original);
+    }
+    if (const auto counters = m_implementation->local_counters(previous_scope); counters)
+    {
+      add(counters->freed_bytes, previous);
+    }
+    if (const auto counters = m_implementation->local_counters(scope); counters)
+    {
+      add(counters->reallocations, 1);
+      add(counters->allocated_bytes, size);
+    }
+    return memory;
+  }
+
+  void host_memory_pool::free(void *const memory) noexcept {
+    if (!memory)
+    {
+      return;
+    }
+    const auto entry = header_of(memory);
+    const auto size = entry->size;
+    const auto scope = entry->scope;
+    m_implementation->release(memory);
+    if (const auto counters = m_implementation->local_counters(scope); counters)
+    {
+      add(counters->frees, 1);
+      add(counters->freed_bytes, size);
+    }
+  }
+
+  void host_memory_pool::record_internal_allocation(const std::size_t size, const std::size_t scope) noexcept {
+    if (const auto counters = m_implementation->local_counters(scope); counters)
+    {
+      add(counters->internal_allocated_bytes, size);
+    }
+  }
+
+  void host_memory_pool::record_internal_free(const std::size_t size, const std::size_t scope) noexcept {
+    if (const auto counters = m_implementation->local_counters(scope); counters)
+    {
+      add(counters->internal_freed_bytes, size);
+    }
+  }
+
+  host_allocation_statistics host_memory_pool::statistics(const std::size_t scope) const {
+    const auto index = scope_index(scope);
+    auto result = host_allocation_statistics{ };
+    auto allocated = std::uint64_t{ 0 };
+    auto freed = std::uint64_t{ 0 };
+    auto internal_allocated = std::uint64_t{ 0 };
+    auto internal_freed = std::uint64_t{ 0 };
+    m_implementation->statistics.for_each([&](const implementation::counters& current) {
+      const auto& counters = current.scopes[index];
+      result.allocations += counters.allocations.load(std::memory_order_relaxed);
+      result.reallocations += counters.reallocations.load(std::memory_order_relaxed);
+      result.frees += counters.frees.load(std::memory_order_relaxed);
+      allocated += counters.allocated_bytes.load(std::memory_order_relaxed);
+      freed += counters.freed_bytes.load(std::memory_order_relaxed);
+      internal_allocated += counters.internal_allocated_bytes.load(std::memory_order_relaxed);
+      internal_freed += counters.internal_freed_bytes.load(std::memory_order_relaxed);
+    });
+    // Frees recorded by one thread can be observed before the matching allocations recorded by another.
+    result.live_bytes = allocated > freed ? allocated - freed : 0;
+    result.internal_bytes = internal_allocated > internal_freed ? internal_allocated - internal_freed : 0;
+    return result;
+  }
+
+}
@@ -0,0 +1,58 @@
+/**
+ * @file cached_tables.cpp
+ * @brief Memoizing Vulkan Dispatch Tables
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#include "megatech/vulkan/dispatch/cached_tables.hpp"
+
+#include <megatech/assertions.hpp>
+
+namespace megatech::vulkan::dispatch {
+
+namespace instance {
+
+  cached_table::cached_table(const table& base) : m_instance{ base.instance() }, m_memoization{ base } {
+    MEGATECH_POSTCONDITION(m_instance != nullptr);
+  }
+
+  bool cached_table::memoized(const command cmd) const noexcept {
+    return m_memoization.memoized(cmd);
+  }
+
+  VkInstance cached_table::instance() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_instance;
+  }
+
+}
+
+namespace device {
+
+  cached_table::cached_table(const table& base) :
+  m_instance{ base.instance() }, m_device{ base.device() }, m_cache{ base } {
+    MEGATECH_POSTCONDITION(m_instance != nullptr);
+  }
+
+  bool cached_table::cached(const command cmd) const noexcept {
+    return m_cache.cached(cmd);
+  }
+
+  std::size_t cached_table::entries(const command cmd) const noexcept {
+    return m_cache.entries(cmd);
+  }
+
+  VkInstance cached_table::instance() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_instance;
+  }
+
+  VkDevice cached_table::device() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_device;
+  }
+
+}
+
+}
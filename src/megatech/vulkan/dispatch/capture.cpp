@@ -0,0 +1,406 @@
+/**
+ * @file capture.cpp
+ * @brief Vulkan Command Call Stream Capture and Replay
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#include "megatech/vulkan/dispatch/capture.hpp"
+
+#include <cstring>
+
+#include <atomic>
+
+#if __has_include(<sys/mman.h>) && __has_include(<fcntl.h>) && __has_include(<unistd.h>)
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #define MEGATECH_VULKAN_DISPATCH_HAS_MMAP (1)
+#endif
+
+#include <megatech/assertions.hpp>
+
+#include "megatech/vulkan/dispatch/internal/base/timestamp.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+namespace {
+
+  constexpr auto magic = std::array<char, 8>{ 'M', 'V', 'D', 'C', 'A', 'L', 'L', 'S' };
+  constexpr auto version = std::uint16_t{ 2 };
+  constexpr auto byte_order = std::uint16_t{ 0x0102 };
+
+  struct stream_header final {
+    std::array<char, 8> magic;
+    std::uint16_t version;
+    std::uint16_t byte_order;
+    std::uint32_t stride;
+    std::uint64_t records;
+    std::uint64_t index_offset;
+    std::uint64_t index_count;
+    std::uint64_t reserved;
+  };
+
+  struct record_header final {
+    std::uint64_t timestamp;
+    std::uint32_t thread;
+    std::uint16_t level;
+    std::uint16_t command;
+    std::uint32_t argument_count;
+    std::uint32_t payload_bytes;
+  };
+
+  static_assert(sizeof(stream_header) == 48, "Stream headers must be tightly packed.");
+  static_assert(sizeof(record_header) == 24, "Record headers must be tightly packed.");
+
+  std::uint32_t thread_identity() noexcept {
+    static auto next = std::atomic<std::uint32_t>{ 0 };
+    thread_local const auto identity = next.fetch_add(1, std::memory_order_relaxed);
+    return identity;
+  }
+
+  record_header header_of(const std::byte *const data) noexcept {
+    auto result = record_header{ };
+    std::memcpy(&result, data, sizeof(result));
+    return result;
+  }
+
+  std::size_t record_size(const record_header& header) noexcept {
+    return sizeof(record_header) + header.argument_count * sizeof(internal::base::encoded_argument) +
+           header.payload_bytes;
+  }
+
+  // Retrieve the size of the record at offset, or zero if it doesn't fit before end.
+  std::size_t complete_record(const std::span<const std::byte> bytes, const std::size_t offset,
+                              const std::size_t end) noexcept {
+    if (offset > end || end - offset < sizeof(record_header))
+    {
+      return 0;
+    }
+    const auto header = header_of(bytes.data() + offset);
+    const auto size = record_size(header);
+    // Records must stay 8-byte aligned.
+    if (header.payload_bytes % sizeof(std::uint64_t) || size > end - offset)
+    {
+      return 0;
+    }
+    return size;
+  }
+
+}
+
+  call_capture::call_capture(const std::filesystem::path& path, const std::size_t stride) : m_stride{ stride } {
+    if (!stride)
+    {
+      throw dispatch::error{ "The index stride of a call capture cannot be zero." };
+    }
+    m_output.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!m_output)
+    {
+      throw dispatch::error{ "The capture file \"" + path.string() + "\" could not be opened." };
+    }
+    auto header = stream_header{ };
+    header.magic = magic;
+    header.version = version;
+    header.byte_order = byte_order;
+    header.stride = static_cast<std::uint32_t>(stride);
+    m_output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_offset = sizeof(header);
+    MEGATECH_POSTCONDITION(m_stride > 0);
+  }
+
+  call_capture::~call_capture() noexcept {
+    try
+    {
+      close();
+    }
+    catch (...)
+    {
+      // Destructors must not throw. The records written so far remain readable without an index.
+    }
+  }
+
+  void call_capture::write(const std::uint16_t level, const std::uint16_t command,
+                           const std::span<const internal::base::encoded_argument> arguments,
+                           const std::span<const std::byte> payloads) {
+    auto header = record_header{ };
+    header.thread = thread_identity();
+    header.level = level;
+    header.command = command;
+    header.argument_count = static_cast<std::uint32_t>(arguments.size());
+    header.payload_bytes = static_cast<std::uint32_t>(payloads.size());
+    auto lock = std::unique_lock{ m_mutex };
+    if (m_closed)
+    {
+      return;
+    }
+    // Timestamps are taken in write order so that records are sorted by time.
+    header.timestamp = internal::base::timestamp();
+    if (!(m_records % m_stride))
+    {
+      m_index.emplace_back(m_offset);
+    }
+    m_output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_output.write(reinterpret_cast<const char*>(arguments.data()), arguments.size_bytes());
+    m_output.write(reinterpret_cast<const char*>(payloads.data()), payloads.size());
+    if (!m_output)
+    {
+      throw dispatch::error{ "The capture file could not be written." };
+    }
+    m_offset += record_size(header);
+    ++m_records;
+  }
+
+  void call_capture::close() {
+    auto lock = std::unique_lock{ m_mutex };
+    if (m_closed)
+    {
+      return;
+    }
+    m_closed = true;
+    auto header = stream_header{ };
+    header.magic = magic;
+    header.version = version;
+    header.byte_order = byte_order;
+    header.stride = static_cast<std::uint32_t>(m_stride);
+    header.records = m_records;
+    header.index_offset = m_offset;
+    header.index_count = m_index.size();
+    m_output.write(reinterpret_cast<const char*>(m_index.data()), m_index.size() * sizeof(std::uint64_t));
+    m_output.seekp(0);
+    m_output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_output.close();
+    if (!m_output)
+    {
+      throw dispatch::error{ "The capture file could not be finalized." };
+    }
+  }
+
+  std::uint64_t call_capture::records() const noexcept {
+    auto lock = std::unique_lock{ m_mutex };
+    return m_records;
+  }
+
+  struct call_stream::mapping final {
+#ifdef MEGATECH_VULKAN_DISPATCH_HAS_MMAP
+    void* data{ MAP_FAILED };
+    std::size_t size{ };
+
+    explicit mapping(const std::filesystem::path& path) {
+      const auto descriptor = open(path.c_str(), O_RDONLY);
+      if (descriptor < 0)
+      {
+        throw dispatch::error{ "The capture file \"" + path.string() + "\" could not be opened." };
+      }
+      struct stat status{ };
+      if (fstat(descriptor, &status) == 0 && status.st_size > 0)
+      {
+        size = static_cast<std::size_t>(status.st_size);
+        data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      }
+      ::close(descriptor);
+      if (data == MAP_FAILED)
+      {
+        throw dispatch::error{ "The capture file \"" + path.string() + "\" could not be mapped." };
+      }
+    }
+
+    ~mapping() noexcept {
+      munmap(data, size);
+    }
+
+    std::span<const std::byte> bytes() const noexcept {
+      return { static_cast<const std::byte*>(data), size };
+    }
+#else
+    std::vector<std::byte> data{ };
+
+    explicit mapping(const std::filesystem::path& path) {
+      auto input = std::ifstream{ path, std::ios::in | std::ios::binary };
+      if (!input)
+      {
+        throw dispatch::error{ "The capture file \"" + path.string() + "\" could not be opened." };
+      }
+      data.resize(std::filesystem::file_size(path));
+      input.read(reinterpret_cast<char*>(data.data()), data.size());
+    }
+
+    std::span<const std::byte> bytes() const noexcept {
+      return data;
+    }
+#endif
+  };
+
+  call_stream::record::record(const std::byte *const data) noexcept : m_data{ data } { }
+
+  std::uint16_t call_stream::record::level() const noexcept {
+    return header_of(m_data).level;
+  }
+
+  std::uint16_t call_stream::record::command() const noexcept {
+    return header_of(m_data).command;
+  }
+
+  std::uint32_t call_stream::record::thread() const noexcept {
+    return header_of(m_data).thread;
+  }
+
+  std::uint64_t call_stream::record::timestamp() const noexcept {
+    return header_of(m_data).timestamp;
+  }
+
+  std::span<const internal::base::encoded_argument> call_stream::record::arguments() const noexcept {
+    // Records are 8-byte aligned within a mapping that is page aligned, so arguments may be read in place.
+    return { reinterpret_cast<const internal::base::encoded_argument*>(m_data + sizeof(record_header)),
+             header_of(m_data).argument_count };
+  }
+
+  std::span<const std::byte> call_stream::record::payloads() const noexcept {
+    const auto header = header_of(m_data);
+    return { m_data + sizeof(record_header) + header.argument_count * sizeof(internal::base::encoded_argument),
+             header.payload_bytes };
+  }
+
+  std::size_t call_stream::record::size() const noexcept {
+    return record_size(header_of(m_data));
+  }
+
+  call_stream::iterator::iterator(const std::byte *const current) noexcept : m_current{ current } { }
+
+  call_stream::record call_stream::iterator::operator*() const noexcept {
+    return record{ m_current };
+  }
+
+  call_stream::iterator& call_stream::iterator::operator++() noexcept {
+    m_current += record{ m_current }.size();
+    return *this;
+  }
+
+  call_stream::iterator call_stream::iterator::operator++(int) noexcept {
+    auto result = *this;
+    ++(*this);
+    return result;
+  }
+
+  call_stream::call_stream(const std::filesystem::path& path) : m_mapping{ std::make_unique<mapping>(path) } {
+    const auto bytes = m_mapping->bytes();
+    auto header = stream_header{ };
+    if (bytes.size() < sizeof(header))
+    {
+      throw dispatch::error{ "The capture file \"" + path.string() + "\" is too small to be a call stream." };
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != magic || header.version != version || header.byte_order != byte_order)
+    {
+      throw dispatch::error{ "The capture file \"" + path.string() + "\" is not a compatible call stream." };
+    }
+    m_stride = header.stride;
+    if (header.index_offset)
+    {
+      // Every record and index entry is validated here, so iterators and seek() can trust them.
+      const auto corrupt = [&]() {
+        return dispatch::error{ "The capture file \"" + path.string() + "\" is corrupt." };
+      };
+      if (!m_stride || header.index_offset < sizeof(header) || header.index_offset > bytes.size() ||
+          header.index_count != (header.records + m_stride - 1) / m_stride ||
+          header.index_count > (bytes.size() - header.index_offset) / sizeof(std::uint64_t))
+      {
+        throw corrupt();
+      }
+      const auto index_size = header.index_count * sizeof(std::uint64_t);
+      m_records = bytes.subspan(sizeof(header), header.index_offset - sizeof(header));
+      m_index = bytes.subspan(header.index_offset, index_size);
+      auto offset = std::size_t{ sizeof(header) };
+      for (auto i = std::uint64_t{ 0 }; i < header.records; ++i)
+      {
+        if (!(i % m_stride))
+        {
+          auto entry = std::uint64_t{ };
+          std::memcpy(&entry, m_index.data() + (i / m_stride) * sizeof(std::uint64_t), sizeof(entry));
+          if (entry != offset)
+          {
+            throw corrupt();
+          }
+        }
+        const auto size = complete_record(bytes, offset, header.index_offset);
+        if (!size)
+        {
+          throw corrupt();
+        }
+        offset += size;
+      }
+      if (offset != header.index_offset)
+      {
+        throw corrupt();
+      }
+      m_count = header.records;
+    }
+    else
+    {
+      // The capture was never closed. Recover every complete record and ignore the index.
+      auto end = sizeof(header);
+      while (const auto size = complete_record(bytes, end, bytes.size()))
+      {
+        end += size;
+        ++m_count;
+      }
+      m_records = bytes.subspan(sizeof(header), end - sizeof(header));
+    }
+  }
+
+  call_stream::~call_stream() noexcept = default;
+
+  std::uint64_t call_stream::size() const noexcept {
+    return m_count;
+  }
+
+  call_stream::iterator call_stream::begin() const noexcept {
+    return iterator{ m_records.data() };
+  }
+
+  call_stream::iterator call_stream::end() const noexcept {
+    return iterator{ m_records.data() + m_records.size() };
+  }
+
+  call_stream::iterator call_stream::seek(const std::uint64_t index) const noexcept {
+    if (index >= m_count)
+    {
+      return end();
+    }
+    auto result = begin();
+    auto remaining = index;
+    if (const auto entry = m_stride ? index / m_stride : 0; entry < m_index.size() / sizeof(std::uint64_t))
+    {
+      auto offset = std::uint64_t{ };
+      std::memcpy(&offset, m_index.data() + entry * sizeof(std::uint64_t), sizeof(offset));
+      result = iterator{ m_records.data() + (offset - sizeof(stream_header)) };
+      remaining = index - entry * m_stride;
+    }
+    for (; remaining; --remaining)
+    {
+      ++result;
+    }
+    return result;
+  }
+
+  std::uint64_t call_replayer::replay(call_stream::iterator first, const call_stream::iterator last) const {
+    auto replayed = std::uint64_t{ 0 };
+    for (; first != last; ++first)
+    {
+      const auto current = *first;
+      const auto key = (static_cast<std::uint32_t>(current.level()) << 16) | current.command();
+      if (const auto found = m_handlers.find(key); found != m_handlers.end())
+      {
+        found->second(current);
+        ++replayed;
+      }
+    }
+    return replayed;
+  }
+
+  std::uint64_t call_replayer::replay(const call_stream& stream) const {
+    return replay(stream.begin(), stream.end());
+  }
+
+}
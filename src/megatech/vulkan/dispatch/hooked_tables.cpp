@@ -0,0 +1,54 @@
+/**
+ * @file hooked_tables.cpp
+ * @brief Hooked Vulkan Dispatch Tables
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#include "megatech/vulkan/dispatch/hooked_tables.hpp"
+
+#include <megatech/assertions.hpp>
+
+namespace megatech::vulkan::dispatch {
+
+namespace instance {
+
+  hooked_table::hooked_table(const table& base) : m_instance{ base.instance() }, m_hooks{ base } {
+    MEGATECH_POSTCONDITION(m_instance != nullptr);
+  }
+
+  bool hooked_table::hooked(const command cmd) const noexcept {
+    return m_hooks.hooked(cmd);
+  }
+
+  VkInstance hooked_table::instance() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_instance;
+  }
+
+}
+
+namespace device {
+
+  hooked_table::hooked_table(const table& base) :
+  m_instance{ base.instance() }, m_device{ base.device() }, m_hooks{ base } {
+    MEGATECH_POSTCONDITION(m_instance != nullptr);
+  }
+
+  bool hooked_table::hooked(const command cmd) const noexcept {
+    return m_hooks.hooked(cmd);
+  }
+
+  VkInstance hooked_table::instance() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_instance;
+  }
+
+  VkDevice hooked_table::device() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_device;
+  }
+
+}
+
+}
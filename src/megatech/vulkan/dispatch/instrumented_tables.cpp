@@ -0,0 +1,119 @@
+/**
+ * @file instrumented_tables.cpp
+ * @brief Instrumented Vulkan Dispatch Tables
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#include "megatech/vulkan/dispatch/instrumented_tables.hpp"
+
+#include <megatech/assertions.hpp>
+
+namespace megatech::vulkan::dispatch {
+
+namespace instance {
+
+  instrumented_table::instrumented_table(const table& base) :
+  m_instance{ base.instance() }, m_instrumentation{ base } {
+    MEGATECH_POSTCONDITION(m_instance != nullptr);
+  }
+
+  bool instrumented_table::instrumented(const command cmd) const noexcept {
+    return m_instrumentation.instrumented(cmd);
+  }
+
+  const call_counters& instrumented_table::counters() const noexcept {
+    return m_instrumentation.counters();
+  }
+
+  call_counters& instrumented_table::counters() noexcept {
+    return m_instrumentation.counters();
+  }
+
+  void instrumented_table::set_tracer(call_tracer *const tracer) noexcept {
+    m_instrumentation.set_tracer(tracer);
+  }
+
+  call_tracer* instrumented_table::tracer() const noexcept {
+    return m_instrumentation.tracer();
+  }
+
+  void instrumented_table::set_histograms(latency_histograms *const histograms) noexcept {
+    m_instrumentation.set_histograms(histograms);
+  }
+
+  latency_histograms* instrumented_table::histograms() const noexcept {
+    return m_instrumentation.histograms();
+  }
+
+  void instrumented_table::set_profiler(call_site_profiler *const profiler) noexcept {
+    m_instrumentation.set_profiler(profiler);
+  }
+
+  call_site_profiler* instrumented_table::profiler() const noexcept {
+    return m_instrumentation.profiler();
+  }
+
+  VkInstance instrumented_table::instance() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_instance;
+  }
+
+}
+
+namespace device {
+
+  instrumented_table::instrumented_table(const table& base) :
+  m_instance{ base.instance() }, m_device{ base.device() }, m_instrumentation{ base } {
+    MEGATECH_POSTCONDITION(m_instance != nullptr);
+  }
+
+  bool instrumented_table::instrumented(const command cmd) const noexcept {
+    return m_instrumentation.instrumented(cmd);
+  }
+
+  const call_counters& instrumented_table::counters() const noexcept {
+    return m_instrumentation.counters();
+  }
+
+  call_counters& instrumented_table::counters() noexcept {
+    return m_instrumentation.counters();
+  }
+
+  void instrumented_table::set_tracer(call_tracer *const tracer) noexcept {
+    m_instrumentation.set_tracer(tracer);
+  }
+
+  call_tracer* instrumented_table::tracer() const noexcept {
+    return m_instrumentation.tracer();
+  }
+
+  void instrumented_table::set_histograms(latency_histograms *const histograms) noexcept {
+    m_instrumentation.set_histograms(histograms);
+  }
+
+  latency_histograms* instrumented_table::histograms() const noexcept {
+    return m_instrumentation.histograms();
+  }
+
+  void instrumented_table::set_profiler(call_site_profiler *const profiler) noexcept {
+    m_instrumentation.set_profiler(profiler);
+  }
+
+  call_site_profiler* instrumented_table::profiler() const noexcept {
+    return m_instrumentation.profiler();
+  }
+
+  VkInstance instrumented_table::instance() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_instance;
+  }
+
+  VkDevice instrumented_table::device() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_device;
+  }
+
+}
+
+}
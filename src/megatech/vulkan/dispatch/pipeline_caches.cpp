@@ -0,0 +1,234 @@
+/**
+ * @file pipeline_caches.cpp
+ * @brief Vulkan Persistent Pipeline Caches
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#include "megatech/vulkan/dispatch/pipeline_caches.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <string>
+#include <system_error>
+
+#if __has_include(<sys/mman.h>) && __has_include(<fcntl.h>) && __has_include(<unistd.h>)
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #define MEGATECH_VULKAN_DISPATCH_HAS_MMAP (1)
+#endif
+
+namespace megatech::vulkan::dispatch {
+
+namespace {
+
+  // This is VkPipelineCacheHeaderVersionOne, which every pipeline cache begins with.
+  struct cache_header final {
+    std::uint32_t size;
+    std::uint32_t version;
+    std::uint32_t vendor;
+    std::uint32_t device;
+    std::array<std::uint8_t, 16> uuid;
+  };
+
+  static_assert(sizeof(cache_header) == 32, "Pipeline cache headers must be tightly packed.");
+
+  constexpr auto header_version_one = std::uint32_t{ 1 };
+
+  std::filesystem::path file_name(const std::uint32_t vendor, const std::uint32_t device,
+                                  const std::span<const std::uint8_t, 16> uuid) {
+    auto name = std::array<char, 96>{ };
+    auto written = std::snprintf(name.data(), name.size(), "pipeline-cache-%08x-%08x-", static_cast<unsigned>(vendor),
+                                 static_cast<unsigned>(device));
+    for (const auto byte : uuid)
+    {
+      written += std::snprintf(name.data() + written, name.size() - written, "%02x", static_cast<unsigned>(byte));
+    }
+    return std::string{ name.data(), static_cast<std::size_t>(written) } + ".bin";
+  }
+
+  std::filesystem::path temporary_path(const std::filesystem::path& path) {
+    // Concurrent writers (including other processes) must never share a temporary file.
+    static auto source = std::random_device{ };
+    static auto mutex = std::mutex{ };
+    auto lock = std::unique_lock{ mutex };
+    auto suffix = std::array<char, 32>{ };
+    std::snprintf(suffix.data(), suffix.size(), ".%08x%08x.tmp", static_cast<unsigned>(source()),
+                  static_cast<unsigned>(source()));
+    auto result = path;
+    result += suffix.data();
+    return result;
+  }
+
+}
+
+  struct pipeline_cache_file::mapping final {
+#ifdef MEGATECH_VULKAN_DISPATCH_HAS_MMAP
+    void* data{ MAP_FAILED };
+    std::size_t size{ };
+
+    explicit mapping(const std::filesystem::path& path) {
+      const auto descriptor = open(path.c_str(), O_RDONLY);
+      if (descriptor < 0)
+      {
+        return;
+      }
+      struct stat status{ };
+      if (fstat(descriptor, &status) == 0 && status.st_size > 0)
+      {
+        size = static_cast<std::size_t>(status.st_size);
+        data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      }
+      ::close(descriptor);
+    }
+
+    ~mapping() noexcept {
+      if (data != MAP_FAILED)
+      {
+        munmap(data, size);
+      }
+    }
+
+    std::span<const std::byte> bytes() const noexcept {
+      if (data == MAP_FAILED)
+      {
+        return { };
+      }
+      return { static_cast<const std::byte*>(data), size };
+    }
+#else
+    std::vector<std::byte> data{ };
+
+    explicit mapping(const std::filesystem::path& path) {
+      auto input = std::ifstream{ path, std::ios::in | std::ios::binary };
+      auto code = std::error_code{ };
+      const auto size = std::filesystem::file_size(path, code);
+      if (!input || code)
+      {
+        return;
+      }
+      data.resize(size);
+      if (!input.read(reinterpret_cast<char*>(data.data()), data.size()))
+      {
+        data.clear();
+      }
+    }
+
+    std::span<const std::byte> bytes() const noexcept {
+      return data;
+    }
+#endif
+  };
+
+  pipeline_cache_file::pipeline_cache_file(const std::filesystem::path& directory, const std::uint32_t vendor,
+                                           const std::uint32_t device, const std::span<const std::uint8_t, 16> uuid) :
+  m_path{ directory / file_name(vendor, device, uuid) },
+  m_vendor{ vendor },
+  m_device{ device } {
+    std::copy(uuid.begin(), uuid.end(), m_uuid.begin());
+  }
+
+  pipeline_cache_file::~pipeline_cache_file() noexcept = default;
+
+  const std::filesystem::path& pipeline_cache_file::path() const noexcept {
+    return m_path;
+  }
+
+  std::span<const std::byte> pipeline_cache_file::read() {
+    m_mapping = std::make_unique<mapping>(m_path);
+    const auto bytes = m_mapping->bytes();
+    auto header = cache_header{ };
+    if (bytes.size() < sizeof(header))
+    {
+      return { };
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.size < sizeof(header) || header.size > bytes.size() || header.version != header_version_one ||
+        header.vendor != m_vendor || header.device != m_device || header.uuid != m_uuid)
+    {
+      return { };
+    }
+    return bytes;
+  }
+
+  void pipeline_cache_file::write(const std::span<const std::byte> data) const {
+    auto code = std::error_code{ };
+    if (const auto directory = m_path.parent_path(); !directory.empty())
+    {
+      std::filesystem::create_directories(directory, code);
+      if (code)
+      {
+        throw dispatch::error{ "The pipeline cache directory \"" + directory.string() + "\" could not be created." };
+      }
+    }
+    const auto temporary = temporary_path(m_path);
+#ifdef MEGATECH_VULKAN_DISPATCH_HAS_MMAP
+    const auto descriptor = open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (descriptor < 0)
+    {
+      throw dispatch::error{ "The pipeline cache file \"" + temporary.string() + "\" could not be created." };
+    }
+    auto remaining = data;
+    while (!remaining.empty())
+    {
+      const auto written = ::write(descriptor, remaining.data(), remaining.size());
+      if (written < 0 && errno == EINTR)
+      {
+        continue;
+      }
+      if (written <= 0)
+      {
+        break;
+      }
+      remaining = remaining.subspan(static_cast<std::size_t>(written));
+    }
+    // The data must be durable before the rename is, or a crash could leave an empty file in place of the old one.
+    const auto synchronized = remaining.empty() && fsync(descriptor) == 0;
+    if (::close(descriptor) != 0 || !synchronized)
+    {
+      std::filesystem::remove(temporary, code);
+      throw dispatch::error{ "The pipeline cache file \"" + temporary.string() + "\" could not be written." };
+    }
+#else
+    {
+      auto output = std::ofstream{ temporary, std::ios::out | std::ios::trunc | std::ios::binary };
+      output.write(reinterpret_cast<const char*>(data.data()), data.size());
+      output.close();
+      if (!output)
+      {
+        std::filesystem::remove(temporary, code);
+        throw dispatch::error{ "The pipeline cache file \"" + temporary.string() + "\" could not be written." };
+      }
+    }
+#endif
+    std::filesystem::rename(temporary, m_path, code);
+    if (code)
+    {
+      std::filesystem::remove(temporary, code);
+      throw dispatch::error{ "The pipeline cache file \"" + m_path.string() + "\" could not be replaced." };
+    }
+#ifdef MEGATECH_VULKAN_DISPATCH_HAS_MMAP
+    // The rename is only durable once the directory entry is. Some file systems can't synchronize directories, which
+    // is reported as EINVAL.
+    const auto directory = m_path.has_parent_path() ? m_path.parent_path() : std::filesystem::path{ "." };
+    const auto directory_descriptor = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (directory_descriptor < 0)
+    {
+      throw dispatch::error{ "The pipeline cache directory \"" + directory.string() + "\" could not be opened." };
+    }
+    const auto directory_synchronized = fsync(directory_descriptor) == 0 || errno == EINVAL;
+    if (::close(directory_descriptor) != 0 || !directory_synchronized)
+    {
+      throw dispatch::error{ "The pipeline cache directory \"" + directory.string() + "\" could not be synchronized." };
+    }
+#endif
+  }
+
+}
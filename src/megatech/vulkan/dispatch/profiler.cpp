@@ -0,0 +1,161 @@
+/**
+ * @file profiler.cpp
+ * @brief Vulkan Command Call-Site Profiler
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#include "megatech/vulkan/dispatch/profiler.hpp"
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <sstream>
+
+#if __has_include(<dlfcn.h>)
+  #include <dlfcn.h>
+  #define MEGATECH_VULKAN_DISPATCH_HAS_DLADDR (1)
+#endif
+#if __has_include(<cxxabi.h>)
+  #include <cxxabi.h>
+  #define MEGATECH_VULKAN_DISPATCH_HAS_CXXABI (1)
+#endif
+
+#include <megatech/assertions.hpp>
+
+#include "megatech/vulkan/dispatch/error.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+namespace {
+
+  std::uint64_t mix(std::uint64_t key) noexcept {
+    // This is the SplitMix64 finalizer. Keys share their low bits with nearby call sites, so they need mixing.
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111eb;
+    return key ^ (key >> 31);
+  }
+
+  std::string demangle(const char *const name) {
+#ifdef MEGATECH_VULKAN_DISPATCH_HAS_CXXABI
+    auto status = 0;
+    const auto demangled = std::unique_ptr<char, decltype(&std::free)>{
+      abi::__cxa_demangle(name, nullptr, nullptr, &status), &std::free
+    };
+    if (!status && demangled)
+    {
+      return demangled.get();
+    }
+#endif
+    return name;
+  }
+
+  std::string symbolize(const void *const address) {
+    auto result = std::ostringstream{ };
+    result << std::hex << std::showbase;
+#ifdef MEGATECH_VULKAN_DISPATCH_HAS_DLADDR
+    auto info = Dl_info{ };
+    if (dladdr(address, &info) && info.dli_fname)
+    {
+      const auto module = std::filesystem::path{ info.dli_fname }.filename().string();
+      if (info.dli_sname && info.dli_saddr)
+      {
+        result << demangle(info.dli_sname) << "+"
+               << (reinterpret_cast<std::uintptr_t>(address) - reinterpret_cast<std::uintptr_t>(info.dli_saddr))
+               << " (" << module << ")";
+      }
+      else
+      {
+        // Without a symbol, the module offset is what addr2line expects.
+        result << module << "+"
+               << (reinterpret_cast<std::uintptr_t>(address) - reinterpret_cast<std::uintptr_t>(info.dli_fbase));
+      }
+      return result.str();
+    }
+#endif
+    result << reinterpret_cast<std::uintptr_t>(address);
+    return result.str();
+  }
+
+}
+
+  call_site_profiler::call_site_profiler(const std::size_t capacity) {
+    if (!capacity)
+    {
+      throw dispatch::error{ "The capacity of a call-site profiler cannot be zero." };
+    }
+    const auto size = std::bit_ceil(capacity);
+    m_entries = std::make_unique<entry[]>(size);
+    m_mask = size - 1;
+    MEGATECH_POSTCONDITION(m_entries != nullptr);
+  }
+
+  void call_site_profiler::record(const std::uint64_t key, const std::uint64_t ticks) noexcept {
+    const auto hash = mix(key);
+    for (auto i = std::size_t{ 0 }; i <= m_mask; ++i)
+    {
+      auto& current = m_entries[(hash + i) & m_mask];
+      auto existing = current.key.load(std::memory_order_acquire);
+      if (!existing)
+      {
+        // On failure, existing is updated with the key that won the entry, which may still be ours.
+        if (current.key.compare_exchange_strong(existing, key, std::memory_order_acq_rel))
+        {
+          existing = key;
+        }
+      }
+      if (existing == key)
+      {
+        current.calls.fetch_add(1, std::memory_order_relaxed);
+        current.ticks.fetch_add(ticks, std::memory_order_relaxed);
+        return;
+      }
+    }
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::vector<call_site_profiler::call_site> call_site_profiler::report() const {
+    auto lock = std::unique_lock{ m_mutex };
+    m_calibration.update();
+    auto result = std::vector<call_site>{ };
+    for (auto i = std::size_t{ 0 }; i <= m_mask; ++i)
+    {
+      const auto& current = m_entries[i];
+      const auto key = current.key.load(std::memory_order_acquire);
+      if (!key)
+      {
+        continue;
+      }
+      auto site = call_site{ };
+      site.address = reinterpret_cast<const void*>(static_cast<std::uintptr_t>(key >> 16));
+      site.level = static_cast<std::uint16_t>((key >> 14) & 0x3);
+      site.command = static_cast<std::uint16_t>(key & 0x3fff);
+      site.name = site.level == 1 ? instance::to_string(static_cast<instance::command>(site.command)) :
+                                    device::to_string(static_cast<device::command>(site.command));
+      site.calls = current.calls.load(std::memory_order_relaxed);
+      site.nanoseconds = m_calibration.nanoseconds(current.ticks.load(std::memory_order_relaxed));
+      site.symbol = symbolize(site.address);
+      result.emplace_back(std::move(site));
+    }
+    std::ranges::sort(result, [](const call_site& a, const call_site& b) { return a.nanoseconds > b.nanoseconds; });
+    return result;
+  }
+
+  void call_site_profiler::reset() noexcept {
+    for (auto i = std::size_t{ 0 }; i <= m_mask; ++i)
+    {
+      auto& current = m_entries[i];
+      current.key.store(0, std::memory_order_relaxed);
+      current.calls.store(0, std::memory_order_relaxed);
+      current.ticks.store(0, std::memory_order_relaxed);
+    }
+    m_dropped.store(0, std::memory_order_relaxed);
+  }
+
+  std::uint64_t call_site_profiler::dropped() const noexcept {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+
+}
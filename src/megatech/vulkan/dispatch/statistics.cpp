@@ -0,0 +1,103 @@
+/**
+ * @file statistics.cpp
+ * @brief Vulkan Dispatch Table Construction Statistics
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#include "megatech/vulkan/dispatch/statistics.hpp"
+
+#include <algorithm>
+
+#include <megatech/assertions.hpp>
+
+#include "megatech/vulkan/dispatch/error.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+namespace {
+
+  const char* name_of(const table_level level, const std::size_t index) {
+    switch (level)
+    {
+    case table_level::global:
+      return global::to_string(static_cast<global::command>(index));
+    case table_level::instance:
+      return instance::to_string(static_cast<instance::command>(index));
+    default:
+      return device::to_string(static_cast<device::command>(index));
+    }
+  }
+
+}
+
+  void construction_statistics::record(const table_level level, const std::span<const std::uint64_t> ticks,
+                                       const std::span<const PFN_vkVoidFunction> pfns,
+                                       const std::uint64_t loader_calls, const std::uint64_t total) {
+    if (ticks.size() != pfns.size())
+    {
+      throw dispatch::error{ "The number of resolution timings must match the number of resolved commands." };
+    }
+    auto lock = std::unique_lock{ m_mutex };
+    auto& current = m_levels[static_cast<std::size_t>(level)];
+    if (current.resolution_ticks.size() < ticks.size())
+    {
+      current.resolution_ticks.resize(ticks.size());
+      current.resolution_counts.resize(ticks.size());
+      current.null_counts.resize(ticks.size());
+    }
+    ++current.tables;
+    current.loader_calls += loader_calls;
+    current.ticks += total;
+    for (auto i = std::size_t{ 0 }; i < ticks.size(); ++i)
+    {
+      current.resolution_ticks[i] += ticks[i];
+      ++current.resolution_counts[i];
+      if (!pfns[i])
+      {
+        ++current.null_counts[i];
+        ++current.null_slots;
+      }
+    }
+    MEGATECH_POSTCONDITION(current.resolution_ticks.size() >= ticks.size());
+  }
+
+  construction_statistics::summary construction_statistics::report(const table_level level,
+                                                                   const std::size_t slowest) const {
+    auto lock = std::unique_lock{ m_mutex };
+    m_calibration.update();
+    const auto& current = m_levels[static_cast<std::size_t>(level)];
+    auto result = summary{ };
+    result.tables = current.tables;
+    result.loader_calls = current.loader_calls;
+    result.null_slots = current.null_slots;
+    result.nanoseconds = m_calibration.nanoseconds(current.ticks);
+    auto resolutions = std::vector<resolution>{ };
+    resolutions.reserve(current.resolution_ticks.size());
+    for (auto i = std::size_t{ 0 }; i < current.resolution_ticks.size(); ++i)
+    {
+      if (!current.resolution_counts[i])
+      {
+        continue;
+      }
+      auto entry = resolution{ };
+      entry.name = name_of(level, i);
+      entry.count = current.resolution_counts[i];
+      entry.null_count = current.null_counts[i];
+      entry.nanoseconds = m_calibration.nanoseconds(current.resolution_ticks[i]);
+      resolutions.emplace_back(entry);
+    }
+    const auto count = std::min(slowest, resolutions.size());
+    std::ranges::partial_sort(resolutions, resolutions.begin() + count,
+                              [](const resolution& a, const resolution& b) { return a.nanoseconds > b.nanoseconds; });
+    resolutions.resize(count);
+    result.slowest = std::move(resolutions);
+    return result;
+  }
+
+  void construction_statistics::reset() noexcept {
+    auto lock = std::unique_lock{ m_mutex };
+    m_levels = { };
+  }
+
+}
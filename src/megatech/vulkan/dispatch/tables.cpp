@@ -7,9 +7,14 @@
  */
 #include "megatech/vulkan/dispatch/tables.hpp"
 
+#include <vector>
+
 #include <megatech/assertions.hpp>
 
 #include "megatech/vulkan/dispatch/error.hpp"
+#include "megatech/vulkan/dispatch/statistics.hpp"
+
+#include "megatech/vulkan/dispatch/internal/base/timestamp.hpp"
 
 #define G(cl, ctx, cmd) (m_pfns[static_cast<std::size_t>(megatech::vulkan::dispatch::global::command::cmd)] = (cl)((ctx), (#cmd)))
 #define I(cl, ctx, cmd) (m_pfns[static_cast<std::size_t>(megatech::vulkan::dispatch::instance::command::cmd)] = (cl)((ctx), (#cmd)))
@@ -17,18 +22,79 @@
 
 namespace megatech::vulkan::dispatch {
 
+namespace {
+
+  // The unmeasured path resolves each command with straight-line code generated from the command list. The measured
+  // path loops over command names instead, so that timing doesn't double the size of every constructor.
+  template <typename Command, std::size_t Count>
+  class measurement final {
+  private:
+    construction_statistics* m_statistics{ };
+    table_level m_level{ };
+    std::uint64_t m_start{ internal::base::timestamp() };
+    std::uint64_t m_loader_calls{ };
+    std::vector<std::uint64_t> m_ticks{ };
+  public:
+    measurement(construction_statistics *const statistics, const table_level level) :
+    m_statistics{ statistics }, m_level{ level } { }
+
+    explicit operator bool() const noexcept {
+      return m_statistics != nullptr;
+    }
+
+    template <typename Loader, typename Context>
+    void resolve(std::array<PFN_vkVoidFunction, Count>& pfns, const Loader loader, const Context context) {
+      m_ticks.resize(Count);
+      for (auto i = std::size_t{ 0 }; i < Count; ++i)
+      {
+        const auto start = internal::base::timestamp();
+        pfns[i] = loader(context, to_string(static_cast<Command>(i)));
+        m_ticks[i] = internal::base::timestamp() - start;
+      }
+      m_loader_calls += Count;
+    }
+
+    void count_loader_call() noexcept {
+      ++m_loader_calls;
+    }
+
+    void finish(const std::array<PFN_vkVoidFunction, Count>& pfns) {
+      if (m_statistics)
+      {
+        m_statistics->record(m_level, m_ticks, pfns, m_loader_calls, internal::base::timestamp() - m_start);
+      }
+    }
+  };
+
+}
+
 namespace global {
 
 #define MEGATECH_VULKAN_DISPATCH_COMMAND(cmd) G(global, nullptr, cmd);
 
-  table::table(const PFN_vkGetInstanceProcAddr global) {
+  table::table(const PFN_vkGetInstanceProcAddr global) : table{ nullptr, global } { }
+
+  table::table(const PFN_vkGetInstanceProcAddr global, construction_statistics& statistics) :
+  table{ &statistics, global } { }
+
+  table::table(construction_statistics *const statistics, const PFN_vkGetInstanceProcAddr global) {
     if (!global)
     {
       throw dispatch::error{ "The global loader command, \"vkGetInstanceProcAddr\", cannot be null." };
     }
-    MEGATECH_VULKAN_DISPATCH_GLOBAL_COMMAND_LIST
+    auto measure = measurement<command, MEGATECH_VULKAN_DISPATCH_GLOBAL_COMMAND_COUNT>{ statistics,
+                                                                                       table_level::global };
+    if (measure)
+    {
+      measure.resolve(m_pfns, global, nullptr);
+    }
+    else
+    {
+      MEGATECH_VULKAN_DISPATCH_GLOBAL_COMMAND_LIST
+    }
     constexpr auto gipa = static_cast<std::size_t>(command::vkGetInstanceProcAddr);
     m_pfns[gipa] = reinterpret_cast<PFN_vkVoidFunction>(global);
+    measure.finish(m_pfns);
     MEGATECH_POSTCONDITION(m_pfns[gipa] != nullptr);
     MEGATECH_POSTCONDITION(m_pfns[gipa] == reinterpret_cast<PFN_vkVoidFunction>(global));
   }
@@ -41,14 +107,32 @@ namespace instance {
 
 #define MEGATECH_VULKAN_DISPATCH_COMMAND(cmd) I(cl, instance, cmd);
 
-  table::table(const megatech::vulkan::dispatch::global::table& global, const VkInstance instance) {
+  table::table(const megatech::vulkan::dispatch::global::table& global, const VkInstance instance) :
+  table{ nullptr, global, instance } { }
+
+  table::table(const megatech::vulkan::dispatch::global::table& global, const VkInstance instance,
+               construction_statistics& statistics) :
+  table{ &statistics, global, instance } { }
+
+  table::table(construction_statistics *const statistics, const megatech::vulkan::dispatch::global::table& global,
+               const VkInstance instance) {
     using gcmd = megatech::vulkan::dispatch::global::command;
     if (!instance)
     {
       throw dispatch::error{ "The \"VkInstance\" handle cannot be null." };
     }
+    auto measure = measurement<command, MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_COUNT>{ statistics,
+                                                                                         table_level::instance };
     const auto cl = *reinterpret_cast<const PFN_vkGetInstanceProcAddr*>(global.get(gcmd::vkGetInstanceProcAddr));
-    MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_LIST
+    if (measure)
+    {
+      measure.resolve(m_pfns, cl, instance);
+    }
+    else
+    {
+      MEGATECH_VULKAN_DISPATCH_INSTANCE_COMMAND_LIST
+    }
+    measure.finish(m_pfns);
     m_instance = instance;
     MEGATECH_POSTCONDITION(m_instance != nullptr);
   }
@@ -67,15 +151,35 @@ namespace device {
 #define MEGATECH_VULKAN_DISPATCH_COMMAND(cmd) D(cl, device, cmd);
 
   table::table(const megatech::vulkan::dispatch::global::table& global,
+               const megatech::vulkan::dispatch::instance::table& instance, const VkDevice device) :
+  table{ nullptr, global, instance, device } { }
+
+  table::table(const megatech::vulkan::dispatch::global::table& global,
+               const megatech::vulkan::dispatch::instance::table& instance, const VkDevice device,
+               construction_statistics& statistics) :
+  table{ &statistics, global, instance, device } { }
+
+  table::table(construction_statistics *const statistics, const megatech::vulkan::dispatch::global::table& global,
                const megatech::vulkan::dispatch::instance::table& instance, const VkDevice device) {
     using gcmd = megatech::vulkan::dispatch::global::command;
     if (!device)
     {
       throw dispatch::error{ "The \"VkDevice\" handle cannot be null." };
     }
+    auto measure = measurement<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT>{ statistics,
+                                                                                       table_level::device };
     const auto gipa = *reinterpret_cast<const PFN_vkGetInstanceProcAddr*>(global.get(gcmd::vkGetInstanceProcAddr));
     const auto cl = reinterpret_cast<PFN_vkGetDeviceProcAddr>(gipa(instance.instance(), "vkGetDeviceProcAddr"));
-    MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+    measure.count_loader_call();
+    if (measure)
+    {
+      measure.resolve(m_pfns, cl, device);
+    }
+    else
+    {
+      MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+    }
+    measure.finish(m_pfns);
     m_instance = instance.instance();
     m_device = device;
     MEGATECH_POSTCONDITION(m_instance != nullptr);
@@ -86,14 +190,32 @@ namespace device {
 
 #define MEGATECH_VULKAN_DISPATCH_COMMAND(cmd) D(cl, instance, cmd);
 
-  table::table(const megatech::vulkan::dispatch::global::table& global, const VkInstance instance) {
+  table::table(const megatech::vulkan::dispatch::global::table& global, const VkInstance instance) :
+  table{ nullptr, global, instance } { }
+
+  table::table(const megatech::vulkan::dispatch::global::table& global, const VkInstance instance,
+               construction_statistics& statistics) :
+  table{ &statistics, global, instance } { }
+
+  table::table(construction_statistics *const statistics, const megatech::vulkan::dispatch::global::table& global,
+               const VkInstance instance) {
     using gcmd = megatech::vulkan::dispatch::global::command;
     if (!instance)
     {
       throw dispatch::error{ "The \"VkInstance\" handle cannot be null." };
     }
+    auto measure = measurement<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT>{ statistics,
+                                                                                       table_level::device };
     const auto cl = *reinterpret_cast<const PFN_vkGetInstanceProcAddr*>(global.get(gcmd::vkGetInstanceProcAddr));
-    MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+    if (measure)
+    {
+      measure.resolve(m_pfns, cl, instance);
+    }
+    else
+    {
+      MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+    }
+    measure.finish(m_pfns);
     m_instance = instance;
     MEGATECH_POSTCONDITION(m_instance != nullptr);
     MEGATECH_POSTCONDITION(m_device == nullptr);
@@ -105,10 +227,28 @@ namespace device {
 #define MEGATECH_VULKAN_DISPATCH_COMMAND(cmd) D(cl, (instance.instance()), cmd);
 
   table::table(const megatech::vulkan::dispatch::global::table& global,
+               const megatech::vulkan::dispatch::instance::table& instance) :
+  table{ nullptr, global, instance } { }
+
+  table::table(const megatech::vulkan::dispatch::global::table& global,
+               const megatech::vulkan::dispatch::instance::table& instance, construction_statistics& statistics) :
+  table{ &statistics, global, instance } { }
+
+  table::table(construction_statistics *const statistics, const megatech::vulkan::dispatch::global::table& global,
                const megatech::vulkan::dispatch::instance::table& instance) {
     using gcmd = megatech::vulkan::dispatch::global::command;
+    auto measure = measurement<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT>{ statistics,
+                                                                                       table_level::device };
     const auto cl = *reinterpret_cast<const PFN_vkGetInstanceProcAddr*>(global.get(gcmd::vkGetInstanceProcAddr));
-    MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+    if (measure)
+    {
+      measure.resolve(m_pfns, cl, instance.instance());
+    }
+    else
+    {
+      MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+    }
+    measure.finish(m_pfns);
     m_instance = instance.instance();
     MEGATECH_POSTCONDITION(m_instance != nullptr);
     MEGATECH_POSTCONDITION(m_device == nullptr);
@@ -118,7 +258,12 @@ namespace device {
 
 #define MEGATECH_VULKAN_DISPATCH_COMMAND(cmd) D(cl, device, cmd);
 
-  table::table(const table& base, const VkDevice device) {
+  table::table(const table& base, const VkDevice device) : table{ nullptr, base, device } { }
+
+  table::table(const table& base, const VkDevice device, construction_statistics& statistics) :
+  table{ &statistics, base, device } { }
+
+  table::table(construction_statistics *const statistics, const table& base, const VkDevice device) {
     using dcmd = megatech::vulkan::dispatch::device::command;
     if (base.device())
     {
@@ -128,8 +273,18 @@ namespace device {
     {
       throw dispatch::error{ "The \"VkDevice\" handle cannot be null." };
     }
+    auto measure = measurement<command, MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_COUNT>{ statistics,
+                                                                                       table_level::device };
     const auto cl = *reinterpret_cast<const PFN_vkGetDeviceProcAddr*>(base.get(dcmd::vkGetDeviceProcAddr));
-    MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+    if (measure)
+    {
+      measure.resolve(m_pfns, cl, device);
+    }
+    else
+    {
+      MEGATECH_VULKAN_DISPATCH_DEVICE_COMMAND_LIST
+    }
+    measure.finish(m_pfns);
     m_instance = base.m_instance;
     m_device = device;
     MEGATECH_POSTCONDITION(m_instance != nullptr);
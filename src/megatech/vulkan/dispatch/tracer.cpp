@@ -0,0 +1,119 @@
+/**
+ * @file tracer.cpp
+ * @brief Vulkan Command Call Tracer
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#include "megatech/vulkan/dispatch/tracer.hpp"
+
+#include <bit>
+#include <condition_variable>
+#include <iomanip>
+
+#include <megatech/assertions.hpp>
+
+#include "megatech/vulkan/dispatch/error.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+  call_tracer::call_tracer(const std::filesystem::path& path, const std::size_t capacity,
+                           const std::chrono::milliseconds interval) :
+  m_capacity{ std::bit_ceil(capacity) } {
+    if (!capacity)
+    {
+      throw dispatch::error{ "The ring buffer capacity of a call tracer cannot be zero." };
+    }
+    m_output.open(path, std::ios::out | std::ios::trunc);
+    if (!m_output)
+    {
+      throw dispatch::error{ "The trace file \"" + path.string() + "\" could not be opened." };
+    }
+    // This is the JSON Array Format described by the Trace Event Format specification. The closing bracket is
+    // optional, so a truncated trace (e.g., from a crashed process) remains loadable.
+    m_output << "[\n";
+    m_output << std::fixed << std::setprecision(3);
+    if (interval.count() > 0)
+    {
+      m_drainer = std::jthread{ [this, interval](std::stop_token stop) {
+        auto mutex = std::mutex{ };
+        auto condition = std::condition_variable_any{ };
+        auto lock = std::unique_lock{ mutex };
+        while (!condition.wait_for(lock, stop, interval, [&]() { return stop.stop_requested(); }))
+        {
+          drain();
+        }
+      } };
+    }
+    MEGATECH_POSTCONDITION(m_capacity > 0);
+    MEGATECH_POSTCONDITION(std::has_single_bit(m_capacity));
+  }
+
+  call_tracer::~call_tracer() noexcept {
+    if (m_drainer.joinable())
+    {
+      m_drainer.request_stop();
+      m_drainer.join();
+    }
+    try
+    {
+      drain();
+      m_output << "\n]\n";
+    }
+    catch (...)
+    {
+      // Destructors must not throw. Losing the tail of a trace is preferable to terminating.
+    }
+  }
+
+  std::uint32_t call_tracer::thread_index() noexcept {
+    static auto next = std::atomic<std::uint32_t>{ 1 };
+    static thread_local const auto index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+  }
+
+  void call_tracer::allocate(ring& current) {
+    current.events = std::make_unique<event[]>(m_capacity);
+    current.mask = m_capacity - 1;
+  }
+
+  void call_tracer::write(const event& current) {
+    const auto name = current.level == 1 ? instance::to_string(static_cast<instance::command>(current.command)) :
+                                           device::to_string(static_cast<device::command>(current.command));
+    const auto start = m_calibration.since_origin(current.start) / 1000.0;
+    const auto duration = m_calibration.nanoseconds(current.end - current.start) / 1000.0;
+    if (!m_empty)
+    {
+      m_output << ",\n";
+    }
+    m_output << R"({"name":")" << name << R"(","cat":")" << (current.level == 1 ? "instance" : "device")
+             << R"(","ph":"X","pid":1,"tid":)" << current.thread << R"(,"ts":)" << start << R"(,"dur":)"
+             << duration << "}";
+    m_empty = false;
+  }
+
+  std::size_t call_tracer::drain() {
+    auto lock = std::unique_lock{ m_mutex };
+    auto written = std::size_t{ 0 };
+    m_calibration.update();
+    m_rings.for_each([&](ring& current) {
+      const auto head = current.head.load(std::memory_order_acquire);
+      auto tail = current.tail.load(std::memory_order_relaxed);
+      for (; tail != head; ++tail)
+      {
+        write(current.events[tail & current.mask]);
+        ++written;
+      }
+      current.tail.store(tail, std::memory_order_release);
+    });
+    m_output.flush();
+    return written;
+  }
+
+  std::uint64_t call_tracer::dropped() const {
+    auto result = std::uint64_t{ 0 };
+    m_rings.for_each([&](const ring& current) { result += current.dropped.load(std::memory_order_relaxed); });
+    return result;
+  }
+
+}
@@ -0,0 +1,168 @@
+/**
+ * @file trampoline_tables.cpp
+ * @brief Trampoline Vulkan Dispatch Tables
+ * @author Alexander Rothman <[gnomesort@megate.ch](mailto:gnomesort@megate.ch)>
+ * @date 2024
+ * @copyright AGPL-3.0-or-later
+ */
+#include "megatech/vulkan/dispatch/trampoline_tables.hpp"
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#if __has_include(<unistd.h>)
+  #include <unistd.h>
+  #define MEGATECH_VULKAN_DISPATCH_HAS_GETPID (1)
+#endif
+#if __has_include(<dlfcn.h>) && __has_include(<link.h>)
+  #include <dlfcn.h>
+  #include <link.h>
+  // dladdr1() is a GNU extension. RTLD_DL_SYMENT is an enumerator, so it can't be detected by the preprocessor.
+  #ifdef __GLIBC__
+    #define MEGATECH_VULKAN_DISPATCH_HAS_DLADDR1 (1)
+  #endif
+#endif
+
+#include <megatech/assertions.hpp>
+
+#include "megatech/vulkan/dispatch/error.hpp"
+
+namespace megatech::vulkan::dispatch {
+
+namespace {
+
+  std::filesystem::path default_perf_map() {
+#ifdef MEGATECH_VULKAN_DISPATCH_HAS_GETPID
+    return "/tmp/perf-" + std::to_string(getpid()) + ".map";
+#else
+    throw dispatch::error{ "perf maps are not supported on this platform." };
+#endif
+  }
+
+  std::size_t symbol_size([[maybe_unused]] const PFN_vkVoidFunction pfn) noexcept {
+#ifdef MEGATECH_VULKAN_DISPATCH_HAS_DLADDR1
+    auto info = Dl_info{ };
+    auto symbol = static_cast<void*>(nullptr);
+    const auto address = reinterpret_cast<void*>(pfn);
+    if (dladdr1(address, &info, &symbol, RTLD_DL_SYMENT) && symbol && info.dli_saddr == address)
+    {
+      return static_cast<const ElfW(Sym)*>(symbol)->st_size;
+    }
+#endif
+    return 0;
+  }
+
+  template <typename Command, std::size_t Count>
+  std::size_t write_perf_map(const internal::base::routing<Command, Count>& routing,
+                             const std::filesystem::path& path) {
+    auto entries = std::map<std::uintptr_t, std::string>{ };
+    auto written = std::size_t{ 0 };
+    for (auto i = std::size_t{ 0 }; i < Count; ++i)
+    {
+      const auto cmd = static_cast<Command>(i);
+      if (!routing.routed(cmd))
+      {
+        continue;
+      }
+      const auto pfn = *routing.slot(i);
+      if (const auto size = symbol_size(pfn); size)
+      {
+        auto entry = std::ostringstream{ };
+        entry << std::hex << reinterpret_cast<std::uintptr_t>(pfn) << " " << size << " mvd_trampoline_"
+              << to_string(cmd);
+        entries[reinterpret_cast<std::uintptr_t>(pfn)] = entry.str();
+        ++written;
+      }
+    }
+    // Slots are shared by every table in the process, so entries that were written previously (e.g., by another table
+    // or by an earlier call) are merged by address rather than appended again. Newer entries replace older ones,
+    // because a slot can be rebound to a different command.
+    if (auto input = std::ifstream{ path }; input)
+    {
+      for (auto line = std::string{ }; std::getline(input, line);)
+      {
+        auto start = std::uintptr_t{ 0 };
+        if (auto parser = std::istringstream{ line }; parser >> std::hex >> start)
+        {
+          entries.try_emplace(start, line);
+        }
+      }
+    }
+    auto output = std::ofstream{ path, std::ios::out | std::ios::trunc };
+    if (!output)
+    {
+      throw dispatch::error{ "The perf map \"" + path.string() + "\" could not be opened." };
+    }
+    for (const auto& [start, entry] : entries)
+    {
+      output << entry << "\n";
+    }
+    output.flush();
+    if (!output)
+    {
+      throw dispatch::error{ "The perf map \"" + path.string() + "\" could not be written." };
+    }
+    return written;
+  }
+
+}
+
+namespace instance {
+
+  trampoline_table::trampoline_table(const table& base) : m_instance{ base.instance() }, m_routing{ base } {
+    MEGATECH_POSTCONDITION(m_instance != nullptr);
+  }
+
+  bool trampoline_table::routed(const command cmd) const noexcept {
+    return m_routing.routed(cmd);
+  }
+
+  std::size_t trampoline_table::write_perf_map() const {
+    return write_perf_map(default_perf_map());
+  }
+
+  std::size_t trampoline_table::write_perf_map(const std::filesystem::path& path) const {
+    return dispatch::write_perf_map(m_routing, path);
+  }
+
+  VkInstance trampoline_table::instance() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_instance;
+  }
+
+}
+
+namespace device {
+
+  trampoline_table::trampoline_table(const table& base) :
+  m_instance{ base.instance() }, m_device{ base.device() }, m_routing{ base } {
+    MEGATECH_POSTCONDITION(m_instance != nullptr);
+  }
+
+  bool trampoline_table::routed(const command cmd) const noexcept {
+    return m_routing.routed(cmd);
+  }
+
+  std::size_t trampoline_table::write_perf_map() const {
+    return write_perf_map(default_perf_map());
+  }
+
+  std::size_t trampoline_table::write_perf_map(const std::filesystem::path& path) const {
+    return dispatch::write_perf_map(m_routing, path);
+  }
+
+  VkInstance trampoline_table::instance() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_instance;
+  }
+
+  VkDevice trampoline_table::device() const {
+    MEGATECH_PRECONDITION(m_instance != nullptr);
+    return m_device;
+  }
+
+}
+
+}
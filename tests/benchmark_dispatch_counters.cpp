@@ -0,0 +1,222 @@
+#include <iostream>
+
+#include "common.hpp"
+#include "perf_counters.hpp"
+
+// See benchmark_dispatch.cpp. Failing via FAIL(...) inside of a measured loop would distort the results.
+#undef CHECK_PFN
+#define CHECK_PFN(pfn) \
+  do \
+  { \
+    if (!pfn) \
+    { \
+      throw megatech::vulkan::dispatch::error("The function-pointer returned by the dispatch table was null."); \
+    } \
+  } \
+  while (0)
+
+#define CHECK_PPFN(ppfn) \
+  do \
+  { \
+    if (!ppfn) \
+    { \
+      throw megatech::vulkan::dispatch::error("The pointer-to-function-pointer returned by the dispatch table was " \
+                                              "null."); \
+    } \
+  } \
+  while (0)
+
+namespace {
+
+  constexpr auto lookup_iterations = std::uint64_t{ 10'000'000 };
+  // The loader's lookups compare strings, so they're measured with fewer iterations.
+  constexpr auto loader_iterations = std::uint64_t{ 1'000'000 };
+  constexpr auto construction_iterations = std::uint64_t{ 1'000 };
+
+  template <typename Operation>
+  void run(perf_counters& counters, const char* name, const std::uint64_t iterations, Operation&& operation) {
+    // Warm up caches and branch predictors before measuring.
+    for (auto i = std::uint64_t{ 0 }; i < iterations / 100 + 1; ++i)
+    {
+      operation();
+    }
+    perf_counters::print(std::cout, name, counters.measure(iterations, operation));
+  }
+
+}
+
+TEST_CASE("Hardware Performance Counters for megatech::vulkan::dispatch Tables", "[dispatch][benchmark]") {
+  using namespace megatech::vulkan::dispatch;
+  auto counters = perf_counters{ };
+  if (!counters.available())
+  {
+    std::cout << "Hardware performance counters are unavailable. Only timing results will be reported.\n";
+  }
+  perf_counters::print_header(std::cout);
+
+  // Global Dispatch
+  run(counters, "vkGetInstanceProcAddr(nullptr, ...)", loader_iterations, [&]() {
+    const auto pfn = vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceLayerProperties");
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  run(counters, "Global Construction", construction_iterations, [&]() {
+    const auto gdt = global::table{ vkGetInstanceProcAddr };
+    keep_value(gdt);
+  });
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  run(counters, "Global Preload with Index", lookup_iterations, [&]() {
+    const auto ppfn = gdt.get(global::command::vkEnumerateInstanceLayerProperties);
+    const auto pfn = *reinterpret_cast<const PFN_vkEnumerateInstanceLayerProperties*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  run(counters, "Global Preload with Run-Time Hash", lookup_iterations, [&]() {
+    const auto ppfn = gdt.get(fnv_1a_cstr("vkEnumerateInstanceLayerProperties"));
+    CHECK_PPFN(ppfn);
+    const auto pfn = *reinterpret_cast<const PFN_vkEnumerateInstanceLayerProperties*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  auto hash = fnv_1a_cstr("vkEnumerateInstanceLayerProperties");
+  keep_value(hash);
+  run(counters, "Global Preload with Stored Run-Time Hash", lookup_iterations, [&]() {
+    const auto ppfn = gdt.get(hash);
+    CHECK_PPFN(ppfn);
+    const auto pfn = *reinterpret_cast<const PFN_vkEnumerateInstanceLayerProperties*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  auto global_command = global::to_command(hash);
+  keep_value(global_command);
+  run(counters, "Global Preload with Stored Run-Time Hash->Index Map", lookup_iterations, [&]() {
+    const auto ppfn = gdt.get(global_command);
+    const auto pfn = *reinterpret_cast<const PFN_vkEnumerateInstanceLayerProperties*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  run(counters, "Global Preload with Compile-Time Hash", lookup_iterations, [&]() {
+    const auto ppfn = gdt.get(internal::base::fnv_1a_cstr("vkEnumerateInstanceLayerProperties"));
+    CHECK_PPFN(ppfn);
+    const auto pfn = *reinterpret_cast<const PFN_vkEnumerateInstanceLayerProperties*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+
+  // Instance Dispatch
+  auto instance = create_instance(gdt);
+  run(counters, "vkGetInstanceProcAddr(instance, ...)", loader_iterations, [&]() {
+    const auto pfn = vkGetInstanceProcAddr(instance, "vkDestroyInstance");
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  run(counters, "Instance Construction", construction_iterations, [&]() {
+    const auto idt = instance::table{ gdt, instance };
+    keep_value(idt);
+  });
+  auto idt = instance::table{ gdt, instance };
+  run(counters, "Instance Preload with Index", lookup_iterations, [&]() {
+    const auto ppfn = idt.get(instance::command::vkDestroyInstance);
+    const auto pfn = *reinterpret_cast<const PFN_vkDestroyInstance*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  run(counters, "Instance Preload with Run-Time Hash", lookup_iterations, [&]() {
+    const auto ppfn = idt.get(fnv_1a_cstr("vkDestroyInstance"));
+    CHECK_PPFN(ppfn);
+    const auto pfn = *reinterpret_cast<const PFN_vkDestroyInstance*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  hash = fnv_1a_cstr("vkDestroyInstance");
+  keep_value(hash);
+  run(counters, "Instance Preload with Stored Run-Time Hash", lookup_iterations, [&]() {
+    const auto ppfn = idt.get(hash);
+    CHECK_PPFN(ppfn);
+    const auto pfn = *reinterpret_cast<const PFN_vkDestroyInstance*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  auto instance_command = instance::to_command(hash);
+  keep_value(instance_command);
+  run(counters, "Instance Preload with Stored Run-Time Hash->Index Map", lookup_iterations, [&]() {
+    const auto ppfn = idt.get(instance_command);
+    const auto pfn = *reinterpret_cast<const PFN_vkDestroyInstance*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  run(counters, "Instance Preload with Compile-Time Hash", lookup_iterations, [&]() {
+    const auto ppfn = idt.get(internal::base::fnv_1a_cstr("vkDestroyInstance"));
+    CHECK_PPFN(ppfn);
+    const auto pfn = *reinterpret_cast<const PFN_vkDestroyInstance*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+
+  // Device Dispatch
+  auto device = create_device(idt);
+  auto vkGetDeviceProcAddr = reinterpret_cast<PFN_vkGetDeviceProcAddr>(vkGetInstanceProcAddr(instance,
+                                                                                            "vkGetDeviceProcAddr"));
+  CHECK_PFN(vkGetDeviceProcAddr);
+  vkGetDeviceProcAddr = reinterpret_cast<PFN_vkGetDeviceProcAddr>(vkGetDeviceProcAddr(device, "vkGetDeviceProcAddr"));
+  CHECK_PFN(vkGetDeviceProcAddr);
+  run(counters, "vkGetDeviceProcAddr(device, ...)", loader_iterations, [&]() {
+    const auto pfn = vkGetDeviceProcAddr(device, "vkDestroyDevice");
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  run(counters, "Device Construction", construction_iterations, [&]() {
+    const auto ddt = device::table{ gdt, idt, device };
+    keep_value(ddt);
+  });
+  run(counters, "Device Construction from VkInstance", construction_iterations, [&]() {
+    const auto ddt = device::table{ gdt, idt };
+    keep_value(ddt);
+  });
+  auto ddt = device::table{ gdt, idt, device };
+  run(counters, "Device Preload with Index", lookup_iterations, [&]() {
+    const auto ppfn = ddt.get(device::command::vkDestroyDevice);
+    const auto pfn = *reinterpret_cast<const PFN_vkDestroyDevice*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  run(counters, "Device Preload with Run-Time Hash", lookup_iterations, [&]() {
+    const auto ppfn = ddt.get(fnv_1a_cstr("vkDestroyDevice"));
+    CHECK_PPFN(ppfn);
+    const auto pfn = *reinterpret_cast<const PFN_vkDestroyDevice*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  hash = fnv_1a_cstr("vkDestroyDevice");
+  keep_value(hash);
+  run(counters, "Device Preload with Stored Run-Time Hash", lookup_iterations, [&]() {
+    const auto ppfn = ddt.get(hash);
+    CHECK_PPFN(ppfn);
+    const auto pfn = *reinterpret_cast<const PFN_vkDestroyDevice*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  auto device_command = device::to_command(hash);
+  keep_value(device_command);
+  run(counters, "Device Preload with Stored Run-Time Hash->Index Map", lookup_iterations, [&]() {
+    const auto ppfn = ddt.get(device_command);
+    const auto pfn = *reinterpret_cast<const PFN_vkDestroyDevice*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  run(counters, "Device Preload with Compile-Time Hash", lookup_iterations, [&]() {
+    const auto ppfn = ddt.get(internal::base::fnv_1a_cstr("vkDestroyDevice"));
+    CHECK_PPFN(ppfn);
+    const auto pfn = *reinterpret_cast<const PFN_vkDestroyDevice*>(ppfn);
+    CHECK_PFN(pfn);
+    keep_value(pfn);
+  });
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
@@ -99,10 +99,11 @@ const void* get_pfn_by_name(DispatchTable&& dt, const char* name) {
   CHECK_PFN(cmd)
 
 
-static inline VkInstance create_instance(const megatech::vulkan::dispatch::global::table& gdt) {
+static inline VkInstance create_instance(const megatech::vulkan::dispatch::global::table& gdt,
+                                         const std::uint32_t api_version = VK_API_VERSION_1_0) {
   auto app_info = VkApplicationInfo{ };
   app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-  app_info.apiVersion = VK_API_VERSION_1_0;
+  app_info.apiVersion = api_version;
   auto instance_info = VkInstanceCreateInfo{ };
   instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
   instance_info.pApplicationInfo = &app_info;
@@ -112,7 +113,9 @@ static inline VkInstance create_instance(const megatech::vulkan::dispatch::globa
   return instance;
 }
 
-static inline VkDevice create_device(const megatech::vulkan::dispatch::instance::table& idt) {
+// Devices created through an intercepted table are created through its policies.
+template <typename InstanceTable>
+static inline VkDevice create_device(const InstanceTable& idt) {
   DECLARE_INSTANCE_PFN(idt, vkEnumeratePhysicalDevices);
   auto sz = std::uint32_t{ };
   VK_CHECK(vkEnumeratePhysicalDevices(idt.instance(), &sz, nullptr));
@@ -127,4 +130,45 @@ static inline VkDevice create_device(const megatech::vulkan::dispatch::instance:
   return device;
 }
 
+// Timeline semaphores are core in Vulkan 1.2, but they're still an optional feature. This requires an instance created
+// with at least Vulkan 1.1, and it returns VK_NULL_HANDLE when the first physical device doesn't support them.
+template <typename InstanceTable>
+static inline VkDevice create_timeline_device(const InstanceTable& idt) {
+  DECLARE_INSTANCE_PFN(idt, vkEnumeratePhysicalDevices);
+  auto sz = std::uint32_t{ };
+  VK_CHECK(vkEnumeratePhysicalDevices(idt.instance(), &sz, nullptr));
+  auto physical_devices = new VkPhysicalDevice[sz];
+  VK_CHECK(vkEnumeratePhysicalDevices(idt.instance(), &sz, physical_devices));
+  const auto physical_device = physical_devices[0];
+  delete[] physical_devices;
+  DECLARE_INSTANCE_PFN(idt, vkGetPhysicalDeviceProperties);
+  auto properties = VkPhysicalDeviceProperties{ };
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  if (properties.apiVersion < VK_API_VERSION_1_2)
+  {
+    return VK_NULL_HANDLE;
+  }
+  DECLARE_INSTANCE_PFN(idt, vkGetPhysicalDeviceFeatures2);
+  auto supported_12 = VkPhysicalDeviceVulkan12Features{ };
+  supported_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  auto supported = VkPhysicalDeviceFeatures2{ };
+  supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  supported.pNext = &supported_12;
+  vkGetPhysicalDeviceFeatures2(physical_device, &supported);
+  if (!supported_12.timelineSemaphore)
+  {
+    return VK_NULL_HANDLE;
+  }
+  auto enabled_12 = VkPhysicalDeviceVulkan12Features{ };
+  enabled_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  enabled_12.timelineSemaphore = VK_TRUE;
+  auto device_info = VkDeviceCreateInfo{ };
+  device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  device_info.pNext = &enabled_12;
+  DECLARE_INSTANCE_PFN(idt, vkCreateDevice);
+  auto device = VkDevice{ };
+  VK_CHECK(vkCreateDevice(physical_device, &device_info, nullptr, &device));
+  return device;
+}
+
 #endif
@@ -0,0 +1,181 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <cstddef>
+#include <cinttypes>
+#include <cstring>
+
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// Prevent the compiler from discarding a value computed inside of a measured loop. This is equivalent to the usual
+// "DoNotOptimize" idiom.
+template <typename Type>
+inline void keep_value(const Type& value) {
+  asm volatile ("" : : "r,m"(value) : "memory");
+}
+
+// A small set of hardware performance counters opened with perf_event_open(2).
+//
+// Each counter is opened independently so that a PMU which cannot schedule all of the events at once will multiplex
+// them instead of failing. Counts are scaled by time_enabled / time_running to account for multiplexing. Counters
+// that cannot be opened (e.g., in containers where perf_event_paranoid forbids them or where no PMU is virtualized)
+// are reported as unavailable. If no counters are available at all, measurements fall back to timing only.
+class perf_counters final {
+public:
+  enum class event : std::size_t {
+    instructions,
+    branches,
+    branch_misses,
+    l1d_misses,
+    itlb_misses
+  };
+
+  static constexpr std::size_t event_count{ 5 };
+
+  struct sample final {
+    std::uint64_t iterations{ };
+    std::chrono::nanoseconds elapsed{ };
+    std::array<std::optional<double>, event_count> counts{ };
+  };
+private:
+  std::array<int, event_count> m_fds{ -1, -1, -1, -1, -1 };
+
+  static int open_event(const std::uint32_t type, const std::uint64_t config) {
+    auto attr = perf_event_attr{ };
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  static constexpr std::uint64_t cache_miss(const std::uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  }
+
+  void control(const unsigned long request) const {
+    for (const auto fd : m_fds)
+    {
+      if (fd >= 0)
+      {
+        ioctl(fd, request, 0);
+      }
+    }
+  }
+
+  std::optional<double> read_event(const event ev) const {
+    struct {
+      std::uint64_t value;
+      std::uint64_t time_enabled;
+      std::uint64_t time_running;
+    } result{ };
+    const auto fd = m_fds[static_cast<std::size_t>(ev)];
+    if (fd < 0 || read(fd, &result, sizeof(result)) != sizeof(result) || !result.time_running)
+    {
+      return std::nullopt;
+    }
+    return static_cast<double>(result.value) * (static_cast<double>(result.time_enabled) / result.time_running);
+  }
+public:
+  perf_counters() {
+    m_fds[static_cast<std::size_t>(event::instructions)] = open_event(PERF_TYPE_HARDWARE,
+                                                                     PERF_COUNT_HW_INSTRUCTIONS);
+    m_fds[static_cast<std::size_t>(event::branches)] = open_event(PERF_TYPE_HARDWARE,
+                                                                 PERF_COUNT_HW_BRANCH_INSTRUCTIONS);
+    m_fds[static_cast<std::size_t>(event::branch_misses)] = open_event(PERF_TYPE_HARDWARE,
+                                                                      PERF_COUNT_HW_BRANCH_MISSES);
+    m_fds[static_cast<std::size_t>(event::l1d_misses)] = open_event(PERF_TYPE_HW_CACHE,
+                                                                   cache_miss(PERF_COUNT_HW_CACHE_L1D));
+    m_fds[static_cast<std::size_t>(event::itlb_misses)] = open_event(PERF_TYPE_HW_CACHE,
+                                                                    cache_miss(PERF_COUNT_HW_CACHE_ITLB));
+  }
+
+  perf_counters(const perf_counters& other) = delete;
+  perf_counters(perf_counters&& other) = delete;
+
+  ~perf_counters() noexcept {
+    for (const auto fd : m_fds)
+    {
+      if (fd >= 0)
+      {
+        close(fd);
+      }
+    }
+  }
+
+  perf_counters& operator=(const perf_counters& rhs) = delete;
+  perf_counters& operator=(perf_counters&& rhs) = delete;
+
+  bool available() const {
+    for (const auto fd : m_fds)
+    {
+      if (fd >= 0)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Run "operation" the given number of times with all available counters enabled.
+  template <typename Operation>
+  sample measure(const std::uint64_t iterations, Operation&& operation) {
+    auto result = sample{ };
+    result.iterations = iterations;
+    control(PERF_EVENT_IOC_RESET);
+    const auto start = std::chrono::steady_clock::now();
+    control(PERF_EVENT_IOC_ENABLE);
+    for (auto i = std::uint64_t{ 0 }; i < iterations; ++i)
+    {
+      operation();
+    }
+    control(PERF_EVENT_IOC_DISABLE);
+    result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    for (auto i = std::size_t{ 0 }; i < event_count; ++i)
+    {
+      result.counts[i] = read_event(static_cast<event>(i));
+    }
+    return result;
+  }
+
+  static void print_header(std::ostream& out) {
+    out << std::left << std::setw(56) << "Scenario" << std::right << std::setw(13) << "ns/op"
+        << std::setw(13) << "instr/op" << std::setw(13) << "br/op" << std::setw(13) << "br-miss/op"
+        << std::setw(13) << "L1d-miss/op" << std::setw(13) << "iTLB-miss/op" << "\n";
+  }
+
+  static void print(std::ostream& out, const std::string_view name, const sample& s) {
+    const auto per_op = [&](const double value) { return value / static_cast<double>(s.iterations); };
+    out << std::left << std::setw(56) << name << std::right << std::fixed << std::setprecision(3)
+        << std::setw(13) << per_op(static_cast<double>(s.elapsed.count()));
+    for (const auto& count : s.counts)
+    {
+      if (count)
+      {
+        out << std::setw(13) << per_op(*count);
+      }
+      else
+      {
+        out << std::setw(13) << "n/a";
+      }
+    }
+    out << "\n";
+  }
+};
+
+#endif
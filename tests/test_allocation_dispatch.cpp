@@ -0,0 +1,242 @@
+#include <cinttypes>
+#include <cstring>
+
+#include <array>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "common.hpp"
+
+using allocator = megatech::vulkan::dispatch::host_allocator<VkAllocationCallbacks>;
+
+namespace {
+
+  class callbacks_policy final {
+  public:
+    const VkAllocationCallbacks* last{ };
+
+    template <auto Cmd, typename Next, typename... Arguments>
+    decltype(auto) invoke(const Next& next, Arguments... arguments) {
+      (record(arguments), ...);
+      return next(arguments...);
+    }
+
+    template <typename Argument>
+    void record(const Argument argument) {
+      if constexpr (std::is_same_v<Argument, const VkAllocationCallbacks*>)
+      {
+        last = argument;
+      }
+    }
+  };
+
+}
+
+static bool aligned(const void *const memory, const std::size_t alignment) {
+  return reinterpret_cast<std::uintptr_t>(memory) % alignment == 0;
+}
+
+TEST_CASE("Host allocators should serve driver allocations from pools.", "[dispatch][allocation]") {
+  auto host = allocator{ };
+  const auto callbacks = host.callbacks();
+  REQUIRE(callbacks->pUserData == &host);
+  REQUIRE(callbacks->pfnAllocation);
+  REQUIRE(callbacks->pfnReallocation);
+  REQUIRE(callbacks->pfnFree);
+  REQUIRE(callbacks->pfnInternalAllocation);
+  REQUIRE(callbacks->pfnInternalFree);
+  const auto scopes = std::array<VkSystemAllocationScope, 5>{ VK_SYSTEM_ALLOCATION_SCOPE_COMMAND,
+                                                              VK_SYSTEM_ALLOCATION_SCOPE_OBJECT,
+                                                              VK_SYSTEM_ALLOCATION_SCOPE_CACHE,
+                                                              VK_SYSTEM_ALLOCATION_SCOPE_DEVICE,
+                                                              VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE };
+  // Every scope honors every alignment, including allocations too large for the arenas or pools.
+  for (const auto scope : scopes)
+  {
+    auto allocations = std::vector<void*>{ };
+    for (auto alignment = std::size_t{ 1 }; alignment <= 256; alignment *= 2)
+    {
+      for (const auto size : { std::size_t{ 1 }, std::size_t{ 100 }, std::size_t{ 3000 }, std::size_t{ 20000 } })
+      {
+        const auto memory = callbacks->pfnAllocation(callbacks->pUserData, size, alignment, scope);
+        REQUIRE(memory);
+        REQUIRE(aligned(memory, alignment));
+        std::memset(memory, 0xff, size);
+        allocations.emplace_back(memory);
+      }
+    }
+    const auto statistics = host.statistics(scope);
+    REQUIRE(statistics.allocations == allocations.size());
+    REQUIRE(statistics.live_bytes == 9 * (1 + 100 + 3000 + 20000));
+    for (const auto memory : allocations)
+    {
+      callbacks->pfnFree(callbacks->pUserData, memory);
+    }
+    REQUIRE(host.statistics(scope).frees == allocations.size());
+    REQUIRE(host.statistics(scope).live_bytes == 0);
+  }
+  REQUIRE(callbacks->pfnAllocation(callbacks->pUserData, 0, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT) == nullptr);
+  callbacks->pfnFree(callbacks->pUserData, nullptr);
+  // Command scope arenas are rewound once every allocation in them has been freed.
+  {
+    const auto first = callbacks->pfnAllocation(callbacks->pUserData, 64, 16, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+    callbacks->pfnFree(callbacks->pUserData, first);
+    const auto second = callbacks->pfnAllocation(callbacks->pUserData, 64, 16, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+    REQUIRE(second == first);
+    callbacks->pfnFree(callbacks->pUserData, second);
+  }
+  // Reallocation preserves contents whether or not the allocation moves.
+  for (const auto scope : scopes)
+  {
+    auto memory = static_cast<std::uint8_t*>(callbacks->pfnReallocation(callbacks->pUserData, nullptr, 8, 8, scope));
+    REQUIRE(memory);
+    for (auto i = 0; i < 8; ++i)
+    {
+      memory[i] = static_cast<std::uint8_t>(i);
+    }
+    for (const auto size : { std::size_t{ 16 }, std::size_t{ 1000 }, std::size_t{ 50000 }, std::size_t{ 4 } })
+    {
+      memory = static_cast<std::uint8_t*>(callbacks->pfnReallocation(callbacks->pUserData, memory, size, 8, scope));
+      REQUIRE(memory);
+      REQUIRE(aligned(memory, 8));
+      for (auto i = 0; i < 4; ++i)
+      {
+        REQUIRE(memory[i] == i);
+      }
+    }
+    REQUIRE(host.statistics(scope).reallocations == 4);
+    REQUIRE(host.statistics(scope).live_bytes == 4);
+    REQUIRE(callbacks->pfnReallocation(callbacks->pUserData, memory, 0, 8, scope) == nullptr);
+    REQUIRE(host.statistics(scope).live_bytes == 0);
+  }
+  // Internal allocations are only recorded.
+  callbacks->pfnInternalAllocation(callbacks->pUserData, 128, VK_INTERNAL_ALLOCATION_TYPE_EXECUTABLE,
+                                   VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+  REQUIRE(host.statistics(VK_SYSTEM_ALLOCATION_SCOPE_DEVICE).internal_bytes == 128);
+  callbacks->pfnInternalFree(callbacks->pUserData, 128, VK_INTERNAL_ALLOCATION_TYPE_EXECUTABLE,
+                             VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+  REQUIRE(host.statistics(VK_SYSTEM_ALLOCATION_SCOPE_DEVICE).internal_bytes == 0);
+}
+
+TEST_CASE("Host allocators should allow memory to be freed by any thread.", "[dispatch][allocation]") {
+  auto host = allocator{ };
+  const auto callbacks = host.callbacks();
+  constexpr auto count = std::size_t{ 4096 };
+  auto allocations = std::array<std::vector<void*>, 4>{ };
+  auto valid = std::array<bool, 4>{ };
+  {
+    auto workers = std::vector<std::thread>{ };
+    for (auto i = std::size_t{ 0 }; i < allocations.size(); ++i)
+    {
+      workers.emplace_back([&, i]() {
+        valid[i] = true;
+        for (auto j = std::size_t{ 0 }; j < count; ++j)
+        {
+          const auto scope = j % 2 ? VK_SYSTEM_ALLOCATION_SCOPE_OBJECT : VK_SYSTEM_ALLOCATION_SCOPE_COMMAND;
+          const auto memory = callbacks->pfnAllocation(callbacks->pUserData, 16 + j % 512, 16, scope);
+          valid[i] = valid[i] && memory && aligned(memory, 16);
+          std::memset(memory, static_cast<int>(i), 16);
+          allocations[i].emplace_back(memory);
+        }
+      });
+    }
+    for (auto& worker : workers)
+    {
+      worker.join();
+    }
+  }
+  for (const auto result : valid)
+  {
+    REQUIRE(result);
+  }
+  // Each thread frees memory allocated by another thread.
+  {
+    auto workers = std::vector<std::thread>{ };
+    for (auto i = std::size_t{ 0 }; i < allocations.size(); ++i)
+    {
+      workers.emplace_back([&, i]() {
+        auto& owned = allocations[(i + 1) % allocations.size()];
+        valid[i] = true;
+        for (const auto memory : owned)
+        {
+          valid[i] = valid[i] && *static_cast<std::uint8_t*>(memory) == (i + 1) % allocations.size();
+          callbacks->pfnFree(callbacks->pUserData, memory);
+        }
+      });
+    }
+    for (auto& worker : workers)
+    {
+      worker.join();
+    }
+  }
+  for (const auto result : valid)
+  {
+    REQUIRE(result);
+  }
+  REQUIRE(host.statistics(VK_SYSTEM_ALLOCATION_SCOPE_OBJECT).allocations == allocations.size() * count / 2);
+  REQUIRE(host.statistics(VK_SYSTEM_ALLOCATION_SCOPE_OBJECT).live_bytes == 0);
+  REQUIRE(host.statistics(VK_SYSTEM_ALLOCATION_SCOPE_COMMAND).live_bytes == 0);
+}
+
+TEST_CASE("Host allocator policies should supply callbacks to tables.", "[dispatch][allocation]") {
+  using namespace megatech::vulkan::dispatch;
+  auto host = allocator{ };
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  // Global commands can't be intercepted, so the instance is created with explicit callbacks.
+  auto instance = VkInstance{ };
+  {
+    auto instance_info = VkInstanceCreateInfo{ };
+    instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    DECLARE_GLOBAL_PFN(gdt, vkCreateInstance);
+    VK_CHECK(vkCreateInstance(&instance_info, host.callbacks(), &instance));
+  }
+  auto idt = instance::table{ gdt, instance };
+  auto iit = instance::intercepted_table<allocator::policy, callbacks_policy>{ idt };
+  iit.policy<allocator::policy>().set_allocator(&host);
+  MEGATECH_VULKAN_DISPATCH_INTERCEPT_INSTANCE_ALLOCATIONS(iit);
+  REQUIRE(iit.intercepted(instance::command::vkCreateDevice));
+  // Instances aren't created through the policy, so they aren't destroyed through it.
+  REQUIRE_FALSE(iit.intercepted(instance::command::vkDestroyInstance));
+  REQUIRE_FALSE(iit.intercepted(instance::command::vkEnumeratePhysicalDevices));
+  auto device = create_device(iit);
+  REQUIRE(iit.policy<callbacks_policy>().last == host.callbacks());
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto dit = device::intercepted_table<allocator::policy, callbacks_policy>{ ddt };
+    MEGATECH_VULKAN_DISPATCH_INTERCEPT_DEVICE_ALLOCATIONS(dit);
+    REQUIRE(dit.intercepted(device::command::vkCreateSampler));
+    REQUIRE(dit.intercepted(device::command::vkDestroySampler));
+    REQUIRE(dit.intercepted(device::command::vkDestroyDevice));
+    DECLARE_DEVICE_PFN(dit, vkCreateSampler);
+    DECLARE_DEVICE_PFN(dit, vkDestroySampler);
+    auto info = VkSamplerCreateInfo{ };
+    info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    auto sampler = VkSampler{ };
+    // Without an allocator, calls are unchanged.
+    VK_CHECK(vkCreateSampler(device, &info, nullptr, &sampler));
+    REQUIRE(dit.policy<callbacks_policy>().last == nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+    dit.policy<allocator::policy>().set_allocator(&host);
+    REQUIRE(dit.policy<allocator::policy>().allocator() == &host);
+    VK_CHECK(vkCreateSampler(device, &info, nullptr, &sampler));
+    REQUIRE(dit.policy<callbacks_policy>().last == host.callbacks());
+    vkDestroySampler(device, sampler, nullptr);
+    REQUIRE(dit.policy<callbacks_policy>().last == host.callbacks());
+    // Calls that supply their own callbacks keep them.
+    auto other = allocator{ };
+    VK_CHECK(vkCreateSampler(device, &info, other.callbacks(), &sampler));
+    REQUIRE(dit.policy<callbacks_policy>().last == other.callbacks());
+    vkDestroySampler(device, sampler, other.callbacks());
+    // The device was created through the instance table's policy, so it's destroyed through the device table's.
+    DECLARE_DEVICE_PFN(dit, vkDestroyDevice);
+    vkDestroyDevice(device, nullptr);
+    REQUIRE(dit.policy<callbacks_policy>().last == host.callbacks());
+  }
+  DECLARE_INSTANCE_PFN(iit, vkDestroyInstance);
+  vkDestroyInstance(instance, host.callbacks());
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
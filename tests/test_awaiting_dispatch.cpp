@@ -0,0 +1,227 @@
+#include <cinttypes>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+using reactor = megatech::vulkan::dispatch::device::wait_reactor<PFN_vkGetFenceStatus, PFN_vkGetSemaphoreCounterValue,
+                                                                 PFN_vkWaitSemaphores>;
+
+namespace {
+
+  struct task final {
+    struct promise_type final {
+      task get_return_object() noexcept {
+        return task{ };
+      }
+
+      std::suspend_never initial_suspend() noexcept {
+        return { };
+      }
+
+      std::suspend_never final_suspend() noexcept {
+        return { };
+      }
+
+      void return_void() noexcept { }
+
+      void unhandled_exception() noexcept {
+        std::terminate();
+      }
+    };
+  };
+
+  struct outcome final {
+    VkResult status{ VK_INCOMPLETE };
+    std::thread::id resumer{ };
+    std::atomic<bool> done{ };
+  };
+
+}
+
+static task await_fence(reactor& waits, const VkFence fence, outcome& result) {
+  result.status = co_await waits.wait(fence);
+  result.resumer = std::this_thread::get_id();
+  result.done.store(true, std::memory_order_release);
+}
+
+static task await_timeline(reactor& waits, const VkSemaphore timeline, const std::uint64_t value, outcome& result) {
+  result.status = co_await waits.wait(timeline, value);
+  result.resumer = std::this_thread::get_id();
+  result.done.store(true, std::memory_order_release);
+}
+
+static VkSemaphore create_timeline(const megatech::vulkan::dispatch::device::table& ddt) {
+  auto type_info = VkSemaphoreTypeCreateInfo{ };
+  type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  auto info = VkSemaphoreCreateInfo{ };
+  info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  info.pNext = &type_info;
+  DECLARE_DEVICE_PFN(ddt, vkCreateSemaphore);
+  auto result = VkSemaphore{ };
+  VK_CHECK(vkCreateSemaphore(ddt.device(), &info, nullptr, &result));
+  return result;
+}
+
+template <typename Predicate>
+static bool eventually(Predicate&& predicate) {
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 5 };
+  while (!predicate())
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+    {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+  }
+  return true;
+}
+
+TEST_CASE("Wait reactors should resume coroutines once fences are signaled.", "[dispatch][awaiting]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  DECLARE_DEVICE_PFN(ddt, vkGetDeviceQueue);
+  DECLARE_DEVICE_PFN(ddt, vkQueueSubmit);
+  DECLARE_DEVICE_PFN(ddt, vkCreateFence);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyFence);
+  auto queue = VkQueue{ };
+  vkGetDeviceQueue(device, 0, 0, &queue);
+  REQUIRE_THROWS_AS(reactor(ddt, 0), error);
+  {
+    auto waits = reactor{ ddt, 2 };
+    REQUIRE(waits.threads() == 2);
+    auto fence_info = VkFenceCreateInfo{ };
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    auto signaled = VkFence{ };
+    VK_CHECK(vkCreateFence(device, &fence_info, nullptr, &signaled));
+    fence_info.flags = 0;
+    auto unsignaled = VkFence{ };
+    VK_CHECK(vkCreateFence(device, &fence_info, nullptr, &unsignaled));
+    // Fences that are already signaled don't suspend.
+    auto immediate = outcome{ };
+    await_fence(waits, signaled, immediate);
+    REQUIRE(immediate.done.load(std::memory_order_acquire));
+    REQUIRE(immediate.status == VK_SUCCESS);
+    REQUIRE(immediate.resumer == std::this_thread::get_id());
+    REQUIRE(waits.resumed() == 0);
+    // Otherwise, the coroutine is resumed on the executor once the fence is signaled.
+    auto deferred = outcome{ };
+    await_fence(waits, unsignaled, deferred);
+    REQUIRE_FALSE(deferred.done.load(std::memory_order_acquire));
+    REQUIRE(waits.waiting() == 1);
+    VK_CHECK(vkQueueSubmit(queue, 0, nullptr, unsignaled));
+    REQUIRE(eventually([&]() { return deferred.done.load(std::memory_order_acquire); }));
+    REQUIRE(deferred.status == VK_SUCCESS);
+    REQUIRE(deferred.resumer != std::this_thread::get_id());
+    REQUIRE(waits.waiting() == 0);
+    REQUIRE(waits.resumed() == 1);
+    vkDestroyFence(device, unsignaled, nullptr);
+    vkDestroyFence(device, signaled, nullptr);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Wait reactors should wait on many timeline values at once.", "[dispatch][awaiting]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt, VK_API_VERSION_1_2);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_timeline_device(idt);
+  if (!device)
+  {
+    DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+    vkDestroyInstance(instance, nullptr);
+    SKIP("The physical device doesn't support timeline semaphores.");
+  }
+  auto ddt = device::table{ gdt, idt, device };
+  DECLARE_DEVICE_PFN(ddt, vkSignalSemaphore);
+  DECLARE_DEVICE_PFN(ddt, vkDestroySemaphore);
+  const auto timelines = std::array<VkSemaphore, 2>{ create_timeline(ddt), create_timeline(ddt) };
+  const auto signal = [&](const VkSemaphore timeline, const std::uint64_t value) {
+    auto info = VkSemaphoreSignalInfo{ };
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+    info.semaphore = timeline;
+    info.value = value;
+    VK_CHECK(vkSignalSemaphore(device, &info));
+  };
+  constexpr auto count = std::size_t{ 2000 };
+  auto outcomes = std::vector<outcome>(count);
+  const auto finished = [&]() {
+    auto result = std::size_t{ 0 };
+    for (const auto& current : outcomes)
+    {
+      result += current.done.load(std::memory_order_acquire);
+    }
+    return result;
+  };
+  {
+    auto waits = reactor{ ddt, 4 };
+    // Even coroutines wait on the first timeline and odd coroutines wait on the second.
+    for (auto i = std::size_t{ 0 }; i < count; ++i)
+    {
+      await_timeline(waits, timelines[i % 2], i / 2 + 1, outcomes[i]);
+    }
+    REQUIRE(waits.waiting() == count);
+    signal(timelines[0], count / 4);
+    REQUIRE(eventually([&]() { return finished() == count / 4; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+    REQUIRE(finished() == count / 4);
+    for (auto i = std::size_t{ 0 }; i < count / 2; i += 2)
+    {
+      REQUIRE(outcomes[i].done.load(std::memory_order_acquire));
+      REQUIRE(outcomes[i].status == VK_SUCCESS);
+    }
+    signal(timelines[0], count);
+    signal(timelines[1], count);
+    REQUIRE(eventually([&]() { return finished() == count; }));
+    for (const auto& current : outcomes)
+    {
+      REQUIRE(current.status == VK_SUCCESS);
+      REQUIRE(current.resumer != std::this_thread::get_id());
+    }
+    REQUIRE(waits.waiting() == 0);
+    REQUIRE(waits.resumed() == count);
+    // Values that were already reached don't suspend.
+    auto immediate = outcome{ };
+    await_timeline(waits, timelines[1], 1, immediate);
+    REQUIRE(immediate.done.load(std::memory_order_acquire));
+    REQUIRE(immediate.status == VK_SUCCESS);
+    REQUIRE(waits.resumed() == count);
+  }
+  // Coroutines that are still waiting are resumed when the reactor is destroyed.
+  auto abandoned = outcome{ };
+  {
+    auto waits = reactor{ ddt, 1 };
+    await_timeline(waits, timelines[0], count + 1, abandoned);
+    REQUIRE_FALSE(abandoned.done.load(std::memory_order_acquire));
+  }
+  REQUIRE(abandoned.done.load(std::memory_order_acquire));
+  REQUIRE(abandoned.status == VK_NOT_READY);
+  for (const auto timeline : timelines)
+  {
+    vkDestroySemaphore(device, timeline, nullptr);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,271 @@
+#include <cinttypes>
+
+#include <array>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+using coalescer = megatech::vulkan::dispatch::device::barrier_coalescer<PFN_vkCmdPipelineBarrier,
+                                                                         PFN_vkCmdPipelineBarrier2>;
+
+struct recording_fixture final {
+  VkDevice device{ };
+  VkCommandPool pool{ };
+  VkCommandBuffer command_buffer{ };
+  std::vector<VkBuffer> buffers{ };
+};
+
+static recording_fixture create_fixture(const megatech::vulkan::dispatch::device::table& ddt, const VkDevice device) {
+  DECLARE_DEVICE_PFN(ddt, vkCreateCommandPool);
+  DECLARE_DEVICE_PFN(ddt, vkAllocateCommandBuffers);
+  DECLARE_DEVICE_PFN(ddt, vkCreateBuffer);
+  auto fixture = recording_fixture{ };
+  fixture.device = device;
+  auto pool_info = VkCommandPoolCreateInfo{ };
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  pool_info.queueFamilyIndex = 0;
+  VK_CHECK(vkCreateCommandPool(device, &pool_info, nullptr, &fixture.pool));
+  auto allocate_info = VkCommandBufferAllocateInfo{ };
+  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.commandPool = fixture.pool;
+  allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandBufferCount = 1;
+  VK_CHECK(vkAllocateCommandBuffers(device, &allocate_info, &fixture.command_buffer));
+  auto buffer_info = VkBufferCreateInfo{ };
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size = 256;
+  buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  fixture.buffers.resize(2);
+  for (auto& buffer : fixture.buffers)
+  {
+    VK_CHECK(vkCreateBuffer(device, &buffer_info, nullptr, &buffer));
+  }
+  return fixture;
+}
+
+static void destroy_fixture(const megatech::vulkan::dispatch::device::table& ddt, const recording_fixture& fixture) {
+  DECLARE_DEVICE_PFN(ddt, vkDestroyBuffer);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyCommandPool);
+  for (const auto buffer : fixture.buffers)
+  {
+    vkDestroyBuffer(fixture.device, buffer, nullptr);
+  }
+  vkDestroyCommandPool(fixture.device, fixture.pool, nullptr);
+}
+
+static VkBufferMemoryBarrier buffer_barrier(const VkBuffer buffer) {
+  auto barrier = VkBufferMemoryBarrier{ };
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer;
+  barrier.size = VK_WHOLE_SIZE;
+  return barrier;
+}
+
+TEST_CASE("Barrier coalescers should merge adjacent barriers.", "[dispatch][barriers]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  const auto fixture = create_fixture(ddt, device);
+  const auto command_buffer = fixture.command_buffer;
+  DECLARE_DEVICE_PFN(ddt, vkBeginCommandBuffer);
+  DECLARE_DEVICE_PFN(ddt, vkEndCommandBuffer);
+  {
+    auto barriers = coalescer{ ddt };
+    auto begin_info = VkCommandBufferBeginInfo{ };
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
+    auto memory = VkMemoryBarrier{ };
+    memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memory.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    for (auto i = 0; i < 4; ++i)
+    {
+      barriers.barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &memory, 0, nullptr, 0, nullptr);
+    }
+    // Barriers on different buffers merge. Barriers on the same buffer don't.
+    const auto first = buffer_barrier(fixture.buffers[0]);
+    const auto second = buffer_barrier(fixture.buffers[1]);
+    barriers.barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
+                     &first, 0, nullptr);
+    barriers.barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
+                     &second, 0, nullptr);
+    REQUIRE(barriers.deferred() == 6);
+    REQUIRE(barriers.barriers() == 0);
+    barriers.barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
+                     &first, 0, nullptr);
+    REQUIRE(barriers.barriers() == 1);
+    REQUIRE(barriers.merged() == 5);
+    // Dependency flags must match.
+    barriers.barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     VK_DEPENDENCY_BY_REGION_BIT, 1, &memory, 0, nullptr, 0, nullptr);
+    REQUIRE(barriers.barriers() == 2);
+    barriers.flush(command_buffer);
+    REQUIRE(barriers.barriers() == 3);
+    barriers.flush(command_buffer);
+    REQUIRE(barriers.barriers() == 3);
+    barriers.barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memory, 0,
+                     nullptr, 0, nullptr);
+    barriers.discard(command_buffer);
+    barriers.flush(command_buffer);
+    REQUIRE(barriers.barriers() == 3);
+    VK_CHECK(vkEndCommandBuffer(command_buffer));
+  }
+  destroy_fixture(ddt, fixture);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Barrier coalescing policies should defer barriers until the next command.", "[dispatch][barriers]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  const auto fixture = create_fixture(ddt, device);
+  const auto command_buffer = fixture.command_buffer;
+  {
+    auto barriers = coalescer{ ddt };
+    auto dit = device::intercepted_table<device::counting_policy, coalescer::policy>{ ddt };
+    dit.policy<coalescer::policy>().set_coalescer(&barriers);
+    REQUIRE(dit.policy<coalescer::policy>().coalescer() == &barriers);
+    dit.intercept<device::command::vkBeginCommandBuffer, PFN_vkBeginCommandBuffer>();
+    dit.intercept<device::command::vkEndCommandBuffer, PFN_vkEndCommandBuffer>();
+    dit.intercept<device::command::vkCmdPipelineBarrier, PFN_vkCmdPipelineBarrier>();
+    dit.intercept<device::command::vkCmdSetViewport, PFN_vkCmdSetViewport>();
+    DECLARE_DEVICE_PFN(dit, vkBeginCommandBuffer);
+    DECLARE_DEVICE_PFN(dit, vkEndCommandBuffer);
+    DECLARE_DEVICE_PFN(dit, vkCmdPipelineBarrier);
+    DECLARE_DEVICE_PFN(dit, vkCmdSetViewport);
+    auto begin_info = VkCommandBufferBeginInfo{ };
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
+    auto memory = VkMemoryBarrier{ };
+    memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memory.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    for (auto i = 0; i < 3; ++i)
+    {
+      vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                           &memory, 0, nullptr, 0, nullptr);
+    }
+    REQUIRE(barriers.barriers() == 0);
+    auto viewport = VkViewport{ };
+    viewport.width = 1.0f;
+    viewport.height = 1.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    REQUIRE(barriers.barriers() == 1);
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                         &memory, 0, nullptr, 0, nullptr);
+    VK_CHECK(vkEndCommandBuffer(command_buffer));
+    REQUIRE(barriers.barriers() == 2);
+    REQUIRE(barriers.merged() == 2);
+    const auto& counters = dit.policy<device::counting_policy>().counters();
+    REQUIRE(counters.count(device::command::vkCmdPipelineBarrier) == 4);
+  }
+  destroy_fixture(ddt, fixture);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Barrier coalescers should track barriers per command buffer until it is freed.", "[dispatch][barriers]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  const auto fixture = create_fixture(ddt, device);
+  {
+    auto barriers = coalescer{ ddt };
+    auto dit = device::intercepted_table<coalescer::policy>{ ddt };
+    dit.policy<coalescer::policy>().set_coalescer(&barriers);
+    dit.intercept<device::command::vkAllocateCommandBuffers, PFN_vkAllocateCommandBuffers>();
+    dit.intercept<device::command::vkFreeCommandBuffers, PFN_vkFreeCommandBuffers>();
+    dit.intercept<device::command::vkResetCommandPool, PFN_vkResetCommandPool>();
+    dit.intercept<device::command::vkDestroyCommandPool, PFN_vkDestroyCommandPool>();
+    dit.intercept<device::command::vkCmdPipelineBarrier, PFN_vkCmdPipelineBarrier>();
+    dit.intercept<device::command::vkEndCommandBuffer, PFN_vkEndCommandBuffer>();
+    DECLARE_DEVICE_PFN(ddt, vkCreateCommandPool);
+    DECLARE_DEVICE_PFN(dit, vkAllocateCommandBuffers);
+    DECLARE_DEVICE_PFN(dit, vkFreeCommandBuffers);
+    DECLARE_DEVICE_PFN(dit, vkResetCommandPool);
+    DECLARE_DEVICE_PFN(dit, vkDestroyCommandPool);
+    DECLARE_DEVICE_PFN(dit, vkCmdPipelineBarrier);
+    DECLARE_DEVICE_PFN(dit, vkEndCommandBuffer);
+    DECLARE_DEVICE_PFN(ddt, vkBeginCommandBuffer);
+    auto pool_info = VkCommandPoolCreateInfo{ };
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    auto pool = VkCommandPool{ };
+    VK_CHECK(vkCreateCommandPool(device, &pool_info, nullptr, &pool));
+    auto allocate_info = VkCommandBufferAllocateInfo{ };
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.commandPool = pool;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = 2;
+    auto command_buffers = std::array<VkCommandBuffer, 2>{ };
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocate_info, command_buffers.data()));
+    REQUIRE(barriers.tracked() == 2);
+    auto begin_info = VkCommandBufferBeginInfo{ };
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    auto memory = VkMemoryBarrier{ };
+    memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memory.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    const auto defer = [&](const VkCommandBuffer command_buffer) {
+      vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                           &memory, 0, nullptr, 0, nullptr);
+    };
+    // Barriers deferred by one thread are recorded by the next thread to record into the command buffer.
+    VK_CHECK(vkBeginCommandBuffer(command_buffers[0], &begin_info));
+    std::thread{ [&]() { defer(command_buffers[0]); defer(command_buffers[0]); } }.join();
+    REQUIRE(barriers.barriers() == 0);
+    VK_CHECK(vkEndCommandBuffer(command_buffers[0]));
+    REQUIRE(barriers.barriers() == 1);
+    REQUIRE(barriers.merged() == 1);
+    // Resetting the pool discards pending barriers.
+    VK_CHECK(vkBeginCommandBuffer(command_buffers[1], &begin_info));
+    defer(command_buffers[1]);
+    VK_CHECK(vkResetCommandPool(device, pool, 0));
+    barriers.flush(command_buffers[1]);
+    REQUIRE(barriers.barriers() == 1);
+    REQUIRE(barriers.tracked() == 2);
+    // Freeing a command buffer releases its state and its pending barriers, even if another thread indexed it.
+    VK_CHECK(vkBeginCommandBuffer(command_buffers[0], &begin_info));
+    defer(command_buffers[0]);
+    vkFreeCommandBuffers(device, pool, 1, command_buffers.data());
+    REQUIRE(barriers.tracked() == 1);
+    REQUIRE(barriers.barriers() == 1);
+    // Destroying the pool releases every command buffer that was allocated from it.
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocate_info, command_buffers.data()));
+    REQUIRE(barriers.tracked() == 3);
+    vkDestroyCommandPool(device, pool, nullptr);
+    REQUIRE(barriers.tracked() == 0);
+  }
+  destroy_fixture(ddt, fixture);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,189 @@
+#include <cinttypes>
+
+#include <vector>
+
+#include "common.hpp"
+
+using batcher = megatech::vulkan::dispatch::device::submission_batcher<PFN_vkQueueSubmit, PFN_vkQueueSubmit2>;
+
+TEST_CASE("Submission batchers should merge deferred submissions.", "[dispatch][batching]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  DECLARE_DEVICE_PFN(ddt, vkGetDeviceQueue);
+  DECLARE_DEVICE_PFN(ddt, vkCreateSemaphore);
+  DECLARE_DEVICE_PFN(ddt, vkDestroySemaphore);
+  DECLARE_DEVICE_PFN(ddt, vkCreateFence);
+  DECLARE_DEVICE_PFN(ddt, vkWaitForFences);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyFence);
+  DECLARE_DEVICE_PFN(ddt, vkQueueWaitIdle);
+  auto queue = VkQueue{ };
+  vkGetDeviceQueue(device, 0, 0, &queue);
+  auto semaphore_info = VkSemaphoreCreateInfo{ };
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  auto semaphores = std::vector<VkSemaphore>(4);
+  for (auto& semaphore : semaphores)
+  {
+    VK_CHECK(vkCreateSemaphore(device, &semaphore_info, nullptr, &semaphore));
+  }
+  auto fence_info = VkFenceCreateInfo{ };
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  auto fence = VkFence{ };
+  VK_CHECK(vkCreateFence(device, &fence_info, nullptr, &fence));
+  {
+    auto submissions = batcher{ ddt };
+    REQUIRE_THROWS_AS((batcher{ ddt, 0 }), error);
+    // Each submission waits on the semaphore signalled by the previous one.
+    const auto stage = VkPipelineStageFlags{ 0x1 };
+    for (auto i = std::size_t{ 0 }; i < semaphores.size(); ++i)
+    {
+      auto submit_info = VkSubmitInfo{ };
+      submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      if (i > 0)
+      {
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &semaphores[i - 1];
+        submit_info.pWaitDstStageMask = &stage;
+      }
+      submit_info.signalSemaphoreCount = 1;
+      submit_info.pSignalSemaphores = &semaphores[i];
+      VK_CHECK(submissions.submit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    }
+    REQUIRE(submissions.pending(queue) == semaphores.size());
+    REQUIRE(submissions.submissions() == 0);
+    // The final submission consumes the last signal and carries a fence, so it flushes everything.
+    auto submit_info = VkSubmitInfo{ };
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &semaphores.back();
+    submit_info.pWaitDstStageMask = &stage;
+    VK_CHECK(submissions.submit(queue, 1, &submit_info, fence));
+    REQUIRE(submissions.pending(queue) == 0);
+    REQUIRE(submissions.deferred() == semaphores.size() + 1);
+    REQUIRE(submissions.submissions() == 1);
+    VK_CHECK(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+    VK_CHECK(submissions.flush());
+    REQUIRE(submissions.submissions() == 1);
+  }
+  {
+    auto submissions = batcher{ ddt, 3 };
+    auto submit_info = VkSubmitInfo{ };
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    for (auto i = 0; i < 7; ++i)
+    {
+      VK_CHECK(submissions.submit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    }
+    REQUIRE(submissions.submissions() == 2);
+    REQUIRE(submissions.pending(queue) == 1);
+    VK_CHECK(submissions.flush(queue));
+    REQUIRE(submissions.submissions() == 3);
+    REQUIRE(submissions.pending(queue) == 0);
+    VK_CHECK(vkQueueWaitIdle(queue));
+  }
+  vkDestroyFence(device, fence, nullptr);
+  for (const auto semaphore : semaphores)
+  {
+    vkDestroySemaphore(device, semaphore, nullptr);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Submission batching policies should defer submissions and flush before waits.", "[dispatch][batching]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto submissions = batcher{ ddt };
+    auto dit = device::intercepted_table<device::counting_policy, batcher::policy>{ ddt };
+    dit.policy<batcher::policy>().set_batcher(&submissions);
+    REQUIRE(dit.policy<batcher::policy>().batcher() == &submissions);
+    dit.intercept<device::command::vkQueueSubmit, PFN_vkQueueSubmit>();
+    dit.intercept<device::command::vkQueueWaitIdle, PFN_vkQueueWaitIdle>();
+    DECLARE_DEVICE_PFN(dit, vkGetDeviceQueue);
+    DECLARE_DEVICE_PFN(dit, vkQueueSubmit);
+    DECLARE_DEVICE_PFN(dit, vkQueueWaitIdle);
+    auto queue = VkQueue{ };
+    vkGetDeviceQueue(device, 0, 0, &queue);
+    auto submit_info = VkSubmitInfo{ };
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    for (auto i = 0; i < 5; ++i)
+    {
+      VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    }
+    REQUIRE(submissions.pending(queue) == 5);
+    REQUIRE(submissions.submissions() == 0);
+    VK_CHECK(vkQueueWaitIdle(queue));
+    REQUIRE(submissions.pending(queue) == 0);
+    REQUIRE(submissions.submissions() == 1);
+    const auto& counters = dit.policy<device::counting_policy>().counters();
+    REQUIRE(counters.count(device::command::vkQueueSubmit) == 5);
+    REQUIRE(counters.count(device::command::vkQueueWaitIdle) == 1);
+    // Fence queries and waits flush every queue, so they never wait behind a deferred batch.
+    dit.intercept<device::command::vkGetFenceStatus, PFN_vkGetFenceStatus>();
+    dit.intercept<device::command::vkWaitForFences, PFN_vkWaitForFences>();
+    DECLARE_DEVICE_PFN(dit, vkGetFenceStatus);
+    DECLARE_DEVICE_PFN(dit, vkWaitForFences);
+    DECLARE_DEVICE_PFN(ddt, vkCreateFence);
+    DECLARE_DEVICE_PFN(ddt, vkDestroyFence);
+    auto fence_info = VkFenceCreateInfo{ };
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    auto fence = VkFence{ };
+    VK_CHECK(vkCreateFence(device, &fence_info, nullptr, &fence));
+    VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    REQUIRE(submissions.pending(queue) == 1);
+    REQUIRE(vkGetFenceStatus(device, fence) == VK_NOT_READY);
+    REQUIRE(submissions.pending(queue) == 0);
+    REQUIRE(submissions.submissions() == 2);
+    VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    REQUIRE(vkWaitForFences(device, 1, &fence, VK_TRUE, 0) == VK_TIMEOUT);
+    REQUIRE(submissions.pending(queue) == 0);
+    REQUIRE(submissions.submissions() == 3);
+    vkDestroyFence(device, fence, nullptr);
+    // So do event polls and query reads, since a deferred batch might set the event or write the query.
+    dit.intercept<device::command::vkGetEventStatus, PFN_vkGetEventStatus>();
+    DECLARE_DEVICE_PFN(dit, vkGetEventStatus);
+    DECLARE_DEVICE_PFN(ddt, vkCreateEvent);
+    DECLARE_DEVICE_PFN(ddt, vkDestroyEvent);
+    auto event_info = VkEventCreateInfo{ };
+    event_info.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
+    auto event = VkEvent{ };
+    VK_CHECK(vkCreateEvent(device, &event_info, nullptr, &event));
+    VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    REQUIRE(vkGetEventStatus(device, event) == VK_EVENT_RESET);
+    REQUIRE(submissions.pending(queue) == 0);
+    REQUIRE(submissions.submissions() == 4);
+    vkDestroyEvent(device, event, nullptr);
+    // Waiting on a query that was never written is invalid, so this one only goes through the policy.
+    VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    auto read = false;
+    const auto get_results = [&](auto...) {
+      read = true;
+      return VK_SUCCESS;
+    };
+    auto results = std::uint64_t{ };
+    auto& policy = dit.policy<batcher::policy>();
+    VK_CHECK(policy.invoke<device::command::vkGetQueryPoolResults>(get_results, device, VkQueryPool{ }, 0, 1,
+                                                                   sizeof(results), &results, sizeof(results),
+                                                                   VK_QUERY_RESULT_WAIT_BIT));
+    REQUIRE(read);
+    REQUIRE(submissions.pending(queue) == 0);
+    REQUIRE(submissions.submissions() == 5);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,275 @@
+#include <cinttypes>
+#include <cstring>
+
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+static VkPhysicalDevice first_physical_device(const megatech::vulkan::dispatch::instance::table& idt) {
+  DECLARE_INSTANCE_PFN(idt, vkEnumeratePhysicalDevices);
+  auto sz = std::uint32_t{ 0 };
+  VK_CHECK(vkEnumeratePhysicalDevices(idt.instance(), &sz, nullptr));
+  auto physical_devices = std::vector<VkPhysicalDevice>(sz);
+  VK_CHECK(vkEnumeratePhysicalDevices(idt.instance(), &sz, physical_devices.data()));
+  REQUIRE(!physical_devices.empty());
+  return physical_devices[0];
+}
+
+TEST_CASE("Cached instance tables should memoize physical device queries.", "[dispatch][cache]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  const auto physical_device = first_physical_device(idt);
+  {
+    auto ict = instance::cached_table{ idt };
+    REQUIRE(ict.instance() == instance);
+    REQUIRE(!ict.memoized(instance::command::vkGetPhysicalDeviceProperties));
+    ict.memoize<instance::command::vkGetPhysicalDeviceProperties, PFN_vkGetPhysicalDeviceProperties>();
+    ict.memoize<instance::command::vkGetPhysicalDeviceFormatProperties, PFN_vkGetPhysicalDeviceFormatProperties>();
+    ict.memoize<instance::command::vkGetPhysicalDeviceImageFormatProperties,
+                PFN_vkGetPhysicalDeviceImageFormatProperties>();
+    REQUIRE(ict.memoized(instance::command::vkGetPhysicalDeviceProperties));
+    REQUIRE(!ict.memoized(instance::command::vkEnumeratePhysicalDevices));
+    {
+      DECLARE_INSTANCE_PFN(idt, vkGetPhysicalDeviceProperties);
+      auto expected = VkPhysicalDeviceProperties{ };
+      vkGetPhysicalDeviceProperties(physical_device, &expected);
+      {
+        DECLARE_INSTANCE_PFN(ict, vkGetPhysicalDeviceProperties);
+        for (auto i = 0; i < 3; ++i)
+        {
+          auto properties = VkPhysicalDeviceProperties{ };
+          vkGetPhysicalDeviceProperties(physical_device, &properties);
+          REQUIRE(properties.apiVersion == expected.apiVersion);
+          REQUIRE(properties.vendorID == expected.vendorID);
+          REQUIRE(std::strcmp(properties.deviceName, expected.deviceName) == 0);
+        }
+      }
+    }
+    {
+      DECLARE_INSTANCE_PFN(idt, vkGetPhysicalDeviceFormatProperties);
+      const auto cached = GET_INSTANCE_PFN(ict, vkGetPhysicalDeviceFormatProperties);
+      for (const auto format : { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM })
+      {
+        auto expected = VkFormatProperties{ };
+        vkGetPhysicalDeviceFormatProperties(physical_device, format, &expected);
+        auto properties = VkFormatProperties{ };
+        cached(physical_device, format, &properties);
+        REQUIRE(properties.optimalTilingFeatures == expected.optimalTilingFeatures);
+        REQUIRE(properties.linearTilingFeatures == expected.linearTilingFeatures);
+        REQUIRE(properties.bufferFeatures == expected.bufferFeatures);
+      }
+    }
+    {
+      DECLARE_INSTANCE_PFN(idt, vkGetPhysicalDeviceImageFormatProperties);
+      auto expected = VkImageFormatProperties{ };
+      const auto expected_result = vkGetPhysicalDeviceImageFormatProperties(physical_device,
+                                                                            VK_FORMAT_R8G8B8A8_UNORM,
+                                                                            VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL,
+                                                                            0x4, 0, &expected);
+      const auto cached = GET_INSTANCE_PFN(ict, vkGetPhysicalDeviceImageFormatProperties);
+      for (auto i = 0; i < 2; ++i)
+      {
+        auto properties = VkImageFormatProperties{ };
+        REQUIRE(cached(physical_device, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL, 0x4, 0,
+                       &properties) == expected_result);
+        REQUIRE(properties.maxMipLevels == expected.maxMipLevels);
+        REQUIRE(properties.maxArrayLayers == expected.maxArrayLayers);
+      }
+    }
+    ict.restore<instance::command::vkGetPhysicalDeviceProperties>();
+    REQUIRE(!ict.memoized(instance::command::vkGetPhysicalDeviceProperties));
+    REQUIRE(*reinterpret_cast<const PFN_vkVoidFunction*>(ict(instance::command::vkGetPhysicalDeviceProperties)) ==
+            *reinterpret_cast<const PFN_vkVoidFunction*>(idt(instance::command::vkGetPhysicalDeviceProperties)));
+  }
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Cached instance tables should memoize enumerations.", "[dispatch][cache]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  const auto physical_device = first_physical_device(idt);
+  {
+    auto ict = instance::cached_table{ idt };
+    ict.memoize<instance::command::vkGetPhysicalDeviceQueueFamilyProperties,
+                PFN_vkGetPhysicalDeviceQueueFamilyProperties>();
+    DECLARE_INSTANCE_PFN(idt, vkGetPhysicalDeviceQueueFamilyProperties);
+    auto sz = std::uint32_t{ 0 };
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &sz, nullptr);
+    REQUIRE(sz > 0);
+    auto expected = std::vector<VkQueueFamilyProperties>(sz);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &sz, expected.data());
+    const auto cached = GET_INSTANCE_PFN(ict, vkGetPhysicalDeviceQueueFamilyProperties);
+    auto cached_sz = std::uint32_t{ 0 };
+    cached(physical_device, &cached_sz, nullptr);
+    REQUIRE(cached_sz == sz);
+    for (auto i = 0; i < 2; ++i)
+    {
+      auto families = std::vector<VkQueueFamilyProperties>(cached_sz);
+      cached(physical_device, &cached_sz, families.data());
+      REQUIRE(cached_sz == sz);
+      for (auto j = std::size_t{ 0 }; j < families.size(); ++j)
+      {
+        REQUIRE(families[j].queueFlags == expected[j].queueFlags);
+        REQUIRE(families[j].queueCount == expected[j].queueCount);
+      }
+    }
+    cached_sz = 0;
+    cached(physical_device, &cached_sz, nullptr);
+    REQUIRE(cached_sz == sz);
+    auto family = VkQueueFamilyProperties{ };
+    cached_sz = 1;
+    cached(physical_device, &cached_sz, &family);
+    REQUIRE(cached_sz == 1);
+    REQUIRE(family.queueFlags == expected[0].queueFlags);
+  }
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Cached instance tables should be safe to read concurrently.", "[dispatch][cache]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  const auto physical_device = first_physical_device(idt);
+  {
+    auto ict = instance::cached_table{ idt };
+    ict.memoize<instance::command::vkGetPhysicalDeviceFormatProperties, PFN_vkGetPhysicalDeviceFormatProperties>();
+    DECLARE_INSTANCE_PFN(idt, vkGetPhysicalDeviceFormatProperties);
+    auto expected = VkFormatProperties{ };
+    vkGetPhysicalDeviceFormatProperties(physical_device, VK_FORMAT_R8G8B8A8_UNORM, &expected);
+    const auto cached = GET_INSTANCE_PFN(ict, vkGetPhysicalDeviceFormatProperties);
+    auto mismatches = std::vector<int>(4);
+    auto threads = std::vector<std::thread>{ };
+    for (auto i = std::size_t{ 0 }; i < mismatches.size(); ++i)
+    {
+      threads.emplace_back([&, i]() {
+        for (auto j = 0; j < 1000; ++j)
+        {
+          auto properties = VkFormatProperties{ };
+          cached(physical_device, VK_FORMAT_R8G8B8A8_UNORM, &properties);
+          mismatches[i] += properties.optimalTilingFeatures != expected.optimalTilingFeatures;
+        }
+      });
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+    REQUIRE(mismatches == std::vector<int>(4));
+  }
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Cached device tables should cache queries keyed by scalars and handles.", "[dispatch][cache]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto dct = device::cached_table{ ddt };
+    REQUIRE(dct.instance() == instance);
+    REQUIRE(dct.device() == device);
+    REQUIRE(!dct.cached(device::command::vkGetDeviceQueue));
+    dct.cache<device::command::vkGetDeviceQueue, PFN_vkGetDeviceQueue>();
+    REQUIRE(dct.cached(device::command::vkGetDeviceQueue));
+    REQUIRE(dct.entries(device::command::vkGetDeviceQueue) == 0);
+    DECLARE_DEVICE_PFN(ddt, vkGetDeviceQueue);
+    auto expected = VkQueue{ };
+    vkGetDeviceQueue(device, 0, 0, &expected);
+    const auto cached = GET_DEVICE_PFN(dct, vkGetDeviceQueue);
+    for (auto i = 0; i < 3; ++i)
+    {
+      auto queue = VkQueue{ };
+      cached(device, 0, 0, &queue);
+      REQUIRE(queue == expected);
+    }
+    REQUIRE(dct.entries(device::command::vkGetDeviceQueue) == 1);
+    dct.clear<device::command::vkGetDeviceQueue>();
+    REQUIRE(dct.entries(device::command::vkGetDeviceQueue) == 0);
+    REQUIRE(dct.cached(device::command::vkGetDeviceQueue));
+    dct.restore<device::command::vkGetDeviceQueue>();
+    REQUIRE(!dct.cached(device::command::vkGetDeviceQueue));
+    REQUIRE(GET_DEVICE_PFN(dct, vkGetDeviceQueue) == vkGetDeviceQueue);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Cached device tables should cache queries keyed by their input structures.", "[dispatch][cache]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    DECLARE_DEVICE_PFN_UNCHECKED(ddt, vkGetDeviceBufferMemoryRequirements);
+    // This requires Vulkan 1.3 or VK_KHR_maintenance4.
+    if (vkGetDeviceBufferMemoryRequirements)
+    {
+      auto dct = device::cached_table{ ddt };
+      auto keys = 0;
+      dct.cache<device::command::vkGetDeviceBufferMemoryRequirements, PFN_vkGetDeviceBufferMemoryRequirements>(
+        [&](query_key& key, VkDevice current, const VkDeviceBufferMemoryRequirements* info, VkMemoryRequirements2*) {
+          const auto& buffer = *info->pCreateInfo;
+          ++keys;
+          if (info->pNext || buffer.pNext)
+          {
+            return false;
+          }
+          key.write(current);
+          key.write(buffer.flags);
+          key.write(buffer.size);
+          key.write(buffer.usage);
+          key.write(buffer.sharingMode);
+          key.write(buffer.pQueueFamilyIndices, buffer.queueFamilyIndexCount);
+          return true;
+        }
+      );
+      const auto cached = GET_DEVICE_PFN(dct, vkGetDeviceBufferMemoryRequirements);
+      for (const auto size : { VkDeviceSize{ 1024 }, VkDeviceSize{ 4096 }, VkDeviceSize{ 1024 }, VkDeviceSize{ 4096 } })
+      {
+        auto buffer_info = VkBufferCreateInfo{ };
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size = size;
+        buffer_info.usage = 0x80;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        auto info = VkDeviceBufferMemoryRequirements{ };
+        info.sType = VK_STRUCTURE_TYPE_DEVICE_BUFFER_MEMORY_REQUIREMENTS;
+        info.pCreateInfo = &buffer_info;
+        auto expected = VkMemoryRequirements2{ };
+        expected.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        vkGetDeviceBufferMemoryRequirements(device, &info, &expected);
+        auto requirements = VkMemoryRequirements2{ };
+        requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        cached(device, &info, &requirements);
+        REQUIRE(requirements.sType == VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2);
+        REQUIRE(requirements.memoryRequirements.size == expected.memoryRequirements.size);
+        REQUIRE(requirements.memoryRequirements.alignment == expected.memoryRequirements.alignment);
+        REQUIRE(requirements.memoryRequirements.memoryTypeBits == expected.memoryRequirements.memoryTypeBits);
+      }
+      REQUIRE(keys == 4);
+      REQUIRE(dct.entries(device::command::vkGetDeviceBufferMemoryRequirements) == 2);
+    }
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,312 @@
+#include <cstddef>
+#include <cinttypes>
+#include <cstring>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "common.hpp"
+
+struct replayed_calls final {
+  std::vector<VkImage> images{ };
+  std::vector<std::uint32_t> families{ };
+  std::vector<VkRenderPass> render_passes{ };
+  std::vector<float> clears{ };
+  std::vector<float> widths{ };
+};
+
+static replayed_calls g_calls{ };
+
+static VKAPI_ATTR void VKAPI_CALL replay_barrier(VkCommandBuffer, const VkDependencyInfo* info) {
+  for (auto i = std::uint32_t{ 0 }; i < info->imageMemoryBarrierCount; ++i)
+  {
+    g_calls.images.push_back(info->pImageMemoryBarriers[i].image);
+    g_calls.families.push_back(info->pImageMemoryBarriers[i].srcQueueFamilyIndex);
+  }
+}
+
+static VKAPI_ATTR void VKAPI_CALL replay_render_pass(VkCommandBuffer, const VkRenderPassBeginInfo* info,
+                                                     VkSubpassContents) {
+  g_calls.render_passes.push_back(info->renderPass);
+  for (auto i = std::uint32_t{ 0 }; i < info->clearValueCount; ++i)
+  {
+    g_calls.clears.push_back(info->pClearValues[i].color.float32[0]);
+  }
+}
+
+static VKAPI_ATTR void VKAPI_CALL replay_viewports(VkCommandBuffer, std::uint32_t, std::uint32_t count,
+                                                   const VkViewport* viewports) {
+  for (auto i = std::uint32_t{ 0 }; i < count; ++i)
+  {
+    g_calls.widths.push_back(viewports[i].width);
+  }
+}
+
+struct replaying_table final {
+  PFN_vkCmdPipelineBarrier2 pipeline_barrier{ &replay_barrier };
+  PFN_vkCmdBeginRenderPass begin_render_pass{ &replay_render_pass };
+  PFN_vkCmdSetViewport set_viewport{ &replay_viewports };
+
+  const void* get(const megatech::vulkan::dispatch::device::command cmd) const {
+    using megatech::vulkan::dispatch::device::command;
+    switch (cmd)
+    {
+    case command::vkCmdPipelineBarrier2:
+      return &pipeline_barrier;
+    case command::vkCmdBeginRenderPass:
+      return &begin_render_pass;
+    case command::vkCmdSetViewport:
+      return &set_viewport;
+    default:
+      return nullptr;
+    }
+  }
+};
+
+template <typename Handle>
+static Handle fake_handle(const std::uintptr_t value) {
+  return reinterpret_cast<Handle>(value);
+}
+
+// Copy a capture file, overwrite a word of the copy, and drop the copy's last `truncated` bytes.
+static std::filesystem::path corrupt(const std::filesystem::path& path, const std::size_t position,
+                                     const std::uint64_t value, const std::size_t truncated = 0) {
+  auto input = std::ifstream{ path, std::ios::in | std::ios::binary };
+  auto bytes = std::vector<char>{ std::istreambuf_iterator<char>{ input }, std::istreambuf_iterator<char>{ } };
+  std::memcpy(bytes.data() + position, &value, sizeof(value));
+  bytes.resize(bytes.size() - truncated);
+  auto result = path;
+  result += ".corrupt";
+  auto output = std::ofstream{ result, std::ios::out | std::ios::trunc | std::ios::binary };
+  output.write(bytes.data(), bytes.size());
+  return result;
+}
+
+TEST_CASE("Captured call streams should be readable and replayable.", "[dispatch][capture]") {
+  using namespace megatech::vulkan::dispatch;
+  const auto path = std::filesystem::temp_directory_path() / "megatech-vulkan-dispatch-capture.bin";
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto capture = call_capture{ path, 2 };
+    auto dit = device::intercepted_table<capture_policy>{ ddt };
+    VK_CHECK((dit.call<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>(device)));
+    dit.policy<capture_policy>().set_capture(&capture);
+    dit.intercept<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>();
+    DECLARE_DEVICE_PFN(dit, vkDeviceWaitIdle);
+    for (auto i = 0; i < 4; ++i)
+    {
+      VK_CHECK(vkDeviceWaitIdle(device));
+    }
+    auto queue = VkQueue{ };
+    dit.call<device::command::vkGetDeviceQueue, PFN_vkGetDeviceQueue>(device, 0, 0, &queue);
+    REQUIRE(capture.records() == 5);
+    capture.close();
+    dit.call<device::command::vkGetDeviceQueue, PFN_vkGetDeviceQueue>(device, 0, 0, &queue);
+    REQUIRE(capture.records() == 5);
+  }
+  {
+    using internal::base::argument_kind;
+    const auto stream = call_stream{ path };
+    REQUIRE(stream.size() == 5);
+    auto count = std::uint64_t{ 0 };
+    for (const auto current : stream)
+    {
+      REQUIRE(current.level() == 2);
+      REQUIRE(current.arguments()[0].kind == argument_kind::handle);
+      REQUIRE(current.arguments()[0].value == reinterpret_cast<std::uintptr_t>(device));
+      ++count;
+    }
+    REQUIRE(count == stream.size());
+    const auto last = *stream.seek(4);
+    REQUIRE(last.command() == static_cast<std::uint16_t>(device::command::vkGetDeviceQueue));
+    REQUIRE(last.arguments().size() == 4);
+    REQUIRE(last.arguments()[1].kind == argument_kind::integer);
+    REQUIRE(last.arguments()[3].kind == argument_kind::pointer);
+    REQUIRE(last.arguments()[3].value == 1);
+    REQUIRE((*stream.seek(3)).command() == static_cast<std::uint16_t>(device::command::vkDeviceWaitIdle));
+    REQUIRE(stream.seek(5) == stream.end());
+    auto player = call_replayer{ };
+    player.bind<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>(ddt);
+    REQUIRE_THROWS_AS(player.replay(stream), error);
+    player.map_handle(reinterpret_cast<std::uintptr_t>(device), device);
+    REQUIRE(player.replay(stream) == 4);
+    player.bind<device::command::vkGetDeviceQueue, PFN_vkGetDeviceQueue>(ddt);
+    REQUIRE_THROWS_AS(player.replay(stream), error);
+  }
+  std::filesystem::remove(path);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Captured call streams should copy pointer payloads.", "[dispatch][capture]") {
+  using namespace megatech::vulkan::dispatch;
+  using internal::base::argument_kind;
+  const auto path = std::filesystem::temp_directory_path() / "megatech-vulkan-dispatch-payloads.bin";
+  const auto command_buffer = fake_handle<VkCommandBuffer>(0x10);
+  {
+    auto capture = call_capture{ path };
+    auto barriers = std::vector<VkImageMemoryBarrier2>(2);
+    for (auto i = std::size_t{ 0 }; i < barriers.size(); ++i)
+    {
+      barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+      barriers[i].srcQueueFamilyIndex = static_cast<std::uint32_t>(i + 1);
+      barriers[i].image = fake_handle<VkImage>(0x20 + i);
+    }
+    auto dependency_info = VkDependencyInfo{ };
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.imageMemoryBarrierCount = static_cast<std::uint32_t>(barriers.size());
+    dependency_info.pImageMemoryBarriers = barriers.data();
+    // Argument types are deduced here, so inputs are passed as const, just as they are through a table.
+    capture.record<device::command::vkCmdPipelineBarrier2>(command_buffer, &std::as_const(dependency_info));
+    auto clears = std::vector<VkClearValue>(3);
+    for (auto i = std::size_t{ 0 }; i < clears.size(); ++i)
+    {
+      clears[i].color.float32[0] = static_cast<float>(i);
+    }
+    auto begin_info = VkRenderPassBeginInfo{ };
+    begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    begin_info.renderPass = fake_handle<VkRenderPass>(0x30);
+    begin_info.clearValueCount = static_cast<std::uint32_t>(clears.size());
+    begin_info.pClearValues = clears.data();
+    capture.record<device::command::vkCmdBeginRenderPass>(command_buffer, &std::as_const(begin_info),
+                                                          VK_SUBPASS_CONTENTS_INLINE);
+    auto viewports = std::vector<VkViewport>(4);
+    for (auto i = std::size_t{ 0 }; i < viewports.size(); ++i)
+    {
+      viewports[i].width = static_cast<float>(i + 1);
+    }
+    capture.record<device::command::vkCmdSetViewport>(command_buffer, std::uint32_t{ 0 },
+                                                      static_cast<std::uint32_t>(viewports.size()),
+                                                      std::as_const(viewports).data());
+    // Payloads are copied when the call is recorded.
+    barriers.clear();
+    clears.clear();
+    viewports.clear();
+    // Structures that can't be copied are recorded opaquely.
+    auto chained = VkDependencyInfo{ };
+    chained.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    chained.pNext = &dependency_info;
+    capture.record<device::command::vkCmdPipelineBarrier2>(command_buffer, &std::as_const(chained));
+    REQUIRE(capture.records() == 4);
+  }
+  {
+    const auto stream = call_stream{ path };
+    REQUIRE(stream.size() == 4);
+    const auto first = *stream.begin();
+    REQUIRE(first.arguments()[1].kind == argument_kind::payload);
+    REQUIRE(first.payloads().size() > sizeof(VkDependencyInfo) + 2 * sizeof(VkImageMemoryBarrier2));
+    const auto last = *stream.seek(3);
+    REQUIRE(last.arguments()[1].kind == argument_kind::pointer);
+    REQUIRE(last.arguments()[1].value == 1);
+    REQUIRE(last.payloads().empty());
+    auto player = call_replayer{ };
+    player.map_handle(reinterpret_cast<std::uintptr_t>(command_buffer), fake_handle<VkCommandBuffer>(0x11));
+    player.map_handle(0x20, fake_handle<VkImage>(0x40));
+    player.map_handle(0x21, fake_handle<VkImage>(0x41));
+    player.map_handle(0x30, fake_handle<VkRenderPass>(0x50));
+    const auto table = replaying_table{ };
+    player.bind<device::command::vkCmdPipelineBarrier2, PFN_vkCmdPipelineBarrier2>(table);
+    player.bind<device::command::vkCmdBeginRenderPass, PFN_vkCmdBeginRenderPass>(table);
+    player.bind<device::command::vkCmdSetViewport, PFN_vkCmdSetViewport>(table);
+    REQUIRE(player.replay(stream.begin(), stream.seek(3)) == 3);
+    // Handles within payloads are translated.
+    REQUIRE(g_calls.images == std::vector<VkImage>{ fake_handle<VkImage>(0x40), fake_handle<VkImage>(0x41) });
+    REQUIRE(g_calls.families == std::vector<std::uint32_t>{ 1, 2 });
+    REQUIRE(g_calls.render_passes == std::vector<VkRenderPass>{ fake_handle<VkRenderPass>(0x50) });
+    REQUIRE(g_calls.clears == std::vector<float>{ 0.0f, 1.0f, 2.0f });
+    REQUIRE(g_calls.widths == std::vector<float>{ 1.0f, 2.0f, 3.0f, 4.0f });
+    // Replaying doesn't modify the stream.
+    g_calls = replayed_calls{ };
+    REQUIRE(player.replay(stream.begin(), stream.seek(1)) == 1);
+    REQUIRE(g_calls.images == std::vector<VkImage>{ fake_handle<VkImage>(0x40), fake_handle<VkImage>(0x41) });
+    // Opaque pointers can't be replayed.
+    REQUIRE_THROWS_AS(player.replay(stream.seek(3), stream.end()), error);
+  }
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Corrupt call streams should be rejected.", "[dispatch][capture]") {
+  using namespace megatech::vulkan::dispatch;
+  const auto path = std::filesystem::temp_directory_path() / "megatech-vulkan-dispatch-corrupt.bin";
+  const auto command_buffer = fake_handle<VkCommandBuffer>(0x10);
+  {
+    auto capture = call_capture{ path };
+    auto barrier = VkImageMemoryBarrier2{ };
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    auto dependency_info = VkDependencyInfo{ };
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.imageMemoryBarrierCount = 1;
+    dependency_info.pImageMemoryBarriers = &barrier;
+    capture.record<device::command::vkCmdPipelineBarrier2>(command_buffer, &std::as_const(dependency_info));
+  }
+  const auto size = std::filesystem::file_size(path);
+  // The stream header is 48 bytes. It is followed by a 24-byte record header, two 16-byte arguments, and a payload
+  // area that begins with the element count and size of the dependency info. The record's argument count and payload
+  // size are its header's last word, and the stream ends with a single index entry.
+  constexpr auto record = std::size_t{ 48 };
+  constexpr auto payloads = record + 24 + 2 * 16;
+  constexpr auto nested = payloads + 16 + offsetof(VkDependencyInfo, pImageMemoryBarriers);
+  auto player = call_replayer{ };
+  player.map_handle(reinterpret_cast<std::uintptr_t>(command_buffer), command_buffer);
+  player.bind<device::command::vkCmdPipelineBarrier2, PFN_vkCmdPipelineBarrier2>(replaying_table{ });
+  REQUIRE(player.replay(call_stream{ path }) == 1);
+  // Truncated files, bad index entries, and records that overrun the stream can't be opened.
+  REQUIRE_THROWS_AS(call_stream{ corrupt(path, record, 0, 1) }, error);
+  REQUIRE_THROWS_AS(call_stream{ corrupt(path, size - 8, record + 8) }, error);
+  REQUIRE_THROWS_AS(call_stream{ corrupt(path, record + 16, std::uint64_t{ 4096 } << 32 | 2) }, error);
+  // Payloads that overrun their record can't be replayed.
+  REQUIRE_THROWS_AS(player.replay(call_stream{ corrupt(path, payloads, 2) }), error);
+  REQUIRE_THROWS_AS(player.replay(call_stream{ corrupt(path, payloads + 8, 4096) }), error);
+  REQUIRE_THROWS_AS(player.replay(call_stream{ corrupt(path, nested, 4096) }), error);
+  std::filesystem::remove(path.string() + ".corrupt");
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Captured call streams should be in timestamp order.", "[dispatch][capture]") {
+  using namespace megatech::vulkan::dispatch;
+  const auto path = std::filesystem::temp_directory_path() / "megatech-vulkan-dispatch-ordering.bin";
+  const auto device = fake_handle<VkDevice>(0x10);
+  {
+    auto capture = call_capture{ path };
+    auto threads = std::vector<std::thread>{ };
+    for (auto i = 0; i < 4; ++i)
+    {
+      threads.emplace_back([&]() {
+        for (auto j = 0; j < 1000; ++j)
+        {
+          capture.record<device::command::vkDeviceWaitIdle>(device);
+        }
+      });
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+  }
+  {
+    const auto stream = call_stream{ path };
+    REQUIRE(stream.size() == 4000);
+    auto timestamps = std::vector<std::uint64_t>{ };
+    for (const auto current : stream)
+    {
+      timestamps.emplace_back(current.timestamp());
+    }
+    REQUIRE(std::ranges::is_sorted(timestamps));
+  }
+  std::filesystem::remove(path);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
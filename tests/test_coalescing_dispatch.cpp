@@ -0,0 +1,245 @@
+#include <cinttypes>
+
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+using coalescer = megatech::vulkan::dispatch::device::descriptor_coalescer<PFN_vkUpdateDescriptorSets>;
+
+struct descriptor_fixture final {
+  VkDevice device{ };
+  VkSampler sampler{ };
+  VkDescriptorSetLayout layout{ };
+  VkDescriptorPool pool{ };
+  std::vector<VkDescriptorSet> sets{ };
+};
+
+static descriptor_fixture create_fixture(const megatech::vulkan::dispatch::device::table& ddt, const VkDevice device,
+                                         const std::uint32_t set_count, const std::uint32_t array_size) {
+  DECLARE_DEVICE_PFN(ddt, vkCreateSampler);
+  DECLARE_DEVICE_PFN(ddt, vkCreateDescriptorSetLayout);
+  DECLARE_DEVICE_PFN(ddt, vkCreateDescriptorPool);
+  DECLARE_DEVICE_PFN(ddt, vkAllocateDescriptorSets);
+  auto fixture = descriptor_fixture{ };
+  fixture.device = device;
+  auto sampler_info = VkSamplerCreateInfo{ };
+  sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  VK_CHECK(vkCreateSampler(device, &sampler_info, nullptr, &fixture.sampler));
+  auto binding = VkDescriptorSetLayoutBinding{ };
+  binding.binding = 0;
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+  binding.descriptorCount = array_size;
+  binding.stageFlags = VK_SHADER_STAGE_ALL;
+  auto layout_info = VkDescriptorSetLayoutCreateInfo{ };
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = 1;
+  layout_info.pBindings = &binding;
+  VK_CHECK(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &fixture.layout));
+  auto pool_size = VkDescriptorPoolSize{ };
+  pool_size.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+  pool_size.descriptorCount = set_count * array_size;
+  auto pool_info = VkDescriptorPoolCreateInfo{ };
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.maxSets = set_count;
+  pool_info.poolSizeCount = 1;
+  pool_info.pPoolSizes = &pool_size;
+  VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &fixture.pool));
+  auto layouts = std::vector<VkDescriptorSetLayout>(set_count, fixture.layout);
+  auto allocate_info = VkDescriptorSetAllocateInfo{ };
+  allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocate_info.descriptorPool = fixture.pool;
+  allocate_info.descriptorSetCount = set_count;
+  allocate_info.pSetLayouts = layouts.data();
+  fixture.sets.resize(set_count);
+  VK_CHECK(vkAllocateDescriptorSets(device, &allocate_info, fixture.sets.data()));
+  return fixture;
+}
+
+static void destroy_fixture(const megatech::vulkan::dispatch::device::table& ddt, const descriptor_fixture& fixture) {
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDescriptorPool);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDescriptorSetLayout);
+  DECLARE_DEVICE_PFN(ddt, vkDestroySampler);
+  vkDestroyDescriptorPool(fixture.device, fixture.pool, nullptr);
+  vkDestroyDescriptorSetLayout(fixture.device, fixture.layout, nullptr);
+  vkDestroySampler(fixture.device, fixture.sampler, nullptr);
+}
+
+static VkWriteDescriptorSet sampler_write(const VkDescriptorSet set, const std::uint32_t element,
+                                          const VkDescriptorImageInfo* info) {
+  auto write = VkWriteDescriptorSet{ };
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = set;
+  write.dstBinding = 0;
+  write.dstArrayElement = element;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+  write.pImageInfo = info;
+  return write;
+}
+
+TEST_CASE("Descriptor coalescers should merge and drop deferred writes.", "[dispatch][coalescing]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  const auto fixture = create_fixture(ddt, device, 2, 8);
+  {
+    REQUIRE_THROWS_AS((coalescer{ ddt, 0 }), error);
+    auto updates = coalescer{ ddt };
+    auto image_info = VkDescriptorImageInfo{ };
+    image_info.sampler = fixture.sampler;
+    // Consecutive single-element writes are merged into one write per set.
+    for (const auto set : fixture.sets)
+    {
+      for (auto i = std::uint32_t{ 0 }; i < 8; ++i)
+      {
+        const auto write = sampler_write(set, i, &image_info);
+        updates.update(device, 1, &write, 0, nullptr);
+      }
+    }
+    REQUIRE(updates.deferred() == 16);
+    REQUIRE(updates.merged() == 14);
+    REQUIRE(updates.updates() == 0);
+    // A write that covers earlier writes replaces them.
+    const auto infos = std::vector<VkDescriptorImageInfo>(8, image_info);
+    auto write = sampler_write(fixture.sets[0], 0, infos.data());
+    write.descriptorCount = 8;
+    updates.update(device, 1, &write, 0, nullptr);
+    REQUIRE(updates.dropped() == 1);
+    updates.flush();
+    REQUIRE(updates.updates() == 1);
+    updates.flush();
+    REQUIRE(updates.updates() == 1);
+    // Copies flush first.
+    updates.update(device, 1, &write, 0, nullptr);
+    auto copy = VkCopyDescriptorSet{ };
+    copy.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+    copy.srcSet = fixture.sets[0];
+    copy.dstSet = fixture.sets[1];
+    copy.descriptorCount = 8;
+    updates.update(device, 0, nullptr, 1, &copy);
+    REQUIRE(updates.updates() == 3);
+  }
+  {
+    auto updates = coalescer{ ddt, 4 };
+    auto image_info = VkDescriptorImageInfo{ };
+    image_info.sampler = fixture.sampler;
+    auto workers = std::vector<std::thread>{ };
+    for (const auto set : fixture.sets)
+    {
+      workers.emplace_back([&, set]() {
+        for (auto i = std::uint32_t{ 0 }; i < 8; i += 2)
+        {
+          const auto write = sampler_write(set, i, &image_info);
+          updates.update(device, 1, &write, 0, nullptr);
+        }
+        updates.flush_local();
+      });
+    }
+    for (auto& worker : workers)
+    {
+      worker.join();
+    }
+    // Every thread fills its arena exactly once. Non-consecutive writes aren't merged.
+    REQUIRE(updates.deferred() == 8);
+    REQUIRE(updates.merged() == 0);
+    REQUIRE(updates.updates() == 2);
+  }
+  destroy_fixture(ddt, fixture);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Descriptor coalescers should order writes to the same set across threads.", "[dispatch][coalescing]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  const auto fixture = create_fixture(ddt, device, 2, 8);
+  {
+    auto updates = coalescer{ ddt };
+    auto image_info = VkDescriptorImageInfo{ };
+    image_info.sampler = fixture.sampler;
+    const auto first = sampler_write(fixture.sets[0], 0, &image_info);
+    updates.update(device, 1, &first, 0, nullptr);
+    // Writes to other sets don't disturb this thread's writes.
+    auto worker = std::thread{ [&]() {
+      const auto other = sampler_write(fixture.sets[1], 0, &image_info);
+      updates.update(device, 1, &other, 0, nullptr);
+    } };
+    worker.join();
+    REQUIRE(updates.updates() == 0);
+    // Overwriting the same binding on another thread sends this thread's stale write first.
+    worker = std::thread{ [&]() {
+      const auto overwrite = sampler_write(fixture.sets[0], 0, &image_info);
+      updates.update(device, 1, &overwrite, 0, nullptr);
+    } };
+    worker.join();
+    REQUIRE(updates.updates() == 1);
+    REQUIRE(updates.dropped() == 0);
+    updates.flush_local();
+    REQUIRE(updates.updates() == 1);
+    // The newer write is sent with the other thread's writes.
+    updates.flush();
+    REQUIRE(updates.updates() == 2);
+    // Once its writes are sent, a set can be written by any thread without a flush.
+    updates.update(device, 1, &first, 0, nullptr);
+    REQUIRE(updates.updates() == 2);
+  }
+  destroy_fixture(ddt, fixture);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Descriptor coalescing policies should defer updates and flush before binds.", "[dispatch][coalescing]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  const auto fixture = create_fixture(ddt, device, 1, 4);
+  {
+    auto updates = coalescer{ ddt };
+    auto dit = device::intercepted_table<device::counting_policy, coalescer::policy>{ ddt };
+    dit.policy<coalescer::policy>().set_coalescer(&updates);
+    REQUIRE(dit.policy<coalescer::policy>().coalescer() == &updates);
+    dit.intercept<device::command::vkUpdateDescriptorSets, PFN_vkUpdateDescriptorSets>();
+    dit.intercept<device::command::vkDestroyDescriptorPool, PFN_vkDestroyDescriptorPool>();
+    DECLARE_DEVICE_PFN(dit, vkUpdateDescriptorSets);
+    auto image_info = VkDescriptorImageInfo{ };
+    image_info.sampler = fixture.sampler;
+    for (auto i = std::uint32_t{ 0 }; i < 4; ++i)
+    {
+      const auto write = sampler_write(fixture.sets[0], i, &image_info);
+      vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+    REQUIRE(updates.updates() == 0);
+    DECLARE_DEVICE_PFN(dit, vkDestroyDescriptorPool);
+    vkDestroyDescriptorPool(device, fixture.pool, nullptr);
+    REQUIRE(updates.updates() == 1);
+    const auto& counters = dit.policy<device::counting_policy>().counters();
+    REQUIRE(counters.count(device::command::vkUpdateDescriptorSets) == 4);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDescriptorSetLayout);
+  DECLARE_DEVICE_PFN(ddt, vkDestroySampler);
+  vkDestroyDescriptorSetLayout(device, fixture.layout, nullptr);
+  vkDestroySampler(device, fixture.sampler, nullptr);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,146 @@
+#include <cinttypes>
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+using compiler = megatech::vulkan::dispatch::device::pipeline_compiler<PFN_vkCreateGraphicsPipelines,
+                                                                        PFN_vkCreateComputePipelines,
+                                                                        PFN_vkCreateRayTracingPipelinesKHR>;
+using manager = megatech::vulkan::dispatch::device::pipeline_cache_manager<PFN_vkCreatePipelineCache>;
+
+// An empty compute shader with a local size of 1x1x1.
+static constexpr auto empty_compute_shader = std::array<std::uint32_t, 35>{
+  0x07230203, 0x00010000, 0x00000000, 0x00000006, 0x00000000,
+  0x00020011, 0x00000001,
+  0x0003000e, 0x00000000, 0x00000001,
+  0x0005000f, 0x00000005, 0x00000004, 0x6e69616d, 0x00000000,
+  0x00060010, 0x00000004, 0x00000011, 0x00000001, 0x00000001, 0x00000001,
+  0x00020013, 0x00000002,
+  0x00030021, 0x00000003, 0x00000002,
+  0x00050036, 0x00000002, 0x00000004, 0x00000000, 0x00000003,
+  0x000200f8, 0x00000005,
+  0x000100fd,
+  0x00010038
+};
+
+static VkPhysicalDeviceProperties physical_device_properties(const megatech::vulkan::dispatch::instance::table& idt) {
+  DECLARE_INSTANCE_PFN(idt, vkEnumeratePhysicalDevices);
+  DECLARE_INSTANCE_PFN(idt, vkGetPhysicalDeviceProperties);
+  auto sz = std::uint32_t{ 0 };
+  VK_CHECK(vkEnumeratePhysicalDevices(idt.instance(), &sz, nullptr));
+  auto physical_devices = std::vector<VkPhysicalDevice>(sz);
+  VK_CHECK(vkEnumeratePhysicalDevices(idt.instance(), &sz, physical_devices.data()));
+  auto properties = VkPhysicalDeviceProperties{ };
+  vkGetPhysicalDeviceProperties(physical_devices[0], &properties);
+  return properties;
+}
+
+TEST_CASE("Pipeline compilers should create pipelines concurrently.", "[dispatch][compilation]") {
+  using namespace megatech::vulkan::dispatch;
+  const auto directory = std::filesystem::temp_directory_path() / "megatech-vulkan-dispatch-compilation";
+  std::filesystem::remove_all(directory);
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  const auto properties = physical_device_properties(idt);
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    DECLARE_DEVICE_PFN(ddt, vkCreateShaderModule);
+    DECLARE_DEVICE_PFN(ddt, vkDestroyShaderModule);
+    DECLARE_DEVICE_PFN(ddt, vkCreatePipelineLayout);
+    DECLARE_DEVICE_PFN(ddt, vkDestroyPipelineLayout);
+    DECLARE_DEVICE_PFN(ddt, vkDestroyPipeline);
+    REQUIRE_THROWS_AS(compiler(ddt, 0), error);
+    auto module_info = VkShaderModuleCreateInfo{ };
+    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_info.codeSize = sizeof(empty_compute_shader);
+    module_info.pCode = empty_compute_shader.data();
+    auto module = VkShaderModule{ };
+    VK_CHECK(vkCreateShaderModule(device, &module_info, nullptr, &module));
+    auto layout_info = VkPipelineLayoutCreateInfo{ };
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    auto layout = VkPipelineLayout{ };
+    VK_CHECK(vkCreatePipelineLayout(device, &layout_info, nullptr, &layout));
+    auto info = VkComputePipelineCreateInfo{ };
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = module;
+    info.stage.pName = "main";
+    info.layout = layout;
+    info.basePipelineIndex = -1;
+    auto pipelines = std::set<VkPipeline>{ };
+    {
+      auto caches = manager{ ddt, properties, directory, std::chrono::milliseconds{ 0 } };
+      auto futures = std::vector<std::future<compiler::compilation>>{ };
+      {
+        auto compilations = compiler{ ddt, caches, 4 };
+        REQUIRE(compilations.threads() == 4);
+        // Pipelines can be requested from any thread.
+        auto requested = std::vector<std::future<compiler::compilation>>{ };
+        auto worker = std::thread{ [&]() {
+          for (auto i = 0; i < 16; ++i)
+          {
+            requested.emplace_back(compilations.compile(info));
+          }
+        } };
+        for (auto i = 0; i < 48; ++i)
+        {
+          futures.emplace_back(compilations.compile(info));
+        }
+        worker.join();
+        for (auto& future : requested)
+        {
+          futures.emplace_back(std::move(future));
+        }
+        for (auto& future : futures)
+        {
+          const auto compiled = future.get();
+          REQUIRE(compiled.status == VK_SUCCESS);
+          REQUIRE(compiled.handle != VkPipeline{ });
+          pipelines.insert(compiled.handle);
+        }
+        REQUIRE(compilations.completed() == 64);
+        REQUIRE(compilations.failed() == 0);
+        // Pipelines that were requested but never waited for are still created.
+        futures.clear();
+        for (auto i = 0; i < 8; ++i)
+        {
+          futures.emplace_back(compilations.compile(info));
+        }
+      }
+      for (auto& future : futures)
+      {
+        REQUIRE(future.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready);
+        pipelines.insert(future.get().handle);
+      }
+      // Workers' caches are merged by the manager.
+      caches.save();
+      REQUIRE(caches.merged() > 0);
+    }
+    REQUIRE(pipelines.size() == 72);
+    for (const auto pipeline : pipelines)
+    {
+      vkDestroyPipeline(device, pipeline, nullptr);
+    }
+    vkDestroyPipelineLayout(device, layout, nullptr);
+    vkDestroyShaderModule(device, module, nullptr);
+  }
+  std::filesystem::remove_all(directory);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,241 @@
+#include <cinttypes>
+
+#include <array>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+using deduplicator = megatech::vulkan::dispatch::device::object_deduplicator;
+
+static VkSamplerCreateInfo sampler_info(const VkFilter filter) {
+  auto result = VkSamplerCreateInfo{ };
+  result.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  result.magFilter = filter;
+  result.minFilter = filter;
+  result.maxLod = 1.0f;
+  return result;
+}
+
+TEST_CASE("Object deduplicators should share identical immutable objects.", "[dispatch][deduplication]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto objects = deduplicator{ };
+    // The counting policy is inside the deduplicator, so it only counts calls that reach the driver.
+    auto dit = device::intercepted_table<deduplicator::policy, device::counting_policy>{ ddt };
+    dit.policy<deduplicator::policy>().set_deduplicator(&objects);
+    REQUIRE(dit.policy<deduplicator::policy>().deduplicator() == &objects);
+    dit.intercept<device::command::vkCreateSampler, PFN_vkCreateSampler>();
+    dit.intercept<device::command::vkDestroySampler, PFN_vkDestroySampler>();
+    dit.intercept<device::command::vkCreateDescriptorSetLayout, PFN_vkCreateDescriptorSetLayout>();
+    dit.intercept<device::command::vkDestroyDescriptorSetLayout, PFN_vkDestroyDescriptorSetLayout>();
+    dit.intercept<device::command::vkCreatePipelineLayout, PFN_vkCreatePipelineLayout>();
+    dit.intercept<device::command::vkDestroyPipelineLayout, PFN_vkDestroyPipelineLayout>();
+    DECLARE_DEVICE_PFN(dit, vkCreateSampler);
+    DECLARE_DEVICE_PFN(dit, vkDestroySampler);
+    DECLARE_DEVICE_PFN(dit, vkCreateDescriptorSetLayout);
+    DECLARE_DEVICE_PFN(dit, vkDestroyDescriptorSetLayout);
+    DECLARE_DEVICE_PFN(dit, vkCreatePipelineLayout);
+    DECLARE_DEVICE_PFN(dit, vkDestroyPipelineLayout);
+    const auto& counters = dit.policy<device::counting_policy>().counters();
+    // Identical creation structures share a single object. Contents are compared, not addresses.
+    const auto linear = sampler_info(VK_FILTER_LINEAR);
+    const auto copy = linear;
+    const auto nearest = sampler_info(VK_FILTER_NEAREST);
+    auto samplers = std::array<VkSampler, 3>{ };
+    VK_CHECK(vkCreateSampler(device, &linear, nullptr, &samplers[0]));
+    VK_CHECK(vkCreateSampler(device, &copy, nullptr, &samplers[1]));
+    VK_CHECK(vkCreateSampler(device, &nearest, nullptr, &samplers[2]));
+    REQUIRE(samplers[0] == samplers[1]);
+    REQUIRE(samplers[0] != samplers[2]);
+    REQUIRE(counters.count(device::command::vkCreateSampler) == 2);
+    REQUIRE(objects.created() == 2);
+    REQUIRE(objects.reused() == 1);
+    REQUIRE(objects.size() == 2);
+    // Known pNext structures are part of the key.
+    auto reduction = VkSamplerReductionModeCreateInfo{ };
+    reduction.sType = VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO;
+    reduction.reductionMode = VK_SAMPLER_REDUCTION_MODE_WEIGHTED_AVERAGE;
+    auto reduced = linear;
+    reduced.pNext = &reduction;
+    auto reduced_sampler = VkSampler{ };
+    VK_CHECK(vkCreateSampler(device, &reduced, nullptr, &reduced_sampler));
+    REQUIRE(reduced_sampler != samplers[0]);
+    REQUIRE(counters.count(device::command::vkCreateSampler) == 3);
+    // Unknown pNext structures bypass deduplication entirely.
+    auto unknown = VkSamplerBorderColorComponentMappingCreateInfoEXT{ };
+    unknown.sType = VK_STRUCTURE_TYPE_SAMPLER_BORDER_COLOR_COMPONENT_MAPPING_CREATE_INFO_EXT;
+    auto bypassed = linear;
+    bypassed.pNext = &unknown;
+    auto bypassed_samplers = std::array<VkSampler, 2>{ };
+    VK_CHECK(vkCreateSampler(device, &bypassed, nullptr, &bypassed_samplers[0]));
+    VK_CHECK(vkCreateSampler(device, &bypassed, nullptr, &bypassed_samplers[1]));
+    REQUIRE(bypassed_samplers[0] != bypassed_samplers[1]);
+    REQUIRE(objects.bypassed() == 2);
+    REQUIRE(counters.count(device::command::vkCreateSampler) == 5);
+    // Layouts that refer to shared objects are deduplicated by the contents of those objects.
+    auto binding = VkDescriptorSetLayoutBinding{ };
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_ALL;
+    binding.pImmutableSamplers = &samplers[1];
+    auto set_layout_info = VkDescriptorSetLayoutCreateInfo{ };
+    set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_info.bindingCount = 1;
+    set_layout_info.pBindings = &binding;
+    auto set_layouts = std::array<VkDescriptorSetLayout, 2>{ };
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &set_layout_info, nullptr, &set_layouts[0]));
+    binding.pImmutableSamplers = &samplers[0];
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &set_layout_info, nullptr, &set_layouts[1]));
+    REQUIRE(set_layouts[0] == set_layouts[1]);
+    binding.pImmutableSamplers = &samplers[2];
+    auto other_set_layout = VkDescriptorSetLayout{ };
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &set_layout_info, nullptr, &other_set_layout));
+    REQUIRE(other_set_layout != set_layouts[0]);
+    REQUIRE(counters.count(device::command::vkCreateDescriptorSetLayout) == 2);
+    auto range = VkPushConstantRange{ };
+    range.stageFlags = VK_SHADER_STAGE_ALL;
+    range.size = 16;
+    auto layout_info = VkPipelineLayoutCreateInfo{ };
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &set_layouts[0];
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &range;
+    // Objects are shared across threads.
+    auto layouts = std::vector<VkPipelineLayout>(8);
+    auto results = std::vector<VkResult>(layouts.size());
+    {
+      auto workers = std::vector<std::thread>{ };
+      for (auto i = std::size_t{ 0 }; i < layouts.size(); ++i)
+      {
+        workers.emplace_back([&, i]() {
+          results[i] = vkCreatePipelineLayout(device, &layout_info, nullptr, &layouts[i]);
+        });
+      }
+      for (auto& worker : workers)
+      {
+        worker.join();
+      }
+    }
+    for (auto i = std::size_t{ 0 }; i < layouts.size(); ++i)
+    {
+      REQUIRE(results[i] == VK_SUCCESS);
+      REQUIRE(layouts[i] != VkPipelineLayout{ });
+    }
+    // Concurrent misses may each reach the driver, but only one object is shared afterwards.
+    auto shared = VkPipelineLayout{ };
+    VK_CHECK(vkCreatePipelineLayout(device, &layout_info, nullptr, &shared));
+    auto again = VkPipelineLayout{ };
+    VK_CHECK(vkCreatePipelineLayout(device, &layout_info, nullptr, &again));
+    REQUIRE(shared == again);
+    const auto layouts_created = counters.count(device::command::vkCreatePipelineLayout);
+    REQUIRE(layouts_created >= 1);
+    REQUIRE(layouts_created <= layouts.size());
+    // Objects are only destroyed when their last reference is released.
+    vkDestroySampler(device, samplers[0], nullptr);
+    REQUIRE(counters.count(device::command::vkDestroySampler) == 0);
+    vkDestroySampler(device, samplers[1], nullptr);
+    REQUIRE(counters.count(device::command::vkDestroySampler) == 1);
+    vkDestroySampler(device, samplers[2], nullptr);
+    vkDestroySampler(device, reduced_sampler, nullptr);
+    vkDestroySampler(device, bypassed_samplers[0], nullptr);
+    vkDestroySampler(device, bypassed_samplers[1], nullptr);
+    REQUIRE(counters.count(device::command::vkDestroySampler) == 5);
+    vkDestroyPipelineLayout(device, shared, nullptr);
+    vkDestroyPipelineLayout(device, again, nullptr);
+    for (const auto layout : layouts)
+    {
+      vkDestroyPipelineLayout(device, layout, nullptr);
+    }
+    REQUIRE(counters.count(device::command::vkDestroyPipelineLayout) == layouts_created);
+    vkDestroyDescriptorSetLayout(device, set_layouts[0], nullptr);
+    vkDestroyDescriptorSetLayout(device, set_layouts[1], nullptr);
+    vkDestroyDescriptorSetLayout(device, other_set_layout, nullptr);
+    REQUIRE(counters.count(device::command::vkDestroyDescriptorSetLayout) == 2);
+    REQUIRE(objects.size() == 0);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Object deduplicators should not confuse objects whose handles were reused.", "[dispatch][deduplication]") {
+  using namespace megatech::vulkan::dispatch;
+  auto objects = deduplicator{ };
+  const auto device = reinterpret_cast<VkDevice>(std::uintptr_t{ 0x10 });
+  const auto allocator = static_cast<const VkAllocationCallbacks*>(nullptr);
+  // This driver always reuses the handle of the last destroyed set layout.
+  const auto create_set_layout = [](VkDevice, const VkDescriptorSetLayoutCreateInfo*, const VkAllocationCallbacks*,
+                                    VkDescriptorSetLayout *const output) {
+    *output = reinterpret_cast<VkDescriptorSetLayout>(std::uintptr_t{ 0x100 });
+    return VK_SUCCESS;
+  };
+  auto next_layout = std::uintptr_t{ 0x200 };
+  const auto create_layout = [&](VkDevice, const VkPipelineLayoutCreateInfo*, const VkAllocationCallbacks*,
+                                 VkPipelineLayout *const output) {
+    *output = reinterpret_cast<VkPipelineLayout>(next_layout++);
+    return VK_SUCCESS;
+  };
+  auto bindings = std::array<VkDescriptorSetLayoutBinding, 2>{ };
+  for (auto i = std::uint32_t{ 0 }; i < bindings.size(); ++i)
+  {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+  }
+  auto set_layout_info = VkDescriptorSetLayoutCreateInfo{ };
+  set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  set_layout_info.bindingCount = 1;
+  set_layout_info.pBindings = bindings.data();
+  auto set_layout = VkDescriptorSetLayout{ };
+  VK_CHECK((objects.create<device::command::vkCreateDescriptorSetLayout>(create_set_layout, device, &set_layout_info,
+                                                                         allocator, &set_layout)));
+  auto layout_info = VkPipelineLayoutCreateInfo{ };
+  layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layout_info.setLayoutCount = 1;
+  layout_info.pSetLayouts = &set_layout;
+  auto layouts = std::array<VkPipelineLayout, 3>{ };
+  VK_CHECK((objects.create<device::command::vkCreatePipelineLayout>(create_layout, device, &layout_info, allocator,
+                                                                    &layouts[0])));
+  // Set layouts may be destroyed while pipeline layouts that were created from them are alive.
+  REQUIRE(objects.release<device::command::vkDestroyDescriptorSetLayout>(set_layout));
+  set_layout_info.bindingCount = 2;
+  auto reused = VkDescriptorSetLayout{ };
+  VK_CHECK((objects.create<device::command::vkCreateDescriptorSetLayout>(create_set_layout, device, &set_layout_info,
+                                                                         allocator, &reused)));
+  REQUIRE(reused == set_layout);
+  // The same handle now refers to different bindings, so the old pipeline layout isn't returned.
+  VK_CHECK((objects.create<device::command::vkCreatePipelineLayout>(create_layout, device, &layout_info, allocator,
+                                                                    &layouts[1])));
+  REQUIRE(layouts[1] != layouts[0]);
+  VK_CHECK((objects.create<device::command::vkCreatePipelineLayout>(create_layout, device, &layout_info, allocator,
+                                                                    &layouts[2])));
+  REQUIRE(layouts[2] == layouts[1]);
+  REQUIRE(objects.created() == 4);
+  REQUIRE(objects.reused() == 1);
+  // Layouts that refer to objects that aren't tracked are never shared.
+  const auto untracked = reinterpret_cast<VkDescriptorSetLayout>(std::uintptr_t{ 0x300 });
+  layout_info.pSetLayouts = &untracked;
+  auto bypassed = VkPipelineLayout{ };
+  VK_CHECK((objects.create<device::command::vkCreatePipelineLayout>(create_layout, device, &layout_info, allocator,
+                                                                    &bypassed)));
+  REQUIRE(objects.bypassed() == 1);
+  REQUIRE(objects.release<device::command::vkDestroyPipelineLayout>(bypassed));
+  REQUIRE(objects.release<device::command::vkDestroyPipelineLayout>(layouts[0]));
+  REQUIRE_FALSE(objects.release<device::command::vkDestroyPipelineLayout>(layouts[1]));
+  REQUIRE(objects.release<device::command::vkDestroyPipelineLayout>(layouts[2]));
+  REQUIRE(objects.release<device::command::vkDestroyDescriptorSetLayout>(reused));
+  REQUIRE(objects.size() == 0);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,210 @@
+#include <cinttypes>
+
+#include <array>
+#include <chrono>
+#include <thread>
+
+#include "common.hpp"
+
+using queue = megatech::vulkan::dispatch::device::destruction_queue<PFN_vkGetSemaphoreCounterValue>;
+
+static VkSemaphore create_timeline(const megatech::vulkan::dispatch::device::table& ddt) {
+  auto type_info = VkSemaphoreTypeCreateInfo{ };
+  type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  auto info = VkSemaphoreCreateInfo{ };
+  info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  info.pNext = &type_info;
+  DECLARE_DEVICE_PFN(ddt, vkCreateSemaphore);
+  auto result = VkSemaphore{ };
+  VK_CHECK(vkCreateSemaphore(ddt.device(), &info, nullptr, &result));
+  return result;
+}
+
+template <typename Predicate>
+static bool eventually(Predicate&& predicate) {
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 5 };
+  while (!predicate())
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+    {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+  }
+  return true;
+}
+
+TEST_CASE("Destruction queues should defer destruction until the timeline is reached.", "[dispatch][destruction]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt, VK_API_VERSION_1_2);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_timeline_device(idt);
+  if (!device)
+  {
+    DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+    vkDestroyInstance(instance, nullptr);
+    SKIP("The physical device doesn't support timeline semaphores.");
+  }
+  auto ddt = device::table{ gdt, idt, device };
+  const auto timeline = create_timeline(ddt);
+  REQUIRE_THROWS_AS(queue(ddt, nullptr), error);
+  DECLARE_DEVICE_PFN(ddt, vkSignalSemaphore);
+  const auto signal = [&](const std::uint64_t value) {
+    auto info = VkSemaphoreSignalInfo{ };
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+    info.semaphore = timeline;
+    info.value = value;
+    VK_CHECK(vkSignalSemaphore(device, &info));
+  };
+  // The counting policy is inside the queue, so it only counts calls that reach the driver.
+  auto dit = device::intercepted_table<queue::policy, device::counting_policy>{ ddt };
+  dit.intercept<device::command::vkDestroySampler, PFN_vkDestroySampler>();
+  dit.intercept<device::command::vkDestroyDescriptorPool, PFN_vkDestroyDescriptorPool>();
+  dit.intercept<device::command::vkFreeDescriptorSets, PFN_vkFreeDescriptorSets>();
+  dit.intercept<device::command::vkCreateSampler, PFN_vkCreateSampler>();
+  DECLARE_DEVICE_PFN(dit, vkCreateSampler);
+  DECLARE_DEVICE_PFN(dit, vkDestroySampler);
+  DECLARE_DEVICE_PFN(dit, vkDestroyDescriptorPool);
+  DECLARE_DEVICE_PFN(dit, vkFreeDescriptorSets);
+  DECLARE_DEVICE_PFN(ddt, vkCreateDescriptorSetLayout);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDescriptorSetLayout);
+  DECLARE_DEVICE_PFN(ddt, vkCreateDescriptorPool);
+  DECLARE_DEVICE_PFN(ddt, vkAllocateDescriptorSets);
+  const auto& counters = dit.policy<device::counting_policy>().counters();
+  auto sampler_info = VkSamplerCreateInfo{ };
+  sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  auto binding = VkDescriptorSetLayoutBinding{ };
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+  binding.descriptorCount = 1;
+  binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  auto layout_info = VkDescriptorSetLayoutCreateInfo{ };
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = 1;
+  layout_info.pBindings = &binding;
+  auto layout = VkDescriptorSetLayout{ };
+  VK_CHECK(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &layout));
+  auto pool_size = VkDescriptorPoolSize{ };
+  pool_size.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+  pool_size.descriptorCount = 2;
+  auto pool_info = VkDescriptorPoolCreateInfo{ };
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  pool_info.maxSets = 2;
+  pool_info.poolSizeCount = 1;
+  pool_info.pPoolSizes = &pool_size;
+  auto descriptor_pool = VkDescriptorPool{ };
+  VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool));
+  {
+    auto garbage = queue{ ddt, timeline };
+    dit.policy<queue::policy>().set_queue(&garbage);
+    REQUIRE(dit.policy<queue::policy>().queue() == &garbage);
+    // Destruction is deferred. Creation is unchanged.
+    auto samplers = std::array<VkSampler, 3>{ };
+    for (auto& sampler : samplers)
+    {
+      VK_CHECK(vkCreateSampler(device, &sampler_info, nullptr, &sampler));
+    }
+    vkDestroySampler(device, samplers[0], nullptr);
+    vkDestroySampler(device, samplers[1], nullptr);
+    {
+      const auto layouts = std::array<VkDescriptorSetLayout, 2>{ layout, layout };
+      auto allocate_info = VkDescriptorSetAllocateInfo{ };
+      allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+      allocate_info.descriptorPool = descriptor_pool;
+      allocate_info.descriptorSetCount = layouts.size();
+      allocate_info.pSetLayouts = layouts.data();
+      auto sets = std::array<VkDescriptorSet, 2>{ };
+      VK_CHECK(vkAllocateDescriptorSets(device, &allocate_info, sets.data()));
+      // Pool children are never deferred, because their pools are externally synchronized.
+      VK_CHECK(vkFreeDescriptorSets(device, descriptor_pool, sets.size(), sets.data()));
+    }
+    REQUIRE(counters.count(device::command::vkCreateSampler) == 3);
+    REQUIRE(counters.count(device::command::vkDestroySampler) == 0);
+    REQUIRE(counters.count(device::command::vkFreeDescriptorSets) == 1);
+    REQUIRE(garbage.pending() == 2);
+    // Closed batches wait for the timeline.
+    garbage.advance(1);
+    vkDestroySampler(device, samplers[2], nullptr);
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+    REQUIRE(garbage.destroyed() == 0);
+    REQUIRE(garbage.collect() == 0);
+    signal(1);
+    REQUIRE(eventually([&]() { return garbage.destroyed() == 2; }));
+    REQUIRE(counters.count(device::command::vkDestroySampler) == 2);
+    // The open batch is never destroyed by the background thread.
+    signal(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+    REQUIRE(garbage.pending() == 1);
+    REQUIRE(counters.count(device::command::vkDestroySampler) == 2);
+    // Empty batches aren't closed, and closing a batch whose value was reached destroys it promptly.
+    garbage.advance(2);
+    garbage.advance(3);
+    REQUIRE(eventually([&]() { return garbage.destroyed() == 3; }));
+    REQUIRE(counters.count(device::command::vkDestroySampler) == 3);
+    // Whatever is left is destroyed when the queue is.
+    vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+    REQUIRE(garbage.pending() == 1);
+    dit.policy<queue::policy>().set_queue(nullptr);
+  }
+  REQUIRE(counters.count(device::command::vkDestroyDescriptorPool) == 1);
+  vkDestroyDescriptorSetLayout(device, layout, nullptr);
+  DECLARE_DEVICE_PFN(ddt, vkDestroySemaphore);
+  vkDestroySemaphore(device, timeline, nullptr);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Destruction queues should be flushed before the device is destroyed.", "[dispatch][destruction]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt, VK_API_VERSION_1_2);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_timeline_device(idt);
+  if (!device)
+  {
+    DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+    vkDestroyInstance(instance, nullptr);
+    SKIP("The physical device doesn't support timeline semaphores.");
+  }
+  auto ddt = device::table{ gdt, idt, device };
+  const auto timeline = create_timeline(ddt);
+  auto dit = device::intercepted_table<queue::policy, device::counting_policy>{ ddt };
+  dit.intercept<device::command::vkDestroySampler, PFN_vkDestroySampler>();
+  dit.intercept<device::command::vkDestroySemaphore, PFN_vkDestroySemaphore>();
+  dit.intercept<device::command::vkDestroyDevice, PFN_vkDestroyDevice>();
+  DECLARE_DEVICE_PFN(ddt, vkCreateSampler);
+  DECLARE_DEVICE_PFN(dit, vkDestroySampler);
+  DECLARE_DEVICE_PFN(dit, vkDestroySemaphore);
+  DECLARE_DEVICE_PFN(dit, vkDestroyDevice);
+  const auto& counters = dit.policy<device::counting_policy>().counters();
+  {
+    auto garbage = queue{ ddt, timeline };
+    dit.policy<queue::policy>().set_queue(&garbage);
+    auto sampler_info = VkSamplerCreateInfo{ };
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    auto sampler = VkSampler{ };
+    VK_CHECK(vkCreateSampler(device, &sampler_info, nullptr, &sampler));
+    vkDestroySampler(device, sampler, nullptr);
+    garbage.advance(1);
+    // The timeline itself can be destroyed through the queue.
+    vkDestroySemaphore(device, timeline, nullptr);
+    REQUIRE(garbage.pending() == 2);
+    REQUIRE(counters.count(device::command::vkDestroySampler) == 0);
+    vkDestroyDevice(device, nullptr);
+    REQUIRE(garbage.pending() == 0);
+    REQUIRE(garbage.destroyed() == 2);
+    REQUIRE(counters.count(device::command::vkDestroySampler) == 1);
+    REQUIRE(counters.count(device::command::vkDestroySemaphore) == 1);
+    REQUIRE(counters.count(device::command::vkDestroyDevice) == 1);
+  }
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
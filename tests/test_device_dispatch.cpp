@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "common.hpp"
 
 TEST_CASE("Device dispatch tables should resolve function pointers.", "[dispatch]") {
@@ -109,6 +111,54 @@ TEST_CASE("Device dispatch tables should be constructible from a base table and
   vkDestroyInstance(instance, nullptr);
 }
 
+TEST_CASE("Dispatch table construction should record statistics when a sink is provided.", "[dispatch][statistics]") {
+  using namespace megatech::vulkan::dispatch;
+  auto statistics = construction_statistics{ };
+  auto gdt = global::table{ vkGetInstanceProcAddr, statistics };
+  auto instance = create_instance(gdt);
+  REQUIRE(instance != nullptr);
+  auto idt = instance::table{ gdt, instance, statistics };
+  auto device = create_device(idt);
+  REQUIRE(device != nullptr);
+  auto ddt = device::table{ gdt, idt, device, statistics };
+  auto plain = device::table{ gdt, idt, device };
+  for (auto i = std::size_t{ 0 }; i < ddt.size(); ++i)
+  {
+    const auto cmd = static_cast<device::command>(i);
+    REQUIRE(*reinterpret_cast<const PFN_vkVoidFunction*>(ddt(cmd)) ==
+            *reinterpret_cast<const PFN_vkVoidFunction*>(plain(cmd)));
+  }
+  const auto global_summary = statistics.report(table_level::global);
+  REQUIRE(global_summary.tables == 1);
+  REQUIRE(global_summary.loader_calls == gdt.size());
+  const auto instance_summary = statistics.report(table_level::instance);
+  REQUIRE(instance_summary.tables == 1);
+  REQUIRE(instance_summary.loader_calls == idt.size());
+  const auto device_summary = statistics.report(table_level::device, 3);
+  REQUIRE(device_summary.tables == 1);
+  REQUIRE(device_summary.loader_calls == ddt.size() + 1);
+  REQUIRE(device_summary.nanoseconds > 0);
+  REQUIRE(device_summary.slowest.size() == std::min(ddt.size(), std::size_t{ 3 }));
+  auto nulls = std::uint64_t{ 0 };
+  for (auto i = std::size_t{ 0 }; i < ddt.size(); ++i)
+  {
+    nulls += !*reinterpret_cast<const PFN_vkVoidFunction*>(ddt(static_cast<device::command>(i)));
+  }
+  REQUIRE(device_summary.null_slots == nulls);
+  for (auto i = std::size_t{ 1 }; i < device_summary.slowest.size(); ++i)
+  {
+    REQUIRE(device_summary.slowest[i - 1].nanoseconds >= device_summary.slowest[i].nanoseconds);
+    REQUIRE(device_summary.slowest[i].count == 1);
+  }
+  statistics.reset();
+  REQUIRE(statistics.report(table_level::device).tables == 0);
+  REQUIRE(statistics.report(table_level::device).slowest.empty());
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
 int main(int argc, char** argv) {
   return Catch::Session().run(argc, argv);
 }
@@ -0,0 +1,223 @@
+#include <cinttypes>
+
+#include <array>
+#include <thread>
+
+#include "common.hpp"
+
+using filter = megatech::vulkan::dispatch::device::state_filter;
+
+struct recording_fixture final {
+  VkDevice device{ };
+  VkCommandPool pool{ };
+  std::array<VkCommandBuffer, 2> command_buffers{ };
+};
+
+static recording_fixture create_fixture(const megatech::vulkan::dispatch::device::table& ddt, const VkDevice device) {
+  DECLARE_DEVICE_PFN(ddt, vkCreateCommandPool);
+  DECLARE_DEVICE_PFN(ddt, vkAllocateCommandBuffers);
+  auto fixture = recording_fixture{ };
+  fixture.device = device;
+  auto pool_info = VkCommandPoolCreateInfo{ };
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  pool_info.queueFamilyIndex = 0;
+  VK_CHECK(vkCreateCommandPool(device, &pool_info, nullptr, &fixture.pool));
+  auto allocate_info = VkCommandBufferAllocateInfo{ };
+  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.commandPool = fixture.pool;
+  allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandBufferCount = static_cast<std::uint32_t>(fixture.command_buffers.size());
+  VK_CHECK(vkAllocateCommandBuffers(device, &allocate_info, fixture.command_buffers.data()));
+  return fixture;
+}
+
+static void destroy_fixture(const megatech::vulkan::dispatch::device::table& ddt, const recording_fixture& fixture) {
+  DECLARE_DEVICE_PFN(ddt, vkDestroyCommandPool);
+  vkDestroyCommandPool(fixture.device, fixture.pool, nullptr);
+}
+
+static VkViewport viewport(const float width) {
+  auto result = VkViewport{ };
+  result.width = width;
+  result.height = width;
+  result.maxDepth = 1.0f;
+  return result;
+}
+
+TEST_CASE("State filters should drop repeated state.", "[dispatch][filtering]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  const auto fixture = create_fixture(ddt, device);
+  const auto first = fixture.command_buffers[0];
+  const auto second = fixture.command_buffers[1];
+  {
+    auto states = filter{ };
+    const auto small = viewport(1.0f);
+    const auto large = viewport(2.0f);
+    REQUIRE(states.admit<device::command::vkCmdSetViewport>(first, 0U, 1U, &small));
+    REQUIRE_FALSE(states.admit<device::command::vkCmdSetViewport>(first, 0U, 1U, &small));
+    // Arguments are compared by content, not by address.
+    const auto copy = small;
+    REQUIRE_FALSE(states.admit<device::command::vkCmdSetViewport>(first, 0U, 1U, &copy));
+    REQUIRE(states.admit<device::command::vkCmdSetViewport>(first, 0U, 1U, &large));
+    REQUIRE(states.admit<device::command::vkCmdSetViewport>(first, 0U, 1U, &small));
+    // Command buffers are tracked separately.
+    REQUIRE(states.admit<device::command::vkCmdSetViewport>(second, 0U, 1U, &small));
+    const auto constants = std::array<float, 4>{ 0.0f, 0.25f, 0.5f, 1.0f };
+    auto changed = constants;
+    changed[3] = 0.75f;
+    REQUIRE(states.admit<device::command::vkCmdSetBlendConstants>(first, constants.data()));
+    REQUIRE_FALSE(states.admit<device::command::vkCmdSetBlendConstants>(first, constants.data()));
+    REQUIRE(states.admit<device::command::vkCmdSetBlendConstants>(first, changed.data()));
+    // Pipelines are tracked for each bind point, and binding a new pipeline invalidates dynamic state.
+    const auto pipeline = VkPipeline{ };
+    REQUIRE(states.admit<device::command::vkCmdBindPipeline>(first, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline));
+    REQUIRE_FALSE(states.admit<device::command::vkCmdBindPipeline>(first, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline));
+    REQUIRE(states.admit<device::command::vkCmdBindPipeline>(first, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline));
+    REQUIRE_FALSE(states.admit<device::command::vkCmdBindPipeline>(first, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline));
+    REQUIRE(states.admit<device::command::vkCmdSetViewport>(first, 0U, 1U, &small));
+    REQUIRE_FALSE(states.admit<device::command::vkCmdSetViewport>(first, 0U, 1U, &small));
+    // State is shared between threads.
+    auto admitted = true;
+    auto worker = std::thread{ [&]() {
+      admitted = states.admit<device::command::vkCmdSetViewport>(first, 0U, 1U, &small);
+      states.reset(first);
+    } };
+    worker.join();
+    REQUIRE_FALSE(admitted);
+    REQUIRE(states.admit<device::command::vkCmdSetViewport>(first, 0U, 1U, &small));
+    REQUIRE(states.admit<device::command::vkCmdBindPipeline>(first, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline));
+    REQUIRE(states.dropped() == 7);
+    REQUIRE(states.forwarded() == 11);
+  }
+  destroy_fixture(ddt, fixture);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("State filtering policies should drop redundant commands until state is invalidated.",
+          "[dispatch][filtering]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  const auto fixture = create_fixture(ddt, device);
+  const auto command_buffer = fixture.command_buffers[0];
+  {
+    auto states = filter{ };
+    auto dit = device::intercepted_table<device::counting_policy, filter::policy>{ ddt };
+    dit.policy<filter::policy>().set_filter(&states);
+    REQUIRE(dit.policy<filter::policy>().filter() == &states);
+    dit.intercept<device::command::vkBeginCommandBuffer, PFN_vkBeginCommandBuffer>();
+    dit.intercept<device::command::vkEndCommandBuffer, PFN_vkEndCommandBuffer>();
+    dit.intercept<device::command::vkCmdSetViewport, PFN_vkCmdSetViewport>();
+    dit.intercept<device::command::vkCmdSetScissor, PFN_vkCmdSetScissor>();
+    DECLARE_DEVICE_PFN(dit, vkBeginCommandBuffer);
+    DECLARE_DEVICE_PFN(dit, vkEndCommandBuffer);
+    DECLARE_DEVICE_PFN(dit, vkCmdSetViewport);
+    DECLARE_DEVICE_PFN(dit, vkCmdSetScissor);
+    auto begin_info = VkCommandBufferBeginInfo{ };
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    const auto current = viewport(1.0f);
+    auto scissor = VkRect2D{ };
+    scissor.extent.width = 1;
+    scissor.extent.height = 1;
+    for (auto i = 0; i < 2; ++i)
+    {
+      VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
+      for (auto j = 0; j < 3; ++j)
+      {
+        vkCmdSetViewport(command_buffer, 0, 1, &current);
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+      }
+      VK_CHECK(vkEndCommandBuffer(command_buffer));
+    }
+    REQUIRE(states.forwarded() == 4);
+    REQUIRE(states.dropped() == 8);
+    const auto& counters = dit.policy<device::counting_policy>().counters();
+    REQUIRE(counters.count(device::command::vkCmdSetViewport) == 6);
+  }
+  destroy_fixture(ddt, fixture);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("State filtering policies should release command buffer state with its pool.", "[dispatch][filtering]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto states = filter{ };
+    auto dit = device::intercepted_table<filter::policy>{ ddt };
+    dit.policy<filter::policy>().set_filter(&states);
+    dit.intercept<device::command::vkAllocateCommandBuffers, PFN_vkAllocateCommandBuffers>();
+    dit.intercept<device::command::vkFreeCommandBuffers, PFN_vkFreeCommandBuffers>();
+    dit.intercept<device::command::vkResetCommandPool, PFN_vkResetCommandPool>();
+    dit.intercept<device::command::vkDestroyCommandPool, PFN_vkDestroyCommandPool>();
+    dit.intercept<device::command::vkCmdSetViewport, PFN_vkCmdSetViewport>();
+    DECLARE_DEVICE_PFN(ddt, vkCreateCommandPool);
+    DECLARE_DEVICE_PFN(dit, vkAllocateCommandBuffers);
+    DECLARE_DEVICE_PFN(dit, vkFreeCommandBuffers);
+    DECLARE_DEVICE_PFN(dit, vkResetCommandPool);
+    DECLARE_DEVICE_PFN(dit, vkDestroyCommandPool);
+    DECLARE_DEVICE_PFN(dit, vkCmdSetViewport);
+    DECLARE_DEVICE_PFN(ddt, vkBeginCommandBuffer);
+    auto pool_info = VkCommandPoolCreateInfo{ };
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    auto pool = VkCommandPool{ };
+    VK_CHECK(vkCreateCommandPool(device, &pool_info, nullptr, &pool));
+    auto allocate_info = VkCommandBufferAllocateInfo{ };
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.commandPool = pool;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = 2;
+    auto command_buffers = std::array<VkCommandBuffer, 2>{ };
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocate_info, command_buffers.data()));
+    REQUIRE(states.tracked() == 2);
+    auto begin_info = VkCommandBufferBeginInfo{ };
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    const auto current = viewport(1.0f);
+    // Resetting the pool invalidates state without releasing it.
+    VK_CHECK(vkBeginCommandBuffer(command_buffers[0], &begin_info));
+    vkCmdSetViewport(command_buffers[0], 0, 1, &current);
+    vkCmdSetViewport(command_buffers[0], 0, 1, &current);
+    REQUIRE(states.dropped() == 1);
+    VK_CHECK(vkResetCommandPool(device, pool, 0));
+    VK_CHECK(vkBeginCommandBuffer(command_buffers[0], &begin_info));
+    vkCmdSetViewport(command_buffers[0], 0, 1, &current);
+    REQUIRE(states.forwarded() == 2);
+    REQUIRE(states.tracked() == 2);
+    // Freeing a command buffer releases its state, even if another thread indexed it.
+    std::thread{ [&]() { states.reset(command_buffers[1]); } }.join();
+    vkFreeCommandBuffers(device, pool, 1, &command_buffers[1]);
+    REQUIRE(states.tracked() == 1);
+    // Destroying the pool releases every command buffer that was allocated from it.
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocate_info, command_buffers.data()));
+    REQUIRE(states.tracked() == 3);
+    vkDestroyCommandPool(device, pool, nullptr);
+    REQUIRE(states.tracked() == 0);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,276 @@
+#include <cinttypes>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+using funnel = megatech::vulkan::dispatch::device::submission_funnel<PFN_vkQueueSubmit, PFN_vkQueueSubmit2>;
+
+// Create a device with two queues, from one family if possible. Returns null if the device only has one queue.
+static VkDevice create_two_queue_device(const megatech::vulkan::dispatch::instance::table& idt,
+                                        std::array<std::uint32_t, 2>& families) {
+  DECLARE_INSTANCE_PFN(idt, vkEnumeratePhysicalDevices);
+  DECLARE_INSTANCE_PFN(idt, vkGetPhysicalDeviceQueueFamilyProperties);
+  DECLARE_INSTANCE_PFN(idt, vkCreateDevice);
+  auto sz = std::uint32_t{ };
+  VK_CHECK(vkEnumeratePhysicalDevices(idt.instance(), &sz, nullptr));
+  auto physical_devices = std::vector<VkPhysicalDevice>(sz);
+  VK_CHECK(vkEnumeratePhysicalDevices(idt.instance(), &sz, physical_devices.data()));
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_devices[0], &sz, nullptr);
+  auto properties = std::vector<VkQueueFamilyProperties>(sz);
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_devices[0], &sz, properties.data());
+  constexpr auto priorities = std::array<float, 2>{ 1.0f, 1.0f };
+  auto queue_infos = std::vector<VkDeviceQueueCreateInfo>{ };
+  for (auto i = std::uint32_t{ 0 }; i < sz && queue_infos.empty(); ++i)
+  {
+    if (properties[i].queueCount >= 2)
+    {
+      auto& info = queue_infos.emplace_back();
+      info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+      info.queueFamilyIndex = i;
+      info.queueCount = 2;
+      info.pQueuePriorities = priorities.data();
+      families = { i, i };
+    }
+  }
+  if (queue_infos.empty() && sz >= 2)
+  {
+    for (const auto family : { std::uint32_t{ 0 }, std::uint32_t{ 1 } })
+    {
+      auto& info = queue_infos.emplace_back();
+      info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+      info.queueFamilyIndex = family;
+      info.queueCount = 1;
+      info.pQueuePriorities = priorities.data();
+      families[family] = family;
+    }
+  }
+  if (queue_infos.empty())
+  {
+    return VK_NULL_HANDLE;
+  }
+  auto device_info = VkDeviceCreateInfo{ };
+  device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  device_info.queueCreateInfoCount = static_cast<std::uint32_t>(queue_infos.size());
+  device_info.pQueueCreateInfos = queue_infos.data();
+  auto device = VkDevice{ };
+  VK_CHECK(vkCreateDevice(physical_devices[0], &device_info, nullptr, &device));
+  return device;
+}
+
+TEST_CASE("Submission funnels should serialize concurrent submissions.", "[dispatch][funneling]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  DECLARE_DEVICE_PFN(ddt, vkGetDeviceQueue);
+  DECLARE_DEVICE_PFN(ddt, vkCreateFence);
+  DECLARE_DEVICE_PFN(ddt, vkWaitForFences);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyFence);
+  auto queue = VkQueue{ };
+  vkGetDeviceQueue(device, 0, 0, &queue);
+  auto fence_info = VkFenceCreateInfo{ };
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  for (const auto mode : { device::drain_mode::cooperative, device::drain_mode::dedicated })
+  {
+    constexpr auto threads = std::size_t{ 8 };
+    constexpr auto iterations = std::size_t{ 256 };
+    auto submissions = funnel{ ddt, mode };
+    auto submit_info = VkSubmitInfo{ };
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    REQUIRE_THROWS_AS(submissions.submit(queue, 1, &submit_info, VK_NULL_HANDLE), error);
+    submissions.add(queue);
+    REQUIRE(submissions.contains(queue));
+    auto completions = std::vector<std::vector<funnel::completion>>(threads);
+    auto workers = std::vector<std::thread>{ };
+    for (auto i = std::size_t{ 0 }; i < threads; ++i)
+    {
+      workers.emplace_back([&, i]() {
+        // Each submission is copied, so the structure can go out of scope before the driver call is made.
+        for (auto j = std::size_t{ 0 }; j < iterations; ++j)
+        {
+          auto local = VkSubmitInfo{ };
+          local.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+          completions[i].emplace_back(submissions.submit(queue, 1, &local, VK_NULL_HANDLE));
+        }
+      });
+    }
+    for (auto& worker : workers)
+    {
+      worker.join();
+    }
+    for (const auto& completed : completions)
+    {
+      for (const auto& completion : completed)
+      {
+        REQUIRE(completion.valid());
+        VK_CHECK(completion.wait());
+        REQUIRE(completion.ready());
+      }
+    }
+    REQUIRE(submissions.operations() == threads * iterations);
+    REQUIRE(submissions.submissions() >= 1);
+    REQUIRE(submissions.submissions() <= threads * iterations);
+    auto fence = VkFence{ };
+    VK_CHECK(vkCreateFence(device, &fence_info, nullptr, &fence));
+    auto fenced = submissions.submit(queue, 1, &submit_info, fence);
+    VK_CHECK(fenced.wait());
+    VK_CHECK(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+    auto executed = submissions.execute(queue, []() { return VK_SUCCESS; });
+    VK_CHECK(executed.wait());
+    submissions.finish();
+    VK_CHECK(submissions.failure());
+    vkDestroyFence(device, fence, nullptr);
+  }
+  REQUIRE(funnel::completion{ }.ready());
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Submission funneling policies should route queue operations through channels.", "[dispatch][funneling]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto submissions = funnel{ ddt, device::drain_mode::dedicated };
+    auto dit = device::intercepted_table<device::counting_policy, funnel::policy>{ ddt };
+    dit.policy<funnel::policy>().set_funnel(&submissions);
+    REQUIRE(dit.policy<funnel::policy>().funnel() == &submissions);
+    dit.intercept<device::command::vkQueueSubmit, PFN_vkQueueSubmit>();
+    dit.intercept<device::command::vkQueueWaitIdle, PFN_vkQueueWaitIdle>();
+    dit.intercept<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>();
+    DECLARE_DEVICE_PFN(dit, vkGetDeviceQueue);
+    DECLARE_DEVICE_PFN(dit, vkQueueSubmit);
+    DECLARE_DEVICE_PFN(dit, vkQueueWaitIdle);
+    DECLARE_DEVICE_PFN(dit, vkDeviceWaitIdle);
+    auto queue = VkQueue{ };
+    vkGetDeviceQueue(device, 0, 0, &queue);
+    auto submit_info = VkSubmitInfo{ };
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    // Queues that weren't added continue the chain directly.
+    VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    REQUIRE(submissions.operations() == 0);
+    submissions.add(queue);
+    for (auto i = 0; i < 5; ++i)
+    {
+      VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    }
+    VK_CHECK(vkQueueWaitIdle(queue));
+    REQUIRE(submissions.operations() == 6);
+    REQUIRE(submissions.submissions() >= 1);
+    REQUIRE(submissions.submissions() <= 5);
+    VK_CHECK(vkDeviceWaitIdle(device));
+    VK_CHECK(submissions.failure());
+    const auto& counters = dit.policy<device::counting_policy>().counters();
+    REQUIRE(counters.count(device::command::vkQueueSubmit) == 6);
+    REQUIRE(counters.count(device::command::vkQueueWaitIdle) == 1);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Submission funnels should submit semaphore signals before waits on other queues.", "[dispatch][funneling]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto families = std::array<std::uint32_t, 2>{ };
+  auto device = create_two_queue_device(idt, families);
+  if (!device)
+  {
+    WARN("The device doesn't have two queues.");
+    DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+    vkDestroyInstance(instance, nullptr);
+    return;
+  }
+  auto ddt = device::table{ gdt, idt, device };
+  DECLARE_DEVICE_PFN(ddt, vkGetDeviceQueue);
+  DECLARE_DEVICE_PFN(ddt, vkCreateSemaphore);
+  DECLARE_DEVICE_PFN(ddt, vkDestroySemaphore);
+  DECLARE_DEVICE_PFN(ddt, vkDeviceWaitIdle);
+  auto queues = std::array<VkQueue, 2>{ };
+  vkGetDeviceQueue(device, families[0], 0, &queues[0]);
+  vkGetDeviceQueue(device, families[1], families[0] == families[1], &queues[1]);
+  REQUIRE(queues[0] != queues[1]);
+  auto semaphore_info = VkSemaphoreCreateInfo{ };
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  auto semaphore = VkSemaphore{ };
+  VK_CHECK(vkCreateSemaphore(device, &semaphore_info, nullptr, &semaphore));
+  const auto stage = VkPipelineStageFlags{ VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+  for (const auto mode : { device::drain_mode::cooperative, device::drain_mode::dedicated })
+  {
+    auto submissions = funnel{ ddt, mode };
+    submissions.add(queues[0]);
+    submissions.add(queues[1]);
+    // Hold the first queue's consumer, so that its signal stays in the channel.
+    auto entered = std::atomic<bool>{ };
+    auto held = std::atomic<bool>{ true };
+    auto holder = std::thread{ [&]() {
+      submissions.execute(queues[0], [&]() {
+        entered.store(true);
+        while (held.load())
+        {
+          std::this_thread::yield();
+        }
+        return VK_SUCCESS;
+      }).wait();
+    } };
+    while (!entered.load())
+    {
+      std::this_thread::yield();
+    }
+    auto signal_info = VkSubmitInfo{ };
+    signal_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    signal_info.signalSemaphoreCount = 1;
+    signal_info.pSignalSemaphores = &semaphore;
+    const auto signaled = submissions.submit(queues[0], 1, &signal_info, VK_NULL_HANDLE);
+    REQUIRE_FALSE(signaled.ready());
+    // Submissions that don't wait on the semaphore aren't held back.
+    auto empty_info = VkSubmitInfo{ };
+    empty_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    VK_CHECK(submissions.submit(queues[1], 1, &empty_info, VK_NULL_HANDLE).wait());
+    auto wait_info = VkSubmitInfo{ };
+    wait_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    wait_info.waitSemaphoreCount = 1;
+    wait_info.pWaitSemaphores = &semaphore;
+    wait_info.pWaitDstStageMask = &stage;
+    auto returned = std::atomic<bool>{ };
+    auto waiter = std::thread{ [&]() {
+      submissions.submit(queues[1], 1, &wait_info, VK_NULL_HANDLE).wait();
+      returned.store(true);
+    } };
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+    REQUIRE_FALSE(returned.load());
+    REQUIRE_FALSE(signaled.ready());
+    held.store(false);
+    holder.join();
+    waiter.join();
+    REQUIRE(signaled.ready());
+    REQUIRE(returned.load());
+    submissions.finish();
+    VK_CHECK(submissions.failure());
+    VK_CHECK(vkDeviceWaitIdle(device));
+  }
+  vkDestroySemaphore(device, semaphore, nullptr);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
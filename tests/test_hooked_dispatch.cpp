@@ -0,0 +1,81 @@
+#include <cinttypes>
+
+#include <vector>
+
+#include "common.hpp"
+
+TEST_CASE("Hooked instance tables should invoke hooks around hooked commands.", "[dispatch][hooks]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  {
+    auto iht = instance::hooked_table{ idt };
+    REQUIRE(iht.instance() == instance);
+    REQUIRE(!iht.hooked(instance::command::vkEnumeratePhysicalDevices));
+    REQUIRE(*reinterpret_cast<const PFN_vkVoidFunction*>(iht(instance::command::vkEnumeratePhysicalDevices)) ==
+            *reinterpret_cast<const PFN_vkVoidFunction*>(idt(instance::command::vkEnumeratePhysicalDevices)));
+    auto order = std::vector<int>{ };
+    auto results = std::vector<VkResult>{ };
+    iht.add_pre_hook<instance::command::vkEnumeratePhysicalDevices, PFN_vkEnumeratePhysicalDevices>(
+      [&](VkInstance current, std::uint32_t*, VkPhysicalDevice*) {
+        REQUIRE(current == instance);
+        order.emplace_back(0);
+      }
+    );
+    iht.add_pre_hook<instance::command::vkEnumeratePhysicalDevices, PFN_vkEnumeratePhysicalDevices>(
+      [&](VkInstance, std::uint32_t*, VkPhysicalDevice*) { order.emplace_back(1); }
+    );
+    iht.add_post_hook<instance::command::vkEnumeratePhysicalDevices, PFN_vkEnumeratePhysicalDevices>(
+      [&](VkResult result, VkInstance, std::uint32_t* count, VkPhysicalDevice*) {
+        REQUIRE(*count > 0);
+        results.emplace_back(result);
+        order.emplace_back(2);
+      }
+    );
+    REQUIRE(iht.hooked(instance::command::vkEnumeratePhysicalDevices));
+    REQUIRE(!iht.hooked(instance::command::vkDestroyInstance));
+    DECLARE_INSTANCE_PFN(iht, vkEnumeratePhysicalDevices);
+    auto sz = std::uint32_t{ 0 };
+    VK_CHECK(vkEnumeratePhysicalDevices(instance, &sz, nullptr));
+    REQUIRE(order == std::vector<int>{ 0, 1, 2 });
+    REQUIRE(results == std::vector<VkResult>{ VK_SUCCESS });
+    REQUIRE_THROWS_AS((iht.add_pre_hook<instance::command::vkEnumeratePhysicalDevices, PFN_vkDestroyInstance>(
+                        [](VkInstance, const VkAllocationCallbacks*) { })), error);
+    iht.clear_hooks<instance::command::vkEnumeratePhysicalDevices>();
+    REQUIRE(!iht.hooked(instance::command::vkEnumeratePhysicalDevices));
+    REQUIRE(*reinterpret_cast<const PFN_vkVoidFunction*>(iht(instance::command::vkEnumeratePhysicalDevices)) ==
+            *reinterpret_cast<const PFN_vkVoidFunction*>(idt(instance::command::vkEnumeratePhysicalDevices)));
+  }
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Hooked device tables should invoke hooks for commands without results.", "[dispatch][hooks]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto dht = device::hooked_table{ ddt };
+    REQUIRE(dht.device() == device);
+    auto queues = std::vector<VkQueue>{ };
+    dht.add_post_hook<device::command::vkGetDeviceQueue, PFN_vkGetDeviceQueue>(
+      [&](VkDevice, std::uint32_t, std::uint32_t, VkQueue* queue) { queues.emplace_back(*queue); }
+    );
+    DECLARE_DEVICE_PFN(dht, vkGetDeviceQueue);
+    auto queue = VkQueue{ };
+    vkGetDeviceQueue(device, 0, 0, &queue);
+    REQUIRE(queues == std::vector<VkQueue>{ queue });
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+TEST_CASE("Instrumented instance tables should count calls to instrumented commands.", "[dispatch][instrumentation]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto iit = instance::instrumented_table{ idt };
+  REQUIRE(iit.instance() == instance);
+  REQUIRE_FALSE(iit.instrumented(instance::command::vkEnumeratePhysicalDevices));
+  iit.instrument<instance::command::vkEnumeratePhysicalDevices, PFN_vkEnumeratePhysicalDevices>();
+  REQUIRE(iit.instrumented(instance::command::vkEnumeratePhysicalDevices));
+  DECLARE_INSTANCE_PFN(iit, vkEnumeratePhysicalDevices);
+  auto sz = std::uint32_t{ };
+  for (auto i = 0; i < 10; ++i)
+  {
+    VK_CHECK(vkEnumeratePhysicalDevices(instance, &sz, nullptr));
+  }
+  REQUIRE(sz > 0);
+  REQUIRE(iit.counters().count(instance::command::vkEnumeratePhysicalDevices) == 10);
+  REQUIRE(iit.counters().snapshot()[static_cast<std::size_t>(instance::command::vkDestroyInstance)] == 0);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Instrumented device tables should aggregate counts across threads.", "[dispatch][instrumentation]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  auto dit = device::instrumented_table{ ddt };
+  REQUIRE(dit.device() == device);
+  dit.instrument<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>();
+  DECLARE_DEVICE_PFN(dit, vkDeviceWaitIdle);
+  auto threads = std::vector<std::thread>{ };
+  for (auto i = 0; i < 4; ++i)
+  {
+    threads.emplace_back([&]() {
+      for (auto j = 0; j < 1000; ++j)
+      {
+        vkDeviceWaitIdle(device);
+      }
+    });
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+  REQUIRE(dit.counters().count(device::command::vkDeviceWaitIdle) == 4000);
+  dit.counters().reset();
+  REQUIRE(dit.counters().count(device::command::vkDeviceWaitIdle) == 0);
+  VK_CHECK(vkDeviceWaitIdle(device));
+  REQUIRE(dit.counters().snapshot()[static_cast<std::size_t>(device::command::vkDeviceWaitIdle)] == 1);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Instrumented tables should leave uninstrumented commands untouched.", "[dispatch][instrumentation]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  auto dit = device::instrumented_table{ ddt };
+  REQUIRE(GET_DEVICE_PFN(dit, vkDeviceWaitIdle) == GET_DEVICE_PFN(ddt, vkDeviceWaitIdle));
+  dit.instrument<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>();
+  REQUIRE(GET_DEVICE_PFN(dit, vkDeviceWaitIdle) != GET_DEVICE_PFN(ddt, vkDeviceWaitIdle));
+  REQUIRE(GET_DEVICE_PFN(dit, vkDestroyDevice) == GET_DEVICE_PFN(ddt, vkDestroyDevice));
+  DECLARE_PFN_BY_HASH(dit, vkDeviceWaitIdle);
+  REQUIRE(vkDeviceWaitIdle == GET_DEVICE_PFN(dit, vkDeviceWaitIdle));
+  dit.restore<device::command::vkDeviceWaitIdle>();
+  REQUIRE(GET_DEVICE_PFN(dit, vkDeviceWaitIdle) == GET_DEVICE_PFN(ddt, vkDeviceWaitIdle));
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Instrumented table construction should fail when no slots remain.", "[dispatch][instrumentation]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  {
+    auto tables = std::vector<std::unique_ptr<instance::instrumented_table>>{ };
+    for (auto i = 0; i < MEGATECH_VULKAN_DISPATCH_INSTRUMENTATION_SLOTS; ++i)
+    {
+      tables.emplace_back(std::make_unique<instance::instrumented_table>(idt));
+    }
+    REQUIRE_THROWS_AS((instance::instrumented_table{ idt }), error);
+  }
+  REQUIRE_NOTHROW((instance::instrumented_table{ idt }));
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Instrumented tables should record calls into an attached tracer.", "[dispatch][instrumentation]") {
+  using namespace megatech::vulkan::dispatch;
+  const auto path = std::filesystem::temp_directory_path() / "megatech-vulkan-dispatch-trace.json";
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto tracer = call_tracer{ path, 4 };
+    auto dit = device::instrumented_table{ ddt };
+    dit.instrument<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>();
+    DECLARE_DEVICE_PFN(dit, vkDeviceWaitIdle);
+    VK_CHECK(vkDeviceWaitIdle(device));
+    REQUIRE(dit.tracer() == nullptr);
+    dit.set_tracer(&tracer);
+    REQUIRE(dit.tracer() == &tracer);
+    for (auto i = 0; i < 6; ++i)
+    {
+      VK_CHECK(vkDeviceWaitIdle(device));
+    }
+    REQUIRE(tracer.dropped() == 2);
+    REQUIRE(tracer.drain() == 4);
+    VK_CHECK(vkDeviceWaitIdle(device));
+    dit.set_tracer(nullptr);
+    VK_CHECK(vkDeviceWaitIdle(device));
+    REQUIRE(dit.counters().count(device::command::vkDeviceWaitIdle) == 9);
+  }
+  auto stream = std::ifstream{ path };
+  auto buffer = std::stringstream{ };
+  buffer << stream.rdbuf();
+  const auto trace = buffer.str();
+  auto events = std::size_t{ 0 };
+  for (auto pos = trace.find("\"vkDeviceWaitIdle\""); pos != std::string::npos;
+       pos = trace.find("\"vkDeviceWaitIdle\"", pos + 1))
+  {
+    ++events;
+  }
+  REQUIRE(events == 5);
+  REQUIRE(trace.front() == '[');
+  REQUIRE(trace.find(']') != std::string::npos);
+  std::filesystem::remove(path);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Latency histogram buckets should cover every value with bounded error.", "[dispatch][instrumentation]") {
+  using megatech::vulkan::dispatch::latency_histogram;
+  for (auto value = std::uint64_t{ 0 }; value < 4096; ++value)
+  {
+    const auto index = latency_histogram::bucket(value);
+    REQUIRE(latency_histogram::lower_bound(index) <= value);
+    REQUIRE(value < latency_histogram::lower_bound(index) + latency_histogram::width(index));
+    REQUIRE(latency_histogram::width(index) * 8 <= std::max(value, std::uint64_t{ 8 }));
+  }
+  REQUIRE(latency_histogram::bucket(~std::uint64_t{ 0 }) == latency_histogram::bucket_count - 1);
+}
+
+TEST_CASE("Instrumented tables should record latencies into attached histograms.", "[dispatch][instrumentation]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto histograms = device::latency_histograms{ };
+    auto dit = device::instrumented_table{ ddt };
+    dit.instrument<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>();
+    DECLARE_DEVICE_PFN(dit, vkDeviceWaitIdle);
+    VK_CHECK(vkDeviceWaitIdle(device));
+    REQUIRE(dit.histograms() == nullptr);
+    dit.set_histograms(&histograms);
+    REQUIRE(dit.histograms() == &histograms);
+    auto threads = std::vector<std::thread>{ };
+    for (auto i = 0; i < 4; ++i)
+    {
+      threads.emplace_back([&]() {
+        for (auto j = 0; j < 250; ++j)
+        {
+          vkDeviceWaitIdle(device);
+        }
+      });
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+    auto histogram = histograms.snapshot(device::command::vkDeviceWaitIdle);
+    REQUIRE(histogram.count() == 1000);
+    REQUIRE(histogram.percentile(0) <= histogram.percentile(50));
+    REQUIRE(histogram.percentile(50) <= histogram.percentile(99));
+    REQUIRE(histogram.percentile(100) <= histogram.max());
+    REQUIRE(histogram.mean() <= histogram.max());
+    REQUIRE(histograms.snapshot(device::command::vkQueueWaitIdle).count() == 0);
+    histograms.reset();
+    REQUIRE(histograms.snapshot(device::command::vkDeviceWaitIdle).count() == 0);
+    VK_CHECK(vkDeviceWaitIdle(device));
+    REQUIRE(histograms.snapshot(device::command::vkDeviceWaitIdle).count() == 1);
+    dit.set_histograms(nullptr);
+    VK_CHECK(vkDeviceWaitIdle(device));
+    REQUIRE(histograms.snapshot(device::command::vkDeviceWaitIdle).count() == 1);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Instrumented tables should attribute calls to call sites with an attached profiler.",
+          "[dispatch][instrumentation]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto profiler = call_site_profiler{ };
+    auto dit = device::instrumented_table{ ddt };
+    dit.instrument<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>();
+    REQUIRE(dit.profiler() == nullptr);
+    dit.set_profiler(&profiler);
+    REQUIRE(dit.profiler() == &profiler);
+    DECLARE_DEVICE_PFN(dit, vkDeviceWaitIdle);
+    for (auto i = 0; i < 3; ++i)
+    {
+      VK_CHECK(vkDeviceWaitIdle(device));
+    }
+    VK_CHECK(vkDeviceWaitIdle(device));
+    const auto sites = profiler.report();
+    REQUIRE(sites.size() == 2);
+    auto calls = std::uint64_t{ 0 };
+    for (const auto& site : sites)
+    {
+      REQUIRE(site.level == 2);
+      REQUIRE(site.name == "vkDeviceWaitIdle");
+      REQUIRE(site.address != nullptr);
+      REQUIRE(!site.symbol.empty());
+      calls += site.calls;
+    }
+    REQUIRE(calls == 4);
+    REQUIRE(sites.front().nanoseconds >= sites.back().nanoseconds);
+    REQUIRE(profiler.dropped() == 0);
+    profiler.reset();
+    REQUIRE(profiler.report().empty());
+    dit.set_profiler(nullptr);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+#include "common.hpp"
+
+namespace {
+
+  class recording_policy final {
+  public:
+    std::vector<int>* order{ };
+    int id{ };
+
+    template <auto Cmd, typename Next, typename... Arguments>
+    decltype(auto) invoke(const Next& next, Arguments... arguments) {
+      order->emplace_back(id);
+      return next(arguments...);
+    }
+  };
+
+  class outer_policy final {
+  public:
+    recording_policy inner{ };
+
+    template <auto Cmd, typename Next, typename... Arguments>
+    decltype(auto) invoke(const Next& next, Arguments... arguments) {
+      return inner.invoke<Cmd>(next, arguments...);
+    }
+  };
+
+  class skipping_policy final {
+  public:
+    bool skip{ };
+
+    template <auto Cmd, typename Next, typename... Arguments>
+    decltype(auto) invoke(const Next& next, Arguments... arguments) {
+      using megatech::vulkan::dispatch::device::command;
+      if constexpr (Cmd == command::vkDeviceWaitIdle)
+      {
+        if (skip)
+        {
+          return VK_SUCCESS;
+        }
+      }
+      return next(arguments...);
+    }
+  };
+
+}
+
+TEST_CASE("Intercepted tables without policies should be identical to their base table.", "[dispatch][interception]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  {
+    auto iit = instance::intercepted_table<>{ idt };
+    REQUIRE(iit.instance() == instance);
+    iit.intercept<instance::command::vkEnumeratePhysicalDevices, PFN_vkEnumeratePhysicalDevices>();
+    REQUIRE(!iit.intercepted(instance::command::vkEnumeratePhysicalDevices));
+    for (auto i = std::size_t{ 0 }; i < iit.size(); ++i)
+    {
+      const auto cmd = static_cast<instance::command>(i);
+      REQUIRE(*reinterpret_cast<const PFN_vkVoidFunction*>(iit(cmd)) ==
+              *reinterpret_cast<const PFN_vkVoidFunction*>(idt(cmd)));
+    }
+    auto sz = std::uint32_t{ 0 };
+    VK_CHECK((iit.call<instance::command::vkEnumeratePhysicalDevices, PFN_vkEnumeratePhysicalDevices>(instance, &sz,
+                                                                                                      nullptr)));
+    REQUIRE(sz > 0);
+  }
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Intercepted tables should apply policies in order.", "[dispatch][interception]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto order = std::vector<int>{ };
+    auto dit = device::intercepted_table<outer_policy, device::counting_policy, recording_policy, skipping_policy>{ ddt };
+    REQUIRE(dit.device() == device);
+    dit.policy<outer_policy>().inner = recording_policy{ &order, 0 };
+    dit.policy<recording_policy>() = recording_policy{ &order, 1 };
+    VK_CHECK((dit.call<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>(device)));
+    REQUIRE(order == std::vector<int>{ 0, 1 });
+    REQUIRE(!dit.intercepted(device::command::vkDeviceWaitIdle));
+    dit.intercept<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>();
+    REQUIRE(dit.intercepted(device::command::vkDeviceWaitIdle));
+    DECLARE_DEVICE_PFN(dit, vkDeviceWaitIdle);
+    VK_CHECK(vkDeviceWaitIdle(device));
+    REQUIRE(order == std::vector<int>{ 0, 1, 0, 1 });
+    dit.policy<skipping_policy>().skip = true;
+    VK_CHECK(vkDeviceWaitIdle(device));
+    REQUIRE(order == std::vector<int>{ 0, 1, 0, 1, 0, 1 });
+    const auto& counters = dit.policy<device::counting_policy>().counters();
+    REQUIRE(counters.count(device::command::vkDeviceWaitIdle) == 3);
+    auto queue = VkQueue{ };
+    dit.call<device::command::vkGetDeviceQueue, PFN_vkGetDeviceQueue>(device, 0, 0, &queue);
+    REQUIRE(counters.count(device::command::vkGetDeviceQueue) == 1);
+    dit.restore<device::command::vkDeviceWaitIdle>();
+    REQUIRE(!dit.intercepted(device::command::vkDeviceWaitIdle));
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Intercepted tables should support tracing and timing policies.", "[dispatch][interception]") {
+  using namespace megatech::vulkan::dispatch;
+  const auto path = std::filesystem::temp_directory_path() / "megatech-vulkan-dispatch-intercepted-trace.json";
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto tracer = call_tracer{ path };
+    auto histograms = device::latency_histograms{ };
+    auto dit = device::intercepted_table<tracing_policy, device::timing_policy>{ ddt };
+    VK_CHECK((dit.call<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>(device)));
+    dit.policy<tracing_policy>().set_tracer(&tracer);
+    dit.policy<device::timing_policy>().set_histograms(&histograms);
+    for (auto i = 0; i < 3; ++i)
+    {
+      VK_CHECK((dit.call<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>(device)));
+    }
+    REQUIRE(tracer.drain() == 3);
+    REQUIRE(histograms.snapshot(device::command::vkDeviceWaitIdle).count() == 3);
+  }
+  std::filesystem::remove(path);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Intercepted tables should attribute calls to call sites with a call site policy.",
+          "[dispatch][interception]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto profiler = call_site_profiler{ };
+    auto dit = device::intercepted_table<call_site_policy>{ ddt };
+    dit.policy<call_site_policy>().set_profiler(&profiler);
+    dit.intercept<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>();
+    DECLARE_DEVICE_PFN(dit, vkDeviceWaitIdle);
+    // Sites are captured by the thunk, so they stay distinct regardless of how the chain is inlined.
+    for (auto i = 0; i < 3; ++i)
+    {
+      VK_CHECK(vkDeviceWaitIdle(device));
+    }
+    VK_CHECK(vkDeviceWaitIdle(device));
+    auto sites = profiler.report();
+    REQUIRE(sites.size() == 2);
+    auto calls = std::vector<std::uint64_t>{ };
+    for (const auto& site : sites)
+    {
+      REQUIRE(site.level == 2);
+      REQUIRE(site.name == "vkDeviceWaitIdle");
+      REQUIRE(site.address != nullptr);
+      calls.push_back(site.calls);
+    }
+    std::sort(calls.begin(), calls.end());
+    REQUIRE(calls == std::vector<std::uint64_t>{ 1, 3 });
+    // Calls through call() are attributed to the calling code as well. When call() is inlined, that's the caller of
+    // the enclosing function, so the number of distinct sites depends on the optimization level.
+    profiler.reset();
+    VK_CHECK((dit.call<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>(device)));
+    VK_CHECK((dit.call<device::command::vkDeviceWaitIdle, PFN_vkDeviceWaitIdle>(device)));
+    sites = profiler.report();
+    REQUIRE(!sites.empty());
+    auto total = std::uint64_t{ 0 };
+    for (const auto& site : sites)
+    {
+      REQUIRE(site.address != nullptr);
+      total += site.calls;
+    }
+    REQUIRE(total == 2);
+    dit.policy<call_site_policy>().set_profiler(nullptr);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
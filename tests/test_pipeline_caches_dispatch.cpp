@@ -0,0 +1,154 @@
+#include <cinttypes>
+#include <cstring>
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+using manager = megatech::vulkan::dispatch::device::pipeline_cache_manager<PFN_vkCreatePipelineCache>;
+
+static VkPhysicalDeviceProperties physical_device_properties(const megatech::vulkan::dispatch::instance::table& idt) {
+  DECLARE_INSTANCE_PFN(idt, vkEnumeratePhysicalDevices);
+  DECLARE_INSTANCE_PFN(idt, vkGetPhysicalDeviceProperties);
+  auto sz = std::uint32_t{ 0 };
+  VK_CHECK(vkEnumeratePhysicalDevices(idt.instance(), &sz, nullptr));
+  auto physical_devices = std::vector<VkPhysicalDevice>(sz);
+  VK_CHECK(vkEnumeratePhysicalDevices(idt.instance(), &sz, physical_devices.data()));
+  auto properties = VkPhysicalDeviceProperties{ };
+  vkGetPhysicalDeviceProperties(physical_devices[0], &properties);
+  return properties;
+}
+
+static std::size_t count_files(const std::filesystem::path& directory) {
+  auto result = std::size_t{ 0 };
+  for (const auto& entry : std::filesystem::directory_iterator{ directory })
+  {
+    result += entry.is_regular_file();
+  }
+  return result;
+}
+
+TEST_CASE("Pipeline cache files should only load data from the same driver.", "[dispatch][pipeline_caches]") {
+  using namespace megatech::vulkan::dispatch;
+  const auto directory = std::filesystem::temp_directory_path() / "megatech-vulkan-dispatch-pipeline-cache-files";
+  std::filesystem::remove_all(directory);
+  auto uuid = std::array<std::uint8_t, 16>{ };
+  for (auto i = std::size_t{ 0 }; i < uuid.size(); ++i)
+  {
+    uuid[i] = static_cast<std::uint8_t>(i);
+  }
+  {
+    auto file = pipeline_cache_file{ directory, 0x10de, 0x1234, uuid };
+    REQUIRE(file.path().parent_path() == directory);
+    // Missing files are empty.
+    REQUIRE(file.read().empty());
+    // The header is VkPipelineCacheHeaderVersionOne, followed by opaque data.
+    auto data = std::vector<std::byte>(40, std::byte{ 0x5a });
+    const auto header = std::array<std::uint32_t, 4>{ 32, 1, 0x10de, 0x1234 };
+    std::memcpy(data.data(), header.data(), sizeof(header));
+    std::memcpy(data.data() + sizeof(header), uuid.data(), uuid.size());
+    file.write(data);
+    const auto read = file.read();
+    REQUIRE(std::vector<std::byte>(read.begin(), read.end()) == data);
+    // Replacing a file doesn't invalidate data that was already read, and doesn't leave temporary files behind.
+    auto concurrent = pipeline_cache_file{ directory, 0x10de, 0x1234, uuid };
+    const auto before = concurrent.read();
+    file.write(std::vector<std::byte>(8));
+    REQUIRE(std::vector<std::byte>(before.begin(), before.end()) == data);
+    REQUIRE(count_files(directory) == 1);
+    // Truncated files and files from other drivers are empty.
+    REQUIRE(file.read().empty());
+    auto other_uuid = uuid;
+    other_uuid[15] = 0xff;
+    auto other = pipeline_cache_file{ directory, 0x10de, 0x1234, other_uuid };
+    REQUIRE(other.path() != file.path());
+    file.write(data);
+    std::filesystem::copy_file(file.path(), other.path());
+    REQUIRE(other.read().empty());
+    auto other_device = pipeline_cache_file{ directory, 0x10de, 0x4321, uuid };
+    REQUIRE(other_device.path() != file.path());
+    std::filesystem::copy_file(file.path(), other_device.path());
+    REQUIRE(other_device.read().empty());
+  }
+  std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Pipeline cache managers should persist merged per-thread caches.", "[dispatch][pipeline_caches]") {
+  using namespace megatech::vulkan::dispatch;
+  const auto directory = std::filesystem::temp_directory_path() / "megatech-vulkan-dispatch-pipeline-caches";
+  std::filesystem::remove_all(directory);
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  const auto properties = physical_device_properties(idt);
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto caches = manager{ ddt, properties, directory, std::chrono::milliseconds{ 0 } };
+    REQUIRE(caches.path().parent_path() == directory);
+    const auto local = caches.local();
+    REQUIRE(local != VkPipelineCache{ });
+    REQUIRE(caches.local() == local);
+    auto elsewhere = VkPipelineCache{ };
+    auto worker = std::thread{ [&]() { elsewhere = caches.local(); } };
+    worker.join();
+    REQUIRE(elsewhere != VkPipelineCache{ });
+    REQUIRE(elsewhere != local);
+    // Only caches that were retrieved since the last merge are merged.
+    caches.merge();
+    REQUIRE(caches.merged() == 2);
+    caches.merge();
+    REQUIRE(caches.merged() == 2);
+    caches.local();
+    caches.merge();
+    REQUIRE(caches.merged() == 3);
+    // Exited threads' caches are adopted rather than recreated.
+    auto adopted = VkPipelineCache{ };
+    worker = std::thread{ [&]() { adopted = caches.local(); } };
+    worker.join();
+    REQUIRE(adopted == elsewhere);
+    // Saving merges every cache.
+    caches.save();
+    REQUIRE(caches.merged() == 5);
+    REQUIRE(std::filesystem::exists(caches.path()));
+    REQUIRE(count_files(directory) == 1);
+  }
+  {
+    // A saved cache is readable by the same driver.
+    auto file = pipeline_cache_file{ directory, properties.vendorID, properties.deviceID,
+                                     properties.pipelineCacheUUID };
+    REQUIRE_FALSE(file.read().empty());
+  }
+  {
+    // Managers tolerate corrupt files, and merge in the background.
+    {
+      const auto path = pipeline_cache_file{ directory, properties.vendorID, properties.deviceID,
+                                             properties.pipelineCacheUUID }.path();
+      auto output = std::ofstream{ path, std::ios::out | std::ios::trunc | std::ios::binary };
+      output << "corrupt";
+    }
+    auto caches = manager{ ddt, properties, directory, std::chrono::milliseconds{ 1 } };
+    caches.local();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 10 };
+    while (!caches.merged() && std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+    }
+    REQUIRE(caches.merged() == 1);
+  }
+  REQUIRE(count_files(directory) == 1);
+  std::filesystem::remove_all(directory);
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
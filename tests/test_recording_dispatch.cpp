@@ -0,0 +1,306 @@
+#include <cinttypes>
+
+#include <array>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+struct recorded_calls final {
+  std::vector<std::uint32_t> firsts{ };
+  std::vector<VkViewport> viewports{ };
+  std::vector<float> widths{ };
+  std::vector<float> constants{ };
+  std::vector<VkImageMemoryBarrier2> barriers{ };
+  std::vector<float> clears{ };
+  std::vector<std::uint32_t> draws{ };
+  std::vector<std::int32_t> offsets{ };
+  std::vector<VkSampleMask> masks{ };
+};
+
+static thread_local recorded_calls* t_calls{ };
+
+static VKAPI_ATTR void VKAPI_CALL record_viewports(VkCommandBuffer, std::uint32_t first, std::uint32_t count,
+                                                   const VkViewport* viewports) {
+  t_calls->firsts.push_back(first);
+  t_calls->viewports.insert(t_calls->viewports.end(), viewports, viewports + count);
+}
+
+static VKAPI_ATTR void VKAPI_CALL record_width(VkCommandBuffer, float width) {
+  t_calls->widths.push_back(width);
+}
+
+static VKAPI_ATTR void VKAPI_CALL record_constants(VkCommandBuffer, const float constants[4]) {
+  t_calls->constants.insert(t_calls->constants.end(), constants, constants + 4);
+}
+
+static VKAPI_ATTR void VKAPI_CALL record_barrier(VkCommandBuffer, const VkDependencyInfo* info) {
+  t_calls->barriers.insert(t_calls->barriers.end(), info->pImageMemoryBarriers,
+                           info->pImageMemoryBarriers + info->imageMemoryBarrierCount);
+}
+
+static VKAPI_ATTR void VKAPI_CALL record_render_pass(VkCommandBuffer, const VkRenderPassBeginInfo* info,
+                                                     VkSubpassContents) {
+  for (auto i = std::uint32_t{ 0 }; i < info->clearValueCount; ++i)
+  {
+    t_calls->clears.push_back(info->pClearValues[i].color.float32[0]);
+  }
+}
+
+static VKAPI_ATTR void VKAPI_CALL record_draws(VkCommandBuffer, std::uint32_t count,
+                                               const VkMultiDrawIndexedInfoEXT* infos, std::uint32_t, std::uint32_t,
+                                               std::uint32_t stride, const std::int32_t* offset) {
+  for (auto i = std::uint32_t{ 0 }; i < count; ++i)
+  {
+    const auto current = reinterpret_cast<const VkMultiDrawIndexedInfoEXT*>(reinterpret_cast<const char*>(infos) +
+                                                                             i * stride);
+    t_calls->draws.push_back(current->indexCount);
+  }
+  t_calls->offsets.push_back(*offset);
+}
+
+static VKAPI_ATTR void VKAPI_CALL record_mask(VkCommandBuffer, VkSampleCountFlagBits samples,
+                                              const VkSampleMask* mask) {
+  t_calls->masks.insert(t_calls->masks.end(), mask, mask + (samples + 31) / 32);
+}
+
+// A minimal table that captures replayed calls.
+struct checking_table final {
+  PFN_vkCmdSetViewport set_viewport{ &record_viewports };
+  PFN_vkCmdSetLineWidth set_line_width{ &record_width };
+  PFN_vkCmdSetBlendConstants set_blend_constants{ &record_constants };
+  PFN_vkCmdPipelineBarrier2 pipeline_barrier{ &record_barrier };
+  PFN_vkCmdBeginRenderPass begin_render_pass{ &record_render_pass };
+  PFN_vkCmdDrawMultiIndexedEXT draw_multi{ &record_draws };
+  PFN_vkCmdSetSampleMaskEXT set_sample_mask{ &record_mask };
+
+  const void* get(const megatech::vulkan::dispatch::device::command cmd) const {
+    using megatech::vulkan::dispatch::device::command;
+    switch (cmd)
+    {
+    case command::vkCmdSetViewport:
+      return &set_viewport;
+    case command::vkCmdSetLineWidth:
+      return &set_line_width;
+    case command::vkCmdSetBlendConstants:
+      return &set_blend_constants;
+    case command::vkCmdPipelineBarrier2:
+      return &pipeline_barrier;
+    case command::vkCmdBeginRenderPass:
+      return &begin_render_pass;
+    case command::vkCmdDrawMultiIndexedEXT:
+      return &draw_multi;
+    case command::vkCmdSetSampleMaskEXT:
+      return &set_sample_mask;
+    default:
+      return nullptr;
+    }
+  }
+};
+
+static VkViewport viewport(const float width) {
+  auto result = VkViewport{ };
+  result.width = width;
+  result.height = width;
+  result.maxDepth = 1.0f;
+  return result;
+}
+
+TEST_CASE("Command streams should replay recorded calls by value.", "[dispatch][recording]") {
+  using namespace megatech::vulkan::dispatch;
+  REQUIRE_THROWS_AS(device::command_stream{ 0 }, error);
+  auto dt = device::deferred_table{ };
+  REQUIRE_FALSE(dt.deferred(device::command::vkCmdSetViewport));
+  dt.defer<device::command::vkCmdSetViewport, PFN_vkCmdSetViewport>();
+  dt.defer<device::command::vkCmdSetLineWidth, PFN_vkCmdSetLineWidth>();
+  dt.defer<device::command::vkCmdSetBlendConstants, PFN_vkCmdSetBlendConstants>();
+  REQUIRE(dt.deferred(device::command::vkCmdSetViewport));
+  REQUIRE(dt.get(megatech::vulkan::dispatch::internal::base::fnv_1a_cstr("vkCmdSetViewport")) ==
+          dt.get(device::command::vkCmdSetViewport));
+  DECLARE_DEVICE_PFN(dt, vkCmdSetViewport);
+  DECLARE_DEVICE_PFN(dt, vkCmdSetLineWidth);
+  DECLARE_DEVICE_PFN(dt, vkCmdSetBlendConstants);
+  // Small chunks force calls to span several chunks, and some calls to be allocated separately.
+  auto stream = device::command_stream{ 64 };
+  const auto command_buffer = stream.command_buffer<VkCommandBuffer>();
+  {
+    // Arguments are copied, so the caller's memory can be reused immediately.
+    auto viewports = std::array<VkViewport, 4>{ viewport(1.0f), viewport(2.0f), viewport(3.0f), viewport(4.0f) };
+    vkCmdSetViewport(command_buffer, 0, 4, viewports.data());
+    viewports.fill(viewport(0.0f));
+    auto constants = std::array<float, 4>{ 0.0f, 0.25f, 0.5f, 1.0f };
+    vkCmdSetBlendConstants(command_buffer, constants.data());
+    constants.fill(2.0f);
+    for (auto i = 0; i < 8; ++i)
+    {
+      vkCmdSetLineWidth(command_buffer, static_cast<float>(i));
+    }
+  }
+  REQUIRE(stream.size() == 10);
+  const auto replay = [&]() {
+    auto calls = recorded_calls{ };
+    t_calls = &calls;
+    stream.replay(checking_table{ }, VkCommandBuffer{ });
+    return calls;
+  };
+  const auto check = [](const recorded_calls& calls) {
+    REQUIRE(calls.firsts == std::vector<std::uint32_t>{ 0 });
+    REQUIRE(calls.viewports.size() == 4);
+    for (auto i = std::size_t{ 0 }; i < calls.viewports.size(); ++i)
+    {
+      REQUIRE(calls.viewports[i].width == static_cast<float>(i + 1));
+    }
+    REQUIRE(calls.constants == std::vector<float>{ 0.0f, 0.25f, 0.5f, 1.0f });
+    REQUIRE(calls.widths == std::vector<float>{ 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f });
+  };
+  // Streams can be replayed more than once and on other threads.
+  check(replay());
+  check(replay());
+  auto elsewhere = recorded_calls{ };
+  auto worker = std::thread{ [&]() { elsewhere = replay(); } };
+  worker.join();
+  check(elsewhere);
+  // Replaying into another stream reproduces the original.
+  auto copy = device::command_stream{ };
+  stream.replay(dt, copy.command_buffer<VkCommandBuffer>());
+  REQUIRE(copy.size() == stream.size());
+  REQUIRE(copy.bytes() == stream.bytes());
+  // Replaying through a table that doesn't resolve a recorded command fails.
+  REQUIRE_THROWS_AS(stream.replay(device::deferred_table{ }, VkCommandBuffer{ }), error);
+  stream.clear();
+  REQUIRE(stream.size() == 0);
+  REQUIRE(stream.bytes() == 0);
+  vkCmdSetLineWidth(command_buffer, 1.0f);
+  REQUIRE(replay().widths == std::vector<float>{ 1.0f });
+}
+
+TEST_CASE("Command streams should copy nested and strided payloads.", "[dispatch][recording]") {
+  using namespace megatech::vulkan::dispatch;
+  auto dt = device::deferred_table{ };
+  dt.defer<device::command::vkCmdPipelineBarrier2, PFN_vkCmdPipelineBarrier2>();
+  dt.defer<device::command::vkCmdBeginRenderPass, PFN_vkCmdBeginRenderPass>();
+  dt.defer<device::command::vkCmdDrawMultiIndexedEXT, PFN_vkCmdDrawMultiIndexedEXT>();
+  dt.defer<device::command::vkCmdSetSampleMaskEXT, PFN_vkCmdSetSampleMaskEXT>();
+  DECLARE_DEVICE_PFN(dt, vkCmdPipelineBarrier2);
+  DECLARE_DEVICE_PFN(dt, vkCmdBeginRenderPass);
+  DECLARE_DEVICE_PFN(dt, vkCmdDrawMultiIndexedEXT);
+  DECLARE_DEVICE_PFN(dt, vkCmdSetSampleMaskEXT);
+  auto stream = device::command_stream{ 64 };
+  const auto command_buffer = stream.command_buffer<VkCommandBuffer>();
+  {
+    // Nested arrays are copied along with the structures that refer to them.
+    auto barriers = std::array<VkImageMemoryBarrier2, 2>{ };
+    for (auto i = std::size_t{ 0 }; i < barriers.size(); ++i)
+    {
+      barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+      barriers[i].srcQueueFamilyIndex = static_cast<std::uint32_t>(i + 1);
+    }
+    auto dependency_info = VkDependencyInfo{ };
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.imageMemoryBarrierCount = barriers.size();
+    dependency_info.pImageMemoryBarriers = barriers.data();
+    vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+    auto clears = std::array<VkClearValue, 3>{ };
+    for (auto i = std::size_t{ 0 }; i < clears.size(); ++i)
+    {
+      clears[i].color.float32[0] = static_cast<float>(i);
+    }
+    auto begin_info = VkRenderPassBeginInfo{ };
+    begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    begin_info.clearValueCount = clears.size();
+    begin_info.pClearValues = clears.data();
+    vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    // Multi-draw arrays are sized by their stride and sample masks are sized by their sample count.
+    auto draws = std::array<VkMultiDrawIndexedInfoEXT, 6>{ };
+    for (auto i = std::size_t{ 0 }; i < draws.size(); ++i)
+    {
+      draws[i].indexCount = static_cast<std::uint32_t>(i);
+    }
+    auto offset = std::int32_t{ -4 };
+    vkCmdDrawMultiIndexedEXT(command_buffer, 3, draws.data(), 1, 0, 2 * sizeof(VkMultiDrawIndexedInfoEXT), &offset);
+    auto mask = std::array<VkSampleMask, 2>{ 0x1, 0x2 };
+    vkCmdSetSampleMaskEXT(command_buffer, VK_SAMPLE_COUNT_64_BIT, mask.data());
+    barriers.fill(VkImageMemoryBarrier2{ });
+    clears.fill(VkClearValue{ });
+    draws.fill(VkMultiDrawIndexedInfoEXT{ });
+    offset = 0;
+    mask.fill(0);
+    // Extension chains aren't described, so calls that use them aren't recorded.
+    auto chained = VkMemoryBarrier2{ };
+    chained.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    dependency_info.pNext = &chained;
+    REQUIRE_THROWS_AS(vkCmdPipelineBarrier2(command_buffer, &dependency_info), error);
+    dependency_info.pNext = nullptr;
+    barriers[0].pNext = &chained;
+    REQUIRE_THROWS_AS(vkCmdPipelineBarrier2(command_buffer, &dependency_info), error);
+  }
+  REQUIRE(stream.size() == 4);
+  auto calls = recorded_calls{ };
+  t_calls = &calls;
+  stream.replay(checking_table{ }, VkCommandBuffer{ });
+  REQUIRE(calls.barriers.size() == 2);
+  REQUIRE(calls.barriers[0].srcQueueFamilyIndex == 1);
+  REQUIRE(calls.barriers[1].srcQueueFamilyIndex == 2);
+  REQUIRE(calls.clears == std::vector<float>{ 0.0f, 1.0f, 2.0f });
+  REQUIRE(calls.draws == std::vector<std::uint32_t>{ 0, 2, 4 });
+  REQUIRE(calls.offsets == std::vector<std::int32_t>{ -4 });
+  REQUIRE(calls.masks == std::vector<VkSampleMask>{ 0x1, 0x2 });
+}
+
+TEST_CASE("Command streams should replay into device command buffers.", "[dispatch][recording]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    DECLARE_DEVICE_PFN(ddt, vkCreateCommandPool);
+    DECLARE_DEVICE_PFN(ddt, vkAllocateCommandBuffers);
+    DECLARE_DEVICE_PFN(ddt, vkBeginCommandBuffer);
+    DECLARE_DEVICE_PFN(ddt, vkEndCommandBuffer);
+    DECLARE_DEVICE_PFN(ddt, vkDestroyCommandPool);
+    auto dt = device::deferred_table{ };
+    dt.defer<device::command::vkCmdSetViewport, PFN_vkCmdSetViewport>();
+    dt.defer<device::command::vkCmdSetScissor, PFN_vkCmdSetScissor>();
+    DECLARE_DEVICE_PFN(dt, vkCmdSetViewport);
+    DECLARE_DEVICE_PFN(dt, vkCmdSetScissor);
+    // Recording doesn't require a command pool.
+    auto stream = device::command_stream{ };
+    const auto current = viewport(1.0f);
+    auto scissor = VkRect2D{ };
+    scissor.extent.width = 1;
+    scissor.extent.height = 1;
+    vkCmdSetViewport(stream.command_buffer<VkCommandBuffer>(), 0, 1, &current);
+    vkCmdSetScissor(stream.command_buffer<VkCommandBuffer>(), 0, 1, &scissor);
+    auto pool_info = VkCommandPoolCreateInfo{ };
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.queueFamilyIndex = 0;
+    auto pool = VkCommandPool{ };
+    VK_CHECK(vkCreateCommandPool(device, &pool_info, nullptr, &pool));
+    auto allocate_info = VkCommandBufferAllocateInfo{ };
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.commandPool = pool;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = 2;
+    auto command_buffers = std::array<VkCommandBuffer, 2>{ };
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocate_info, command_buffers.data()));
+    auto begin_info = VkCommandBufferBeginInfo{ };
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    for (const auto command_buffer : command_buffers)
+    {
+      VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
+      stream.replay(ddt, command_buffer);
+      VK_CHECK(vkEndCommandBuffer(command_buffer));
+    }
+    vkDestroyCommandPool(device, pool, nullptr);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}
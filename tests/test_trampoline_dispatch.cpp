@@ -0,0 +1,82 @@
+#include <cinttypes>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+
+TEST_CASE("Trampoline instance tables should route commands through named trampolines.", "[dispatch][trampolines]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  {
+    auto itt = instance::trampoline_table{ idt };
+    REQUIRE(itt.instance() == instance);
+    REQUIRE(!itt.routed(instance::command::vkEnumeratePhysicalDevices));
+    REQUIRE(*reinterpret_cast<const PFN_vkVoidFunction*>(itt(instance::command::vkEnumeratePhysicalDevices)) ==
+            *reinterpret_cast<const PFN_vkVoidFunction*>(idt(instance::command::vkEnumeratePhysicalDevices)));
+    itt.route<instance::command::vkEnumeratePhysicalDevices, PFN_vkEnumeratePhysicalDevices>();
+    REQUIRE(itt.routed(instance::command::vkEnumeratePhysicalDevices));
+    REQUIRE(!itt.routed(instance::command::vkDestroyInstance));
+    REQUIRE(*reinterpret_cast<const PFN_vkVoidFunction*>(itt(instance::command::vkEnumeratePhysicalDevices)) !=
+            *reinterpret_cast<const PFN_vkVoidFunction*>(idt(instance::command::vkEnumeratePhysicalDevices)));
+    DECLARE_INSTANCE_PFN(itt, vkEnumeratePhysicalDevices);
+    auto sz = std::uint32_t{ 0 };
+    VK_CHECK(vkEnumeratePhysicalDevices(instance, &sz, nullptr));
+    REQUIRE(sz > 0);
+    auto physical_devices = std::vector<VkPhysicalDevice>(sz);
+    VK_CHECK(vkEnumeratePhysicalDevices(instance, &sz, physical_devices.data()));
+    const auto path = std::filesystem::temp_directory_path() / "test-trampoline-dispatch.map";
+    std::filesystem::remove(path);
+    REQUIRE(itt.write_perf_map(path) == 1);
+    // Writing the map again doesn't duplicate its entries.
+    REQUIRE(itt.write_perf_map(path) == 1);
+    {
+      auto input = std::ifstream{ path };
+      auto line = std::string{ };
+      REQUIRE(std::getline(input, line));
+      REQUIRE(line.ends_with(" mvd_trampoline_vkEnumeratePhysicalDevices"));
+      REQUIRE(!std::getline(input, line));
+    }
+    std::filesystem::remove(path);
+    itt.restore<instance::command::vkEnumeratePhysicalDevices>();
+    REQUIRE(!itt.routed(instance::command::vkEnumeratePhysicalDevices));
+    REQUIRE(*reinterpret_cast<const PFN_vkVoidFunction*>(itt(instance::command::vkEnumeratePhysicalDevices)) ==
+            *reinterpret_cast<const PFN_vkVoidFunction*>(idt(instance::command::vkEnumeratePhysicalDevices)));
+  }
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+TEST_CASE("Trampoline device tables should route commands without results.", "[dispatch][trampolines]") {
+  using namespace megatech::vulkan::dispatch;
+  auto gdt = global::table{ vkGetInstanceProcAddr };
+  auto instance = create_instance(gdt);
+  auto idt = instance::table{ gdt, instance };
+  auto device = create_device(idt);
+  auto ddt = device::table{ gdt, idt, device };
+  {
+    auto dtt = device::trampoline_table{ ddt };
+    REQUIRE(dtt.device() == device);
+    dtt.route<device::command::vkGetDeviceQueue, PFN_vkGetDeviceQueue>();
+    REQUIRE(dtt.routed(device::command::vkGetDeviceQueue));
+    DECLARE_DEVICE_PFN(dtt, vkGetDeviceQueue);
+    auto routed = VkQueue{ };
+    auto direct = VkQueue{ };
+    vkGetDeviceQueue(device, 0, 0, &routed);
+    (*reinterpret_cast<const PFN_vkGetDeviceQueue*>(ddt(device::command::vkGetDeviceQueue)))(device, 0, 0, &direct);
+    REQUIRE(routed != nullptr);
+    REQUIRE(routed == direct);
+  }
+  DECLARE_DEVICE_PFN(ddt, vkDestroyDevice);
+  vkDestroyDevice(device, nullptr);
+  DECLARE_INSTANCE_PFN(idt, vkDestroyInstance);
+  vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char** argv) {
+  return Catch::Session().run(argc, argv);
+}